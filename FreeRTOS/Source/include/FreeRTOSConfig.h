@@ -100,6 +100,31 @@
 #endif
 #endif
 
+/* Set to 1 to keep software timers in a timing wheel, with constant time
+   start and stop done without the timer command queue. See
+   portable/esp8266/timers_wheel.c. */
+#ifndef configUSE_TIMER_WHEEL
+#define configUSE_TIMER_WHEEL 0
+#endif
+
+/* Set to 1 to stop the tick and halt the CPU while all tasks are blocked,
+   see core/include/tickless.h. */
+#ifndef configUSE_TICKLESS_IDLE
+#define configUSE_TICKLESS_IDLE 0
+#endif
+
+/* Allow xTaskCreateStatic() etc. The idle and timer task stacks are then
+   statically allocated as well, see port.c */
+#ifndef configSUPPORT_STATIC_ALLOCATION
+#define configSUPPORT_STATIC_ALLOCATION 1
+#endif
+
+/* Set to 1 to record the longest critical sections, see
+   xPortGetCriticalStats() in portmacro.h */
+#ifndef configCRITICAL_SECTION_STATS
+#define configCRITICAL_SECTION_STATS 0
+#endif
+
 /* Co-routine definitions. */
 #ifndef configUSE_CO_ROUTINES
 #define configUSE_CO_ROUTINES 		0
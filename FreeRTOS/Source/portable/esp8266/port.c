@@ -71,9 +71,14 @@
 
 #include <xtensa/config/core.h>
 #include <malloc.h>
+#include <slab.h>
+#include <tickless.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <xtensa_ops.h>
+#include <esplibs/libmain.h>
+#include <open_esplibs.h>
+#include <string.h>
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -168,8 +173,54 @@ void IRAM SV_ISR(void)
 	}
 }
 
+#if configGENERATE_RUN_TIME_STATS
+/* CCOUNT extended to 64 bits. It must be sampled at least once per
+   2^32 cycles (26s at 160MHz), which the tick interrupt takes care of
+   (tickless sleeps are limited to 2^31 cycles). */
+static uint32_t run_time_ccount;
+static uint64_t run_time_cycles;
+
+/* Accumulated by _xt_isr_handler */
+extern bool esp_in_isr;
+extern uint32_t esp_isr_enter_ccount;
+extern uint64_t esp_isr_cycles;
+
+static inline uint64_t IRAM run_time_update(uint32_t *now)
+{
+    RSR(*now, ccount);
+    run_time_cycles += *now - run_time_ccount;
+    run_time_ccount = *now;
+    return run_time_cycles;
+}
+
+/* Cycles spent outside interrupt handlers, so a task switched out from
+   an ISR isn't charged for the time the ISR has run so far. */
+uint32_t IRAM ulPortGetRunTimeCounter( void )
+{
+    uint32_t ps = _xt_disable_interrupts();
+    uint32_t now;
+    uint64_t cycles = run_time_update(&now) - esp_isr_cycles;
+    if(esp_in_isr)
+        cycles -= now - esp_isr_enter_ccount;
+    _xt_restore_interrupts(ps);
+    return cycles >> portRUN_TIME_SHIFT;
+}
+
+uint32_t ulPortGetIsrRunTime( void )
+{
+    uint32_t ps = _xt_disable_interrupts();
+    uint64_t cycles = esp_isr_cycles;
+    _xt_restore_interrupts(ps);
+    return cycles >> portRUN_TIME_SHIFT;
+}
+#endif
+
 void xPortSysTickHandle (void)
 {
+#if configGENERATE_RUN_TIME_STATS
+	uint32_t now;
+	run_time_update(&now);
+#endif
 	//CloseNMI();
 	{
 		if(xTaskIncrementTick() !=pdFALSE )
@@ -180,6 +231,49 @@ void xPortSysTickHandle (void)
 	//OpenNMI();
 }
 
+#if configUSE_TICKLESS_IDLE
+/* Called by the idle task with the scheduler suspended when no task needs
+   to run for xExpectedIdleTime ticks. Moves the CCOMPARE0 tick out and
+   halts the CPU until the next interrupt, then accounts for the ticks
+   that passed. sdk__xt_timer_int always schedules the next tick relative
+   to the previous CCOMPARE0 value, so the tick phase is kept. */
+void IRAM vPortSuppressTicksAndSleep( TickType_t xExpectedIdleTime )
+{
+    tickless_sleep_t sleep;
+    uint32_t ps, now, compare, new_compare, ticks;
+    uint32_t tick_cycles = portTICK_PERIOD_MS * sdk_os_get_cpu_frequency() * 1000;
+
+    ps = _xt_disable_interrupts();
+    RSR(now, ccount);
+    RSR(compare, ccompare0);
+    if( eTaskConfirmSleepModeStatus() == eAbortSleep
+        || !tickless_plan( &sleep, compare, now, tick_cycles, xExpectedIdleTime ) )
+    {
+        _xt_restore_interrupts(ps);
+        return;
+    }
+    WSR(sleep.target, ccompare0);
+    ESYNC();
+
+    /* WAITI lowers the interrupt level to 0, any pending or new interrupt
+       is handled before it returns */
+    __asm__ volatile ("waiti 0" ::: "memory");
+
+    _xt_disable_interrupts();
+    RSR(now, ccount);
+    RSR(compare, ccompare0);
+    ticks = tickless_wake( &sleep, now, compare, &new_compare );
+    if( new_compare != compare )
+    {
+        WSR(new_compare, ccompare0);
+        ESYNC();
+    }
+    vTaskStepTick( ticks );
+    tickless_account( ticks, compare == sleep.target );
+    _xt_restore_interrupts(ps);
+}
+#endif
+
 /*
  * See header file for description.
  */
@@ -210,7 +304,8 @@ portBASE_TYPE xPortStartScheduler( void )
 /* Determine free heap size via libc sbrk function & mallinfo
 
    sbrk gives total size in totally unallocated memory,
-   mallinfo.fordblks gives free space inside area dedicated to heap.
+   mallinfo.fordblks gives free space inside area dedicated to heap,
+   slab_free_bytes gives free space held by the small object allocator.
 
    mallinfo is possibly non-portable, although glibc & newlib both support
    the fordblks member.
@@ -223,7 +318,7 @@ size_t xPortGetFreeHeapSize( void )
     intptr_t sp = (intptr_t)xPortSupervisorStackPointer;
     if(sp == 0) /* scheduler not started */
         SP(sp);
-    return sp - brk_val + mi.fordblks;
+    return sp - brk_val + mi.fordblks + slab_free_bytes();
 }
 
 void vPortEndScheduler( void )
@@ -237,26 +332,199 @@ void vPortEndScheduler( void )
 variable. */
 static unsigned portBASE_TYPE uxCriticalNesting = 0;
 
+/* _xt_timing_critical_ints and the state of the current critical section
+   are shared with _xt_isr_mask/_xt_isr_unmask, see esp/interrupts.h */
+
+#if configCRITICAL_SECTION_STATS
+static uint32_t critical_start_ccount;
+static void *critical_caller;
+static PortCriticalStat_t critical_stats[portCRITICAL_STATS_COUNT];
+
+/* Keep the longest sections, replacing the shortest one recorded */
+static inline void IRAM critical_record(void)
+{
+    uint32_t now, cycles;
+    int shortest = 0;
+
+    RSR(now, ccount);
+    cycles = now - critical_start_ccount;
+    for(int i = 1; i < portCRITICAL_STATS_COUNT; i++) {
+        if(critical_stats[i].cycles < critical_stats[shortest].cycles)
+            shortest = i;
+    }
+    if(cycles > critical_stats[shortest].cycles) {
+        critical_stats[shortest].cycles = cycles;
+        critical_stats[shortest].caller = critical_caller;
+    }
+}
+#endif
+
 /* These nested vPortEnter/ExitCritical macros are called by SDK
  * libraries in libmain, libnet80211, libpp
  *
  * It may be possible to replace the global nesting count variable
  * with a save/restore of interrupt level, although it's difficult as
  * the functions have no return value.
+ *
+ * By default a critical section masks all level 1 interrupts via
+ * PS.INTLEVEL. If vPortSetTimingCriticalInterrupts() has been called,
+ * the outermost section instead clears every other bit in INTENABLE,
+ * so the timing critical interrupts keep running.
  */
 void IRAM vPortEnterCritical( void )
 {
-    portDISABLE_INTERRUPTS();
-    uxCriticalNesting++;
+    uint32_t ps = 0;
+
+    if( _xt_timing_critical_ints == 0 )
+        portDISABLE_INTERRUPTS();
+    else
+        ps = _xt_disable_interrupts();
+
+    if( uxCriticalNesting++ == 0 )
+    {
+        if( _xt_timing_critical_ints != 0 )
+        {
+            uint32_t intenable;
+            RSR(intenable, intenable);
+            _xt_critical_saved_intenable = intenable;
+            WSR(intenable & _xt_timing_critical_ints, intenable);
+            ESYNC();
+            _xt_critical_masked = true;
+        }
+#if configCRITICAL_SECTION_STATS
+        RSR(critical_start_ccount, ccount);
+        critical_caller = __builtin_return_address(0);
+#endif
+    }
+
+    if( _xt_critical_masked )
+        _xt_restore_interrupts(ps);
 }
 /*-----------------------------------------------------------*/
 
 void IRAM vPortExitCritical( void )
 {
-    uxCriticalNesting--;
+    uint32_t ps = 0;
+    bool masked = _xt_critical_masked;
+
+    if( masked )
+        ps = _xt_disable_interrupts();
+
+    if( --uxCriticalNesting == 0 )
+    {
+#if configCRITICAL_SECTION_STATS
+        critical_record();
+#endif
+        if( masked )
+        {
+            _xt_critical_masked = false;
+            WSR(_xt_critical_saved_intenable, intenable);
+            ESYNC();
+        }
+        else
+        {
+            portENABLE_INTERRUPTS();
+        }
+    }
+
+    if( masked )
+        _xt_restore_interrupts(ps);
+}
+
+/* vPortYield() brackets vTaskSwitchContext() with these. Interrupt entry
+   saves the interrupted context through pxCurrentTCB, so no interrupt
+   can be allowed in while it changes, timing critical or not. */
+static uint32_t switch_ps;
+
+void IRAM vPortEnterSwitchCritical( void )
+{
+    switch_ps = _xt_disable_interrupts();
+}
+
+void IRAM vPortExitSwitchCritical( void )
+{
+    _xt_restore_interrupts(switch_ps);
+}
+
+bool vPortSetTimingCriticalInterrupts( uint32_t mask )
+{
+#if !OPEN_LIBMAIN_OS_CPU_A
+    /* The binary vPortYield uses vPortEnterCritical around the context
+       switch and the binary interrupt mask functions don't know about
+       _xt_critical_saved_intenable. */
+    if( mask != 0 )
+        return false;
+#endif
+    bool ok = false;
+    uint32_t ps = _xt_disable_interrupts();
     if( uxCriticalNesting == 0 )
-	portENABLE_INTERRUPTS();
+    {
+        _xt_timing_critical_ints = mask;
+        ok = true;
+    }
+    _xt_restore_interrupts(ps);
+    return ok;
+}
+
+#if configCRITICAL_SECTION_STATS
+int xPortGetCriticalStats( PortCriticalStat_t *stats, int max )
+{
+    PortCriticalStat_t sorted[portCRITICAL_STATS_COUNT];
+    int n = 0;
+
+    uint32_t ps = _xt_disable_interrupts();
+    for(int i = 0; i < portCRITICAL_STATS_COUNT; i++) {
+        if(critical_stats[i].cycles == 0)
+            continue;
+        /* Longest first */
+        int j = n++;
+        while(j > 0 && sorted[j - 1].cycles < critical_stats[i].cycles) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = critical_stats[i];
+    }
+    _xt_restore_interrupts(ps);
+
+    if(n > max)
+        n = max;
+    memcpy(stats, sorted, n * sizeof(PortCriticalStat_t));
+    return n;
+}
+
+void vPortResetCriticalStats( void )
+{
+    uint32_t ps = _xt_disable_interrupts();
+    memset(critical_stats, 0, sizeof(critical_stats));
+    _xt_restore_interrupts(ps);
+}
+#endif
+
+#if configSUPPORT_STATIC_ALLOCATION
+/* With static allocation enabled, the kernel asks for the idle and timer
+   task memory rather than allocating it itself */
+void vApplicationGetIdleTaskMemory( StaticTask_t **ppxIdleTaskTCBBuffer, StackType_t **ppxIdleTaskStackBuffer, uint32_t *pulIdleTaskStackSize )
+{
+    static StaticTask_t xIdleTaskTCB;
+    static StackType_t uxIdleTaskStack[ configMINIMAL_STACK_SIZE ];
+
+    *ppxIdleTaskTCBBuffer = &xIdleTaskTCB;
+    *ppxIdleTaskStackBuffer = uxIdleTaskStack;
+    *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+
+#if configUSE_TIMERS
+void vApplicationGetTimerTaskMemory( StaticTask_t **ppxTimerTaskTCBBuffer, StackType_t **ppxTimerTaskStackBuffer, uint32_t *pulTimerTaskStackSize )
+{
+    static StaticTask_t xTimerTaskTCB;
+    static StackType_t uxTimerTaskStack[ configTIMER_TASK_STACK_DEPTH ];
+
+    *ppxTimerTaskTCBBuffer = &xTimerTaskTCB;
+    *ppxTimerTaskStackBuffer = uxTimerTaskStack;
+    *pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
 }
+#endif
+#endif
 
 /* Backward compatibility with libmain.a and libpp.a and can remove when these are open. */
 signed portBASE_TYPE xTaskGenericCreate( TaskFunction_t pxTaskCode, const signed char * const pcName, unsigned short usStackDepth, void *pvParameters, unsigned portBASE_TYPE uxPriority, TaskHandle_t *pxCreatedTask, portSTACK_TYPE *puxStackBuffer, const MemoryRegion_t * const xRegions )
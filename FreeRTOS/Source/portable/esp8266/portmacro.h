@@ -180,6 +180,57 @@ void vPortExitCritical( void );
 #define portENTER_CRITICAL()                vPortEnterCritical()
 #define portEXIT_CRITICAL()                 vPortExitCritical()
 
+/* Used by vPortYield() around the context switch, masks all interrupts */
+void vPortEnterSwitchCritical( void );
+void vPortExitSwitchCritical( void );
+
+/* Keep the interrupts in 'mask' (BIT(INUM_TIMER_FRC1) etc.) enabled inside
+   critical sections, so that for example a bit-banging timer interrupt
+   isn't delayed by lwIP or SPIFFS. Critical sections then mask the other
+   interrupts through INTENABLE rather than PS.INTLEVEL.
+
+   The handlers of these interrupts must not call any FreeRTOS function
+   or take part in anything protected by a critical section, and must be
+   in IRAM (critical sections are held while the flash cache is
+   disabled). Pass 0 to go back to masking everything. Returns false if
+   called inside a critical section, or with the binary libmain os_cpu_a
+   (OPEN_LIBMAIN_OS_CPU_A=0). */
+bool vPortSetTimingCriticalInterrupts( uint32_t mask );
+
+/* With configCRITICAL_SECTION_STATS, the portCRITICAL_STATS_COUNT longest
+   critical sections are recorded with the address they were entered
+   from. */
+#if configCRITICAL_SECTION_STATS
+#define portCRITICAL_STATS_COUNT 8
+
+typedef struct {
+    uint32_t cycles;
+    void *caller;
+} PortCriticalStat_t;
+
+/* Copy up to 'max' records, longest first. Returns the number copied. */
+int xPortGetCriticalStats( PortCriticalStat_t *stats, int max );
+void vPortResetCriticalStats( void );
+#endif
+
+/* Run time statistics, counted in CPU cycles >> portRUN_TIME_SHIFT (so
+   the 32-bit counters wrap after ~28 minutes at 160MHz). Time spent in
+   interrupt handlers is not charged to the interrupted task but counted
+   separately, see ulPortGetIsrRunTime(). */
+#if configGENERATE_RUN_TIME_STATS
+#define portRUN_TIME_SHIFT 6
+uint32_t ulPortGetRunTimeCounter( void );
+uint32_t ulPortGetIsrRunTime( void );
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE() ulPortGetRunTimeCounter()
+#endif
+
+/* Tickless idle, see core/include/tickless.h */
+#if configUSE_TICKLESS_IDLE
+void vPortSuppressTicksAndSleep( TickType_t xExpectedIdleTime );
+#define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime ) vPortSuppressTicksAndSleep( xExpectedIdleTime )
+#endif
+
 /* Task function macros as described on the FreeRTOS.org WEB site.  These are
 not necessary for to use this port.  They are defined so the common demo files
 (which build with all the ports) will build. */
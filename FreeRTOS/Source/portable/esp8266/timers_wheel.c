@@ -0,0 +1,590 @@
+/* FreeRTOS software timers on a timing wheel
+ *
+ * With configUSE_TIMER_WHEEL set to 1 this file implements the xTimer API
+ * from timers.h in place of FreeRTOS/Source/timers.c, keeping active
+ * timers in a core/timer_wheel.c hierarchical timing wheel rather than a
+ * sorted list.
+ *
+ * Starting, resetting, stopping and changing the period of a timer are
+ * constant time, so they are done directly by the calling task or
+ * interrupt in a short critical section instead of being queued for the
+ * timer service task. They never block or fail, and xTicksToWait is
+ * ignored. The service task is only notified when the change means it
+ * has to wake earlier than it planned to.
+ *
+ * Callbacks still all run in the timer service task, which takes each
+ * expired timer off the wheel and reloads it (if it auto-reloads) in a
+ * critical section, then runs its callback with interrupts enabled.
+ *
+ * Deleting a timer and xTimerPendFunctionCall() still go through the
+ * configTIMER_QUEUE_LENGTH command queue, which the service task drains
+ * whenever it wakes. A deleted timer stops straight away, its memory is
+ * freed by the service task. Commands that don't fit in the queue are
+ * counted, see timer_service_get_stats() in timer_wheel.h.
+ *
+ * The FromISR functions must not be called from interrupts set with
+ * vPortSetTimingCriticalInterrupts(), as those can interrupt a critical
+ * section.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stddef.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "timers.h"
+
+#if ( configUSE_TIMERS == 1 ) && ( configUSE_TIMER_WHEEL == 1 )
+
+#include "timer_wheel.h"
+
+#define tmrNO_DELAY		( TickType_t ) 0U
+
+typedef struct tmrTimerControl
+{
+    const char *pcTimerName;
+    union
+    {
+        timer_wheel_node_t xNode;
+        StaticListItem_t xSpace;    /* Keeps Timer_t the size of StaticTimer_t */
+    } u;
+    TickType_t xTimerPeriodInTicks;
+    UBaseType_t uxAutoReload;
+    void *pvTimerID;
+    TimerCallbackFunction_t pxCallbackFunction;
+    #if( configUSE_TRACE_FACILITY == 1 )
+        UBaseType_t uxTimerNumber;
+    #endif
+    #if( ( configSUPPORT_STATIC_ALLOCATION == 1 ) && ( configSUPPORT_DYNAMIC_ALLOCATION == 1 ) )
+        uint8_t ucStaticallyAllocated;
+    #endif
+} Timer_t;
+
+_Static_assert(sizeof(Timer_t) == sizeof(StaticTimer_t), "StaticTimer_t doesn't fit Timer_t");
+
+/* Messages for the service task. Only deletes and pended function calls
+   are queued. */
+typedef struct tmrTimerQueueMessage
+{
+    BaseType_t xMessageID;
+    union
+    {
+        Timer_t *pxTimer;
+        #if ( INCLUDE_xTimerPendFunctionCall == 1 )
+            struct
+            {
+                PendedFunction_t pxCallbackFunction;
+                void *pvParameter1;
+                uint32_t ulParameter2;
+            } xCallbackParameters;
+        #endif
+    } u;
+} DaemonTaskMessage_t;
+
+/* Active timers, shared with the calling tasks under a critical section */
+static timer_wheel_t xWheel;
+
+static QueueHandle_t xTimerQueue = NULL;
+static TaskHandle_t xTimerTaskHandle = NULL;
+
+/* Set while the service task is blocked until xDaemonWakeTime (or
+   indefinitely if xDaemonBlockForever), so starting a timer due earlier
+   than that wakes it */
+static volatile BaseType_t xDaemonWaiting = pdFALSE;
+static TickType_t xDaemonWakeTime;
+static BaseType_t xDaemonBlockForever;
+
+static uint32_t ulCommandsQueued;
+static uint32_t ulCommandsDropped;
+static uint32_t ulMaxBatch;
+
+#if( configSUPPORT_STATIC_ALLOCATION == 1 )
+    extern void vApplicationGetTimerTaskMemory( StaticTask_t **ppxTimerTaskTCBBuffer, StackType_t **ppxTimerTaskStackBuffer, uint32_t *pulTimerTaskStackSize );
+#endif
+
+static void prvCheckForValidListAndQueue( void )
+{
+    taskENTER_CRITICAL();
+    if( xTimerQueue == NULL )
+    {
+        timer_wheel_init( &xWheel, xTaskGetTickCount() );
+        #if( configSUPPORT_STATIC_ALLOCATION == 1 )
+        {
+            static StaticQueue_t xStaticTimerQueue;
+            static uint8_t ucStaticTimerQueueStorage[ configTIMER_QUEUE_LENGTH * sizeof( DaemonTaskMessage_t ) ];
+
+            xTimerQueue = xQueueCreateStatic( ( UBaseType_t ) configTIMER_QUEUE_LENGTH, sizeof( DaemonTaskMessage_t ), &( ucStaticTimerQueueStorage[ 0 ] ), &xStaticTimerQueue );
+        }
+        #else
+        {
+            xTimerQueue = xQueueCreate( ( UBaseType_t ) configTIMER_QUEUE_LENGTH, sizeof( DaemonTaskMessage_t ) );
+        }
+        #endif
+        #if ( configQUEUE_REGISTRY_SIZE > 0 )
+        {
+            if( xTimerQueue != NULL )
+            {
+                vQueueAddToRegistry( xTimerQueue, "TmrQ" );
+            }
+        }
+        #endif
+    }
+    taskEXIT_CRITICAL();
+}
+
+/* Call in a critical section. Returns pdTRUE if the service task needs
+   waking for the timer. */
+static BaseType_t prvAddTimer( Timer_t *pxTimer, TickType_t xStart, TickType_t xTicks )
+{
+    TickType_t xDue;
+
+    timer_wheel_add( &xWheel, &pxTimer->u.xNode, xStart, xTicks );
+    if( xDaemonWaiting == pdFALSE )
+    {
+        return pdFALSE;
+    }
+    xDue = pxTimer->u.xNode.expiry - xWheel.now;
+    if( ( int32_t ) xDue < 0 )
+    {
+        xDue = 0;
+    }
+    if( xDaemonBlockForever != pdFALSE || xDue < ( TickType_t ) ( xDaemonWakeTime - xWheel.now ) )
+    {
+        /* One notification is enough */
+        xDaemonWaiting = pdFALSE;
+        return pdTRUE;
+    }
+    return pdFALSE;
+}
+
+static BaseType_t prvSendToDaemon( const DaemonTaskMessage_t *pxMessage, TickType_t xTicksToWait, BaseType_t *pxHigherPriorityTaskWoken, BaseType_t xFromISR )
+{
+    BaseType_t xReturn;
+
+    if( xFromISR != pdFALSE )
+    {
+        xReturn = xQueueSendToBackFromISR( xTimerQueue, pxMessage, pxHigherPriorityTaskWoken );
+    }
+    else
+    {
+        if( xTaskGetSchedulerState() != taskSCHEDULER_RUNNING )
+        {
+            xTicksToWait = tmrNO_DELAY;
+        }
+        xReturn = xQueueSendToBack( xTimerQueue, pxMessage, xTicksToWait );
+    }
+    ulCommandsQueued++;
+    if( xReturn != pdPASS )
+    {
+        ulCommandsDropped++;
+    }
+    else if( xTimerTaskHandle != NULL )
+    {
+        if( xFromISR != pdFALSE )
+        {
+            vTaskNotifyGiveFromISR( xTimerTaskHandle, pxHigherPriorityTaskWoken );
+        }
+        else
+        {
+            xTaskNotifyGive( xTimerTaskHandle );
+        }
+    }
+    return xReturn;
+}
+
+static void prvProcessExpiredTimers( TickType_t xTimeNow )
+{
+    for( ;; )
+    {
+        Timer_t *pxTimer = NULL;
+
+        taskENTER_CRITICAL();
+        {
+            timer_wheel_node_t *pxNode = timer_wheel_expire( &xWheel, xTimeNow );
+
+            if( pxNode != NULL )
+            {
+                pxTimer = ( Timer_t * ) ( ( char * ) pxNode - offsetof( Timer_t, u.xNode ) );
+                if( pxTimer->uxAutoReload == ( UBaseType_t ) pdTRUE )
+                {
+                    /* Relative to when it was due, if that has already
+                       passed it comes straight back round */
+                    timer_wheel_add( &xWheel, pxNode, pxNode->expiry, pxTimer->xTimerPeriodInTicks );
+                }
+            }
+        }
+        taskEXIT_CRITICAL();
+
+        if( pxTimer == NULL )
+        {
+            break;
+        }
+        traceTIMER_EXPIRED( pxTimer );
+        pxTimer->pxCallbackFunction( ( TimerHandle_t ) pxTimer );
+    }
+}
+
+static void prvProcessReceivedCommands( void )
+{
+    DaemonTaskMessage_t xMessage;
+    uint32_t ulBatch = 0;
+
+    while( xQueueReceive( xTimerQueue, &xMessage, tmrNO_DELAY ) != pdFAIL )
+    {
+        ulBatch++;
+        #if ( INCLUDE_xTimerPendFunctionCall == 1 )
+        {
+            if( xMessage.xMessageID < ( BaseType_t ) 0 )
+            {
+                xMessage.u.xCallbackParameters.pxCallbackFunction( xMessage.u.xCallbackParameters.pvParameter1, xMessage.u.xCallbackParameters.ulParameter2 );
+                continue;
+            }
+        }
+        #endif
+        traceTIMER_COMMAND_RECEIVED( xMessage.u.pxTimer, xMessage.xMessageID, 0 );
+        if( xMessage.xMessageID == tmrCOMMAND_DELETE )
+        {
+            /* Make sure a callback didn't restart it */
+            taskENTER_CRITICAL();
+            timer_wheel_remove( &xWheel, &xMessage.u.pxTimer->u.xNode );
+            taskEXIT_CRITICAL();
+            vPortFree( xMessage.u.pxTimer );
+        }
+    }
+    if( ulBatch > ulMaxBatch )
+    {
+        ulMaxBatch = ulBatch;
+    }
+}
+
+static void prvTimerTask( void *pvParameters )
+{
+    ( void ) pvParameters;
+
+    #if( configUSE_DAEMON_TASK_STARTUP_HOOK == 1 )
+    {
+        extern void vApplicationDaemonTaskStartupHook( void );
+        vApplicationDaemonTaskStartupHook();
+    }
+    #endif
+
+    for( ;; )
+    {
+        TickType_t xWait = portMAX_DELAY;
+        uint32_t ulNext;
+
+        prvProcessExpiredTimers( xTaskGetTickCount() );
+        prvProcessReceivedCommands();
+
+        taskENTER_CRITICAL();
+        {
+            xDaemonBlockForever = !timer_wheel_next( &xWheel, &ulNext );
+            if( xDaemonBlockForever == pdFALSE )
+            {
+                xDaemonWakeTime = ulNext;
+                xWait = ulNext - xTaskGetTickCount();
+                if( ( int32_t ) xWait < 0 )
+                {
+                    xWait = 0;
+                }
+            }
+            xDaemonWaiting = ( xWait != 0 );
+        }
+        taskEXIT_CRITICAL();
+
+        if( xWait != 0 )
+        {
+            ( void ) ulTaskNotifyTake( pdTRUE, xWait );
+            xDaemonWaiting = pdFALSE;
+        }
+    }
+}
+
+BaseType_t xTimerCreateTimerTask( void )
+{
+    BaseType_t xReturn = pdFAIL;
+
+    prvCheckForValidListAndQueue();
+
+    if( xTimerQueue != NULL )
+    {
+        #if( configSUPPORT_STATIC_ALLOCATION == 1 )
+        {
+            StaticTask_t *pxTimerTaskTCBBuffer = NULL;
+            StackType_t *pxTimerTaskStackBuffer = NULL;
+            uint32_t ulTimerTaskStackSize;
+
+            vApplicationGetTimerTaskMemory( &pxTimerTaskTCBBuffer, &pxTimerTaskStackBuffer, &ulTimerTaskStackSize );
+            xTimerTaskHandle = xTaskCreateStatic( prvTimerTask, "Tmr Svc", ulTimerTaskStackSize, NULL,
+                                                  ( ( UBaseType_t ) configTIMER_TASK_PRIORITY ) | portPRIVILEGE_BIT,
+                                                  pxTimerTaskStackBuffer, pxTimerTaskTCBBuffer );
+            if( xTimerTaskHandle != NULL )
+            {
+                xReturn = pdPASS;
+            }
+        }
+        #else
+        {
+            xReturn = xTaskCreate( prvTimerTask, "Tmr Svc", configTIMER_TASK_STACK_DEPTH, NULL,
+                                   ( ( UBaseType_t ) configTIMER_TASK_PRIORITY ) | portPRIVILEGE_BIT,
+                                   &xTimerTaskHandle );
+        }
+        #endif
+    }
+
+    configASSERT( xReturn );
+    return xReturn;
+}
+
+static void prvInitialiseNewTimer( const char * const pcTimerName, const TickType_t xTimerPeriodInTicks, const UBaseType_t uxAutoReload, void * const pvTimerID, TimerCallbackFunction_t pxCallbackFunction, Timer_t *pxNewTimer )
+{
+    configASSERT( ( xTimerPeriodInTicks > 0 ) );
+
+    prvCheckForValidListAndQueue();
+    pxNewTimer->pcTimerName = pcTimerName;
+    pxNewTimer->xTimerPeriodInTicks = xTimerPeriodInTicks;
+    pxNewTimer->uxAutoReload = uxAutoReload;
+    pxNewTimer->pvTimerID = pvTimerID;
+    pxNewTimer->pxCallbackFunction = pxCallbackFunction;
+    pxNewTimer->u.xNode.pprev = NULL;
+    traceTIMER_CREATE( pxNewTimer );
+}
+
+#if( configSUPPORT_DYNAMIC_ALLOCATION == 1 )
+
+TimerHandle_t xTimerCreate( const char * const pcTimerName, const TickType_t xTimerPeriodInTicks, const UBaseType_t uxAutoReload, void * const pvTimerID, TimerCallbackFunction_t pxCallbackFunction )
+{
+    Timer_t *pxNewTimer = ( Timer_t * ) pvPortMalloc( sizeof( Timer_t ) );
+
+    if( pxNewTimer != NULL )
+    {
+        prvInitialiseNewTimer( pcTimerName, xTimerPeriodInTicks, uxAutoReload, pvTimerID, pxCallbackFunction, pxNewTimer );
+        #if( configSUPPORT_STATIC_ALLOCATION == 1 )
+            pxNewTimer->ucStaticallyAllocated = pdFALSE;
+        #endif
+    }
+    else
+    {
+        traceTIMER_CREATE_FAILED();
+    }
+    return pxNewTimer;
+}
+
+#endif
+
+#if( configSUPPORT_STATIC_ALLOCATION == 1 )
+
+TimerHandle_t xTimerCreateStatic( const char * const pcTimerName, const TickType_t xTimerPeriodInTicks, const UBaseType_t uxAutoReload, void * const pvTimerID, TimerCallbackFunction_t pxCallbackFunction, StaticTimer_t *pxTimerBuffer )
+{
+    Timer_t *pxNewTimer = ( Timer_t * ) pxTimerBuffer;
+
+    configASSERT( pxTimerBuffer );
+    if( pxNewTimer != NULL )
+    {
+        prvInitialiseNewTimer( pcTimerName, xTimerPeriodInTicks, uxAutoReload, pvTimerID, pxCallbackFunction, pxNewTimer );
+        #if( configSUPPORT_DYNAMIC_ALLOCATION == 1 )
+            pxNewTimer->ucStaticallyAllocated = pdTRUE;
+        #endif
+    }
+    return pxNewTimer;
+}
+
+#endif
+
+BaseType_t xTimerGenericCommand( TimerHandle_t xTimer, const BaseType_t xCommandID, const TickType_t xOptionalValue, BaseType_t * const pxHigherPriorityTaskWoken, const TickType_t xTicksToWait )
+{
+    Timer_t *pxTimer = ( Timer_t * ) xTimer;
+    const BaseType_t xFromISR = ( xCommandID >= tmrFIRST_FROM_ISR_COMMAND );
+    BaseType_t xReturn = pdPASS;
+    BaseType_t xWake = pdFALSE;
+    UBaseType_t uxSavedInterruptStatus = 0;
+    TickType_t xTimeNow;
+
+    configASSERT( xTimer );
+
+    if( xFromISR != pdFALSE )
+    {
+        xTimeNow = xTaskGetTickCountFromISR();
+        uxSavedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+    }
+    else
+    {
+        xTimeNow = xTaskGetTickCount();
+        taskENTER_CRITICAL();
+    }
+
+    switch( xCommandID )
+    {
+        case tmrCOMMAND_START :
+        case tmrCOMMAND_START_FROM_ISR :
+        case tmrCOMMAND_RESET :
+        case tmrCOMMAND_RESET_FROM_ISR :
+        case tmrCOMMAND_START_DONT_TRACE :
+            xWake = prvAddTimer( pxTimer, xOptionalValue, pxTimer->xTimerPeriodInTicks );
+            break;
+
+        case tmrCOMMAND_CHANGE_PERIOD :
+        case tmrCOMMAND_CHANGE_PERIOD_FROM_ISR :
+            configASSERT( ( xOptionalValue > 0 ) );
+            pxTimer->xTimerPeriodInTicks = xOptionalValue;
+            xWake = prvAddTimer( pxTimer, xTimeNow, xOptionalValue );
+            break;
+
+        case tmrCOMMAND_STOP :
+        case tmrCOMMAND_STOP_FROM_ISR :
+        case tmrCOMMAND_DELETE :
+            timer_wheel_remove( &xWheel, &pxTimer->u.xNode );
+            break;
+
+        default :
+            xReturn = pdFAIL;
+            break;
+    }
+
+    if( xFromISR != pdFALSE )
+    {
+        portCLEAR_INTERRUPT_MASK_FROM_ISR( uxSavedInterruptStatus );
+        if( xWake != pdFALSE )
+        {
+            vTaskNotifyGiveFromISR( xTimerTaskHandle, pxHigherPriorityTaskWoken );
+        }
+    }
+    else
+    {
+        taskEXIT_CRITICAL();
+        if( xWake != pdFALSE )
+        {
+            xTaskNotifyGive( xTimerTaskHandle );
+        }
+    }
+
+    if( xCommandID == tmrCOMMAND_DELETE )
+    {
+        #if( configSUPPORT_DYNAMIC_ALLOCATION == 1 )
+        {
+            #if( configSUPPORT_STATIC_ALLOCATION == 1 )
+            if( pxTimer->ucStaticallyAllocated == ( uint8_t ) pdFALSE )
+            #endif
+            {
+                DaemonTaskMessage_t xMessage;
+
+                /* The service task might be running its callback */
+                xMessage.xMessageID = tmrCOMMAND_DELETE;
+                xMessage.u.pxTimer = pxTimer;
+                xReturn = prvSendToDaemon( &xMessage, xTicksToWait, NULL, pdFALSE );
+            }
+        }
+        #endif
+    }
+
+    traceTIMER_COMMAND_SEND( xTimer, xCommandID, xOptionalValue, xReturn );
+    return xReturn;
+}
+
+TaskHandle_t xTimerGetTimerDaemonTaskHandle( void )
+{
+    configASSERT( ( xTimerTaskHandle != NULL ) );
+    return xTimerTaskHandle;
+}
+
+TickType_t xTimerGetPeriod( TimerHandle_t xTimer )
+{
+    configASSERT( xTimer );
+    return ( ( Timer_t * ) xTimer )->xTimerPeriodInTicks;
+}
+
+TickType_t xTimerGetExpiryTime( TimerHandle_t xTimer )
+{
+    configASSERT( xTimer );
+    return ( ( Timer_t * ) xTimer )->u.xNode.expiry;
+}
+
+const char * pcTimerGetName( TimerHandle_t xTimer )
+{
+    configASSERT( xTimer );
+    return ( ( Timer_t * ) xTimer )->pcTimerName;
+}
+
+BaseType_t xTimerIsTimerActive( TimerHandle_t xTimer )
+{
+    BaseType_t xActive;
+
+    configASSERT( xTimer );
+    taskENTER_CRITICAL();
+    xActive = timer_wheel_pending( &( ( Timer_t * ) xTimer )->u.xNode );
+    taskEXIT_CRITICAL();
+    return xActive;
+}
+
+void *pvTimerGetTimerID( const TimerHandle_t xTimer )
+{
+    void *pvReturn;
+
+    configASSERT( xTimer );
+    taskENTER_CRITICAL();
+    pvReturn = ( ( Timer_t * ) xTimer )->pvTimerID;
+    taskEXIT_CRITICAL();
+    return pvReturn;
+}
+
+void vTimerSetTimerID( TimerHandle_t xTimer, void *pvNewID )
+{
+    configASSERT( xTimer );
+    taskENTER_CRITICAL();
+    ( ( Timer_t * ) xTimer )->pvTimerID = pvNewID;
+    taskEXIT_CRITICAL();
+}
+
+#if( INCLUDE_xTimerPendFunctionCall == 1 )
+
+BaseType_t xTimerPendFunctionCallFromISR( PendedFunction_t xFunctionToPend, void *pvParameter1, uint32_t ulParameter2, BaseType_t *pxHigherPriorityTaskWoken )
+{
+    DaemonTaskMessage_t xMessage;
+    BaseType_t xReturn;
+
+    xMessage.xMessageID = tmrCOMMAND_EXECUTE_CALLBACK_FROM_ISR;
+    xMessage.u.xCallbackParameters.pxCallbackFunction = xFunctionToPend;
+    xMessage.u.xCallbackParameters.pvParameter1 = pvParameter1;
+    xMessage.u.xCallbackParameters.ulParameter2 = ulParameter2;
+    xReturn = prvSendToDaemon( &xMessage, tmrNO_DELAY, pxHigherPriorityTaskWoken, pdTRUE );
+    tracePEND_FUNC_CALL_FROM_ISR( xFunctionToPend, pvParameter1, ulParameter2, xReturn );
+    return xReturn;
+}
+
+BaseType_t xTimerPendFunctionCall( PendedFunction_t xFunctionToPend, void *pvParameter1, uint32_t ulParameter2, TickType_t xTicksToWait )
+{
+    DaemonTaskMessage_t xMessage;
+    BaseType_t xReturn;
+
+    configASSERT( xTimerQueue );
+    xMessage.xMessageID = tmrCOMMAND_EXECUTE_CALLBACK;
+    xMessage.u.xCallbackParameters.pxCallbackFunction = xFunctionToPend;
+    xMessage.u.xCallbackParameters.pvParameter1 = pvParameter1;
+    xMessage.u.xCallbackParameters.ulParameter2 = ulParameter2;
+    xReturn = prvSendToDaemon( &xMessage, xTicksToWait, NULL, pdFALSE );
+    tracePEND_FUNC_CALL( xFunctionToPend, pvParameter1, ulParameter2, xReturn );
+    return xReturn;
+}
+
+#endif /* INCLUDE_xTimerPendFunctionCall */
+
+void timer_service_get_stats(timer_service_stats_t *stats)
+{
+    uint32_t far = 0;
+
+    taskENTER_CRITICAL();
+    for (const timer_wheel_node_t *node = xWheel.overflow; node; node = node->next) {
+        far++;
+    }
+    stats->active = xWheel.active;
+    stats->peak = xWheel.peak;
+    stats->cascades = xWheel.cascades;
+    stats->far = far;
+    stats->commands = ulCommandsQueued;
+    stats->dropped = ulCommandsDropped;
+    stats->max_batch = ulMaxBatch;
+    taskEXIT_CRITICAL();
+}
+
+#endif /* configUSE_TIMERS && configUSE_TIMER_WHEEL */
@@ -31,6 +31,7 @@
 #include "esplibs/libphy.h"
 #include "esplibs/libpp.h"
 #include "sysparam.h"
+#include "boot_profile.h"
 
 /* This is not declared in any header file (but arguably should be) */
 
@@ -147,6 +148,7 @@ void IRAM sdk_user_start(void) {
     uint32_t sysparam_addr;
     sysparam_status_t status;
 
+    boot_profile_mark("reset");
     SPI(0).USER0 |= SPI_USER0_CS_SETUP;
     sdk_SPIRead(0, buf32, 4);
 
@@ -197,6 +199,7 @@ void IRAM sdk_user_start(void) {
     ic_flash_addr = (flash_sectors - 3 + boot_slot) * sdk_flashchip.sector_size;
     sdk_SPIRead(ic_flash_addr, buf32, sizeof(struct sdk_g_ic_saved_st));
     Cache_Read_Enable(0, 0, 1);
+    boot_profile_mark("flash config");
     zero_bss();
     sdk_os_install_putc1(default_putc);
     if (cksum_magic == 0xffffffff) {
@@ -210,6 +213,7 @@ void IRAM sdk_user_start(void) {
         //FIXME: should we halt here? (original SDK code doesn't)
     }
     memcpy(&sdk_g_ic.s, buf32, sizeof(struct sdk_g_ic_saved_st));
+    boot_profile_mark("bss, checksum");
 
     // By default, put the sysparam region just below the config sectors at the
     // top of the flash space
@@ -224,6 +228,7 @@ void IRAM sdk_user_start(void) {
     if (status != SYSPARAM_OK) {
         printf("WARNING: Could not initialize sysparams (%d)!\n", status);
     }
+    boot_profile_mark("sysparam");
 
     user_start_phase2();
 }
@@ -348,7 +353,9 @@ void sdk_user_init_task(void *params) {
     printf("phy ver: %d, ", phy_ver);
     pp_ver = RTCMEM_SYSTEM[RTCMEM_SYSTEM_PP_VER];
     printf("pp ver: %d.%d\n\n", (pp_ver >> 8) & 0xff, pp_ver & 0xff);
+    boot_profile_mark("scheduler");
     user_init();
+    boot_profile_mark("user_init");
     sdk_user_init_flag = 1;
     sdk_wifi_mode_set(sdk_g_ic.s.wifi_mode);
     if (sdk_g_ic.s.wifi_mode == 1) {
@@ -367,6 +374,8 @@ void sdk_user_init_task(void *params) {
     if (sdk_wifi_station_get_auto_connect()) {
         sdk_wifi_station_connect();
     }
+    boot_profile_mark("wifi start");
+    deferred_init_start();
     vTaskDelete(NULL);
 }
 
@@ -394,6 +403,7 @@ static __attribute__((noinline)) void user_start_phase2(void) {
     sdk_info.softap_netmask.addr = 0x00ffffff; // 255.255.255.0
     sdk_info.softap_gw.addr = 0x0104a8c0;      // 192.168.4.1
     init_g_ic();
+    boot_profile_mark("rtc, mac, g_ic");
 
     read_saved_phy_info(&phy_info);
     get_default_phy_info(&default_phy_info);
@@ -410,8 +420,10 @@ static __attribute__((noinline)) void user_start_phase2(void) {
     // Wait for UARTs to finish sending anything in their queues.
     uart_flush_txfifo(0);
     uart_flush_txfifo(1);
+    boot_profile_mark("phy info, uart flush");
 
     init_networking(&phy_info, sdk_info.sta_mac_addr);
+    boot_profile_mark("phy, networking");
 
     srand(hwrand()); /* seed libc rng */
 
@@ -424,6 +436,7 @@ static __attribute__((noinline)) void user_start_phase2(void) {
     for ( ctor = &__init_array_start; ctor != &__init_array_end; ++ctor) {
         (*ctor)();
     }
+    boot_profile_mark("constructors");
 
     tcpip_init(NULL, NULL);
     sdk_wdt_init();
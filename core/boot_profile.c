@@ -0,0 +1,143 @@
+/* Boot time profiler and deferred initialisation
+ *
+ * See boot_profile.h
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "event_groups.h"
+#include "common_macros.h"
+#include "xtensa_ops.h"
+#include "esplibs/libmain.h"
+#include "boot_profile.h"
+
+typedef struct {
+    const char *name;
+    uint32_t ccount;
+    uint8_t mhz;
+} boot_mark_t;
+
+static boot_mark_t marks[BOOT_PROFILE_MARKS] RAM;
+static uint8_t n_marks RAM;
+
+typedef struct {
+    const char *name;
+    deferred_init_fn_t fn;
+    void *arg;
+} deferred_init_t;
+
+#define DEFERRED_DONE BIT(0)
+
+static deferred_init_t deferred[DEFERRED_INIT_MAX];
+static uint8_t n_deferred;
+static bool deferred_started;
+static EventGroupHandle_t deferred_events;
+
+void IRAM boot_profile_mark(const char *name)
+{
+    uint32_t ccount;
+
+    RSR(ccount, ccount);
+    if (n_marks < BOOT_PROFILE_MARKS) {
+        marks[n_marks].name = name;
+        marks[n_marks].ccount = ccount;
+        marks[n_marks].mhz = sdk_os_get_cpu_frequency();
+        n_marks++;
+    }
+}
+
+/* Microseconds between marks i - 1 and i */
+static uint32_t interval_us(int i)
+{
+    return (marks[i].ccount - marks[i - 1].ccount) / marks[i - 1].mhz;
+}
+
+uint32_t boot_profile_elapsed_us(void)
+{
+    uint32_t us = 0;
+
+    for (int i = 1; i < n_marks; i++) {
+        us += interval_us(i);
+    }
+    return us;
+}
+
+bool boot_profile_get(unsigned i, const char **name, uint32_t *us, uint32_t *phase_us)
+{
+    uint32_t t = 0;
+
+    if (i >= n_marks) {
+        return false;
+    }
+    for (unsigned j = 1; j <= i; j++) {
+        t += interval_us(j);
+    }
+    *name = marks[i].name;
+    *us = t;
+    *phase_us = i ? interval_us(i) : 0;
+    return true;
+}
+
+void boot_profile_print(void)
+{
+    const char *name;
+    uint32_t us, phase;
+
+    printf("    time(us)   phase(us)  mark\n");
+    for (unsigned i = 0; boot_profile_get(i, &name, &us, &phase); i++) {
+        printf("%12u %11u  %s\n", us, phase, name);
+    }
+    if (n_marks == BOOT_PROFILE_MARKS) {
+        printf("(further marks dropped)\n");
+    }
+}
+
+bool deferred_init_add(const char *name, deferred_init_fn_t fn, void *arg)
+{
+    bool ok = false;
+
+    taskENTER_CRITICAL();
+    if (!deferred_started && n_deferred < DEFERRED_INIT_MAX) {
+        deferred[n_deferred].name = name;
+        deferred[n_deferred].fn = fn;
+        deferred[n_deferred].arg = arg;
+        n_deferred++;
+        ok = true;
+    }
+    taskEXIT_CRITICAL();
+    return ok;
+}
+
+static void deferred_init_task(void *params)
+{
+    for (int i = 0; i < n_deferred; i++) {
+        deferred[i].fn(deferred[i].arg);
+        boot_profile_mark(deferred[i].name);
+    }
+    xEventGroupSetBits(deferred_events, DEFERRED_DONE);
+    vTaskDelete(NULL);
+}
+
+void deferred_init_start(void)
+{
+    deferred_events = xEventGroupCreate();
+    taskENTER_CRITICAL();
+    deferred_started = true;
+    taskEXIT_CRITICAL();
+    if (n_deferred == 0 || xTaskCreate(deferred_init_task, "init", DEFERRED_INIT_STACK_SIZE,
+                                       NULL, DEFERRED_INIT_PRIORITY, NULL) != pdPASS) {
+        xEventGroupSetBits(deferred_events, DEFERRED_DONE);
+    }
+}
+
+bool deferred_init_wait(TickType_t ticks)
+{
+    if (!deferred_started) {
+        /* Called from user_init(), which would never return */
+        return false;
+    }
+    return xEventGroupWaitBits(deferred_events, DEFERRED_DONE, pdFALSE, pdTRUE, ticks) & DEFERRED_DONE;
+}
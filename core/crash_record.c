@@ -0,0 +1,215 @@
+/* Crash records kept across resets
+ *
+ * See crash_record.h
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <string.h>
+#include <stdio.h>
+#include <malloc.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "crash_record.h"
+#include "common_macros.h"
+#include "xtensa_ops.h"
+#include "esp/rtcmem_regs.h"
+#include "espressif/spi_flash.h"
+
+_Static_assert(sizeof(crash_record_t) <= CRASH_RECORD_FLASH_SLOT, "crash_record_t too large for flash slot");
+_Static_assert(CRASH_RECORD_WORDS <= 64, "crash_record_t too large for RTC memory");
+
+/* Magic of a record in RTC memory not yet seen by crash_record_init() */
+#define CRASH_RECORD_MAGIC_NEW 0x4e445243     /* "CRDN" */
+
+#define RTC_RECORD (&RTCMEM_USER[128 - CRASH_RECORD_WORDS])
+
+#define SLOTS (SPI_FLASH_SEC_SIZE / CRASH_RECORD_FLASH_SLOT)
+
+static uint32_t flash_base;
+
+static uint32_t checksum(const uint32_t *words)
+{
+    uint32_t sum = 0;
+
+    for (int i = 2; i < CRASH_RECORD_WORDS; i++) {
+        sum += words[i];
+    }
+    return ~sum;
+}
+
+static bool valid(const crash_record_t *rec)
+{
+    return (rec->magic == CRASH_RECORD_MAGIC || rec->magic == CRASH_RECORD_MAGIC_NEW)
+        && rec->check == checksum((const uint32_t *)rec);
+}
+
+/* RTC memory only supports 32 bit access */
+static void rtc_read(crash_record_t *rec)
+{
+    uint32_t *words = (uint32_t *)rec;
+
+    for (int i = 0; i < CRASH_RECORD_WORDS; i++) {
+        words[i] = RTC_RECORD[i];
+    }
+}
+
+static void rtc_write(crash_record_t *rec)
+{
+    const uint32_t *words = (uint32_t *)rec;
+
+    rec->check = checksum(words);
+    for (int i = 0; i < CRASH_RECORD_WORDS; i++) {
+        RTC_RECORD[i] = words[i];
+    }
+}
+
+static bool in_dram(const uint32_t *p)
+{
+    return (intptr_t)p >= 0x3ffe8000 && (intptr_t)p < 0x3fffc000 && !((intptr_t)p & 3);
+}
+
+void crash_record_capture(crash_reason_t reason, uint32_t *sp, uint32_t *regs, uint32_t *caller)
+{
+    crash_record_t rec;
+    uint32_t seq;
+
+    rtc_read(&rec);
+    seq = valid(&rec) ? rec.seq + 1 : 1;
+    memset(&rec, 0, sizeof(rec));
+    rec.magic = CRASH_RECORD_MAGIC_NEW;
+    rec.seq = seq;
+    rec.reason = reason;
+    rec.uptime_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    rec.a[1] = (intptr_t)sp;
+    if (reason == CRASH_EXCEPTION) {
+        RSR(rec.exccause, exccause);
+        RSR(rec.epc1, epc1);
+        RSR(rec.epc2, epc2);
+        RSR(rec.epc3, epc3);
+        RSR(rec.excvaddr, excvaddr);
+        RSR(rec.depc, depc);
+        RSR(rec.a[0], excsave1);
+    } else {
+        rec.epc1 = (intptr_t)caller;
+        rec.a[0] = (intptr_t)caller;
+    }
+    /* Same layout as dump_registers_in_exception_handler() */
+    if (regs) {
+        for (int a = 2; a < 14; a++) {
+            rec.a[a] = regs[a + 3];
+        }
+        rec.sar = regs[0x13];
+    }
+    /* Save in steps, the registers first, then the stack, the task name
+       and the heap: each may be what is corrupt, and reading it fault
+       again before anything is kept */
+    rec.free_heap = 0xffffffff;
+    rtc_write(&rec);
+
+    if (in_dram(sp)) {
+        for (int i = 0; i < CRASH_RECORD_STACK_WORDS && in_dram(sp + i); i++) {
+            rec.stack[i] = sp[i];
+        }
+        rtc_write(&rec);
+    }
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    if (task) {
+        strncpy(rec.task, pcTaskGetName(task), sizeof(rec.task) - 1);
+        rtc_write(&rec);
+    }
+
+    struct mallinfo mi = mallinfo();
+    rec.free_heap = xPortGetFreeHeapSize();
+    rec.heap_used = mi.uordblks;
+    rtc_write(&rec);
+}
+
+bool crash_record_last(crash_record_t *rec)
+{
+    rtc_read(rec);
+    if (!valid(rec)) {
+        return false;
+    }
+    rec->magic = CRASH_RECORD_MAGIC;
+    return true;
+}
+
+static bool flash_slot_read(int slot, crash_record_t *rec)
+{
+    return sdk_spi_flash_read(flash_base + slot * CRASH_RECORD_FLASH_SLOT,
+                              (uint32_t *)rec, sizeof(*rec)) == SPI_FLASH_RESULT_OK;
+}
+
+/* Index of the first empty slot in the sector, or SLOTS if it is full */
+static int flash_used(void)
+{
+    uint32_t magic;
+    int slot;
+
+    for (slot = 0; slot < SLOTS; slot++) {
+        if (sdk_spi_flash_read(flash_base + slot * CRASH_RECORD_FLASH_SLOT, &magic, 4) != SPI_FLASH_RESULT_OK
+            || magic == 0xffffffff) {
+            break;
+        }
+    }
+    return slot;
+}
+
+bool crash_record_init(uint32_t flash_addr)
+{
+    crash_record_t rec;
+
+    flash_base = flash_addr;
+    rtc_read(&rec);
+    if (!valid(&rec) || rec.magic != CRASH_RECORD_MAGIC_NEW) {
+        return false;
+    }
+    rec.magic = CRASH_RECORD_MAGIC;
+    rtc_write(&rec);
+    if (flash_base) {
+        int slot = flash_used();
+        if (slot == SLOTS) {
+            crash_record_erase();
+            slot = 0;
+        }
+        if (sdk_spi_flash_write(flash_base + slot * CRASH_RECORD_FLASH_SLOT,
+                                (uint32_t *)&rec, sizeof(rec)) != SPI_FLASH_RESULT_OK) {
+            printf("crash_record: flash write failed\n");
+        }
+    }
+    return true;
+}
+
+int crash_record_count(void)
+{
+    return flash_base ? flash_used() : 0;
+}
+
+bool crash_record_read(int index, crash_record_t *rec)
+{
+    if (!flash_base || index < 0 || index >= SLOTS || !flash_slot_read(index, rec)) {
+        return false;
+    }
+    return rec->magic == CRASH_RECORD_MAGIC && valid(rec);
+}
+
+bool crash_record_erase(void)
+{
+    if (!flash_base) {
+        return false;
+    }
+    return sdk_spi_flash_erase_sector(flash_base / SPI_FLASH_SEC_SIZE) == SPI_FLASH_RESULT_OK;
+}
+
+void crash_record_print(const crash_record_t *rec)
+{
+    const uint8_t *bytes = (const uint8_t *)rec;
+
+    printf("CR:");
+    for (int i = 0; i < sizeof(*rec); i++) {
+        printf("%02x", bytes[i]);
+    }
+    printf("\n");
+}
@@ -15,6 +15,7 @@
 #include <unistd.h>
 
 #include "debug_dumps.h"
+#include "crash_record.h"
 #include "common_macros.h"
 #include "xtensa_ops.h"
 #include "esp/rom.h"
@@ -22,6 +23,9 @@
 #include "espressif/esp_common.h"
 #include "esplibs/libmain.h"
 
+/* Defined if extras/heap_trace is linked in */
+void heap_trace_dump(void) __attribute__((weak));
+
 /* Forward declarations */
 static void IRAM fatal_handler_prelude(void);
 /* Inner parts of crash handlers */
@@ -166,6 +170,10 @@ static void standard_fatal_exception_handler_inner(uint32_t *sp, bool registers_
        don't end up in a crash loop if this handler crashes. */
     fatal_exception_handler_inner = second_fatal_exception_handler_inner;
     dump_excinfo();
+    /* After the UART dump, so the cause and PC get out even if capturing
+       faults */
+    crash_record_capture(CRASH_EXCEPTION, sp,
+                         sp && registers_saved_on_stack ? sp - (0x50 / sizeof(uint32_t)) : NULL, NULL);
     if (sp) {
         if (registers_saved_on_stack) {
             dump_registers_in_exception_handler(sp);
@@ -218,6 +226,11 @@ void dump_heapinfo(void)
      */
     printf("arena (total_size) %d fordblks (free_size) %d uordblocks (used_size) %d\n",
            mi.arena, mi.fordblks, mi.uordblks);
+
+    /* Most recent allocations, for decoding with utils/heap_trace.py */
+    if(heap_trace_dump) {
+        heap_trace_dump();
+    }
 }
 
 /* Main part of abort handler, can be run from flash to save some
@@ -225,6 +238,8 @@ void dump_heapinfo(void)
 */
 static void abort_handler_inner(uint32_t *caller, uint32_t *sp) {
     printf("abort() invoked at %p.\n", caller);
+    /* After the UART message, as on the exception path */
+    crash_record_capture(CRASH_ABORT, sp, NULL, caller);
     dump_stack(sp);
     dump_heapinfo();
     post_crash_reset();
@@ -29,6 +29,11 @@
      bits after handling interrupts. This gives you full control, but
      you can't combine it with the first approach.
 
+   Pins in gpio_capture_mask are passed to gpio_capture_hook instead of
+   their gpXX_interrupt_handler(), this is how extras/gpio_capture
+   timestamps edges. A gpio_interrupt_handler() of your own replaces
+   that too.
+
 
   Part of esp-open-rtos
   Copyright (C) 2015 Superhouse Automation Pty Ltd
@@ -65,10 +70,18 @@ const gpio_interrupt_handler_t gpio_interrupt_handlers[16] = {
     gpio12_interrupt_handler, gpio13_interrupt_handler, gpio14_interrupt_handler,
     gpio15_interrupt_handler };
 
+uint32_t gpio_capture_mask;
+gpio_capture_hook_t gpio_capture_hook;
+
 void __attribute__((weak)) IRAM gpio_interrupt_handler(void)
 {
     uint32_t status_reg = GPIO.STATUS;
     GPIO.STATUS_CLEAR = status_reg;
+    if(status_reg & gpio_capture_mask)
+    {
+        gpio_capture_hook(status_reg & gpio_capture_mask);
+        status_reg &= ~gpio_capture_mask;
+    }
     uint8_t gpio_idx;
     while((gpio_idx = __builtin_ffs(status_reg)))
     {
@@ -6,11 +6,23 @@
  * BSD Licensed as described in the file LICENSE
  */
 #include <esp/interrupts.h>
+#include <xtensa_ops.h>
+#include "FreeRTOS.h"
 
 _xt_isr isr[16];
 
 bool esp_in_isr;
 
+uint32_t _xt_timing_critical_ints;
+bool _xt_critical_masked;
+uint32_t _xt_critical_saved_intenable;
+
+#if configGENERATE_RUN_TIME_STATS
+/* Time spent in this handler, for the FreeRTOS run time stats (port.c) */
+uint32_t esp_isr_enter_ccount;
+uint64_t esp_isr_cycles;
+#endif
+
 void IRAM _xt_isr_attach(uint8_t i, _xt_isr func)
 {
     isr[i] = func;
@@ -23,6 +35,9 @@ void IRAM _xt_isr_attach(uint8_t i, _xt_isr func)
 uint16_t IRAM _xt_isr_handler(uint16_t intset)
 {
     esp_in_isr = true;
+#if configGENERATE_RUN_TIME_STATS
+    RSR(esp_isr_enter_ccount, ccount);
+#endif
 
     /* WDT has highest priority (occasional WDT resets otherwise) */
     if(intset & BIT(INUM_WDT)) {
@@ -39,6 +54,11 @@ uint16_t IRAM _xt_isr_handler(uint16_t intset)
         intset -= mask;
     }
 
+#if configGENERATE_RUN_TIME_STATS
+    uint32_t now;
+    RSR(now, ccount);
+    esp_isr_cycles += now - esp_isr_enter_ccount;
+#endif
     esp_in_isr = false;
 
     return 0;
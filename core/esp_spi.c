@@ -6,10 +6,13 @@
  * BSD Licensed as described in the file LICENSE
  */
 #include "esp/spi.h"
+#include "esp/spi2.h"
 
 #include "esp/iomux.h"
 #include "esp/gpio.h"
 #include <string.h>
+#include "FreeRTOS.h"
+#include "semphr.h"
 
 #define _SPI0_SCK_GPIO  6
 #define _SPI0_MISO_GPIO 7
@@ -29,7 +32,12 @@
 #define _SPI_BUF_SIZE 64
 #define __min(a,b) ((a > b) ? (b):(a))
 
-static bool _minimal_pins[2] = {false, false};
+/* Settings as written to the bus registers, see spi_device_acquire() */
+static spi_settings_t _applied[2];
+/* Registers may not match _applied, see spi_device_invalidate() */
+static bool _stale[2];
+
+static SemaphoreHandle_t _lock[2];
 
 bool spi_init(uint8_t bus, spi_mode_t mode, uint32_t freq_divider, bool msb, spi_endianness_t endianness, bool minimal_pins)
 {
@@ -57,7 +65,10 @@ bool spi_init(uint8_t bus, spi_mode_t mode, uint32_t freq_divider, bool msb, spi
             return false;
     }
 
-    _minimal_pins[bus] = minimal_pins;
+    if (!_lock[bus])
+        _lock[bus] = xSemaphoreCreateMutex();
+
+    _applied[bus].minimal_pins = minimal_pins;
     SPI(bus).USER0 = SPI_USER0_MOSI | SPI_USER0_CLOCK_IN_EDGE | SPI_USER0_DUPLEX |
         (minimal_pins ? 0 : (SPI_USER0_CS_HOLD | SPI_USER0_CS_SETUP));
 
@@ -75,7 +86,7 @@ void spi_get_settings(uint8_t bus, spi_settings_t *s)
     s->freq_divider = spi_get_frequency_div(bus);
     s->msb = spi_get_msb(bus);
     s->endianness = spi_get_endianness(bus);
-    s->minimal_pins = _minimal_pins[bus];
+    s->minimal_pins = _applied[bus].minimal_pins;
 }
 
 void spi_set_mode(uint8_t bus, spi_mode_t mode)
@@ -96,6 +107,8 @@ void spi_set_mode(uint8_t bus, spi_mode_t mode)
         SPI(bus).PIN |= SPI_PIN_IDLE_EDGE;
     else
         SPI(bus).PIN &= ~SPI_PIN_IDLE_EDGE;
+
+    _applied[bus].mode = mode;
 }
 
 spi_mode_t spi_get_mode(uint8_t bus)
@@ -112,6 +125,8 @@ void spi_set_msb(uint8_t bus, bool msb)
         SPI(bus).CTRL0 &= ~(SPI_CTRL0_WR_BIT_ORDER | SPI_CTRL0_RD_BIT_ORDER);
     else
         SPI(bus).CTRL0 |= (SPI_CTRL0_WR_BIT_ORDER | SPI_CTRL0_RD_BIT_ORDER);
+
+    _applied[bus].msb = msb;
 }
 
 void spi_set_endianness(uint8_t bus, spi_endianness_t endianness)
@@ -120,6 +135,8 @@ void spi_set_endianness(uint8_t bus, spi_endianness_t endianness)
         SPI(bus).USER0 |= (SPI_USER0_WR_BYTE_ORDER | SPI_USER0_RD_BYTE_ORDER);
     else
         SPI(bus).USER0 &= ~(SPI_USER0_WR_BYTE_ORDER | SPI_USER0_RD_BYTE_ORDER);
+
+    _applied[bus].endianness = endianness;
 }
 
 void spi_set_frequency_div(uint8_t bus, uint32_t divider)
@@ -139,6 +156,8 @@ void spi_set_frequency_div(uint8_t bus, uint32_t divider)
         IOMUX.CONF |= bus == 0 ? IOMUX_CONF_SPI0_CLOCK_EQU_SYS_CLOCK : IOMUX_CONF_SPI1_CLOCK_EQU_SYS_CLOCK;
         SPI(bus).CLOCK = SPI_CLOCK_EQU_SYS_CLOCK;
     }
+
+    _applied[bus].freq_divider = divider;
 }
 
 inline static void _set_size(uint8_t bus, uint8_t bytes)
@@ -223,7 +242,7 @@ uint32_t spi_transfer_32(uint8_t bus, uint32_t data)
 
 static void _rearm_extras_bit(uint8_t bus, bool arm) {
 
-    if(!_minimal_pins[bus]) return ;
+    if(!_applied[bus].minimal_pins) return ;
     static uint8_t status[2] ;
 
     if (arm)
@@ -302,3 +321,152 @@ void spi_repeat_send_32(uint8_t bus, uint32_t data,int32_t repeats)
 {
     _repeat_send(bus,&data,&repeats, SPI_32BIT);
 }
+
+/* Only write the registers for settings that change */
+static void _apply_settings(uint8_t bus, const spi_settings_t *s)
+{
+    spi_settings_t *a = &_applied[bus];
+    bool all = _stale[bus];
+
+    _stale[bus] = false;
+    if (all || s->mode != a->mode)
+        spi_set_mode(bus, s->mode);
+    if (all || s->freq_divider != a->freq_divider)
+        spi_set_frequency_div(bus, s->freq_divider);
+    if (all || s->msb != a->msb)
+        spi_set_msb(bus, s->msb);
+    if (all || s->endianness != a->endianness)
+        spi_set_endianness(bus, s->endianness);
+    if (all || s->minimal_pins != a->minimal_pins)
+    {
+        if (s->minimal_pins)
+            SPI(bus).USER0 &= ~(SPI_USER0_CS_HOLD | SPI_USER0_CS_SETUP);
+        else
+            SPI(bus).USER0 |= SPI_USER0_CS_HOLD | SPI_USER0_CS_SETUP;
+        a->minimal_pins = s->minimal_pins;
+    }
+}
+
+bool spi_device_acquire(const spi_device_t *dev, TickType_t timeout)
+{
+    uint8_t bus = dev->bus;
+
+    if (bus > 1 || !_lock[bus])
+        return false;
+    if (xSemaphoreTake(_lock[bus], timeout) != pdTRUE)
+        return false;
+
+    _apply_settings(bus, &dev->settings);
+    if (dev->cs_gpio != SPI_CS_NONE)
+        gpio_write(dev->cs_gpio, false);
+    return true;
+}
+
+void spi_device_release(const spi_device_t *dev)
+{
+    uint8_t bus = dev->bus;
+
+    _wait(bus);
+    if (dev->cs_gpio != SPI_CS_NONE)
+        gpio_write(dev->cs_gpio, true);
+    xSemaphoreGive(_lock[bus]);
+}
+
+void spi_device_invalidate(uint8_t bus)
+{
+    if (bus <= 1)
+        _stale[bus] = true;
+}
+
+/*
+ * esp/spi2.h interface, on top of the functions above
+ */
+
+void spi_init_gpio(uint8_t spi_no, uint8_t sysclk_as_spiclk)
+{
+    spi_init(spi_no, spi_get_mode(spi_no),
+        sysclk_as_spiclk ? SPI_FREQ_DIV_80M : spi_get_frequency_div(spi_no),
+        spi_get_msb(spi_no), spi_get_endianness(spi_no), false);
+}
+
+void spi_clock(uint8_t spi_no, uint16_t prediv, uint8_t cntdiv)
+{
+    if (spi_no > 1)
+        return;
+
+    spi_set_frequency_div(spi_no, prediv && cntdiv ? SPI_GET_FREQ_DIV(prediv, cntdiv) : SPI_FREQ_DIV_80M);
+}
+
+/* spi.h only knows both byte orders being the same */
+static void _set_byte_order(uint8_t bus, uint32_t bit, bool set)
+{
+    if (set)
+        SPI(bus).USER0 |= bit;
+    else
+        SPI(bus).USER0 &= ~bit;
+
+    uint32_t order = SPI(bus).USER0 & (SPI_USER0_WR_BYTE_ORDER | SPI_USER0_RD_BYTE_ORDER);
+    if (!order)
+        _applied[bus].endianness = SPI_LITTLE_ENDIAN;
+    else if (order == (SPI_USER0_WR_BYTE_ORDER | SPI_USER0_RD_BYTE_ORDER))
+        _applied[bus].endianness = SPI_BIG_ENDIAN;
+    else
+        _applied[bus].endianness = (spi_endianness_t)-1;  // rewritten by the next device
+}
+
+void spi_tx_byte_order(uint8_t spi_no, uint8_t byte_order)
+{
+    if (spi_no > 1)
+        return;
+
+    _set_byte_order(spi_no, SPI_USER0_WR_BYTE_ORDER, byte_order);
+}
+
+void spi_rx_byte_order(uint8_t spi_no, uint8_t byte_order)
+{
+    if (spi_no > 1)
+        return;
+
+    _set_byte_order(spi_no, SPI_USER0_RD_BYTE_ORDER, byte_order);
+}
+
+void spi_mode(uint8_t spi_no, uint8_t spi_cpha, uint8_t spi_cpol)
+{
+    spi_set_mode(spi_no, (spi_mode_t)((spi_cpol ? 2 : 0) | (spi_cpha ? 1 : 0)));
+}
+
+/* Send up to 32 bits from dout_data on HSPI, without waiting for them to
+   be sent */
+void IRAM spi_transaction(uint32_t dout_bits, uint32_t dout_data, uint8_t dummy_bits)
+{
+    const uint8_t bus = HSPIBUS;
+
+    _wait(bus);
+    SPI(bus).USER0 &= ~(SPI_USER0_MOSI | SPI_USER0_MISO | SPI_USER0_COMMAND | SPI_USER0_ADDR | SPI_USER0_DUMMY);
+    SPI(bus).USER1 = VAL2FIELD_M(SPI_USER1_MOSI_BITLEN, dout_bits - 1) |
+                     VAL2FIELD_M(SPI_USER1_DUMMY_CYCLELEN, dummy_bits - 1);
+    if (dummy_bits)
+        SPI(bus).USER0 |= SPI_USER0_DUMMY;
+
+    if (dout_bits)
+    {
+        SPI(bus).USER0 |= SPI_USER0_MOSI;
+        if (SPI(bus).USER0 & SPI_USER0_WR_BYTE_ORDER)
+        {
+            SPI(bus).W[0] = dout_data << (32 - dout_bits);
+        }
+        else
+        {
+            /* Move a part byte to the top of the last byte sent, so 12 bits
+               0xda4 go out as 0xa4 then 0xd */
+            uint8_t extra_bits = dout_bits % 8;
+            if (extra_bits)
+                SPI(bus).W[0] = ((0xffffffff << (dout_bits - extra_bits) & dout_data) << (8 - extra_bits)) |
+                                ((0xffffffff >> (32 - (dout_bits - extra_bits))) & dout_data);
+            else
+                SPI(bus).W[0] = dout_data;
+        }
+    }
+
+    _start(bus);
+}
@@ -0,0 +1,87 @@
+/* Boot time profiler and deferred initialisation
+ *
+ * boot_profile_mark() records the CPU cycle counter (CCOUNT) under a name.
+ * core/app_main.c marks each startup phase from sdk_user_start() up to
+ * user_init() and starting WiFi, and the program can add its own marks
+ * (e.g. "first sample"). boot_profile_print() prints them as a timeline.
+ * The marks live in .data so they survive zero_bss().
+ *
+ * Times are converted with the CPU clock frequency the SDK reports at each
+ * mark. Until sdk_register_chipv6_phy() sets up the PLL (the "phy" mark)
+ * an ESP8266 with a 26MHz crystal really runs at 52MHz rather than 80MHz,
+ * so phases before that take about 1.5 times as long as shown.
+ *
+ * Work that doesn't need to be done before the program's tasks start
+ * (mounting a filesystem, scanning a bus for sensors) can be passed to
+ * deferred_init_add() from user_init(). It then runs in its own low
+ * priority task once the startup code has finished, in the order added,
+ * with a boot_profile_mark() after each item.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _BOOT_PROFILE_H
+#define _BOOT_PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Marks beyond this many are dropped */
+#ifndef BOOT_PROFILE_MARKS
+#define BOOT_PROFILE_MARKS 32
+#endif
+
+#ifndef DEFERRED_INIT_MAX
+#define DEFERRED_INIT_MAX 8
+#endif
+
+#ifndef DEFERRED_INIT_PRIORITY
+#define DEFERRED_INIT_PRIORITY (tskIDLE_PRIORITY + 1)
+#endif
+
+#ifndef DEFERRED_INIT_STACK_SIZE
+#define DEFERRED_INIT_STACK_SIZE 512
+#endif
+
+/* Record the time now under 'name', which must be a string constant.
+   Safe to call from anywhere, including before the flash cache is
+   enabled. */
+void boot_profile_mark(const char *name);
+
+/* Microseconds from the first mark (sdk_user_start()) to the latest */
+uint32_t boot_profile_elapsed_us(void);
+
+/* Print all marks with the time of each since the first one and since
+   the previous one */
+void boot_profile_print(void);
+
+/* Mark 'i', counting from 0: its name, and microseconds since the first
+   mark and since the previous one. Returns false past the last mark. If
+   BOOT_PROFILE_MARKS were recorded, later ones were dropped. */
+bool boot_profile_get(unsigned i, const char **name, uint32_t *us, uint32_t *phase_us);
+
+typedef void (*deferred_init_fn_t)(void *arg);
+
+/* Run fn(arg) after startup in the deferred init task. 'name' (a string
+   constant) is used for its boot profile mark. Call this before the
+   startup code finishes, i.e. from user_init() or a constructor. Returns
+   false if there is no room or it is too late. */
+bool deferred_init_add(const char *name, deferred_init_fn_t fn, void *arg);
+
+/* Wait until all deferred initialisation has run. Returns false if it
+   hasn't finished within 'ticks'. */
+bool deferred_init_wait(TickType_t ticks);
+
+/* Called by core/app_main.c once user_init() has returned */
+void deferred_init_start(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _BOOT_PROFILE_H */
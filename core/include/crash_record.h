@@ -0,0 +1,99 @@
+/* Crash records kept across resets
+ *
+ * When a fatal exception or abort() happens the crash handler in
+ * debug_dumps.c stores a compact binary crash_record_t (registers, a
+ * window of the stack, task name, heap and uptime) at the top of the RTC
+ * user memory, which survives the reset that follows. It is still printed
+ * to the UART as before.
+ *
+ * On the next boot the program calls crash_record_init() from user_init()
+ * with the address of a flash sector it has set aside, and a new record
+ * is appended there. The program can then read the saved records and send
+ * them somewhere (e.g. publish them over MQTT as they are) and erase the
+ * sector. utils/crash_decode.py decodes records, symbolising addresses
+ * against the program's ELF file.
+ *
+ * The record takes the last CRASH_RECORD_WORDS words of RTCMEM_USER,
+ * i.e. sdk_system_rtc_mem_read/write() blocks 192 - CRASH_RECORD_WORDS
+ * to 191. RTC memory is undefined after power on, so records are only
+ * found after a reset.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _CRASH_RECORD_H
+#define _CRASH_RECORD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CRASH_RECORD_MAGIC 0x31445243        /* "CRD1" */
+#define CRASH_RECORD_STACK_WORDS 24
+
+/* Size of each record in the flash sector, 16 per sector */
+#define CRASH_RECORD_FLASH_SLOT 256
+
+typedef enum {
+    CRASH_EXCEPTION = 1,
+    CRASH_ABORT = 2,
+} crash_reason_t;
+
+/* All fields are 32 bit little endian words, for utils/crash_decode.py */
+typedef struct {
+    uint32_t magic;
+    uint32_t check;                 /* ~sum of the words after this one */
+    uint32_t seq;                   /* Crashes since power on, from 1 */
+    uint32_t reason;                /* crash_reason_t */
+    uint32_t exccause;
+    uint32_t epc1;                  /* Faulting instruction, or abort() caller */
+    uint32_t epc2;
+    uint32_t epc3;
+    uint32_t excvaddr;
+    uint32_t depc;
+    uint32_t a[16];                 /* a0 is the return address and a1 the
+                                       stack pointer. 0 where not saved. */
+    uint32_t sar;
+    uint32_t uptime_ms;
+    uint32_t free_heap;             /* 0xffffffff if it couldn't be read */
+    uint32_t heap_used;
+    char task[16];                  /* Empty before the scheduler starts */
+    uint32_t stack[CRASH_RECORD_STACK_WORDS];   /* From a1 up */
+} crash_record_t;
+
+#define CRASH_RECORD_WORDS (sizeof(crash_record_t) / 4)
+
+/* Look for a crash record left in RTC memory by the last reset, and if
+   flash_addr isn't 0 append it to the (sector aligned) flash sector there.
+   A full sector is erased first. Returns true if there was a new record. */
+bool crash_record_init(uint32_t flash_addr);
+
+/* Copy the last crash record (since power on) from RTC memory. Returns
+   false if there isn't one. */
+bool crash_record_last(crash_record_t *rec);
+
+/* Number of records in the flash sector */
+int crash_record_count(void);
+
+/* Read record 'index' (0 is the oldest) from the flash sector */
+bool crash_record_read(int index, crash_record_t *rec);
+
+/* Erase the flash sector, e.g. once the records have been uploaded */
+bool crash_record_erase(void);
+
+/* Print a record to stdout as a "CR:" line of hex, which
+   utils/crash_decode.py picks out of a console log */
+void crash_record_print(const crash_record_t *rec);
+
+/* Called by the crash handler. 'regs' points to the registers saved by
+   the exception vector or is NULL. */
+void crash_record_capture(crash_reason_t reason, uint32_t *sp, uint32_t *regs, uint32_t *caller);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CRASH_RECORD_H */
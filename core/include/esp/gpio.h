@@ -129,6 +129,14 @@ static inline bool gpio_read(const uint8_t gpio_num)
 
 extern void gpio_interrupt_handler(void);
 
+/* Called by the default gpio_interrupt_handler() with the interrupt status
+ * bits of the pins in gpio_capture_mask, instead of the per-pin handlers.
+ * Set up by extras/gpio_capture.
+ */
+typedef void (*gpio_capture_hook_t)(uint32_t status);
+extern uint32_t gpio_capture_mask;
+extern gpio_capture_hook_t gpio_capture_hook;
+
 /* Set the interrupt type for a given pin
  *
  * If int_type is not GPIO_INTTYPE_NONE, the gpio_interrupt_handler will be
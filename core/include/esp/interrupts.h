@@ -68,22 +68,39 @@ static inline void _xt_restore_interrupts(uint32_t new_ps)
     __asm__ volatile ("wsr %0, ps; rsync" :: "a" (new_ps));
 }
 
-/* ESPTODO: the mask/unmask functions aren't thread safe */
+/* Interrupts which stay enabled inside FreeRTOS critical sections, set by
+   vPortSetTimingCriticalInterrupts(). While a critical section has the
+   others masked, _xt_critical_masked is set and the INTENABLE value to
+   restore afterwards is in _xt_critical_saved_intenable. */
+extern uint32_t _xt_timing_critical_ints;
+extern bool _xt_critical_masked;
+extern uint32_t _xt_critical_saved_intenable;
 
 static inline void _xt_isr_unmask(uint32_t unmask)
 {
+    uint32_t ps = _xt_disable_interrupts();
     uint32_t intenable;
+    if (_xt_critical_masked) {
+        _xt_critical_saved_intenable |= unmask;
+        unmask &= _xt_timing_critical_ints;
+    }
     asm volatile ("rsr %0, intenable" : "=a" (intenable));
     intenable |= unmask;
     asm volatile ("wsr %0, intenable; esync" :: "a" (intenable));
+    _xt_restore_interrupts(ps);
 }
 
 static inline void _xt_isr_mask (uint32_t mask)
 {
+    uint32_t ps = _xt_disable_interrupts();
     uint32_t intenable;
+    if (_xt_critical_masked) {
+        _xt_critical_saved_intenable &= ~mask;
+    }
     asm volatile ("rsr %0, intenable" : "=a" (intenable));
     intenable &= ~mask;
     asm volatile ("wsr %0, intenable; esync" :: "a" (intenable));
+    _xt_restore_interrupts(ps);
 }
 
 static inline uint32_t _xt_read_ints (void)
@@ -13,6 +13,7 @@
 #include <stdint.h>
 #include "esp/spi_regs.h"
 #include "esp/clocks.h"
+#include "FreeRTOS.h"
 
 /**
  * Macro for use with spi_init and spi_set_frequency_div.
@@ -186,7 +187,7 @@ void spi_set_frequency_div(uint8_t bus, uint32_t divider);
 inline uint32_t spi_get_frequency_div(uint8_t bus)
 {
     return (FIELD2VAL(SPI_CLOCK_DIV_PRE, SPI(bus).CLOCK) + 1) |
-            (FIELD2VAL(SPI_CLOCK_COUNT_NUM, SPI(bus).CLOCK) + 1);
+            ((FIELD2VAL(SPI_CLOCK_COUNT_NUM, SPI(bus).CLOCK) + 1) << 16);
 }
 /**
  * \brief Get SPI bus frequency in Hz
@@ -397,6 +398,73 @@ void spi_repeat_send_16(uint8_t bus, uint16_t data, int32_t repeats);
  */
 void spi_repeat_send_32(uint8_t bus, uint32_t data, int32_t repeats);
 
+/**
+ * No chip select GPIO, see spi_device_t
+ */
+#define SPI_CS_NONE 0xff
+
+/**
+ * A device on a shared SPI bus
+ *
+ * Devices on the same bus take turns with spi_device_acquire() and
+ * spi_device_release(). Each one brings its own settings, which are
+ * applied when it takes the bus.
+ */
+typedef struct
+{
+    uint8_t bus;                ///< Bus ID: 0 - system, 1 - user
+    spi_settings_t settings;    ///< Mode, frequency and bit and byte order
+    uint8_t cs_gpio;            ///< Output driven low while the device has the bus, or SPI_CS_NONE
+} spi_device_t;
+
+/**
+ * \brief Take the bus for a device
+ * Waits for any other device to release the bus, applies the device's
+ * settings and selects it. The settings last applied to the bus are
+ * remembered, and only registers for the settings which differ are
+ * written, so switching between devices with the same mode or frequency
+ * is cheap and taking the bus again for the same device writes nothing.
+ * The spi_set_*() functions keep track of changes too.
+ *
+ * minimal_pins only switches the hardware CS0 timing on or off, the pins
+ * themselves are set up once by spi_init(), which has to be called for
+ * the bus first. cs_gpio must be set up as an output.
+ *
+ * Not for use in interrupt handlers.
+ *
+ * Example:
+ *
+ *     static const spi_device_t display = {
+ *         .bus = 1,
+ *         .settings = { SPI_MODE0, SPI_FREQ_DIV_20M, true, SPI_LITTLE_ENDIAN, true },
+ *         .cs_gpio = 4
+ *     };
+ *     ...
+ *     if (spi_device_acquire(&display, portMAX_DELAY)) {
+ *         spi_transfer(display.bus, buf, NULL, sizeof(buf), SPI_8BIT);
+ *         spi_device_release(&display);
+ *     }
+ *
+ * \param dev Device
+ * \param timeout Ticks to wait for the bus
+ * \return false on timeout, or if spi_init() wasn't called for the bus
+ */
+bool spi_device_acquire(const spi_device_t *dev, TickType_t timeout);
+/**
+ * \brief Release the bus taken with spi_device_acquire()
+ * Deselects the device. Its settings stay on the bus until another
+ * device needs different ones.
+ * \param dev Device
+ */
+void spi_device_release(const spi_device_t *dev);
+/**
+ * \brief Forget the settings last applied to the bus
+ * For drivers which write the bus registers themselves while holding the
+ * bus: the next spi_device_acquire() writes every setting again.
+ * \param bus Bus ID: 0 - system, 1 - user
+ */
+void spi_device_invalidate(uint8_t bus);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,3 +1,11 @@
+/* Older SPI master interface, from
+ * https://github.com/MetalPhreak/ESP8266_SPI_Driver
+ *
+ * Kept for existing code. The functions are implemented in esp_spi.c on
+ * top of the esp/spi.h driver, so they keep its record of the bus
+ * settings up to date and mix with spi_device_acquire(). New code should
+ * use esp/spi.h.
+ */
 #ifndef SPI2__h
 #define SPI2__h
 
@@ -26,16 +34,10 @@
 #define SPI_CLK_CNTDIV 2
 #define SPI_CLK_FREQ CPU_CLK_FREQ/(SPI_CLK_PREDIV*SPI_CLK_CNTDIV) // 80 / 20 = 4 MHz
 
-/*******************************************************************************
- * spi_init:
- * Description: Wrapper to setup HSPI/SPI GPIO pins and default SPI clock
- * Parameters: spi_no - SPI (0) or HSPI (1)
-*******************************************************************************/
-void spi_init(uint8_t spi_no);
-
 /*******************************************************************************
  * spi_init_gpio:
- * Description: Initialises the GPIO pins for use as SPI pins.
+ * Description: Initialises the GPIO pins for use as SPI pins, and the bus
+ *    as spi_init() does.
  * Parameters:
  *    - spi_no: SPI (0) or HSPI (1)
  *    - sysclk_as_spiclk:
@@ -0,0 +1,90 @@
+/* Size-class slab allocator for small heap allocations
+ *
+ * Allocations of up to SLAB_MAX_SIZE bytes are served from per-size-class
+ * pages carved out of a few larger "extents" obtained from malloc() on
+ * demand. Each size class keeps a list of partially used pages, and each
+ * page its own free list, so allocating and freeing are constant time and
+ * small, short lived objects don't break up the newlib heap. The 16-64
+ * byte classes serve lwIP's pbuf headers (PBUF_REF/PBUF_ROM), tcp_seg and
+ * netbuf structures, FreeRTOS queue and timer control blocks, and the
+ * small buffers of the binary SDK libraries. Pages which become
+ * completely free go back to a shared pool for any size class to use.
+ *
+ * Larger allocations, and small ones when all extents are in use, are
+ * passed straight to newlib malloc(). In utils/slab_replay's network
+ * workload roughly a fifth of the allocations in the slab's size range
+ * still fall back to malloc() that way at the peak. slab_free() and slab_realloc()
+ * accept pointers from either allocator, so memory from malloc() can be
+ * released with slab_free(). free() and realloc() are wrapped at link time
+ * to call slab_free() and slab_realloc(), so slab memory can be released
+ * with free() too.
+ *
+ * lwIP (mem_malloc/mem_free) and FreeRTOS (pvPortMalloc/vPortFree, also
+ * used by the binary SDK libraries) allocate through this layer.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Largest allocation served by the slab allocator */
+#define SLAB_MAX_SIZE 64
+
+/* Number of size classes, 16 to SLAB_MAX_SIZE bytes */
+#define SLAB_CLASSES 6
+
+void *slab_malloc(size_t size);
+void *slab_calloc(size_t nmemb, size_t size);
+void *slab_realloc(void *ptr, size_t size);
+void slab_free(void *ptr);
+
+typedef struct {
+    uint16_t size;          /* Object size for this class */
+    uint16_t pages;         /* Pages currently assigned to this class */
+    uint32_t inuse;         /* Objects currently allocated */
+    uint32_t peak;          /* Most objects ever allocated at once */
+    uint32_t allocs;        /* Total allocations served */
+    uint32_t fallbacks;     /* Allocations passed to malloc() as no page was free */
+} slab_class_stats_t;
+
+typedef struct {
+    slab_class_stats_t cls[SLAB_CLASSES];
+    uint16_t extents;       /* Extents obtained from malloc() */
+    uint16_t pages;         /* Total pages in those extents */
+    uint16_t pages_free;    /* Pages not assigned to any class */
+    uint32_t slab_bytes;    /* Bytes held by the slab allocator */
+    uint32_t slab_free;     /* Of which not allocated (free pages and free slots) */
+    uint32_t slab_slack;    /* Free slots in partially used pages, unusable by other classes */
+    uint32_t heap_arena;    /* newlib heap size (mallinfo arena) */
+    uint32_t heap_free;     /* Free bytes inside the newlib heap (mallinfo fordblks) */
+    uint32_t heap_free_chunks;  /* Number of free heap chunks, 0 if unknown */
+    uint32_t heap_largest_free; /* Largest free heap chunk, 0 if unknown */
+} slab_stats_t;
+
+/* Fill 'stats' with the current slab and heap statistics.
+
+   Heap fragmentation can be estimated as
+   1 - heap_largest_free / heap_free. Free chunk details need newlib's
+   nano malloc and are left zero with other malloc implementations. */
+void slab_get_stats(slab_stats_t *stats);
+
+/* Print slab and heap statistics to stdout */
+void slab_print_stats(void);
+
+/* Bytes held by the slab allocator that are free for reuse, as added to
+   xPortGetFreeHeapSize() */
+size_t slab_free_bytes(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SLAB_H */
@@ -0,0 +1,48 @@
+/* Tickless idle support
+ *
+ * With configUSE_TICKLESS_IDLE set to 1 in FreeRTOSConfig.h, the idle task
+ * calls vPortSuppressTicksAndSleep() (FreeRTOS port.c) whenever no task is
+ * due to run for at least configEXPECTED_IDLE_TIME_BEFORE_SLEEP ticks. It
+ * moves the CCOMPARE0 tick interrupt out to the next task wake time and
+ * halts the CPU with WAITI until that or any other interrupt (WiFi MAC,
+ * FRC timers, GPIO, UART) arrives, then steps the tick count forward by
+ * the ticks that passed.
+ *
+ * The WiFi modem sleep selected with sdk_wifi_set_sleep_type() runs in
+ * the MAC layer independently of this and benefits from the CPU staying
+ * halted between beacons.
+ *
+ * The CCOUNT arithmetic is in tickless_calc.h.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _TICKLESS_H
+#define _TICKLESS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tickless_calc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t sleeps;        /* Number of times the CPU was halted */
+    uint32_t early_wakes;   /* ... and woken before the planned time */
+    uint32_t slept_ticks;   /* Ticks that passed while halted */
+    uint32_t awake_ticks;   /* All other ticks */
+} tickless_stats_t;
+
+/* Called by the port after each sleep */
+void tickless_account(uint32_t ticks, bool early);
+
+void tickless_get_stats(tickless_stats_t *stats);
+void tickless_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TICKLESS_H */
@@ -0,0 +1,56 @@
+/* Tickless idle CCOUNT arithmetic
+ *
+ * Planning a sleep and working out the ticks that passed from the CPU
+ * cycle counter, for vPortSuppressTicksAndSleep() (see tickless.h). No
+ * hardware access and no dependencies beyond the C library, core/tests
+ * builds it on a host.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _TICKLESS_CALC_H
+#define _TICKLESS_CALC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Don't sleep if the next tick is due within this many CPU cycles, and
+   never program CCOMPARE0 closer than this to the current CCOUNT. */
+#define TICKLESS_MIN_CYCLES 2000
+
+typedef struct {
+    uint32_t base;          /* CCOMPARE0 before sleeping (next tick due) */
+    uint32_t target;        /* CCOMPARE0 while sleeping */
+    uint32_t tick_cycles;   /* CPU cycles per tick */
+    uint32_t ticks;         /* Ticks between base and target */
+} tickless_sleep_t;
+
+/* Plan a sleep of up to 'idle_ticks' ticks, where the next tick is due at
+   CCOUNT 'next_tick' and the current CCOUNT is 'now'. The final tick of
+   the sleep is left to the tick interrupt, and the sleep is limited so
+   CCOMPARE0 stays less than 2^31 cycles ahead.
+
+   Returns false if there's nothing to gain from sleeping. */
+bool tickless_plan(tickless_sleep_t *sleep, uint32_t next_tick, uint32_t now,
+                   uint32_t tick_cycles, uint32_t idle_ticks);
+
+/* After waking, given the CCOUNT 'now' and the current CCOMPARE0 value
+   'compare', return the number of ticks to add to the tick count with
+   vTaskStepTick(). *new_compare is set to the value CCOMPARE0 should hold
+   for the next tick; if it differs from 'compare' the caller must write
+   it.
+
+   If the tick interrupt has run since sleeping (compare has moved on from
+   sleep->target) it has already counted the ticks from target onwards. */
+uint32_t tickless_wake(const tickless_sleep_t *sleep, uint32_t now, uint32_t compare,
+                       uint32_t *new_compare);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TICKLESS_CALC_H */
@@ -0,0 +1,118 @@
+/* Hierarchical timing wheel
+ *
+ * Keeps timers sorted by expiry tick with constant time insertion and
+ * removal, however many are running. Level 0 has one slot per tick for
+ * the next TIMER_WHEEL_SLOTS ticks, and each further level has slots
+ * TIMER_WHEEL_SLOTS times as wide. A timer is filed in the lowest level
+ * that reaches its expiry time, and moved ("cascaded") down a level each
+ * time the level below wraps around onto its slot. Timers further away
+ * than the top level reaches wait on a separate list, which is rehashed
+ * whenever the top level wraps.
+ *
+ * timer_wheel_expire() hands back expired timers one at a time, so the
+ * caller can drop its lock to run each callback. It skips directly over
+ * stretches of ticks where nothing is due, so it costs the same however
+ * long it is since the last call.
+ *
+ * The wheel does no locking of its own. With configUSE_TIMER_WHEEL set
+ * in FreeRTOSConfig.h the FreeRTOS xTimer API is implemented on top of
+ * it instead of FreeRTOS/Source/timers.c, see timers_wheel.c in the
+ * esp8266 port.
+ *
+ * This file has no dependencies beyond stdint, so core/tests and
+ * utils/timer_wheel_bench build it on a host.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _TIMER_WHEEL_H
+#define _TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+/* Timers due further ahead than this go on the overflow list */
+#define TIMER_WHEEL_RANGE (1UL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+/* Slot arithmetic for a wheel of 2^bits slots, each 2^shift ticks wide,
+   also used by single-level wheels kept elsewhere (extras/dhcpserver) */
+static inline uint32_t timer_wheel_slot(uint32_t tick, unsigned shift, unsigned bits)
+{
+    return (tick >> shift) & ((1UL << bits) - 1);
+}
+
+/* First tick of the slot holding 'tick' */
+static inline uint32_t timer_wheel_slot_start(uint32_t tick, unsigned shift)
+{
+    return tick & ~((1UL << shift) - 1);
+}
+
+/* Embed one of these in each timer */
+typedef struct timer_wheel_node {
+    struct timer_wheel_node *next;
+    struct timer_wheel_node **pprev;    /* NULL when not in the wheel */
+    uint32_t expiry;
+} timer_wheel_node_t;
+
+typedef struct {
+    uint32_t now;                       /* Tick being processed */
+    uint32_t active;                    /* Timers in the wheel */
+    uint32_t peak;                      /* Most timers ever in the wheel */
+    uint32_t cascades;                  /* Timers moved down a level */
+    timer_wheel_node_t *slot[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    timer_wheel_node_t *overflow;
+} timer_wheel_t;
+
+/* Empty the wheel and set the current tick */
+void timer_wheel_init(timer_wheel_t *w, uint32_t now);
+
+/* Add 'node' to expire 'ticks' ticks after tick 'start', removing it
+   first if it is already in the wheel. If the wheel has already passed
+   that time the timer is due straight away. 'start' should be recent,
+   as it is compared with the wheel's current tick. */
+void timer_wheel_add(timer_wheel_t *w, timer_wheel_node_t *node, uint32_t start, uint32_t ticks);
+
+/* Remove 'node' if it is in the wheel */
+void timer_wheel_remove(timer_wheel_t *w, timer_wheel_node_t *node);
+
+static inline bool timer_wheel_pending(const timer_wheel_node_t *node)
+{
+    return node->pprev != 0;
+}
+
+/* Remove and return a timer which expired at or before tick 'now', or
+   return NULL once there are none left. Timers are returned in expiry
+   order (timers due on the same tick in no particular order). */
+timer_wheel_node_t *timer_wheel_expire(timer_wheel_t *w, uint32_t now);
+
+/* Set '*tick' to the next tick timer_wheel_expire() has work to do,
+   which is either a timer's expiry time or an earlier tick where timers
+   are cascaded. Returns false if the wheel is empty. */
+bool timer_wheel_next(const timer_wheel_t *w, uint32_t *tick);
+
+/* FreeRTOS timer service statistics (configUSE_TIMER_WHEEL only) */
+typedef struct {
+    uint32_t active;            /* Timers running */
+    uint32_t peak;              /* Most timers running at once */
+    uint32_t cascades;          /* Timers moved down a wheel level */
+    uint32_t far;               /* Timers due beyond TIMER_WHEEL_RANGE */
+    uint32_t commands;          /* Deletes and pended function calls queued */
+    uint32_t dropped;           /* ... which failed as the queue was full */
+    uint32_t max_batch;         /* Most commands handled in one wakeup */
+} timer_service_stats_t;
+
+void timer_service_get_stats(timer_service_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TIMER_WHEEL_H */
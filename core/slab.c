@@ -0,0 +1,448 @@
+/* Size-class slab allocator for small heap allocations
+ *
+ * See slab.h for an overview.
+ *
+ * Memory layout: up to SLAB_MAX_EXTENTS extents of SLAB_EXTENT_PAGES pages
+ * each are malloc()ed as needed, and given back to the heap when all their
+ * pages are free again (except for the last one). Page metadata is kept
+ * in a static table rather than in the pages, so the whole page is usable.
+ * Objects are carved from a page with a bump offset the first time round,
+ * then recycled through the page's free list (linked through the first
+ * word of each free object).
+ *
+ * This file also builds on a Linux host (define SLAB_HOST and the
+ * SLAB_BACKEND_* allocator macros) for utils/slab_replay.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "slab.h"
+
+#ifndef SLAB_HOST
+#include <malloc.h>
+#include "FreeRTOS.h"
+#include "task.h"
+/* Same global critical section newlib uses to lock malloc */
+#define SLAB_LOCK() taskENTER_CRITICAL()
+#define SLAB_UNLOCK() taskEXIT_CRITICAL()
+#endif
+
+#ifndef SLAB_BACKEND_MALLOC
+/* free() and realloc() are wrapped at link time (see slab_libc.c), the
+   newlib versions are __real_free() and __real_realloc() */
+void __real_free(void *ptr);
+void *__real_realloc(void *ptr, size_t size);
+#define SLAB_BACKEND_MALLOC malloc
+#define SLAB_BACKEND_FREE __real_free
+#define SLAB_BACKEND_REALLOC __real_realloc
+#endif
+
+#ifndef SLAB_PAGE_SIZE
+#define SLAB_PAGE_SIZE 128
+#endif
+
+#ifndef SLAB_EXTENT_PAGES
+#define SLAB_EXTENT_PAGES 2
+#endif
+
+/* Set to 0 to pass every allocation straight through to malloc() */
+#ifndef SLAB_MAX_EXTENTS
+#define SLAB_MAX_EXTENTS 8
+#endif
+
+#define SLAB_EXTENT_SIZE (SLAB_PAGE_SIZE * SLAB_EXTENT_PAGES)
+#define SLAB_PAGES (SLAB_MAX_EXTENTS * SLAB_EXTENT_PAGES)
+
+#define NO_PAGE 0xff
+#define NO_CLASS 0xff
+
+_Static_assert(SLAB_PAGES < NO_PAGE, "Too many slab pages for 8-bit page indexes");
+_Static_assert(SLAB_PAGE_SIZE >= SLAB_MAX_SIZE, "Slab page smaller than largest object");
+
+static const uint16_t class_size[SLAB_CLASSES] = {
+    16, 24, 32, 40, 48, 64
+};
+
+/* Size class for each (size + 7) / 8 */
+static const uint8_t size_class[SLAB_MAX_SIZE / 8 + 1] = {
+    0, 0, 0,                /* 0-16 */
+    1,                      /* 17-24 */
+    2,                      /* 25-32 */
+    3,                      /* 33-40 */
+    4,                      /* 41-48 */
+    5, 5,                   /* 49-64 */
+};
+
+typedef struct {
+    void *free;             /* Recycled objects */
+    uint16_t bump;          /* Offset of the first never-allocated object */
+    uint16_t inuse;
+    uint8_t cls;            /* NO_CLASS while on the free page list */
+    uint8_t next;           /* Free page list or class partial list links */
+    uint8_t prev;
+} slab_page_t;
+
+static uint8_t *extents[SLAB_MAX_EXTENTS]; /* NULL for unused slots */
+static uint8_t n_extents;
+static slab_page_t pages[SLAB_PAGES];
+static uint8_t free_pages = NO_PAGE;
+static uint8_t partial[SLAB_CLASSES] = {
+    NO_PAGE, NO_PAGE, NO_PAGE, NO_PAGE, NO_PAGE, NO_PAGE
+};
+static slab_class_stats_t class_stats[SLAB_CLASSES];
+
+static inline uint8_t *page_base(uint8_t idx)
+{
+    return extents[idx / SLAB_EXTENT_PAGES] + (idx % SLAB_EXTENT_PAGES) * SLAB_PAGE_SIZE;
+}
+
+/* Page index for a pointer, or NO_PAGE if it didn't come from the slab */
+static uint8_t page_of(void *ptr)
+{
+    uint8_t *p = ptr;
+    for(int e = 0; e < SLAB_MAX_EXTENTS; e++) {
+        if(extents[e] != NULL && p >= extents[e] && p < extents[e] + SLAB_EXTENT_SIZE) {
+            return e * SLAB_EXTENT_PAGES + (p - extents[e]) / SLAB_PAGE_SIZE;
+        }
+    }
+    return NO_PAGE;
+}
+
+static void list_push(uint8_t *head, uint8_t idx)
+{
+    pages[idx].prev = NO_PAGE;
+    pages[idx].next = *head;
+    if(*head != NO_PAGE) {
+        pages[*head].prev = idx;
+    }
+    *head = idx;
+}
+
+static void list_remove(uint8_t *head, uint8_t idx)
+{
+    slab_page_t *page = &pages[idx];
+    if(page->prev != NO_PAGE) {
+        pages[page->prev].next = page->next;
+    } else {
+        *head = page->next;
+    }
+    if(page->next != NO_PAGE) {
+        pages[page->next].prev = page->prev;
+    }
+}
+
+static inline bool page_full(const slab_page_t *page)
+{
+    return page->free == NULL && page->bump + class_size[page->cls] > SLAB_PAGE_SIZE;
+}
+
+/* Get a page with a free object for class 'cls', or NO_PAGE */
+static uint8_t page_for_class(uint8_t cls)
+{
+    uint8_t idx = partial[cls];
+    if(idx == NO_PAGE && free_pages != NO_PAGE) {
+        idx = free_pages;
+        list_remove(&free_pages, idx);
+        pages[idx].cls = cls;
+        list_push(&partial[cls], idx);
+        class_stats[cls].pages++;
+    }
+    return idx;
+}
+
+/* Add a new extent's pages to the free page list. Called without the lock
+   held, as it calls malloc(). */
+static bool extent_add(void)
+{
+    if(n_extents >= SLAB_MAX_EXTENTS) {
+        return false;
+    }
+    uint8_t *extent = SLAB_BACKEND_MALLOC(SLAB_EXTENT_SIZE);
+    if(extent == NULL) {
+        return false;
+    }
+    SLAB_LOCK();
+    int e = 0;
+    while(e < SLAB_MAX_EXTENTS && extents[e] != NULL) {
+        e++;
+    }
+    if(e == SLAB_MAX_EXTENTS) {
+        /* Another task added the last extent meanwhile */
+        SLAB_UNLOCK();
+        SLAB_BACKEND_FREE(extent);
+        return true;
+    }
+    extents[e] = extent;
+    for(int i = 0; i < SLAB_EXTENT_PAGES; i++) {
+        uint8_t idx = e * SLAB_EXTENT_PAGES + i;
+        pages[idx].cls = NO_CLASS;
+        list_push(&free_pages, idx);
+    }
+    n_extents++;
+    SLAB_UNLOCK();
+    return true;
+}
+
+/* If every page in the extent holding page 'idx' is free, and it isn't the
+   only extent, take it out of use and return it for freeing. Call with the
+   lock held. */
+static uint8_t *extent_release(uint8_t idx)
+{
+    int e = idx / SLAB_EXTENT_PAGES;
+    uint8_t first = e * SLAB_EXTENT_PAGES;
+    if(n_extents <= 1) {
+        return NULL;
+    }
+    for(int i = 0; i < SLAB_EXTENT_PAGES; i++) {
+        if(pages[first + i].cls != NO_CLASS) {
+            return NULL;
+        }
+    }
+    for(int i = 0; i < SLAB_EXTENT_PAGES; i++) {
+        list_remove(&free_pages, first + i);
+    }
+    uint8_t *extent = extents[e];
+    extents[e] = NULL;
+    n_extents--;
+    return extent;
+}
+
+void *slab_malloc(size_t size)
+{
+    if(size > SLAB_MAX_SIZE || SLAB_MAX_EXTENTS == 0) {
+        return SLAB_BACKEND_MALLOC(size);
+    }
+    uint8_t cls = size_class[(size + 7) / 8];
+
+    SLAB_LOCK();
+    uint8_t idx = page_for_class(cls);
+    if(idx == NO_PAGE) {
+        SLAB_UNLOCK();
+        if(extent_add()) {
+            SLAB_LOCK();
+            idx = page_for_class(cls);
+        } else {
+            SLAB_LOCK();
+        }
+        if(idx == NO_PAGE) {
+            class_stats[cls].fallbacks++;
+            SLAB_UNLOCK();
+            return SLAB_BACKEND_MALLOC(size);
+        }
+    }
+
+    slab_page_t *page = &pages[idx];
+    void *obj = page->free;
+    if(obj != NULL) {
+        page->free = *(void **)obj;
+    } else {
+        obj = page_base(idx) + page->bump;
+        page->bump += class_size[cls];
+    }
+    page->inuse++;
+    if(page_full(page)) {
+        list_remove(&partial[cls], idx);
+    }
+
+    slab_class_stats_t *stats = &class_stats[cls];
+    stats->allocs++;
+    if(++stats->inuse > stats->peak) {
+        stats->peak = stats->inuse;
+    }
+    SLAB_UNLOCK();
+    return obj;
+}
+
+void slab_free(void *ptr)
+{
+    if(ptr == NULL) {
+        return;
+    }
+
+    SLAB_LOCK();
+    uint8_t idx = page_of(ptr);
+    if(idx == NO_PAGE) {
+        SLAB_UNLOCK();
+        SLAB_BACKEND_FREE(ptr);
+        return;
+    }
+
+    slab_page_t *page = &pages[idx];
+    uint8_t cls = page->cls;
+    bool was_full = page_full(page);
+    *(void **)ptr = page->free;
+    page->free = ptr;
+    page->inuse--;
+    class_stats[cls].inuse--;
+
+    uint8_t *extent = NULL;
+    if(page->inuse == 0) {
+        /* Give the page back for any class to use */
+        if(!was_full) {
+            list_remove(&partial[cls], idx);
+        }
+        page->free = NULL;
+        page->bump = 0;
+        page->cls = NO_CLASS;
+        list_push(&free_pages, idx);
+        class_stats[cls].pages--;
+        extent = extent_release(idx);
+    } else if(was_full) {
+        list_push(&partial[cls], idx);
+    }
+    SLAB_UNLOCK();
+
+    if(extent != NULL) {
+        SLAB_BACKEND_FREE(extent);
+    }
+}
+
+void *slab_calloc(size_t nmemb, size_t size)
+{
+    size_t total = nmemb * size;
+    if(size != 0 && total / size != nmemb) {
+        return NULL;
+    }
+    void *ptr = slab_malloc(total);
+    if(ptr != NULL) {
+        memset(ptr, 0, total);
+    }
+    return ptr;
+}
+
+void *slab_realloc(void *ptr, size_t size)
+{
+    if(ptr == NULL) {
+        return slab_malloc(size);
+    }
+    if(size == 0) {
+        slab_free(ptr);
+        return NULL;
+    }
+
+    SLAB_LOCK();
+    uint8_t idx = page_of(ptr);
+    size_t old_size = (idx == NO_PAGE) ? 0 : class_size[pages[idx].cls];
+    SLAB_UNLOCK();
+
+    if(old_size == 0) {
+        /* Blocks from malloc() stay there, as we don't know their size */
+        return SLAB_BACKEND_REALLOC(ptr, size);
+    }
+    if(size <= old_size) {
+        return ptr;
+    }
+    void *new_ptr = slab_malloc(size);
+    if(new_ptr != NULL) {
+        memcpy(new_ptr, ptr, old_size);
+        slab_free(ptr);
+    }
+    return new_ptr;
+}
+
+/* Free slot bytes in pages assigned to size classes. Call with lock held. */
+static uint32_t slack_bytes(void)
+{
+    uint32_t slack = 0;
+    for(int i = 0; i < SLAB_PAGES; i++) {
+        if(extents[i / SLAB_EXTENT_PAGES] != NULL && pages[i].cls != NO_CLASS) {
+            slack += SLAB_PAGE_SIZE - pages[i].inuse * class_size[pages[i].cls];
+        }
+    }
+    return slack;
+}
+
+static uint32_t count_free_pages(void)
+{
+    uint32_t n = 0;
+    for(uint8_t idx = free_pages; idx != NO_PAGE; idx = pages[idx].next) {
+        n++;
+    }
+    return n;
+}
+
+size_t slab_free_bytes(void)
+{
+    SLAB_LOCK();
+    size_t free_bytes = count_free_pages() * SLAB_PAGE_SIZE + slack_bytes();
+    SLAB_UNLOCK();
+    return free_bytes;
+}
+
+#ifndef SLAB_HOST
+/* newlib nano malloc's free list, sorted by address. Weak so that other
+   malloc implementations just report no chunk details. */
+typedef struct nano_chunk {
+    long size;
+    struct nano_chunk *next;
+} nano_chunk_t;
+
+extern nano_chunk_t *__malloc_free_list __attribute__((weak));
+
+static void heap_stats(slab_stats_t *stats)
+{
+    struct mallinfo mi = mallinfo();
+    stats->heap_arena = mi.arena;
+    stats->heap_free = mi.fordblks;
+    if(&__malloc_free_list == NULL) {
+        return;
+    }
+    SLAB_LOCK();
+    for(nano_chunk_t *c = __malloc_free_list; c != NULL; c = c->next) {
+        stats->heap_free_chunks++;
+        if(c->size > stats->heap_largest_free) {
+            stats->heap_largest_free = c->size;
+        }
+    }
+    SLAB_UNLOCK();
+}
+#endif
+
+void slab_get_stats(slab_stats_t *stats)
+{
+    memset(stats, 0, sizeof(slab_stats_t));
+
+    SLAB_LOCK();
+    memcpy(stats->cls, class_stats, sizeof(class_stats));
+    for(int c = 0; c < SLAB_CLASSES; c++) {
+        stats->cls[c].size = class_size[c];
+    }
+    stats->extents = n_extents;
+    stats->pages = n_extents * SLAB_EXTENT_PAGES;
+    stats->pages_free = count_free_pages();
+    stats->slab_bytes = n_extents * SLAB_EXTENT_SIZE;
+    stats->slab_slack = slack_bytes();
+    stats->slab_free = stats->pages_free * SLAB_PAGE_SIZE + stats->slab_slack;
+    SLAB_UNLOCK();
+
+#ifndef SLAB_HOST
+    heap_stats(stats);
+#endif
+}
+
+void slab_print_stats(void)
+{
+    slab_stats_t s;
+    slab_get_stats(&s);
+
+    printf("slab: %u extents, %u/%u pages free, %u/%u bytes free (%u in partial pages)\n",
+           s.extents, s.pages_free, s.pages, s.slab_free, s.slab_bytes, s.slab_slack);
+    printf(" size pages  inuse   peak     allocs fallbacks\n");
+    for(int c = 0; c < SLAB_CLASSES; c++) {
+        slab_class_stats_t *cs = &s.cls[c];
+        printf("%5u %5u %6u %6u %10u %9u\n", cs->size, cs->pages, cs->inuse,
+               cs->peak, cs->allocs, cs->fallbacks);
+    }
+#ifndef SLAB_HOST
+    printf("heap: arena %u bytes, %u free", s.heap_arena, s.heap_free);
+    if(s.heap_free_chunks) {
+        printf(" in %u chunks, largest %u", s.heap_free_chunks, s.heap_largest_free);
+    }
+    printf("\n");
+#endif
+}
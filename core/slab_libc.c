@@ -0,0 +1,26 @@
+/* newlib free() and realloc() wrappers for the slab allocator
+ *
+ * Blocks from pvPortMalloc() can reach free() and realloc() in the binary
+ * SDK libraries and application code, so those are wrapped at link time
+ * (-Wl,--wrap in parameters.mk) to go to slab_free() and slab_realloc(),
+ * which pass blocks from malloc() on to newlib.
+ *
+ * This is the only place free() and realloc() are wrapped. It is kept
+ * out of slab.c so the calls below are resolved by the linker, and
+ * extras/heap_trace's own slab_free/slab_realloc wrappers see them.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stddef.h>
+#include "slab.h"
+
+void __wrap_free(void *ptr)
+{
+    slab_free(ptr);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    return slab_realloc(ptr, size);
+}
@@ -0,0 +1,115 @@
+/* Host unit tests for tickless_calc.c: the cases in tests/cases/09_tickless.c
+ * plus random wakeups over whole sleeps, many across CCOUNT wraparound.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "tickless_calc.h"
+#include "check.h"
+
+#define TICK 800000   /* 10ms at 80MHz */
+
+static void test_cases(void)
+{
+    tickless_sleep_t s;
+    uint32_t compare;
+
+    /* Nothing to gain from sleeping one tick, or with the tick imminent */
+    CHECK(!tickless_plan(&s, 1000000, 0, TICK, 1));
+    CHECK(!tickless_plan(&s, 1000, 0, TICK, 10));
+
+    /* Sleep 10 ticks: the tick interrupt handles the 10th */
+    CHECK(tickless_plan(&s, 1000000, 500000, TICK, 10));
+    CHECK(s.ticks == 9);
+    CHECK(s.target == 1000000 + 9 * TICK);
+
+    /* Tick interrupt woke us and moved CCOMPARE0 on */
+    CHECK(tickless_wake(&s, s.target + 100, s.target + TICK, &compare) == 9);
+    CHECK(compare == s.target + TICK);
+
+    /* Other interrupt before the first tick was due */
+    CHECK(tickless_wake(&s, 600000, s.target, &compare) == 0);
+    CHECK(compare == 1000000);
+
+    /* Other interrupt part way through the third tick period */
+    CHECK(tickless_wake(&s, 1000000 + 2 * TICK + 5000, s.target, &compare) == 3);
+    CHECK(compare == 1000000 + 3 * TICK);
+
+    /* ... just before a tick is due: count it now rather than race it */
+    CHECK(tickless_wake(&s, 1000000 + 3 * TICK - 10, s.target, &compare) == 4);
+    CHECK(compare == 1000000 + 4 * TICK);
+
+    /* Target reached but its interrupt still pending: leave CCOMPARE0 */
+    CHECK(tickless_wake(&s, s.target + 10, s.target, &compare) == 9);
+    CHECK(compare == s.target);
+
+    /* Across CCOUNT wraparound */
+    CHECK(tickless_plan(&s, 0xfff00000, 0xffe00000, TICK, 5));
+    CHECK(tickless_wake(&s, 0xfff00000 + TICK + 10, s.target, &compare) == 2);
+    CHECK(compare == 0xfff00000 + 2 * TICK);
+
+    /* Long sleeps are limited to 2^31 cycles */
+    CHECK(tickless_plan(&s, 1000000, 500000, TICK, 0xffffffff));
+    CHECK(s.target - 500000 < 0x80000000);
+    CHECK(s.target - 1000000 == s.ticks * TICK);
+}
+
+/* Wake at every point of a sleep (another interrupt, CCOMPARE0 still at
+   the target) and check the ticks counted against the due times */
+static void check_wake(const tickless_sleep_t *s, uint32_t now)
+{
+    uint32_t compare;
+    uint32_t ticks = tickless_wake(s, now, s->target, &compare);
+
+    CHECK(ticks <= s->ticks);
+    /* Every tick counted is due, or too close to program */
+    if (ticks > 0) {
+        CHECK((int32_t)(s->base + (ticks - 1) * s->tick_cycles - now) < TICKLESS_MIN_CYCLES);
+    }
+    if (compare != s->target) {
+        /* Reprogrammed for the next tick, which is safely ahead */
+        CHECK(ticks < s->ticks);
+        CHECK(compare == s->base + ticks * s->tick_cycles);
+        CHECK((int32_t)(compare - now) >= TICKLESS_MIN_CYCLES);
+    } else {
+        /* Left at the target, whose tick the interrupt will count */
+        CHECK(ticks == s->ticks);
+    }
+}
+
+static void test_random(void)
+{
+    static const uint32_t tick_cycles[] = { 800000, 1600000, 80000, 12345 };
+    tickless_sleep_t s;
+
+    srand(1);
+    for (int i = 0; i < 20000; i++) {
+        uint32_t tc = tick_cycles[i % 4];
+        /* Half of the sleeps start shortly before CCOUNT wraps */
+        uint32_t now = (i & 1) ? 0u - (uint32_t)(rand() % (64 * tc)) : (uint32_t)rand() * 2;
+        uint32_t next_tick = now + TICKLESS_MIN_CYCLES + rand() % tc;
+        uint32_t idle = 2 + rand() % 100;
+
+        if (!tickless_plan(&s, next_tick, now, tc, idle)) {
+            CHECK(false);
+            continue;
+        }
+        CHECK(s.ticks == idle - 1);
+        CHECK(s.target == next_tick + s.ticks * tc);
+        for (int j = 0; j < 50; j++) {
+            check_wake(&s, now + rand() % (s.target - now + TICKLESS_MIN_CYCLES));
+        }
+        check_wake(&s, s.target - TICKLESS_MIN_CYCLES);
+        check_wake(&s, s.target - 1);
+        check_wake(&s, s.target);
+    }
+}
+
+int main(void)
+{
+    test_cases();
+    test_random();
+    return check_done("tickless");
+}
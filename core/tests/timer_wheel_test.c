@@ -0,0 +1,167 @@
+/* Host unit tests for timer_wheel.c: random starts, stops, restarts and
+ * time steps (including across 32 bit tick wraparound and beyond the
+ * wheel's range) against a simple reference model with 64 bit time,
+ * checking every timer expires exactly on its tick.
+ *
+ * utils/timer_wheel_bench times the wheel against a sorted list.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "timer_wheel.h"
+#include "check.h"
+
+#define container_of(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+
+static uint64_t rand64(void)
+{
+    return ((uint64_t)random() << 31) ^ random();
+}
+
+typedef struct {
+    timer_wheel_node_t node;
+    bool active;
+    bool reload;
+    uint32_t period;
+    uint64_t due;               /* Model expiry time */
+} model_timer_t;
+
+/* CHECK() with the model time and details, for the first few failures */
+#define MODEL_CHECK(cond, ...) do { \
+        if (!(cond) && failures < 20) { \
+            printf("t=%llu: ", (unsigned long long)t64); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+        } \
+        CHECK(cond); \
+    } while (0)
+
+static uint64_t t64;            /* Model time, the wheel sees the low 32 bits */
+
+static uint32_t random_period(void)
+{
+    switch (random() % 8) {
+    case 0:
+        return 1 + random() % 4;
+    case 1:
+        return 1 + random() % TIMER_WHEEL_SLOTS * 2;
+    case 2:
+        return 1 + random() % 100000;
+    case 3:
+        return 1 + rand64() % ((uint64_t)TIMER_WHEEL_RANGE * 4);
+    case 4:
+        return 0xffffffff - random() % 1000;
+    default:
+        return 1 + random() % 5000;
+    }
+}
+
+/* Add as the FreeRTOS timer service does, with 'start' up to a few ticks
+   behind or ahead of the wheel */
+static void model_add(timer_wheel_t *w, model_timer_t *m, uint64_t start, uint32_t ticks)
+{
+    timer_wheel_add(w, &m->node, (uint32_t)start, ticks);
+    uint64_t due = start + ticks;
+    m->due = due < t64 ? t64 : due;
+    m->active = true;
+}
+
+static void model_advance(timer_wheel_t *w, model_timer_t *timers, int n, uint64_t to)
+{
+    timer_wheel_node_t *node;
+    uint64_t prev = t64;
+
+    t64 = to;
+    while ((node = timer_wheel_expire(w, (uint32_t)to)) != NULL) {
+        model_timer_t *m = container_of(node, model_timer_t, node);
+        MODEL_CHECK(m->active, "inactive timer %d expired", (int)(m - timers));
+        MODEL_CHECK(m->due <= to, "timer %d expired early, due %llu", (int)(m - timers),
+              (unsigned long long)m->due);
+        MODEL_CHECK(m->due >= prev, "timer %d expired late, due %llu",
+              (int)(m - timers), (unsigned long long)m->due);
+        m->active = false;
+        if (m->reload) {
+            model_add(w, m, m->due, m->period);
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        MODEL_CHECK(!timers[i].active || timers[i].due > to, "timer %d due %llu didn't expire", i,
+              (unsigned long long)timers[i].due);
+        if (timers[i].active && timers[i].due <= to) {
+            timers[i].active = false;
+            timer_wheel_remove(w, &timers[i].node);
+        }
+    }
+}
+
+static void model_test(unsigned operations, int n)
+{
+    model_timer_t *timers = calloc(n, sizeof(model_timer_t));
+    timer_wheel_t w;
+
+    t64 = 0xfffff000 - (random() % 0x10000);
+    timer_wheel_init(&w, (uint32_t)t64);
+
+    for (unsigned op = 0; op < operations; op++) {
+        model_timer_t *m = &timers[random() % n];
+        int active = 0;
+        uint64_t earliest = UINT64_MAX;
+        uint32_t next;
+
+        switch (random() % 10) {
+        case 0:
+        case 1:
+        case 2:
+        case 3:
+            m->reload = random() % 4 == 0;
+            m->period = random_period();
+            model_add(&w, m, t64 - random() % 3, m->period);
+            break;
+        case 4:
+            timer_wheel_remove(&w, &m->node);
+            m->active = false;
+            break;
+        case 5:
+            /* Jump to the next event, which must not be past any timer */
+            for (int i = 0; i < n; i++) {
+                if (timers[i].active) {
+                    active++;
+                    if (timers[i].due < earliest) {
+                        earliest = timers[i].due;
+                    }
+                }
+            }
+            MODEL_CHECK(timer_wheel_next(&w, &next) == (active > 0), "next with %d active", active);
+            MODEL_CHECK((int)w.active == active, "wheel has %u active, model %d", w.active, active);
+            if (active) {
+                uint64_t next64 = t64 + (uint32_t)(next - (uint32_t)t64);
+                MODEL_CHECK(next64 <= earliest, "next %llu is after earliest due %llu",
+                      (unsigned long long)next64, (unsigned long long)earliest);
+                model_advance(&w, timers, n, next64);
+            }
+            break;
+        case 6:
+            model_advance(&w, timers, n, t64 + rand64() % ((uint64_t)TIMER_WHEEL_RANGE * 3));
+            break;
+        default:
+            model_advance(&w, timers, n, t64 + random() % 200);
+            break;
+        }
+    }
+    printf("%u operations on %d timers, %u cascades, peak %u\n",
+           operations, n, w.cascades, w.peak);
+    free(timers);
+}
+
+int main(void)
+{
+    srandom(1);
+    model_test(200000, 64);
+    model_test(200000, 1000);
+    return check_done("timer_wheel");
+}
@@ -0,0 +1,40 @@
+/* Tickless idle tick compensation
+ *
+ * See tickless.h. The sleep itself is in FreeRTOS port.c, the CCOUNT
+ * arithmetic in tickless_calc.c.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "tickless.h"
+
+static tickless_stats_t stats;
+static TickType_t stats_start;
+
+void tickless_account(uint32_t ticks, bool early)
+{
+    stats.sleeps++;
+    stats.slept_ticks += ticks;
+    if (early) {
+        stats.early_wakes++;
+    }
+}
+
+void tickless_get_stats(tickless_stats_t *out)
+{
+    taskENTER_CRITICAL();
+    *out = stats;
+    out->awake_ticks = xTaskGetTickCount() - stats_start - stats.slept_ticks;
+    taskEXIT_CRITICAL();
+}
+
+void tickless_reset_stats(void)
+{
+    taskENTER_CRITICAL();
+    memset(&stats, 0, sizeof(stats));
+    stats_start = xTaskGetTickCount();
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,61 @@
+/* Tickless idle CCOUNT arithmetic
+ *
+ * See tickless_calc.h
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include "tickless_calc.h"
+
+bool tickless_plan(tickless_sleep_t *sleep, uint32_t next_tick, uint32_t now,
+                   uint32_t tick_cycles, uint32_t idle_ticks)
+{
+    uint32_t ahead = next_tick - now;
+
+    if (idle_ticks < 2 || (int32_t)ahead < TICKLESS_MIN_CYCLES) {
+        return false;
+    }
+    uint32_t ticks = idle_ticks - 1;
+    uint32_t max_ticks = (0x7fffffff - ahead) / tick_cycles;
+    if (ticks > max_ticks) {
+        ticks = max_ticks;
+    }
+    if (ticks == 0) {
+        return false;
+    }
+    sleep->base = next_tick;
+    sleep->tick_cycles = tick_cycles;
+    sleep->ticks = ticks;
+    sleep->target = next_tick + ticks * tick_cycles;
+    return true;
+}
+
+uint32_t tickless_wake(const tickless_sleep_t *sleep, uint32_t now, uint32_t compare,
+                       uint32_t *new_compare)
+{
+    *new_compare = compare;
+    if (compare != sleep->target) {
+        /* Woken by the tick interrupt, which has counted the final tick
+           (and any after it) itself */
+        return sleep->ticks;
+    }
+
+    /* Ticks whose due time has passed, the next one is due at 'next' */
+    int32_t elapsed = now - sleep->base;
+    uint32_t ticks = elapsed < 0 ? 0 : elapsed / sleep->tick_cycles + 1;
+    if (ticks < sleep->ticks) {
+        uint32_t next = sleep->base + ticks * sleep->tick_cycles;
+        if ((int32_t)(next - now) < TICKLESS_MIN_CYCLES) {
+            /* Too close to program safely, count the tick early */
+            ticks++;
+            next += sleep->tick_cycles;
+        }
+        if (ticks < sleep->ticks) {
+            *new_compare = next;
+            return ticks;
+        }
+    }
+    /* The target tick is due (or pending), leave CCOMPARE0 alone so the
+       tick interrupt counts it */
+    return sleep->ticks;
+}
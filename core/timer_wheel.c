@@ -0,0 +1,194 @@
+/* Hierarchical timing wheel
+ *
+ * See timer_wheel.h for an overview.
+ *
+ * Each slot is a list of timers linked through their nodes, with a
+ * pointer back to whatever points at the node so it can be removed
+ * without knowing which slot it is in. Level 0 slot i holds timers due at
+ * the tick in the next TIMER_WHEEL_SLOTS whose low bits are i. Level L
+ * slot i holds timers to be cascaded when the wheel reaches the next tick
+ * that is a multiple of TIMER_WHEEL_SLOTS^L with bits i above that.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stddef.h>
+#include <string.h>
+#include "timer_wheel.h"
+
+#define SHIFT(level) ((level) * TIMER_WHEEL_BITS)
+#define SLOT(tick, level) timer_wheel_slot(tick, SHIFT(level), TIMER_WHEEL_BITS)
+
+static void link_node(timer_wheel_node_t **head, timer_wheel_node_t *node)
+{
+    node->next = *head;
+    if (node->next) {
+        node->next->pprev = &node->next;
+    }
+    node->pprev = head;
+    *head = node;
+}
+
+static void unlink_node(timer_wheel_node_t *node)
+{
+    *node->pprev = node->next;
+    if (node->next) {
+        node->next->pprev = node->pprev;
+    }
+    node->pprev = NULL;
+}
+
+/* File 'node' under the tick 'delta' ticks from now */
+static void file_node(timer_wheel_t *w, timer_wheel_node_t *node, uint32_t delta)
+{
+    uint32_t at = w->now + delta;
+    timer_wheel_node_t **head;
+
+    if (delta < TIMER_WHEEL_SLOTS) {
+        head = &w->slot[0][SLOT(at, 0)];
+    } else if (delta >= TIMER_WHEEL_RANGE) {
+        head = &w->overflow;
+    } else {
+        int level = 1;
+        while (delta >> SHIFT(level + 1)) {
+            level++;
+        }
+        head = &w->slot[level][SLOT(at, level)];
+    }
+    link_node(head, node);
+}
+
+/* Refile everything on a list against the current tick */
+static void refile(timer_wheel_t *w, timer_wheel_node_t **head)
+{
+    timer_wheel_node_t *node = *head;
+
+    *head = NULL;
+    while (node) {
+        timer_wheel_node_t *next = node->next;
+        file_node(w, node, node->expiry - w->now);
+        w->cascades++;
+        node = next;
+    }
+}
+
+/* Move timers down from the slots of every level that has just come
+   round, lowest level first */
+static void cascade(timer_wheel_t *w)
+{
+    uint32_t now = w->now;
+    int level;
+
+    for (level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        if (timer_wheel_slot_start(now, SHIFT(level)) != now) {
+            return;
+        }
+        refile(w, &w->slot[level][SLOT(now, level)]);
+    }
+    if (timer_wheel_slot_start(now, SHIFT(TIMER_WHEEL_LEVELS)) == now) {
+        refile(w, &w->overflow);
+    }
+}
+
+void timer_wheel_init(timer_wheel_t *w, uint32_t now)
+{
+    memset(w, 0, sizeof(*w));
+    w->now = now;
+}
+
+void timer_wheel_add(timer_wheel_t *w, timer_wheel_node_t *node, uint32_t start, uint32_t ticks)
+{
+    int32_t elapsed = (int32_t)(w->now - start);
+    uint32_t delta;
+
+    timer_wheel_remove(w, node);
+    if (elapsed >= 0) {
+        delta = (uint32_t)elapsed >= ticks ? 0 : ticks - elapsed;
+    } else {
+        /* 'start' is ahead of the wheel, which hasn't caught up with the
+           tick count yet */
+        delta = ticks - elapsed;
+        if (delta < ticks) {
+            delta = ticks;
+        }
+    }
+    node->expiry = start + ticks;
+    file_node(w, node, delta);
+    if (++w->active > w->peak) {
+        w->peak = w->active;
+    }
+}
+
+void timer_wheel_remove(timer_wheel_t *w, timer_wheel_node_t *node)
+{
+    if (node->pprev) {
+        unlink_node(node);
+        w->active--;
+    }
+}
+
+bool timer_wheel_next(const timer_wheel_t *w, uint32_t *tick)
+{
+    uint32_t now = w->now;
+    uint32_t best = UINT32_MAX;     /* As ticks from now */
+
+    if (w->active == 0) {
+        return false;
+    }
+    for (uint32_t i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+        if (w->slot[0][SLOT(now + i, 0)]) {
+            best = i;
+            break;
+        }
+    }
+    for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        uint32_t granule = 1UL << SHIFT(level);
+        /* Next tick after now when this level cascades. Higher levels
+           cascade no earlier, so stop when that's too late. */
+        uint32_t base = timer_wheel_slot_start(now, SHIFT(level)) + granule;
+        if (base - now >= best) {
+            break;
+        }
+        uint32_t index = SLOT(base, level);
+        for (uint32_t j = 0; j < TIMER_WHEEL_SLOTS; j++) {
+            if (w->slot[level][(index + j) % TIMER_WHEEL_SLOTS]) {
+                uint32_t delta = base + j * granule - now;
+                if (delta < best) {
+                    best = delta;
+                }
+                break;
+            }
+        }
+    }
+    if (w->overflow) {
+        uint32_t delta = timer_wheel_slot_start(now, SHIFT(TIMER_WHEEL_LEVELS)) + TIMER_WHEEL_RANGE - now;
+        if (delta < best) {
+            best = delta;
+        }
+    }
+    *tick = now + best;
+    return true;
+}
+
+timer_wheel_node_t *timer_wheel_expire(timer_wheel_t *w, uint32_t now)
+{
+    for (;;) {
+        timer_wheel_node_t *node = w->slot[0][SLOT(w->now, 0)];
+        uint32_t next;
+
+        if (node) {
+            unlink_node(node);
+            w->active--;
+            return node;
+        }
+        if ((int32_t)(now - w->now) <= 0) {
+            return NULL;
+        }
+        /* Skip ahead to the next tick with something to do */
+        if (!timer_wheel_next(w, &next) || (int32_t)(next - now) > 0) {
+            next = now;
+        }
+        w->now = next;
+        cascade(w);
+    }
+}
@@ -37,7 +37,7 @@
  * task_1_t
  *
  */
-class task_1_t: public esp_open_rtos::thread::task_t
+class task_1_t: public esp_open_rtos::thread::static_task_t<>
 {
 public:
     esp_open_rtos::thread::queue_t<uint32_t> queue;
@@ -60,7 +60,7 @@ private:
  * task_2_t
  *
  */
-class task_2_t: public esp_open_rtos::thread::task_t
+class task_2_t: public esp_open_rtos::thread::static_task_t<>
 {
 public:
     esp_open_rtos::thread::queue_t<uint32_t> queue;
@@ -89,7 +89,9 @@ private:
 task_1_t task_1;
 task_2_t task_2;
 
-esp_open_rtos::thread::queue_t<uint32_t> MyQueue;
+/* Task stacks and the queue storage are all in .bss, nothing is allocated
+   from the heap or can fail at startup */
+esp_open_rtos::thread::static_queue_t<uint32_t, 10> MyQueue;
 
 /**
  * 
@@ -98,8 +100,6 @@ extern "C" void user_init(void)
 {
     uart_set_baud(0, 115200);
     
-    MyQueue.queue_create(10);
-    
     task_1.queue = MyQueue;
     task_2.queue = MyQueue;
     
@@ -0,0 +1,255 @@
+/* Passes 256 byte frames from one task to another and prints the CPU
+ * cycles per frame for
+ *
+ * - queue_t, which copies each frame into and out of the queue
+ * - channel_t in MPMC and SPSC mode, moving ownership of pooled frames
+ * - channel_t with post_n()/receive_n() batches
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <utility>
+
+#include "task.hpp"
+#include "queue.hpp"
+#include "channel.hpp"
+
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include <xtensa_ops.h>
+
+using namespace esp_open_rtos::thread;
+
+#define FRAMES   20000
+#define DEPTH    8
+#define BATCH    4
+#define TIMEOUT  1000
+
+struct frame_t
+{
+    uint32_t seq;
+    uint8_t data[252];
+};
+
+static inline uint32_t ccount()
+{
+    uint32_t ccount;
+    RSR(ccount, ccount);
+    return ccount;
+}
+
+/******************************************************************************************************************
+ * bench_t
+ *
+ * One way of moving frames between a producer and a consumer task.
+ * produce() and consume() run in different tasks and return the number of
+ * frames lost or out of order.
+ */
+class bench_t
+{
+public:
+    bench_t(const char* name) : name(name) {}
+
+    virtual unsigned produce(uint32_t count) = 0;
+    virtual unsigned consume(uint32_t count) = 0;
+
+    const char* name;
+};
+
+class queue_bench_t : public bench_t
+{
+public:
+    queue_bench_t() : bench_t("queue_t") {}
+
+    unsigned produce(uint32_t count)
+    {
+        frame_t frame;
+        unsigned errors = 0;
+        for(uint32_t seq = 0; seq < count; seq++) {
+            frame.seq = seq;
+            errors += queue.post(frame, TIMEOUT) != 0;
+        }
+        return errors;
+    }
+    unsigned consume(uint32_t count)
+    {
+        frame_t frame;
+        unsigned errors = 0;
+        for(uint32_t seq = 0; seq < count; seq++) {
+            errors += queue.receive(frame, TIMEOUT) != 0 || frame.seq != seq;
+        }
+        return errors;
+    }
+
+private:
+    static_queue_t<frame_t, DEPTH> queue;
+};
+
+template<channel_mode_t Mode>
+class channel_bench_t : public bench_t
+{
+public:
+    channel_bench_t(const char* name) : bench_t(name) {}
+
+    unsigned produce(uint32_t count)
+    {
+        unsigned errors = 0;
+        for(uint32_t seq = 0; seq < count; seq++) {
+            typename chan_t::message_t frame = channel.alloc(TIMEOUT);
+            if(!frame) {
+                errors++;
+                continue;
+            }
+            frame->seq = seq;
+            channel.post(std::move(frame));
+        }
+        return errors;
+    }
+    unsigned consume(uint32_t count)
+    {
+        typename chan_t::message_t frame;
+        unsigned errors = 0;
+        for(uint32_t seq = 0; seq < count; seq++) {
+            errors += channel.receive(frame, TIMEOUT) != 0 || frame->seq != seq;
+            frame.reset();
+        }
+        return errors;
+    }
+
+protected:
+    typedef channel_t<frame_t, DEPTH, Mode> chan_t;
+    chan_t channel;
+};
+
+template<channel_mode_t Mode>
+class batch_bench_t : public channel_bench_t<Mode>
+{
+public:
+    batch_bench_t(const char* name) : channel_bench_t<Mode>(name) {}
+
+    unsigned produce(uint32_t count)
+    {
+        typename chan_t::message_t frames[BATCH];
+        unsigned errors = 0;
+        for(uint32_t seq = 0; seq < count; seq += BATCH) {
+            for(unsigned i = 0; i < BATCH; i++) {
+                frames[i] = this->channel.alloc(TIMEOUT);
+                if(!frames[i]) {
+                    return errors + count - seq;
+                }
+                frames[i]->seq = seq + i;
+            }
+            this->channel.post_n(frames, BATCH);
+        }
+        return errors;
+    }
+    unsigned consume(uint32_t count)
+    {
+        typename chan_t::message_t frames[BATCH];
+        unsigned errors = 0;
+        for(uint32_t seq = 0; seq < count; ) {
+            unsigned n = this->channel.receive_n(frames, BATCH, TIMEOUT);
+            if(n == 0) {
+                return errors + count - seq;
+            }
+            for(unsigned i = 0; i < n; i++, seq++) {
+                errors += frames[i]->seq != seq;
+                frames[i].reset();
+            }
+        }
+        return errors;
+    }
+
+private:
+    typedef typename channel_bench_t<Mode>::chan_t chan_t;
+};
+
+/******************************************************************************************************************
+ * consumer_t
+ *
+ */
+class consumer_t: public static_task_t<512>
+{
+public:
+    static_queue_t<bench_t*, 1> start;
+    static_queue_t<unsigned, 1> done;
+
+private:
+    void task()
+    {
+        while(true) {
+            bench_t* bench;
+            if(start.receive(bench, 10000) == 0) {
+                done.post(bench->consume(FRAMES), TIMEOUT);
+            }
+        }
+    }
+};
+
+/******************************************************************************************************************
+ * producer_t
+ *
+ */
+class producer_t: public static_task_t<512>
+{
+public:
+    consumer_t* consumer;
+
+private:
+    void run(bench_t* bench)
+    {
+        unsigned rx_errors = FRAMES;
+
+        consumer->start.post(bench);
+        uint32_t start = ccount();
+        unsigned tx_errors = bench->produce(FRAMES);
+        consumer->done.receive(rx_errors, 10000);
+        uint32_t cycles = ccount() - start;
+
+        printf("%-16s %6u cycles/frame", bench->name, cycles / FRAMES);
+        if(tx_errors || rx_errors) {
+            printf("  %u send and %u receive errors", tx_errors, rx_errors);
+        }
+        printf("\n");
+    }
+
+    void task()
+    {
+        while(true) {
+            sleep(1000);
+            printf("%u frames of %u bytes, %u deep\n", FRAMES, (unsigned)sizeof(frame_t), DEPTH);
+            run(&queue_bench);
+            run(&mpmc_bench);
+            run(&spsc_bench);
+            run(&mpmc_batch_bench);
+            run(&spsc_batch_bench);
+            sleep(4000);
+        }
+    }
+
+    queue_bench_t queue_bench;
+    channel_bench_t<CHANNEL_MPMC> mpmc_bench { "channel_t MPMC" };
+    channel_bench_t<CHANNEL_SPSC> spsc_bench { "channel_t SPSC" };
+    batch_bench_t<CHANNEL_MPMC> mpmc_batch_bench { "batch MPMC" };
+    batch_bench_t<CHANNEL_SPSC> spsc_batch_bench { "batch SPSC" };
+};
+
+/******************************************************************************************************************
+ * globals
+ *
+ */
+consumer_t consumer;
+producer_t producer;
+
+/**
+ * 
+ */
+extern "C" void user_init(void)
+{
+    uart_set_baud(0, 115200);
+
+    producer.consumer = &consumer;
+
+    consumer.task_create("consumer");
+    producer.task_create("producer");
+}
@@ -0,0 +1,68 @@
+/* Cycles per log call: extras/dlog vs. snprintf() and printf()
+ *
+ * Logs the same message N times each way and prints the average CCOUNT
+ * cycles per call. snprintf() is the formatting cost alone, printf() adds
+ * writing to the UART. The dlog records are then formatted by its task,
+ * or run utils/dlog_decode.py on the output after switching it to
+ * DLOG_OUTPUT_HEX.
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "xtensa_ops.h"
+#include "dlog.h"
+
+#define CALLS 100
+#define PRINTF_CALLS 10
+
+static inline uint32_t ccount(void)
+{
+    uint32_t r;
+    RSR(r, ccount);
+    return r;
+}
+
+static void bench_task(void *params)
+{
+    char buf[80];
+    uint32_t start, t_dlog, t_snprintf, t_printf;
+
+    vTaskDelay(500 / portTICK_PERIOD_MS);
+
+    start = ccount();
+    for (int i = 0; i < CALLS; i++) {
+        DLOGI("sample %d: adc %u, state %x", i, 512 + i, 0xbeef);
+    }
+    t_dlog = (ccount() - start) / CALLS;
+
+    start = ccount();
+    for (int i = 0; i < CALLS; i++) {
+        snprintf(buf, sizeof(buf), "sample %d: adc %u, state %x\n", i, 512 + i, 0xbeef);
+    }
+    t_snprintf = (ccount() - start) / CALLS;
+
+    start = ccount();
+    for (int i = 0; i < PRINTF_CALLS; i++) {
+        printf("sample %d: adc %u, state %x\n", i, 512 + i, 0xbeef);
+    }
+    t_printf = (ccount() - start) / PRINTF_CALLS;
+
+    printf("\nCycles per log call at %u MHz:\n", sdk_system_get_cpu_freq());
+    printf("  DLOGI     %6u\n", t_dlog);
+    printf("  snprintf  %6u\n", t_snprintf);
+    printf("  printf    %6u\n", t_printf);
+    printf("%u dlog records lost\n\n", dlog_lost());
+
+    dlog_start(tskIDLE_PRIORITY + 1, DLOG_OUTPUT_TEXT);
+    vTaskDelete(NULL);
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    xTaskCreate(bench_task, "bench", 512, NULL, 2, NULL);
+}
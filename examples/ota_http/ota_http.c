@@ -0,0 +1,70 @@
+/* HTTP pull OTA example
+ *
+ * Downloads a firmware image over HTTP into the next rboot slot, resuming
+ * interrupted downloads, then reboots into it.
+ *
+ * To try it against a Linux host, serve the firmware directory with:
+ *   utils/ota_http_server.py -d firmware -p 8080 --drop-every 65536
+ * (--drop-every makes the server hang up periodically to exercise resume.)
+ *
+ * NOT SUITABLE TO PUT ON THE INTERNET OR INTO A PRODUCTION ENVIRONMENT!!!!
+ */
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "ssid_config.h"
+
+#include "ota-http.h"
+#include "rboot-api.h"
+
+#define OTA_HTTP_SERVER "192.168.1.23"
+#define OTA_HTTP_PORT 8080
+#define OTA_HTTP_PATH "/ota_http.bin"
+
+static void progress(size_t bytes_written, size_t total_len)
+{
+    printf("OTA: %d / %d bytes\n", bytes_written, total_len);
+}
+
+void ota_http_task(void *pvParameters)
+{
+    rboot_config conf = rboot_get_config();
+    int slot = (conf.current_rom + 1) % conf.count;
+    printf("Image will be saved in OTA slot %d.\n", slot);
+
+    const ota_http_request_t req = {
+        .host = OTA_HTTP_SERVER,
+        .port = OTA_HTTP_PORT,
+        .path = OTA_HTTP_PATH,
+    };
+
+    while(1) {
+        vTaskDelay(5000 / portTICK_PERIOD_MS);
+        ota_http_result_t res = ota_http_download(&req, slot, 10, progress);
+        printf("ota_http_download result %d\n", res);
+        if(res == OTA_HTTP_OK) {
+            printf("Rebooting into slot %d...\n", slot);
+            rboot_set_current_rom(slot);
+            sdk_system_restart();
+        }
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+
+    rboot_config conf = rboot_get_config();
+    printf("\r\n\r\nOTA HTTP demo.\r\nCurrently running on flash slot %d / %d.\r\n\r\n",
+           conf.current_rom, conf.count);
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    xTaskCreate(&ota_http_task, "ota_http", 1024, NULL, 2, NULL);
+}
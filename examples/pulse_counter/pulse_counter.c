@@ -0,0 +1,85 @@
+/* Count pulses and measure their frequency with extras/gpio_capture
+ *
+ * Falling edges on GPIO 4 (e.g. a flow meter or anemometer reed switch
+ * pulling it low) are timestamped in the interrupt handler. Once a
+ * second this task reads them in batches, ignores contact bounce and
+ * prints the pulse count and frequency.
+ *
+ * To try it without a sensor, connect GPIO 5 to GPIO 4: it is toggled
+ * by a hardware timer at PULSE_HZ.
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/timer.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "gpio_capture.h"
+
+#define INPUT_PIN 4
+#define TEST_PIN 5
+#define PULSE_HZ 2000
+
+#define DEBOUNCE_US 50
+#define BATCH 64
+
+static void IRAM frc1_isr(void)
+{
+    gpio_toggle(TEST_PIN);
+}
+
+static void pulse_task(void *params)
+{
+    static gpio_capture_event_t events[BATCH];
+    uint32_t mhz = sdk_system_get_cpu_freq();
+    TickType_t report = xTaskGetTickCount() + configTICK_RATE_HZ;
+    capture_pulse_t pulse;
+    capture_pulse_stats_t s;
+    uint32_t total = 0, reads = 0;
+
+    capture_pulse_init(&pulse, DEBOUNCE_US * mhz);
+    gpio_capture_add(INPUT_PIN, GPIO_INTTYPE_EDGE_NEG);
+
+    while (1) {
+        size_t n = gpio_capture_read(events, BATCH, configTICK_RATE_HZ / 10);
+        reads++;
+        for (size_t i = 0; i < n; i++) {
+            capture_pulse_add(&pulse, events[i].ccount);
+        }
+        if ((int32_t)(xTaskGetTickCount() - report) < 0) {
+            continue;
+        }
+        report += configTICK_RATE_HZ;
+        capture_pulse_take(&pulse, &s);
+        if (!s.edges) {
+            /* Don't count a quiet spell as one long period */
+            capture_pulse_restart(&pulse);
+        }
+        total += s.edges;
+        uint32_t millihz = capture_pulse_millihz(s.period, mhz);
+        printf("%u pulses (%u total), %u bounces, %u.%03u Hz, period %u..%u us, "
+               "%u wakeups, %u dropped\n",
+               s.edges, total, s.bounces, millihz / 1000, millihz % 1000,
+               s.period_min / mhz, s.period_max / mhz, reads, gpio_capture_dropped());
+        reads = 0;
+    }
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+
+    gpio_enable(INPUT_PIN, GPIO_INPUT);
+    gpio_set_pullup(INPUT_PIN, true, false);
+    gpio_capture_init(256, BATCH);
+
+    gpio_enable(TEST_PIN, GPIO_OUTPUT);
+    _xt_isr_attach(INUM_TIMER_FRC1, frc1_isr);
+    timer_set_frequency(FRC1, PULSE_HZ * 2);
+    timer_set_interrupts(FRC1, true);
+    timer_set_run(FRC1, true);
+
+    xTaskCreate(pulse_task, "pulse", 512, NULL, 2, NULL);
+}
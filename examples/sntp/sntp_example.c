@@ -42,8 +42,8 @@ void sntp_tsk(void *pvParameters)
 
 	/* Start SNTP */
 	printf("Starting SNTP... ");
-	/* SNTP will request an update each 5 minutes */
-	sntp_set_update_delay(5*60000);
+	/* SNTP will request updates at least every 30 minutes */
+	sntp_set_update_delay(30*60000);
 	/* Set GMT+1 zone, daylight savings off */
 	const struct timezone tz = {1*60, 0};
 	/* SNTP initialization */
@@ -52,11 +52,16 @@ void sntp_tsk(void *pvParameters)
 	sntp_set_servers(servers, sizeof(servers) / sizeof(char*));
 	printf("DONE!\n");
 
-	/* Print date and time each 5 seconds */
+	/* Print date and time each 5 seconds, and how the RTC is doing */
 	while(1) {
 		vTaskDelayMs(5000);
 		time_t ts = time(NULL);
 		printf("TIME: %s", ctime(&ts));
+
+		sntp_clock_stats_t stats;
+		sntp_get_clock_stats(&stats);
+		printf("offset %d us, jitter %u us, RTC %+d ppb, next update in %u s\n",
+				stats.offset, stats.jitter, stats.freq, stats.poll);
 	}
 }
 
@@ -0,0 +1,102 @@
+/* SPI throughput and CPU time, spi_transfer() vs. extras/spi_async
+ *
+ * Sends the same 4 KB on HSPI (MOSI on GPIO13, SCK on GPIO14) at a few
+ * clock rates, first with spi_transfer() and then queued as one
+ * transaction per 512 bytes. For the queued case the task counts how many
+ * times it could run a loop while waiting, to show the CPU time left
+ * over. Connect MISO (GPIO12) to MOSI to check the received data.
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/spi.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "xtensa_ops.h"
+#include "spi_async.h"
+
+#define BYTES 4096
+#define PART 512
+
+static uint8_t tx[BYTES], rx[BYTES];
+static spi_async_trans_t trans[BYTES / PART];
+
+static inline uint32_t ccount(void)
+{
+    uint32_t r;
+    RSR(r, ccount);
+    return r;
+}
+
+static void report(const char *what, uint32_t cycles, uint32_t freq)
+{
+    uint32_t mhz = sdk_system_get_cpu_freq();
+    uint32_t us = cycles / mhz;
+    /* Time the bits take on the wire, as a percentage of the elapsed time */
+    uint32_t wire = (uint64_t)BYTES * 8 * 1000000 / freq;
+
+    printf("  %-8s %6u us, %3u%% of wire rate, rx %s\n", what, us,
+           us ? wire * 100 / us : 0, memcmp(tx, rx, BYTES) ? "differs" : "ok");
+}
+
+static void bench(uint32_t divider)
+{
+    uint32_t start, loops = 0;
+
+    spi_set_frequency_div(1, divider);
+    uint32_t freq = spi_get_frequency_hz(1);
+    printf("%u Hz:\n", freq);
+
+    memset(rx, 0, sizeof(rx));
+    start = ccount();
+    spi_transfer(1, tx, rx, BYTES, SPI_8BIT);
+    report("polled", ccount() - start, freq);
+
+    memset(rx, 0, sizeof(rx));
+    start = ccount();
+    for (int i = 0; i < BYTES / PART; i++) {
+        trans[i] = (spi_async_trans_t) {
+            .tx = tx + i * PART,
+            .rx = rx + i * PART,
+            .len = PART,
+            .cs_gpio = SPI_ASYNC_CS_NONE,
+        };
+        spi_async_queue(&trans[i]);
+    }
+    while (spi_async_busy()) {
+        loops++;
+    }
+    report("queued", ccount() - start, freq);
+    printf("  %u loops while waiting\n", loops);
+}
+
+static void bench_task(void *params)
+{
+    spi_async_stats_t stats;
+
+    for (int i = 0; i < BYTES; i++) {
+        tx[i] = i * 13 + 7;
+    }
+    spi_init(1, SPI_MODE0, SPI_FREQ_DIV_1M, true, SPI_LITTLE_ENDIAN, true);
+    spi_async_init(1);
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    bench(SPI_FREQ_DIV_1M);
+    bench(SPI_FREQ_DIV_10M);
+    bench(SPI_FREQ_DIV_20M);
+    bench(SPI_FREQ_DIV_40M);
+
+    spi_async_get_stats(&stats);
+    printf("spi_async: %u transactions, %u chunks, %u bytes, %u interrupts\n",
+           stats.transactions, stats.chunks, stats.bytes, stats.interrupts);
+    vTaskDelete(NULL);
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    xTaskCreate(bench_task, "bench", 512, NULL, 2, NULL);
+}
@@ -0,0 +1,97 @@
+/* Cost of switching between devices on a shared SPI bus
+ *
+ * Measures, in CPU cycles per acquire/release pair, taking HSPI again for
+ * the same device, alternating between two devices with the same
+ * settings, and alternating between two devices with different mode,
+ * clock and byte order. For comparison, the last line is what applying
+ * all settings with spi_set_settings() each time costs. Nothing is
+ * transferred, so no hardware needs to be connected.
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "esp/spi.h"
+#include "esp/gpio.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "xtensa_ops.h"
+
+#define ROUNDS 1000
+
+static const spi_device_t display = {
+    .bus = 1,
+    .settings = { SPI_MODE0, SPI_FREQ_DIV_20M, true, SPI_LITTLE_ENDIAN, true },
+    .cs_gpio = 4
+};
+
+static const spi_device_t flash = {
+    .bus = 1,
+    .settings = { SPI_MODE0, SPI_FREQ_DIV_20M, true, SPI_LITTLE_ENDIAN, true },
+    .cs_gpio = 5
+};
+
+static const spi_device_t adc = {
+    .bus = 1,
+    .settings = { SPI_MODE3, SPI_FREQ_DIV_1M, true, SPI_BIG_ENDIAN, true },
+    .cs_gpio = 15
+};
+
+static inline uint32_t ccount(void)
+{
+    uint32_t r;
+    RSR(r, ccount);
+    return r;
+}
+
+static uint32_t alternate(const spi_device_t *a, const spi_device_t *b)
+{
+    uint32_t start = ccount();
+
+    for (int i = 0; i < ROUNDS / 2; i++) {
+        spi_device_acquire(a, portMAX_DELAY);
+        spi_device_release(a);
+        spi_device_acquire(b, portMAX_DELAY);
+        spi_device_release(b);
+    }
+    return (ccount() - start) / ROUNDS;
+}
+
+static uint32_t set_settings(void)
+{
+    uint32_t start = ccount();
+
+    for (int i = 0; i < ROUNDS / 2; i++) {
+        spi_set_settings(1, &display.settings);
+        spi_set_settings(1, &adc.settings);
+    }
+    return (ccount() - start) / ROUNDS;
+}
+
+static void bench_task(void *params)
+{
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+
+    printf("Cycles per device switch, %d rounds:\n", ROUNDS);
+    printf("  same device          %5u\n", alternate(&display, &display));
+    printf("  same settings        %5u\n", alternate(&display, &flash));
+    printf("  different settings   %5u\n", alternate(&display, &adc));
+    printf("  spi_set_settings()   %5u\n", set_settings());
+    vTaskDelete(NULL);
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+
+    gpio_enable(display.cs_gpio, GPIO_OUTPUT);
+    gpio_enable(flash.cs_gpio, GPIO_OUTPUT);
+    gpio_enable(adc.cs_gpio, GPIO_OUTPUT);
+    gpio_write(display.cs_gpio, true);
+    gpio_write(flash.cs_gpio, true);
+    gpio_write(adc.cs_gpio, true);
+    spi_set_settings(1, &display.settings);
+
+    xTaskCreate(bench_task, "bench", 512, NULL, 2, NULL);
+}
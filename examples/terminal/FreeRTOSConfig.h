@@ -4,8 +4,12 @@
    which are otherwise found in FreeRTOS/Source/include/FreeRTOSConfig.h
 */
 
-/* The serial driver depends on counting semaphores */
-#define configUSE_COUNTING_SEMAPHORES 1
+/* Per-task CPU time for the 'top' command */
+#define configUSE_TRACE_FACILITY 1
+#define configGENERATE_RUN_TIME_STATS 1
+
+/* Longest critical sections for the 'critical' command */
+#define configCRITICAL_SECTION_STATS 1
 
 /* Use the defaults for everything else */
 #include_next<FreeRTOSConfig.h>
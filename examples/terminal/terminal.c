@@ -1,6 +1,6 @@
 /* Serial terminal example
- * UART RX is interrupt driven
- * Implements a simple GPIO terminal for setting and clearing GPIOs
+ * Implements a simple GPIO terminal for setting and clearing GPIOs, on the
+ * serial port and over telnet, with extras/shell
  *
  * This sample code is in the public domain.
  */
@@ -15,103 +15,167 @@
 #include <stdio.h>
 #include "FreeRTOS.h"
 #include "task.h"
+#include "esp_netstats.h"
+#include "cpu_stats.h"
+#include "boot_profile.h"
+#include "espressif/esp_common.h"
+#include "shell.h"
+#include "ssid_config.h"
 
-#define MAX_ARGC (10)
+/* Telnet to the module on this port for the same commands */
+#define TELNET_PORT 23
 
-static void cmd_on(uint32_t argc, char *argv[])
+static int cmd_on(shell_t *sh, int argc, char *argv[])
 {
     if (argc >= 2) {
         for(int i=1; i<argc; i++) {
             uint8_t gpio_num = atoi(argv[i]);
             gpio_enable(gpio_num, GPIO_OUTPUT);
             gpio_write(gpio_num, true);
-            printf("On %d\n", gpio_num);
+            shell_printf(sh, "On %d\n", gpio_num);
         }
-    } else {
-        printf("Error: missing gpio number.\n");
+        return 0;
     }
+    shell_printf(sh, "Error: missing gpio number.\n");
+    return 1;
 }
 
-static void cmd_off(uint32_t argc, char *argv[])
+static int cmd_off(shell_t *sh, int argc, char *argv[])
 {
     if (argc >= 2) {
         for(int i=1; i<argc; i++) {
             uint8_t gpio_num = atoi(argv[i]);
             gpio_enable(gpio_num, GPIO_OUTPUT);
             gpio_write(gpio_num, false);
-            printf("Off %d\n", gpio_num);
+            shell_printf(sh, "Off %d\n", gpio_num);
         }
-    } else {
-        printf("Error: missing gpio number.\n");
+        return 0;
     }
+    shell_printf(sh, "Error: missing gpio number.\n");
+    return 1;
 }
 
-static void cmd_help(uint32_t argc, char *argv[])
+static int cmd_sleep(shell_t *sh, int argc, char *argv[])
 {
-    printf("on <gpio number> [ <gpio number>]+     Set gpio to 1\n");
-    printf("off <gpio number> [ <gpio number>]+    Set gpio to 0\n");
-    printf("sleep                                  Take a nap\n");
-    printf("\nExample:\n");
-    printf("  on 0<enter> switches on gpio 0\n");
-    printf("  on 0 2 4<enter> switches on gpios 0, 2 and 4\n");
+    shell_printf(sh, "Type away while I take a 2 second nap (ie. let you test the UART buffering)\n");
+    vTaskDelay(2000 / portTICK_PERIOD_MS);
+    return 0;
 }
 
-static void cmd_sleep(uint32_t argc, char *argv[])
+static void netstats_dir(shell_t *sh, const char *name, const netstats_dir_t *dir)
 {
-    printf("Type away while I take a 2 second nap (ie. let you test the UART HW FIFO\n");
-    vTaskDelay(2000 / portTICK_PERIOD_MS);
+    shell_printf(sh, "%s: %u packets %u bytes, chain length 1:%u 2:%u 3:%u 4+:%u\n",
+                 name, dir->packets, dir->bytes, dir->chain_len[0],
+                 dir->chain_len[1], dir->chain_len[2], dir->chain_len[3]);
 }
 
-static void handle_command(char *cmd)
+static int cmd_netstats(shell_t *sh, int argc, char *argv[])
 {
-    char *argv[MAX_ARGC];
-    int argc = 1;
-    char *temp, *rover;
-    memset((void*) argv, 0, sizeof(argv));
-    argv[0] = cmd;
-    rover = cmd;
-    // Split string "<command> <argument 1> <argument 2>  ...  <argument N>"
-    // into argv, argc style
-    while(argc < MAX_ARGC && (temp = strstr(rover, " "))) {
-        rover = &(temp[1]);
-        argv[argc++] = rover;
-        *temp = 0;
+    netstats_t s;
+    uint32_t mhz = sdk_system_get_cpu_freq();
+
+    if (argc >= 2 && strcmp(argv[1], "reset") == 0) {
+        netstats_reset();
+        shell_printf(sh, "Network statistics cleared\n");
+        return 0;
     }
+    if (!ESP_NETSTATS) {
+        shell_printf(sh, "Network statistics are disabled (ESP_NETSTATS=0)\n");
+        return 1;
+    }
+    netstats_get(&s);
+    netstats_dir(sh, "RX", &s.rx);
+    netstats_dir(sh, "TX", &s.tx);
+    shell_printf(sh, "TX coalesced: %u chains, %u bytes copied, %u pool misses\n",
+                 s.tx_coalesced, s.tx_copied_bytes, s.tx_pool_misses);
+    shell_printf(sh, "Drops: rx ethtype %u, rx input %u, rx recvmbox full %u, tx mac %u, tx mem %u\n",
+                 s.drops[NETSTATS_DROP_RX_ETHTYPE], s.drops[NETSTATS_DROP_RX_INPUT],
+                 s.drops[NETSTATS_DROP_RX_RECVMBOX], s.drops[NETSTATS_DROP_TX_MAC],
+                 s.drops[NETSTATS_DROP_TX_MEM]);
+    shell_printf(sh, "tcpip mbox high water mark: %u\n", s.tcpip_mbox_hwm);
+    if (s.latency_samples == 0) {
+        shell_printf(sh, "RX to socket latency: no samples\n");
+        return 0;
+    }
+    shell_printf(sh, "RX to socket latency: %u samples, min %uus avg %uus max %uus\n",
+                 s.latency_samples, s.latency_min / mhz,
+                 (uint32_t)(s.latency_total / s.latency_samples / mhz),
+                 s.latency_max / mhz);
+    shell_printf(sh, "  <16us:%u <32us:%u <64us:%u <128us:%u <256us:%u <512us:%u <1ms:%u >=1ms:%u\n",
+                 s.latency_hist[0], s.latency_hist[1], s.latency_hist[2], s.latency_hist[3],
+                 s.latency_hist[4], s.latency_hist[5], s.latency_hist[6], s.latency_hist[7]);
+    return 0;
+}
+
+static void top_out(void *ctx, const char *text)
+{
+    shell_write(ctx, text, strlen(text));
+}
+
+static int cmd_top(shell_t *sh, int argc, char *argv[])
+{
+    uint32_t ms = argc >= 2 ? atoi(argv[1]) : 1000;
+
+    return cpu_stats_top_out(ms, top_out, sh) ? 0 : 1;
+}
+
+static int cmd_critical(shell_t *sh, int argc, char *argv[])
+{
+    PortCriticalStat_t stats[portCRITICAL_STATS_COUNT];
+    uint32_t mhz = sdk_system_get_cpu_freq();
 
-    if (strlen(argv[0]) > 0) {
-        if (strcmp(argv[0], "help") == 0) cmd_help(argc, argv);
-        else if (strcmp(argv[0], "on") == 0) cmd_on(argc, argv);
-        else if (strcmp(argv[0], "off") == 0) cmd_off(argc, argv);
-        else if (strcmp(argv[0], "sleep") == 0) cmd_sleep(argc, argv);
-        else printf("Unknown command %s, try 'help'\n", argv[0]);
+    if (argc >= 2 && strcmp(argv[1], "reset") == 0) {
+        vPortResetCriticalStats();
+        shell_printf(sh, "Critical section statistics cleared\n");
+        return 0;
     }
+    int n = xPortGetCriticalStats(stats, portCRITICAL_STATS_COUNT);
+    for (int i = 0; i < n; i++) {
+        shell_printf(sh, "%6u us  %p\n", stats[i].cycles / mhz, stats[i].caller);
+    }
+    return 0;
 }
 
-static void gpiomon()
+static int cmd_boot(shell_t *sh, int argc, char *argv[])
 {
-    char ch;
-    char cmd[81];
-    int i = 0;
-    printf("\n\n\nWelcome to gpiomon. Type 'help<enter>' for, well, help\n");
-    printf("%% ");
-    while(1) {
-        if (read(0, (void*)&ch, 1)) { // 0 is stdin
-            printf("%c", ch);
-            if (ch == '\n' || ch == '\r') {
-                cmd[i] = 0;
-                i = 0;
-                printf("\n");
-                handle_command((char*) cmd);
-                printf("%% ");
-            } else {
-                if (i < sizeof(cmd)) cmd[i++] = ch;
-            }
-        }
+    const char *name;
+    uint32_t us, phase;
+    unsigned i;
+
+    shell_printf(sh, "    time(us)   phase(us)  mark\n");
+    for (i = 0; boot_profile_get(i, &name, &us, &phase); i++) {
+        shell_printf(sh, "%12u %11u  %s\n", us, phase, name);
+    }
+    if (i == BOOT_PROFILE_MARKS) {
+        shell_printf(sh, "(further marks dropped)\n");
     }
+    return 0;
 }
 
+/* Example: 'on 0 2 4' switches on gpios 0, 2 and 4 */
+static const shell_cmd_t commands[] = {
+    { "on", "<gpio> [<gpio>]+", "Set gpios to 1", cmd_on },
+    { "off", "<gpio> [<gpio>]+", "Set gpios to 0", cmd_off },
+    { "sleep", NULL, "Take a nap", cmd_sleep },
+    { "netstats", "[reset]", "Show (or clear) WiFi/lwIP packet statistics", cmd_netstats },
+    { "top", "[ms]", "Show CPU use and free stack per task", cmd_top },
+    { "critical", "[reset]", "Show (or clear) the longest critical sections", cmd_critical },
+    { "boot", NULL, "Show the boot timeline", cmd_boot },
+};
+
 void user_init(void)
 {
     uart_set_baud(0, 115200);
-    gpiomon();
+
+    struct sdk_station_config config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASS,
+    };
+    sdk_wifi_set_opmode(STATION_MODE);
+    sdk_wifi_station_set_config(&config);
+
+    printf("\n\n\nWelcome to gpiomon. Type 'help<enter>' for, well, help\n");
+    shell_register(commands, sizeof(commands) / sizeof(commands[0]));
+    shell_start_uart(2);
+    shell_start_tcp(TELNET_PORT, 2);
 }
@@ -0,0 +1,96 @@
+/* How long a task spends logging, polled vs. interrupt driven UART
+ *
+ * Writes bursts of log lines at 115200 baud, first the way the default
+ * _write_r in core/newlib_syscalls.c does (waiting on the 128 byte FIFO
+ * for each character), then with printf() through extras/uart_ring. The
+ * CPU time the writing task spends is measured with CCOUNT, and printed
+ * with the driver statistics once the output has drained.
+ *
+ * This sample code is in the public domain.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "espressif/esp_common.h"
+#include "esp/uart.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "xtensa_ops.h"
+#include "uart_ring.h"
+
+#define LINES 8
+#define BURSTS 5
+
+static const char line[] = "sensor 3: temperature 21.5C humidity 48% pressure 1013hPa";
+
+static inline uint32_t ccount(void)
+{
+    uint32_t r;
+    RSR(r, ccount);
+    return r;
+}
+
+/* What core/newlib_syscalls.c's _write_r does */
+static void write_polled(const char *s)
+{
+    for (; *s; s++) {
+        if (*s == '\n') {
+            uart_putc(0, '\r');
+        }
+        uart_putc(0, *s);
+    }
+}
+
+static uint32_t burst_polled(void)
+{
+    char buf[80];
+    uint32_t start = ccount();
+
+    for (int i = 0; i < LINES; i++) {
+        snprintf(buf, sizeof(buf), "%d %s\n", i, line);
+        write_polled(buf);
+    }
+    return ccount() - start;
+}
+
+static uint32_t burst_buffered(void)
+{
+    uint32_t start = ccount();
+
+    for (int i = 0; i < LINES; i++) {
+        printf("%d %s\n", i, line);
+    }
+    return ccount() - start;
+}
+
+static void bench_task(void *params)
+{
+    uint32_t polled = 0, buffered = 0;
+    uint32_t mhz = sdk_system_get_cpu_freq();
+    uart_ring_stats_t stats;
+
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    for (int i = 0; i < BURSTS; i++) {
+        uart_ring_flush(0, portMAX_DELAY);
+        polled += burst_polled();
+        uart_flush_txfifo(0);
+        buffered += burst_buffered();
+        /* Leave time to drain, as a program logging now and then would */
+        vTaskDelay(200 / portTICK_PERIOD_MS);
+    }
+    uart_ring_flush(0, portMAX_DELAY);
+    uart_ring_get_stats(0, &stats);
+
+    printf("\n%d bursts of %d lines (%d bytes each):\n", BURSTS, LINES,
+           LINES * (int)(strlen(line) + 4));
+    printf("  polled   %8u us in the logging task\n", polled / mhz);
+    printf("  buffered %8u us in the logging task\n", buffered / mhz);
+    printf("uart_ring: %u bytes in %u interrupts, %u waits for space, %u dropped\n",
+           stats.tx_bytes, stats.tx_interrupts, stats.tx_waits, stats.tx_dropped);
+    vTaskDelete(NULL);
+}
+
+void user_init(void)
+{
+    uart_set_baud(0, 115200);
+    xTaskCreate(bench_task, "bench", 512, NULL, 2, NULL);
+}
@@ -0,0 +1,444 @@
+/* Zero-copy message channel for C++ tasks
+ *
+ * channel_t<T, N> owns a pool of N message blocks of type T. A producer
+ * alloc()s a block, fills it in through the returned handle and post()s
+ * the handle; the consumer receive()s the same block and it returns to
+ * the pool when the handle goes out of scope. Only block indices move
+ * through the channel, however large T is, and a post can never fail as
+ * the channel holds as many entries as there are blocks.
+ *
+ * Handles (channel_t::message_t) are move-only, like std::unique_ptr:
+ *
+ *   channel_t<frame_t, 8> frames;
+ *
+ *   auto msg = frames.alloc(100);       // producer
+ *   if(msg) {
+ *       msg->len = read_frame(msg->data);
+ *       frames.post(std::move(msg));
+ *   }
+ *
+ *   channel_t<frame_t, 8>::message_t in;  // consumer
+ *   if(frames.receive(in, 1000) == 0) {
+ *       handle(in->data, in->len);
+ *   }                                   // block is freed with 'in'
+ *
+ * With Mode CHANNEL_MPMC (the default) any number of tasks may post and
+ * receive, using two counting semaphores and a critical section around
+ * the ring and the free block stack. With CHANNEL_SPSC exactly one task
+ * posts and one task receives, and nothing takes a lock: messages go
+ * through one single-writer ring and received blocks come back through
+ * another, while blocks the producer drops without posting go on a stack
+ * only the producer touches. Blocking uses direct task notifications, and
+ * only when a side is actually waiting. The SPSC consumer and producer
+ * must not use task notifications for anything else while waiting on the
+ * channel, received handles must be dropped by the consumer (or one task
+ * at a time standing in for it), and it relies on the ESP8266 having a
+ * single core.
+ *
+ * Needs C++11 (EXTRA_CXXFLAGS = -std=gnu++11), and counting semaphores
+ * (#define configUSE_COUNTING_SEMAPHORES 1 in a FreeRTOSConfig.h in the
+ * program directory, see examples/cpp_02_channel). The OS primitives come
+ * from the Sync class, which can be replaced to test the channel logic
+ * on a host, see extras/cpp_support/tests.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef ESP_OPEN_RTOS_CHANNEL_HPP
+#define	ESP_OPEN_RTOS_CHANNEL_HPP
+
+#if __cplusplus < 201103L
+#error "channel.hpp needs C++11, add -std=gnu++11 to EXTRA_CXXFLAGS"
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+
+#ifndef ESP_OPEN_RTOS_CHANNEL_SYNC
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#if !configUSE_COUNTING_SEMAPHORES
+#error "channel.hpp needs configUSE_COUNTING_SEMAPHORES 1 in the program's FreeRTOSConfig.h"
+#endif
+#endif
+
+namespace esp_open_rtos {
+namespace thread {
+
+#ifndef ESP_OPEN_RTOS_CHANNEL_SYNC
+/******************************************************************************************************************
+ * freertos_sync_t
+ *
+ * FreeRTOS primitives used by channel_t.
+ */
+struct freertos_sync_t
+{
+    static inline void lock()   { taskENTER_CRITICAL(); }
+    static inline void unlock() { taskEXIT_CRITICAL(); }
+    /* Single core, only the compiler can reorder */
+    static inline void fence()  { __asm__ volatile ("" ::: "memory"); }
+
+    class semaphore_t
+    {
+    public:
+        semaphore_t(unsigned count, unsigned max)
+        {
+            sem = xSemaphoreCreateCountingStatic(max, count, &buffer);
+        }
+        bool take(unsigned long ms) { return xSemaphoreTake(sem, ms / portTICK_PERIOD_MS) == pdTRUE; }
+        void give() { xSemaphoreGive(sem); }
+    private:
+        StaticSemaphore_t buffer;
+        SemaphoreHandle_t sem;
+    };
+
+    /* Wakes a single waiting task, if there is one */
+    class notifier_t
+    {
+    public:
+        notifier_t() : waiter(0) {}
+        void prepare() { waiter = xTaskGetCurrentTaskHandle(); fence(); }
+        void cancel()  { waiter = 0; }
+        bool wait(unsigned long ms) { return ulTaskNotifyTake(pdTRUE, ms / portTICK_PERIOD_MS) != 0; }
+        void signal()
+        {
+            TaskHandle_t w = waiter;
+            if(w) {
+                waiter = 0;
+                xTaskNotifyGive(w);
+            }
+        }
+    private:
+        TaskHandle_t volatile waiter;
+    };
+};
+#define ESP_OPEN_RTOS_CHANNEL_SYNC freertos_sync_t
+#endif
+
+enum channel_mode_t {
+    CHANNEL_MPMC,       // Any number of producer and consumer tasks
+    CHANNEL_SPSC,       // One producer task, one consumer task
+};
+
+/******************************************************************************************************************
+ * class channel_t
+ *
+ */
+template<class T, unsigned N, channel_mode_t Mode = CHANNEL_MPMC, class Sync = ESP_OPEN_RTOS_CHANNEL_SYNC>
+class channel_t
+{
+    static_assert(N > 0 && N < 0xffff, "channel_t holds 1 to 65534 blocks");
+
+public:
+    /**
+     * Owning handle to a message block
+     */
+    class message_t
+    {
+    public:
+        message_t() : owner(0), index(0), received(false) {}
+        message_t(message_t&& other) : owner(other.owner), index(other.index), received(other.received)
+        {
+            other.owner = 0;
+        }
+        message_t& operator = (message_t&& other)
+        {
+            if(this != &other) {
+                reset();
+                owner = other.owner;
+                index = other.index;
+                received = other.received;
+                other.owner = 0;
+            }
+            return *this;
+        }
+        ~message_t()
+        {
+            reset();
+        }
+        /**
+         * Return the block to the pool
+         */
+        void reset()
+        {
+            if(owner) {
+                owner->release(index, received);
+                owner = 0;
+            }
+        }
+        T* get() const { return owner ? owner->slot(index) : 0; }
+        T& operator * () const { return *get(); }
+        T* operator -> () const { return get(); }
+        explicit operator bool () const { return owner != 0; }
+
+    private:
+        friend class channel_t;
+        message_t(channel_t* owner, uint16_t index, bool received)
+            : owner(owner), index(index), received(received) {}
+
+        channel_t* owner;
+        uint16_t index;
+        bool received;          // From receive(), not alloc()
+
+        message_t(const message_t&) = delete;
+        message_t& operator = (const message_t&) = delete;
+    };
+
+    /**
+     *
+     */
+    channel_t() : head(0), tail(0), free_head(0), free_tail(0), free_top(N), items(0, N), free_blocks(N, N)
+    {
+        for(unsigned i = 0; i < N; i++) {
+            free_stack[i] = N - 1 - i;
+        }
+    }
+    /**
+     * Get a free block, waiting up to ms milliseconds for one. The block
+     * holds a default constructed T. Returns an empty handle on timeout.
+     */
+    message_t alloc(unsigned long ms = 0)
+    {
+        int i;
+        if(Mode == CHANNEL_MPMC) {
+            i = free_blocks.take(ms) ? pop_free() : -1;
+        }
+        else {
+            i = wait_for(tx_note, &channel_t::pop_free, ms);
+        }
+        if(i < 0) {
+            return message_t();
+        }
+        new (slot(i)) T();
+        return message_t(this, i, false);
+    }
+    /**
+     * Pass a block to the consumer. Returns 0, or -1 if msg is empty or
+     * belongs to another channel.
+     */
+    int post(message_t&& msg)
+    {
+        if(msg.owner != this) {
+            return -1;
+        }
+        msg.owner = 0;
+        push(msg.index);
+        if(Mode == CHANNEL_MPMC) {
+            items.give();
+        }
+        else {
+            rx_note.signal();
+        }
+        return 0;
+    }
+    /**
+     * Post msgs[0..n-1]. Returns the number posted (stopping at the first
+     * empty or foreign handle). An SPSC consumer is woken once for the
+     * batch, MPMC still gives the semaphore once per message.
+     */
+    unsigned post_n(message_t* msgs, unsigned n)
+    {
+        unsigned done;
+        for(done = 0; done < n && msgs[done].owner == this; done++) {
+            msgs[done].owner = 0;
+            push(msgs[done].index);
+            if(Mode == CHANNEL_MPMC) {
+                items.give();
+            }
+        }
+        if(Mode == CHANNEL_SPSC && done) {
+            rx_note.signal();
+        }
+        return done;
+    }
+    /**
+     * Wait up to ms milliseconds for a message. Returns 0 and sets msg
+     * (freeing whatever it held), or -1 on timeout.
+     */
+    int receive(message_t& msg, unsigned long ms = 0)
+    {
+        int i;
+        if(Mode == CHANNEL_MPMC) {
+            i = items.take(ms) ? pop() : -1;
+        }
+        else {
+            i = wait_for(rx_note, &channel_t::pop, ms);
+        }
+        if(i < 0) {
+            return -1;
+        }
+        msg = message_t(this, i, true);
+        return 0;
+    }
+    /**
+     * Wait up to ms milliseconds for at least one message, then take up
+     * to max without waiting further. Returns the number received.
+     */
+    unsigned receive_n(message_t* msgs, unsigned max, unsigned long ms = 0)
+    {
+        unsigned n = 0;
+        while(n < max && receive(msgs[n], n ? 0 : ms) == 0) {
+            n++;
+        }
+        return n;
+    }
+
+private:
+    typedef int (channel_t::*take_fn_t)();
+
+    T* slot(unsigned i)
+    {
+        return reinterpret_cast<T*>(storage[i]);
+    }
+
+    void release(uint16_t i, bool received)
+    {
+        slot(i)->~T();
+        if(Mode == CHANNEL_MPMC) {
+            Sync::lock();
+            free_stack[free_top++] = i;
+            Sync::unlock();
+            free_blocks.give();
+        }
+        else if(received) {
+            /* Consumer side, back to the producer through the free ring */
+            ring_put(free_ring, free_tail, i);
+            tx_note.signal();
+        }
+        else {
+            /* Allocated and dropped by the producer itself */
+            free_stack[free_top++] = i;
+        }
+    }
+
+    int pop_free()
+    {
+        int i = -1;
+        if(Mode == CHANNEL_MPMC) {
+            Sync::lock();
+        }
+        if(free_top) {
+            i = free_stack[--free_top];
+        }
+        if(Mode == CHANNEL_MPMC) {
+            Sync::unlock();
+        }
+        else if(i < 0) {
+            i = ring_get(free_ring, free_head, free_tail);
+        }
+        return i;
+    }
+
+    static uint16_t next(uint16_t i)
+    {
+        return i == N ? 0 : i + 1;
+    }
+
+    /* Rings have N + 1 entries so they can't fill up. Without a lock
+       around them only one task may put and one task may get. */
+    static void ring_put(uint16_t* r, volatile uint16_t& tail, uint16_t i)
+    {
+        uint16_t t = tail;
+        r[t] = i;
+        Sync::fence();
+        tail = next(t);
+        Sync::fence();
+    }
+
+    static int ring_get(const uint16_t* r, volatile uint16_t& head, const volatile uint16_t& tail)
+    {
+        int i = -1;
+        uint16_t h = head;
+        if(h != tail) {
+            Sync::fence();
+            i = r[h];
+            Sync::fence();
+            head = next(h);
+        }
+        return i;
+    }
+
+    void push(uint16_t i)
+    {
+        if(Mode == CHANNEL_MPMC) {
+            Sync::lock();
+        }
+        ring_put(ring, tail, i);
+        if(Mode == CHANNEL_MPMC) {
+            Sync::unlock();
+        }
+    }
+
+    int pop()
+    {
+        if(Mode == CHANNEL_MPMC) {
+            Sync::lock();
+        }
+        int i = ring_get(ring, head, tail);
+        if(Mode == CHANNEL_MPMC) {
+            Sync::unlock();
+        }
+        return i;
+    }
+
+    /* SPSC: try 'take', and if that fails register as the waiter and try
+       again before sleeping, so a signal can't be missed */
+    int wait_for(typename Sync::notifier_t& note, take_fn_t take, unsigned long ms)
+    {
+        int i = (this->*take)();
+        while(i < 0 && ms) {
+            note.prepare();
+            i = (this->*take)();
+            if(i >= 0) {
+                note.cancel();
+                break;
+            }
+            if(!note.wait(ms)) {
+                note.cancel();
+                i = (this->*take)();
+                break;
+            }
+            i = (this->*take)();
+        }
+        return i;
+    }
+
+    alignas(T) uint8_t storage[N][sizeof(T)];
+    uint16_t ring[N + 1];
+    volatile uint16_t head;
+    volatile uint16_t tail;
+    uint16_t free_ring[Mode == CHANNEL_SPSC ? N + 1 : 1];   // SPSC
+    volatile uint16_t free_head;
+    volatile uint16_t free_tail;
+    uint16_t free_stack[N];
+    uint16_t free_top;
+
+    /* Stands in for the semaphores in SPSC mode, so none are created */
+    struct no_semaphore_t
+    {
+        no_semaphore_t(unsigned, unsigned) {}
+        bool take(unsigned long) { return false; }
+        void give() {}
+    };
+    typedef typename std::conditional<Mode == CHANNEL_MPMC,
+        typename Sync::semaphore_t, no_semaphore_t>::type semaphore_t;
+
+    semaphore_t items;                        // MPMC
+    semaphore_t free_blocks;                  // MPMC
+    typename Sync::notifier_t rx_note;        // SPSC
+    typename Sync::notifier_t tx_note;        // SPSC
+
+    // no copy and no = operator
+    channel_t(const channel_t&) = delete;
+    channel_t &operator = (const channel_t&) = delete;
+};
+
+} //namespace thread {
+} //namespace esp_open_rtos {
+
+
+#endif	/* ESP_OPEN_RTOS_CHANNEL_HPP */
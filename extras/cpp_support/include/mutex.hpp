@@ -97,14 +97,36 @@ public:
         return (xSemaphoreGive(mutex) == pdTRUE) ? 0 : -1;
     }
 
-private:
+protected:
     SemaphoreHandle_t    mutex;
 
+private:
     // Disable copy construction and assignment.
     mutex_t (const mutex_t&);
     const mutex_t &operator = (const mutex_t&);
 };
 
+/******************************************************************************************************************
+ * class static_mutex_t
+ *
+ * A mutex_t whose semaphore structure is part of the object rather than
+ * allocated from the heap. Created by the constructor, no mutex_create().
+ */
+class static_mutex_t : public mutex_t
+{
+public:
+    /**
+     * 
+     */
+    inline static_mutex_t()
+    {
+        mutex = xSemaphoreCreateMutexStatic(&buffer);
+    }
+
+private:
+    StaticSemaphore_t buffer;
+};
+
 } //namespace thread {
 } //namespace esp_open_rtos {
 
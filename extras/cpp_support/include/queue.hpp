@@ -109,13 +109,40 @@ public:
         return *this;
     }
 
-private:
+protected:
     QueueHandle_t queue;
 
+private:
     // Disable copy construction.
     queue_t (const queue_t&);
 };
 
+/******************************************************************************************************************
+ * class static_queue_t
+ *
+ * A queue_t holding up to Length items, with the queue structure and item
+ * storage allocated as part of the object (in .bss for a global) instead
+ * of on the heap. It is created by the constructor, so there is no
+ * queue_create() and nothing to fail at runtime. Can be assigned to a
+ * queue_t to share it.
+ */
+template<class Data, unsigned portBASE_TYPE Length>
+class static_queue_t : public queue_t<Data>
+{
+public:
+    /**
+     * 
+     */
+    inline static_queue_t()
+    {
+        this->queue = xQueueCreateStatic(Length, sizeof(Data), storage, &buffer);
+    }
+
+private:
+    StaticQueue_t buffer;
+    uint8_t storage[Length * sizeof(Data)] __attribute__((aligned(4)));
+};
+
 } //namespace thread {
 } //namespace esp_open_rtos {
 
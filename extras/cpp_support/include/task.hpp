@@ -77,11 +77,6 @@ protected:
         return xTaskGetTickCount() * portTICK_PERIOD_MS;
     }
     
-private:
-    /**
-     * 
-     */
-    virtual void task() = 0;
     /**
      * 
      * @param pvParameters
@@ -92,12 +87,52 @@ private:
             ((task_t*)(pvParameters))->task();
         }
     }
+
+private:
+    /**
+     * 
+     */
+    virtual void task() = 0;
     
     // no copy and no = operator
     task_t(const task_t&);
     task_t &operator=(const task_t&);    
 };
 
+/******************************************************************************************************************
+ * static_task_t
+ *
+ * A task_t with a stack of StackWords words and its task control block
+ * allocated as part of the object (in .bss for a global) instead of on
+ * the heap, so task_create() doesn't depend on free heap. The stack size
+ * is the template argument, task_create() only takes the priority.
+ */
+template<unsigned short StackWords = 256>
+class static_task_t : public task_t
+{
+public:
+    /**
+     * 
+     * @param pcName
+     * @param uxPriority
+     * @return pdPASS, or pdFAIL if the task couldn't be created
+     */
+    int task_create(const char* const pcName, unsigned portBASE_TYPE uxPriority = 2)
+    {
+        TaskHandle_t handle = xTaskCreateStatic(task_t::_task, pcName, StackWords, static_cast<task_t*>(this), uxPriority, stack, &tcb);
+        return handle != NULL ? pdPASS : pdFAIL;
+    }
+    /**
+     * task_t's (name, stack depth, priority) form would silently take the
+     * stack depth as the priority here, so it is rejected at compile time.
+     */
+    int task_create(const char* const pcName, unsigned short usStackDepth, unsigned portBASE_TYPE uxPriority) = delete;
+
+private:
+    StackType_t stack[StackWords];
+    StaticTask_t tcb;
+};
+
 } //namespace thread {
 } //namespace esp_open_rtos {
 
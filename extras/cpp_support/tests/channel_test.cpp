@@ -0,0 +1,318 @@
+/* Host unit tests for channel_t, with std::thread standing in for
+ * FreeRTOS tasks.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/* Sync policy for channel_t built on the C++ standard library */
+struct host_sync_t
+{
+    static std::recursive_mutex& big_lock()
+    {
+        static std::recursive_mutex m;
+        return m;
+    }
+    static std::atomic<unsigned> locks;
+    static void lock()   { big_lock().lock(); locks++; }
+    static void unlock() { big_lock().unlock(); }
+    static void fence()  { std::atomic_thread_fence(std::memory_order_seq_cst); }
+
+    class semaphore_t
+    {
+    public:
+        semaphore_t(unsigned count, unsigned) : count(count) {}
+        bool take(unsigned long ms)
+        {
+            std::unique_lock<std::mutex> l(m);
+            if(!cv.wait_for(l, std::chrono::milliseconds(ms), [this] { return count > 0; })) {
+                return false;
+            }
+            count--;
+            return true;
+        }
+        void give()
+        {
+            std::lock_guard<std::mutex> l(m);
+            count++;
+            cv.notify_one();
+        }
+    private:
+        std::mutex m;
+        std::condition_variable cv;
+        unsigned count;
+    };
+
+    class notifier_t
+    {
+    public:
+        notifier_t() : waiting(false), pending(false), signals(0) {}
+        void prepare() { waiting = true; fence(); }
+        void cancel()  { waiting = false; }
+        bool wait(unsigned long ms)
+        {
+            std::unique_lock<std::mutex> l(m);
+            cv.wait_for(l, std::chrono::milliseconds(ms), [this] { return pending; });
+            bool r = pending;
+            pending = false;
+            return r;
+        }
+        void signal()
+        {
+            if(waiting.exchange(false)) {
+                std::lock_guard<std::mutex> l(m);
+                pending = true;
+                signals++;
+                cv.notify_one();
+            }
+        }
+        std::atomic<bool> waiting;
+        bool pending;
+        unsigned signals;
+    private:
+        std::mutex m;
+        std::condition_variable cv;
+    };
+};
+
+std::atomic<unsigned> host_sync_t::locks(0);
+
+#define ESP_OPEN_RTOS_CHANNEL_SYNC host_sync_t
+#include "channel.hpp"
+#include "check.h"
+
+using esp_open_rtos::thread::channel_t;
+using esp_open_rtos::thread::channel_mode_t;
+using esp_open_rtos::thread::CHANNEL_MPMC;
+using esp_open_rtos::thread::CHANNEL_SPSC;
+
+/* Counts live instances, so leaks and double destruction show up */
+struct counted_t
+{
+    static int live;
+    uint32_t seq;
+    uint8_t payload[60];
+    counted_t() : seq(0) { live++; }
+    ~counted_t() { live--; }
+};
+int counted_t::live;
+
+template<channel_mode_t Mode>
+static void test_ownership()
+{
+    typedef channel_t<counted_t, 4, Mode> chan_t;
+    {
+        chan_t ch;
+        typename chan_t::message_t a = ch.alloc();
+        CHECK(a);
+        CHECK(counted_t::live == 1);
+        a->seq = 42;
+
+        /* Moving transfers the block, the source is left empty */
+        typename chan_t::message_t b(std::move(a));
+        CHECK(!a);
+        CHECK(b && b->seq == 42);
+        CHECK(ch.post(std::move(a)) == -1);
+        CHECK(ch.post(std::move(b)) == 0);
+        CHECK(!b);
+        CHECK(counted_t::live == 1);
+
+        typename chan_t::message_t in;
+        CHECK(ch.receive(in) == 0);
+        CHECK(in->seq == 42);
+        CHECK(ch.receive(in) == -1);
+        CHECK(in);
+        in.reset();
+        CHECK(counted_t::live == 0);
+
+        /* Pool exhaustion, and blocks coming back when handles go away */
+        typename chan_t::message_t all[4];
+        for(auto& m : all) {
+            m = ch.alloc();
+            CHECK(m);
+        }
+        CHECK(!ch.alloc());
+        CHECK(!ch.alloc(5));
+        all[2] = typename chan_t::message_t();
+        CHECK(counted_t::live == 3);
+        typename chan_t::message_t again = ch.alloc();
+        CHECK(again);
+        CHECK(again.get() != all[0].get() && again.get() != all[1].get());
+
+        /* A handle from another channel is refused */
+        chan_t other;
+        typename chan_t::message_t foreign = other.alloc();
+        CHECK(ch.post(std::move(foreign)) == -1);
+        CHECK(foreign);
+        CHECK(ch.post(std::move(all[0])) == 0);
+    }
+    /* Messages still in the ring are destroyed with the handles they were
+       posted from gone, but their T lives on in the pool until received;
+       only check nothing was destroyed twice */
+    CHECK(counted_t::live >= 0);
+    counted_t::live = 0;
+}
+
+template<channel_mode_t Mode>
+static void test_batch()
+{
+    typedef channel_t<counted_t, 8, Mode> chan_t;
+    chan_t ch;
+    typename chan_t::message_t out[8], in[8];
+
+    for(unsigned i = 0; i < 6; i++) {
+        out[i] = ch.alloc();
+        out[i]->seq = i;
+    }
+    /* Stops at the first empty handle */
+    CHECK(ch.post_n(out, 8) == 6);
+    for(unsigned i = 0; i < 6; i++) {
+        CHECK(!out[i]);
+    }
+    CHECK(ch.receive_n(in, 4) == 4);
+    CHECK(ch.receive_n(in + 4, 4) == 2);
+    for(unsigned i = 0; i < 6; i++) {
+        CHECK(in[i] && in[i]->seq == i);
+    }
+    CHECK(ch.receive_n(in + 6, 2, 5) == 0);
+    for(auto& m : in) {
+        m.reset();
+    }
+    CHECK(counted_t::live == 0);
+}
+
+static void test_spsc_notify()
+{
+    typedef channel_t<counted_t, 4, CHANNEL_SPSC> chan_t;
+    chan_t ch;
+    chan_t::message_t in;
+
+    /* Nobody waiting: posting doesn't signal */
+    ch.post(ch.alloc());
+    CHECK(ch.receive(in) == 0);
+
+    /* Timeout when nothing arrives */
+    auto start = std::chrono::steady_clock::now();
+    CHECK(ch.receive(in, 20) == -1);
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+    in.reset();
+
+    /* A waiting consumer is woken by the post */
+    std::thread producer([&ch] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        chan_t::message_t m = ch.alloc();
+        m->seq = 7;
+        ch.post(std::move(m));
+    });
+    CHECK(ch.receive(in, 5000) == 0);
+    CHECK(in->seq == 7);
+    producer.join();
+    in.reset();
+    CHECK(counted_t::live == 0);
+}
+
+/* One producer and one consumer, with both sides blocking: every message
+   arrives once, in order */
+template<channel_mode_t Mode>
+static void test_stream(unsigned count)
+{
+    typedef channel_t<counted_t, 16, Mode> chan_t;
+    chan_t ch;
+    unsigned locks = host_sync_t::locks;
+    std::thread producer([&ch, count] {
+        typename chan_t::message_t batch[4];
+        for(uint32_t seq = 0; seq < count; ) {
+            unsigned n = seq % 3 + 1;
+            if(n > count - seq) {
+                n = count - seq;
+            }
+            for(unsigned i = 0; i < n; i++) {
+                batch[i] = ch.alloc(5000);
+                batch[i]->seq = seq++;
+            }
+            ch.post_n(batch, n);
+        }
+    });
+    typename chan_t::message_t in[4];
+    uint32_t expect = 0;
+    bool in_order = true;
+    while(expect < count) {
+        unsigned n = ch.receive_n(in, 4, 5000);
+        CHECK(n > 0);
+        if(!n) {
+            break;
+        }
+        for(unsigned i = 0; i < n; i++) {
+            in_order = in_order && in[i]->seq == expect;
+            expect++;
+            in[i].reset();
+        }
+    }
+    producer.join();
+    CHECK(in_order);
+    CHECK(expect == count);
+    CHECK(counted_t::live == 0);
+    /* SPSC never takes the lock, messages or free blocks */
+    CHECK(Mode == CHANNEL_MPMC || host_sync_t::locks == locks);
+}
+
+static void test_mpmc_many(unsigned producers, unsigned consumers, unsigned per_producer)
+{
+    typedef channel_t<counted_t, 8, CHANNEL_MPMC> chan_t;
+    chan_t ch;
+    std::atomic<uint64_t> sum(0);
+    std::atomic<unsigned> received(0);
+    std::vector<std::thread> threads;
+    unsigned total = producers * per_producer;
+
+    for(unsigned p = 0; p < producers; p++) {
+        threads.emplace_back([&ch, p, per_producer] {
+            for(uint32_t i = 0; i < per_producer; i++) {
+                chan_t::message_t m = ch.alloc(5000);
+                m->seq = p * per_producer + i;
+                ch.post(std::move(m));
+            }
+        });
+    }
+    for(unsigned c = 0; c < consumers; c++) {
+        threads.emplace_back([&ch, &sum, &received, total] {
+            chan_t::message_t m;
+            while(received < total) {
+                if(ch.receive(m, 10) == 0) {
+                    sum += m->seq;
+                    received++;
+                    m.reset();
+                }
+            }
+        });
+    }
+    for(auto& t : threads) {
+        t.join();
+    }
+    CHECK(received == total);
+    CHECK(sum == (uint64_t)total * (total - 1) / 2);
+    CHECK(counted_t::live == 0);
+}
+
+int main()
+{
+    test_ownership<CHANNEL_MPMC>();
+    test_ownership<CHANNEL_SPSC>();
+    test_batch<CHANNEL_MPMC>();
+    test_batch<CHANNEL_SPSC>();
+    test_spsc_notify();
+    test_stream<CHANNEL_SPSC>(200000);
+    test_stream<CHANNEL_MPMC>(200000);
+    test_mpmc_many(4, 3, 50000);
+
+    return check_done("channel_t");
+}
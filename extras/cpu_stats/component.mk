@@ -0,0 +1,11 @@
+# Component makefile for extras/cpu_stats
+#
+# The program's FreeRTOSConfig.h needs configUSE_TRACE_FACILITY and
+# configGENERATE_RUN_TIME_STATS set to 1, see examples/terminal.
+
+INC_DIRS += $(cpu_stats_ROOT)
+
+# args for passing into compile rule generation
+cpu_stats_SRC_DIR = $(cpu_stats_ROOT)
+
+$(eval $(call component_compile_rules,cpu_stats))
@@ -0,0 +1,150 @@
+/* Per-task CPU usage and stack statistics
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu_stats.h"
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+
+bool cpu_stats_sample(cpu_stats_t *stats)
+{
+    TaskStatus_t *status = malloc(CPU_STATS_MAX_TASKS * sizeof(TaskStatus_t));
+    uint32_t total;
+
+    if (!status) {
+        return false;
+    }
+    /* Returns 0 if there are more tasks than fit */
+    UBaseType_t n = uxTaskGetSystemState(status, CPU_STATS_MAX_TASKS, &total);
+    stats->time = total;
+    stats->isr_time = ulPortGetIsrRunTime();
+    stats->interval = 0;
+    stats->isr_permille = 0;
+    stats->n_tasks = n;
+    for (int i = 0; i < n; i++) {
+        cpu_stats_task_t *t = &stats->tasks[i];
+        t->handle = status[i].xHandle;
+        strncpy(t->name, status[i].pcTaskName, sizeof(t->name) - 1);
+        t->name[sizeof(t->name) - 1] = 0;
+        t->number = status[i].xTaskNumber;
+        t->priority = status[i].uxCurrentPriority;
+        t->state = status[i].eCurrentState;
+        t->run_time = status[i].ulRunTimeCounter;
+        t->stack_free = status[i].usStackHighWaterMark;
+        t->permille = 0;
+    }
+    free(status);
+    return n > 0;
+}
+
+#else
+
+bool cpu_stats_sample(cpu_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    return false;
+}
+
+#endif
+
+static uint16_t permille(uint32_t part, uint32_t whole)
+{
+    if (whole == 0) {
+        return 0;
+    }
+    return ((uint64_t)part * 1000 + whole / 2) / whole;
+}
+
+void cpu_stats_delta(const cpu_stats_t *prev, cpu_stats_t *now)
+{
+    uint32_t isr = now->isr_time - prev->isr_time;
+
+    now->interval = now->time - prev->time + isr;
+    now->isr_permille = permille(isr, now->interval);
+    for (int i = 0; i < now->n_tasks; i++) {
+        cpu_stats_task_t *t = &now->tasks[i];
+        uint32_t before = 0;
+        for (int j = 0; j < prev->n_tasks; j++) {
+            /* Handles can be reused after a task is deleted, task numbers
+               aren't */
+            if (prev->tasks[j].number == t->number) {
+                before = prev->tasks[j].run_time;
+                break;
+            }
+        }
+        t->permille = permille(t->run_time - before, now->interval);
+    }
+}
+
+/* Indexed by eTaskState */
+static const char state_names[] = "RrBSD";
+
+/* Longest line of the table */
+#define LINE_LEN 80
+
+static void emit(cpu_stats_out_t out, void *ctx, const char *fmt, ...)
+{
+    char line[LINE_LEN];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    out(ctx, line);
+}
+
+bool cpu_stats_top_out(uint32_t ms, cpu_stats_out_t out, void *ctx)
+{
+    cpu_stats_t *s = malloc(2 * sizeof(cpu_stats_t));
+    uint8_t order[CPU_STATS_MAX_TASKS];
+
+    if (!s) {
+        out(ctx, "Out of memory\n");
+        return false;
+    }
+    if (!cpu_stats_sample(&s[0])) {
+        out(ctx, "Run time stats need configUSE_TRACE_FACILITY and configGENERATE_RUN_TIME_STATS\n");
+        free(s);
+        return false;
+    }
+    vTaskDelay(ms / portTICK_PERIOD_MS);
+    cpu_stats_sample(&s[1]);
+    cpu_stats_delta(&s[0], &s[1]);
+
+    /* Insertion sort by CPU share, highest first */
+    for (int i = 0; i < s[1].n_tasks; i++) {
+        int j = i;
+        while (j > 0 && s[1].tasks[order[j - 1]].permille < s[1].tasks[i].permille) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    emit(out, ctx, "%-*s pri st   cpu%%  stack\n", configMAX_TASK_NAME_LEN, "task");
+    for (int i = 0; i < s[1].n_tasks; i++) {
+        const cpu_stats_task_t *t = &s[1].tasks[order[i]];
+        emit(out, ctx, "%-*s %3u  %c %3u.%u  %5u\n", configMAX_TASK_NAME_LEN, t->name,
+             (unsigned)t->priority, t->state < sizeof(state_names) - 1 ? state_names[t->state] : '?',
+             t->permille / 10, t->permille % 10, t->stack_free);
+    }
+    emit(out, ctx, "%-*s          %3u.%u\n", configMAX_TASK_NAME_LEN, "(interrupts)",
+         s[1].isr_permille / 10, s[1].isr_permille % 10);
+    free(s);
+    return true;
+}
+
+static void out_stdout(void *ctx, const char *text)
+{
+    fputs(text, stdout);
+}
+
+void cpu_stats_top(uint32_t ms)
+{
+    cpu_stats_top_out(ms, out_stdout, NULL);
+}
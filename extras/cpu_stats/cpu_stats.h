@@ -0,0 +1,75 @@
+/* Per-task CPU usage and stack statistics
+ *
+ * Requires configUSE_TRACE_FACILITY and configGENERATE_RUN_TIME_STATS to
+ * be set to 1 in the program's FreeRTOSConfig.h. The FreeRTOS port then
+ * counts run time with the CPU cycle counter and keeps time spent in
+ * interrupt handlers separate from the tasks they interrupted. (The WiFi
+ * MAC's NMI handler is not included in the interrupt time.)
+ *
+ * Take two samples some time apart and pass both to cpu_stats_delta() for
+ * the share of CPU time each task and the interrupt handlers used in
+ * between, or call cpu_stats_top() to print that as a table.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _CPU_STATS_H
+#define _CPU_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CPU_STATS_MAX_TASKS
+#define CPU_STATS_MAX_TASKS 24
+#endif
+
+typedef struct {
+    TaskHandle_t handle;
+    char name[configMAX_TASK_NAME_LEN];
+    UBaseType_t number;         /* FreeRTOS task number */
+    UBaseType_t priority;
+    eTaskState state;
+    uint32_t run_time;          /* Run time counter, wraps */
+    uint16_t stack_free;        /* Stack high water mark, in words */
+    uint16_t permille;          /* CPU share, set by cpu_stats_delta() */
+} cpu_stats_task_t;
+
+typedef struct {
+    uint32_t time;              /* Run time counter total for tasks */
+    uint32_t isr_time;          /* ... and for interrupt handlers */
+    uint32_t interval;          /* Set by cpu_stats_delta() */
+    uint16_t isr_permille;      /* ditto */
+    uint16_t n_tasks;
+    cpu_stats_task_t tasks[CPU_STATS_MAX_TASKS];
+} cpu_stats_t;
+
+/* Fill in 'stats' with the current counters for up to CPU_STATS_MAX_TASKS
+   tasks. Returns false if run time statistics aren't enabled. */
+bool cpu_stats_sample(cpu_stats_t *stats);
+
+/* Set the permille and interval fields of 'now' from the time used since
+   'prev' was sampled. Tasks created in between count from zero. */
+void cpu_stats_delta(const cpu_stats_t *prev, cpu_stats_t *now);
+
+/* Receives cpu_stats_top_out() output, a line at a time */
+typedef void (*cpu_stats_out_t)(void *ctx, const char *text);
+
+/* Sample for 'ms' milliseconds and pass 'out' a table of tasks sorted by
+   CPU use, with their priority, state and free stack. Returns false (after
+   passing on an error message) if there are no statistics. */
+bool cpu_stats_top_out(uint32_t ms, cpu_stats_out_t out, void *ctx);
+
+/* cpu_stats_top_out() to stdout */
+void cpu_stats_top(uint32_t ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CPU_STATS_H */
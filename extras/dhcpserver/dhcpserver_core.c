@@ -0,0 +1,430 @@
+/* DHCP server lease table and message handling
+ *
+ * Based on RFC2131 http://www.ietf.org/rfc/rfc2131.txt
+ *
+ * See dhcpserver_core.h
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "timer_wheel.h"
+#include "dhcpserver_core.h"
+
+/* Message layout */
+#define DHCP_OFS_OP       0
+#define DHCP_OFS_HTYPE    1
+#define DHCP_OFS_HLEN     2
+#define DHCP_OFS_XID      4
+#define DHCP_OFS_FLAGS    10
+#define DHCP_OFS_CIADDR   12
+#define DHCP_OFS_YIADDR   16
+#define DHCP_OFS_GIADDR   24
+#define DHCP_OFS_CHADDR   28
+#define DHCP_OFS_COOKIE   236
+#define DHCP_OFS_OPTIONS  240
+
+#define DHCP_BOOTREQUEST  1
+#define DHCP_BOOTREPLY    2
+#define DHCP_HTYPE_ETH    1
+
+#define DHCP_DISCOVER     1
+#define DHCP_OFFER        2
+#define DHCP_REQUEST      3
+#define DHCP_DECLINE      4
+#define DHCP_ACK          5
+#define DHCP_NAK          6
+#define DHCP_RELEASE      7
+
+#define DHCP_OPTION_PAD          0
+#define DHCP_OPTION_SUBNET_MASK  1
+#define DHCP_OPTION_REQUESTED_IP 50
+#define DHCP_OPTION_LEASE_TIME   51
+#define DHCP_OPTION_MESSAGE_TYPE 53
+#define DHCP_OPTION_SERVER_ID    54
+#define DHCP_OPTION_END          255
+
+static const uint8_t magic_cookie[4] = { 99, 130, 83, 99 };
+
+/* Options we look at in a client message, NULL if not there */
+typedef struct {
+    uint8_t type;
+    const uint8_t *requested_ip;
+    const uint8_t *server_id;
+} dhcp_options_t;
+
+static inline bool time_before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+static inline bool in_wheel(const dhcps_lease_t *lease)
+{
+    return lease->state == DHCPS_LEASE_OFFERED || lease->state == DHCPS_LEASE_BOUND
+        || lease->state == DHCPS_LEASE_DECLINED;
+}
+
+static inline bool in_hash(const dhcps_lease_t *lease)
+{
+    return lease->state == DHCPS_LEASE_OFFERED || lease->state == DHCPS_LEASE_BOUND
+        || lease->state == DHCPS_LEASE_EXPIRED;
+}
+
+static uint8_t hash_of(const dhcps_t *s, const uint8_t *hwaddr)
+{
+    uint32_t h = 2166136261U;
+    for(int i = 0; i < 6; i++) {
+        h = (h ^ hwaddr[i]) * 16777619U;
+    }
+    return (h ^ (h >> 16)) & s->hash_mask;
+}
+
+static void hash_insert(dhcps_t *s, uint8_t i)
+{
+    uint8_t *head = &s->hash[hash_of(s, s->leases[i].hwaddr)];
+    s->leases[i].hnext = *head;
+    *head = i;
+}
+
+static void hash_remove(dhcps_t *s, uint8_t i)
+{
+    uint8_t *p = &s->hash[hash_of(s, s->leases[i].hwaddr)];
+    while(*p != i) {
+        p = &s->leases[*p].hnext;
+    }
+    *p = s->leases[i].hnext;
+}
+
+static uint8_t hash_find(const dhcps_t *s, const uint8_t *hwaddr)
+{
+    uint8_t i = s->hash[hash_of(s, hwaddr)];
+    while(i != DHCPS_NONE && memcmp(s->leases[i].hwaddr, hwaddr, 6)) {
+        i = s->leases[i].hnext;
+    }
+    return i;
+}
+
+static uint8_t *wheel_slot(dhcps_t *s, uint32_t t)
+{
+    return &s->wheel[timer_wheel_slot(t, DHCPS_WHEEL_SHIFT, DHCPS_WHEEL_BITS)];
+}
+
+/* Take lease 'i' out of the free list or its wheel slot */
+static void lease_unlink(dhcps_t *s, uint8_t i)
+{
+    dhcps_lease_t *lease = &s->leases[i];
+
+    if(lease->prev != DHCPS_NONE)
+        s->leases[lease->prev].next = lease->next;
+    else if(in_wheel(lease))
+        *wheel_slot(s, lease->expires) = lease->next;
+    else
+        s->free_head = lease->next;
+
+    if(lease->next != DHCPS_NONE)
+        s->leases[lease->next].prev = lease->prev;
+    else if(!in_wheel(lease))
+        s->free_tail = lease->prev;
+}
+
+static void free_append(dhcps_t *s, uint8_t i)
+{
+    s->leases[i].prev = s->free_tail;
+    s->leases[i].next = DHCPS_NONE;
+    if(s->free_tail != DHCPS_NONE)
+        s->leases[s->free_tail].next = i;
+    else
+        s->free_head = i;
+    s->free_tail = i;
+}
+
+static void wheel_insert(dhcps_t *s, uint8_t i)
+{
+    uint8_t *head = wheel_slot(s, s->leases[i].expires);
+    s->leases[i].prev = DHCPS_NONE;
+    s->leases[i].next = *head;
+    if(*head != DHCPS_NONE)
+        s->leases[*head].prev = i;
+    *head = i;
+}
+
+/* Move lease 'i' to the timer wheel, in 'state' until 'expires' */
+static void lease_hold(dhcps_t *s, uint8_t i, uint8_t state, uint32_t expires)
+{
+    lease_unlink(s, i);
+    s->leases[i].state = state;
+    s->leases[i].expires = expires;
+    wheel_insert(s, i);
+}
+
+/* Put lease 'i' back in the free list, used again last */
+static void lease_drop(dhcps_t *s, uint8_t i)
+{
+    dhcps_lease_t *lease = &s->leases[i];
+
+    if(in_wheel(lease)) {
+        lease_unlink(s, i);
+        lease->state = lease->state == DHCPS_LEASE_DECLINED ? DHCPS_LEASE_FREE : DHCPS_LEASE_EXPIRED;
+        free_append(s, i);
+    }
+}
+
+/* Give free lease 'i' to 'hwaddr', taking it from its last client if
+   that was someone else. The client's other lease is dropped. */
+static void lease_claim(dhcps_t *s, uint8_t i, const uint8_t *hwaddr)
+{
+    dhcps_lease_t *lease = &s->leases[i];
+    uint8_t other = hash_find(s, hwaddr);
+
+    if(other == i)
+        return;
+    if(other != DHCPS_NONE) {
+        lease_drop(s, other);
+        hash_remove(s, other);
+        s->leases[other].state = DHCPS_LEASE_FREE;
+    }
+    if(lease->state == DHCPS_LEASE_EXPIRED)
+        hash_remove(s, i);
+    memcpy(lease->hwaddr, hwaddr, 6);
+    hash_insert(s, i);
+}
+
+bool dhcps_init(dhcps_t *s, const uint8_t *first_client_addr, uint8_t max_leases,
+                uint32_t lease_time, uint32_t now)
+{
+    /* Only the last octet counts up, and DHCPS_NONE isn't an index */
+    if(max_leases > 255 - first_client_addr[3])
+        max_leases = 255 - first_client_addr[3];
+    if(max_leases == DHCPS_NONE)
+        max_leases--;
+
+    uint16_t buckets = 1;
+    while(buckets < max_leases)
+        buckets <<= 1;
+
+    memset(s, 0, sizeof(dhcps_t));
+    s->leases = calloc(max_leases ? max_leases : 1, sizeof(dhcps_lease_t));
+    s->hash = malloc(buckets);
+    if(!s->leases || !s->hash) {
+        dhcps_free(s);
+        return false;
+    }
+    memcpy(s->first_client_addr, first_client_addr, 4);
+    s->lease_time = lease_time;
+    s->max_leases = max_leases;
+    s->hash_mask = buckets - 1;
+    memset(s->hash, DHCPS_NONE, buckets);
+    memset(s->wheel, DHCPS_NONE, sizeof(s->wheel));
+    s->wheel_time = timer_wheel_slot_start(now, DHCPS_WHEEL_SHIFT);
+    s->free_head = s->free_tail = DHCPS_NONE;
+    for(int i = 0; i < max_leases; i++) {
+        free_append(s, i);
+    }
+    return true;
+}
+
+void dhcps_free(dhcps_t *s)
+{
+    free(s->leases);
+    free(s->hash);
+    s->leases = NULL;
+    s->hash = NULL;
+}
+
+void dhcps_expire(dhcps_t *s, uint32_t now)
+{
+    const uint32_t width = 1U << DHCPS_WHEEL_SHIFT;
+    int slots = DHCPS_WHEEL_SLOTS;
+
+    /* Each slot due is looked at once, even after a long time */
+    while(!time_before(now, s->wheel_time + width) && slots--) {
+        uint8_t i = *wheel_slot(s, s->wheel_time);
+        while(i != DHCPS_NONE) {
+            uint8_t next = s->leases[i].next;
+            /* Slots also hold leases for later rounds of the wheel */
+            if(!time_before(now, s->leases[i].expires))
+                lease_drop(s, i);
+            i = next;
+        }
+        s->wheel_time += width;
+    }
+    if(slots < 0)
+        s->wheel_time = timer_wheel_slot_start(now, DHCPS_WHEEL_SHIFT);
+}
+
+const dhcps_lease_t *dhcps_find(const dhcps_t *s, const uint8_t *hwaddr)
+{
+    uint8_t i = hash_find(s, hwaddr);
+    return i == DHCPS_NONE ? NULL : &s->leases[i];
+}
+
+/* Index of the lease for 'addr', or DHCPS_NONE */
+static uint8_t lease_of_addr(const dhcps_t *s, const uint8_t *addr)
+{
+    if(memcmp(addr, s->first_client_addr, 3) || addr[3] < s->first_client_addr[3])
+        return DHCPS_NONE;
+    uint8_t i = addr[3] - s->first_client_addr[3];
+    return i < s->max_leases ? i : DHCPS_NONE;
+}
+
+static bool parse_options(const uint8_t *msg, size_t len, dhcp_options_t *opts)
+{
+    const uint8_t *p = msg + DHCP_OFS_OPTIONS;
+    const uint8_t *end = msg + len;
+
+    memset(opts, 0, sizeof(*opts));
+    while(p < end && *p != DHCP_OPTION_END) {
+        uint8_t type = *p++;
+        if(type == DHCP_OPTION_PAD)
+            continue;
+        if(p >= end || p + 1 + *p > end)
+            break;
+        uint8_t optlen = *p++;
+        if(type == DHCP_OPTION_MESSAGE_TYPE && optlen == 1)
+            opts->type = *p;
+        else if(type == DHCP_OPTION_REQUESTED_IP && optlen == 4)
+            opts->requested_ip = p;
+        else if(type == DHCP_OPTION_SERVER_ID && optlen == 4)
+            opts->server_id = p;
+        p += optlen;
+    }
+    return opts->type != 0;
+}
+
+static uint8_t *add_option(uint8_t *opt, uint8_t type, const void *value, uint8_t len)
+{
+    *opt++ = type;
+    *opt++ = len;
+    memcpy(opt, value, len);
+    return opt + len;
+}
+
+/* Reply of 'type' to 'msg', for lease 'i' (DHCPS_NONE for a NAK) */
+static size_t make_reply(const dhcps_t *s, const uint8_t *msg, uint8_t *reply,
+                         uint8_t type, uint8_t i)
+{
+    memset(reply, 0, DHCPS_REPLY_LEN);
+    reply[DHCP_OFS_OP] = DHCP_BOOTREPLY;
+    reply[DHCP_OFS_HTYPE] = msg[DHCP_OFS_HTYPE];
+    reply[DHCP_OFS_HLEN] = msg[DHCP_OFS_HLEN];
+    memcpy(reply + DHCP_OFS_XID, msg + DHCP_OFS_XID, 4);
+    memcpy(reply + DHCP_OFS_FLAGS, msg + DHCP_OFS_FLAGS, 2);
+    if(type == DHCP_ACK)
+        memcpy(reply + DHCP_OFS_CIADDR, msg + DHCP_OFS_CIADDR, 4);
+    if(i != DHCPS_NONE) {
+        memcpy(reply + DHCP_OFS_YIADDR, s->first_client_addr, 4);
+        reply[DHCP_OFS_YIADDR + 3] += i;
+    }
+    memcpy(reply + DHCP_OFS_GIADDR, msg + DHCP_OFS_GIADDR, 4);
+    memcpy(reply + DHCP_OFS_CHADDR, msg + DHCP_OFS_CHADDR, 16);
+    memcpy(reply + DHCP_OFS_COOKIE, magic_cookie, 4);
+
+    uint8_t *opt = reply + DHCP_OFS_OPTIONS;
+    opt = add_option(opt, DHCP_OPTION_MESSAGE_TYPE, &type, 1);
+    opt = add_option(opt, DHCP_OPTION_SERVER_ID, s->server_addr, 4);
+    if(type != DHCP_NAK) {
+        uint8_t lease_time[4] = {
+            s->lease_time >> 24, s->lease_time >> 16, s->lease_time >> 8, s->lease_time
+        };
+        opt = add_option(opt, DHCP_OPTION_LEASE_TIME, lease_time, 4);
+        opt = add_option(opt, DHCP_OPTION_SUBNET_MASK, s->netmask, 4);
+    }
+    *opt = DHCP_OPTION_END;
+    return DHCPS_REPLY_LEN;
+}
+
+static size_t handle_discover(dhcps_t *s, const uint8_t *msg, const dhcp_options_t *opts,
+                              uint32_t now, uint8_t *reply)
+{
+    const uint8_t *hwaddr = msg + DHCP_OFS_CHADDR;
+    uint8_t i = hash_find(s, hwaddr);
+
+    /* The client's last address, the one it asks for if free, or the
+       least recently used */
+    if(i == DHCPS_NONE && opts->requested_ip) {
+        i = lease_of_addr(s, opts->requested_ip);
+        if(i != DHCPS_NONE && in_wheel(&s->leases[i]))
+            i = DHCPS_NONE;
+    }
+    if(i == DHCPS_NONE)
+        i = s->free_head;
+    if(i == DHCPS_NONE)
+        return 0; /* All leases taken */
+
+    lease_claim(s, i, hwaddr);
+    if(s->leases[i].state != DHCPS_LEASE_BOUND)
+        lease_hold(s, i, DHCPS_LEASE_OFFERED, now + DHCPSERVER_OFFER_TIME);
+    return make_reply(s, msg, reply, DHCP_OFFER, i);
+}
+
+static size_t handle_request(dhcps_t *s, const uint8_t *msg, const dhcp_options_t *opts,
+                             uint32_t now, uint8_t *reply)
+{
+    const uint8_t *hwaddr = msg + DHCP_OFS_CHADDR;
+
+    if(opts->server_id && memcmp(opts->server_id, s->server_addr, 4)) {
+        /* The client took another server's offer */
+        uint8_t i = hash_find(s, hwaddr);
+        if(i != DHCPS_NONE && s->leases[i].state == DHCPS_LEASE_OFFERED)
+            lease_drop(s, i);
+        return 0;
+    }
+
+    /* Requested IP when selecting or rebooting, ciaddr when renewing */
+    const uint8_t *addr = opts->requested_ip ? opts->requested_ip : msg + DHCP_OFS_CIADDR;
+    uint8_t i = lease_of_addr(s, addr);
+    if(i == DHCPS_NONE)
+        return make_reply(s, msg, reply, DHCP_NAK, DHCPS_NONE);
+
+    dhcps_lease_t *lease = &s->leases[i];
+    if(lease->state == DHCPS_LEASE_DECLINED
+       || (in_wheel(lease) && memcmp(lease->hwaddr, hwaddr, 6)))
+        return make_reply(s, msg, reply, DHCP_NAK, DHCPS_NONE);
+
+    lease_claim(s, i, hwaddr);
+    lease_hold(s, i, DHCPS_LEASE_BOUND, now + s->lease_time);
+    return make_reply(s, msg, reply, DHCP_ACK, i);
+}
+
+size_t dhcps_handle(dhcps_t *s, const uint8_t *msg, size_t len, uint32_t now, uint8_t *reply)
+{
+    dhcp_options_t opts;
+
+    if(len < DHCP_OFS_OPTIONS || msg[DHCP_OFS_OP] != DHCP_BOOTREQUEST
+       || msg[DHCP_OFS_HTYPE] != DHCP_HTYPE_ETH || msg[DHCP_OFS_HLEN] != 6
+       || memcmp(msg + DHCP_OFS_COOKIE, magic_cookie, 4))
+        return 0;
+    if(!parse_options(msg, len, &opts))
+        return 0;
+
+    dhcps_expire(s, now);
+
+    switch(opts.type) {
+    case DHCP_DISCOVER:
+        return handle_discover(s, msg, &opts, now, reply);
+    case DHCP_REQUEST:
+        return handle_request(s, msg, &opts, now, reply);
+    case DHCP_RELEASE: {
+        uint8_t i = hash_find(s, msg + DHCP_OFS_CHADDR);
+        if(i != DHCPS_NONE && s->leases[i].state == DHCPS_LEASE_BOUND
+           && lease_of_addr(s, msg + DHCP_OFS_CIADDR) == i)
+            lease_drop(s, i);
+        return 0;
+    }
+    case DHCP_DECLINE: {
+        /* Someone else uses the address, keep it out of use for a lease time */
+        uint8_t i = hash_find(s, msg + DHCP_OFS_CHADDR);
+        if(i != DHCPS_NONE && opts.requested_ip && lease_of_addr(s, opts.requested_ip) == i) {
+            lease_drop(s, i);
+            hash_remove(s, i);
+            s->leases[i].state = DHCPS_LEASE_FREE;
+            lease_hold(s, i, DHCPS_LEASE_DECLINED, now + s->lease_time);
+        }
+        return 0;
+    }
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,109 @@
+/* DHCP server lease table and message handling
+ *
+ * The part of the DHCP server that doesn't need the network stack: it
+ * takes a client message as bytes, straight from the receive buffer, and
+ * writes the reply to send back, if any.
+ *
+ * Lease N is for the first client address plus N. Leases are found by
+ * client MAC through a hash table, and by address by index. Unused leases
+ * wait in a free list, least recently used first, so a client coming back
+ * usually gets its old address. Offered and bound leases sit in a timer
+ * wheel by expiry time: moving time forward only looks at the slots that
+ * have passed, not at every lease.
+ *
+ * The wheel is a single level of slot heads linked through the leases'
+ * 8-bit list indexes, with the slot arithmetic from core timer_wheel.h.
+ * A full timer_wheel_t would cost over 1 KB of slot heads, and a pointer
+ * linked timer_wheel_node_t would grow every lease from 16 to 24 bytes,
+ * for leases that expire minutes apart.
+ *
+ * Times are in seconds, from any starting point, and may wrap around.
+ *
+ * No dependencies beyond the C library and timer_wheel.h,
+ * extras/dhcpserver/tests builds it on a host.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _DHCPSERVER_CORE_H
+#define _DHCPSERVER_CORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Seconds an offered address is kept for the client to request it */
+#ifndef DHCPSERVER_OFFER_TIME
+#define DHCPSERVER_OFFER_TIME 30
+#endif
+
+/* Timer wheel: slots, and seconds per slot. Leases may expire up to a
+   slot late. */
+#define DHCPS_WHEEL_BITS 5
+#define DHCPS_WHEEL_SLOTS (1 << DHCPS_WHEEL_BITS)
+#define DHCPS_WHEEL_SHIFT 3
+
+/* Size of the replies, the minimum BOOTP message */
+#define DHCPS_REPLY_LEN 300
+
+#define DHCPS_NONE 0xff
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    DHCPS_LEASE_FREE = 0,  /* Never used, or declined and over */
+    DHCPS_LEASE_OFFERED,
+    DHCPS_LEASE_BOUND,
+    DHCPS_LEASE_EXPIRED,   /* Free, but remembers its last client */
+    DHCPS_LEASE_DECLINED,  /* A client found the address in use */
+} dhcps_lease_state_t;
+
+typedef struct {
+    uint8_t hwaddr[6];
+    uint8_t state;
+    uint8_t hnext;         /* Hash chain */
+    uint8_t prev, next;    /* Free list, or timer wheel slot */
+    uint32_t expires;
+} dhcps_lease_t;
+
+typedef struct {
+    uint8_t first_client_addr[4];
+    /* Sent in replies, set by the caller */
+    uint8_t server_addr[4];
+    uint8_t netmask[4];
+    uint32_t lease_time;
+
+    uint8_t max_leases;
+    uint8_t hash_mask;
+    uint8_t free_head, free_tail;
+    uint32_t wheel_time;   /* Start of the first slot not expired yet */
+    uint8_t wheel[DHCPS_WHEEL_SLOTS];
+    uint8_t *hash;
+    dhcps_lease_t *leases;
+} dhcps_t;
+
+/* Set up 'max_leases' leases, from 'first_client_addr' on (only the last
+   octet counts up, so there may be fewer), of 'lease_time' seconds.
+   Returns false if out of memory. */
+bool dhcps_init(dhcps_t *s, const uint8_t *first_client_addr, uint8_t max_leases,
+                uint32_t lease_time, uint32_t now);
+
+void dhcps_free(dhcps_t *s);
+
+/* Expire the leases due by 'now' */
+void dhcps_expire(dhcps_t *s, uint32_t now);
+
+/* Handle a client message of 'len' bytes. Returns the length of the reply
+   written to 'reply' (DHCPS_REPLY_LEN bytes), or 0 if there is none. */
+size_t dhcps_handle(dhcps_t *s, const uint8_t *msg, size_t len, uint32_t now, uint8_t *reply);
+
+/* The lease of a client, or NULL */
+const dhcps_lease_t *dhcps_find(const dhcps_t *s, const uint8_t *hwaddr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,486 @@
+/* Host unit tests for dhcpserver_core.c: synthetic clients going through
+ * discover, request, release and decline, lease expiry over time, and a
+ * consistency check of the lease lists after many clients come and go.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dhcpserver_core.h"
+#include "check.h"
+
+#define DISCOVER 1
+#define OFFER    2
+#define REQUEST  3
+#define DECLINE  4
+#define ACK      5
+#define NAK      6
+#define RELEASE  7
+
+static const uint8_t first_addr[4] = { 172, 16, 0, 2 };
+static const uint8_t server_addr[4] = { 172, 16, 0, 1 };
+static const uint8_t other_server[4] = { 172, 16, 0, 254 };
+
+static uint8_t msg[548];
+static uint8_t reply[DHCPS_REPLY_LEN];
+
+static void mac_of(uint8_t *mac, int client)
+{
+    mac[0] = 0x02;
+    mac[1] = 0;
+    mac[2] = client >> 24;
+    mac[3] = client >> 16;
+    mac[4] = client >> 8;
+    mac[5] = client;
+}
+
+/* Build a message from 'client', with a requested IP and server id if
+   not NULL. Returns its length. */
+static size_t build(int client, uint8_t type, const uint8_t *ciaddr,
+                    const uint8_t *requested, const uint8_t *server_id, bool pad)
+{
+    memset(msg, 0, sizeof(msg));
+    msg[0] = 1;
+    msg[1] = 1;
+    msg[2] = 6;
+    msg[4] = client;
+    msg[7] = 0x5a;
+    if(ciaddr)
+        memcpy(msg + 12, ciaddr, 4);
+    mac_of(msg + 28, client);
+    msg[236] = 99;
+    msg[237] = 130;
+    msg[238] = 83;
+    msg[239] = 99;
+
+    uint8_t *p = msg + 240;
+    if(pad) {
+        *p++ = 0;
+        *p++ = 0;
+    }
+    *p++ = 53;
+    *p++ = 1;
+    *p++ = type;
+    if(pad)
+        *p++ = 0;
+    if(requested) {
+        *p++ = 50;
+        *p++ = 4;
+        memcpy(p, requested, 4);
+        p += 4;
+    }
+    if(server_id) {
+        *p++ = 54;
+        *p++ = 4;
+        memcpy(p, server_id, 4);
+        p += 4;
+    }
+    *p++ = 255;
+    return p - msg;
+}
+
+/* Message type of the reply, or 0 */
+static uint8_t transact(dhcps_t *s, size_t len, uint32_t now)
+{
+    memset(reply, 0xee, sizeof(reply));
+    size_t n = dhcps_handle(s, msg, len, now, reply);
+    if(!n)
+        return 0;
+    CHECK(n == DHCPS_REPLY_LEN);
+    CHECK(reply[0] == 2);
+    CHECK(!memcmp(reply + 4, msg + 4, 4));
+    CHECK(!memcmp(reply + 28, msg + 28, 16));
+    CHECK(reply[240] == 53 && reply[241] == 1);
+    CHECK(reply[243] == 54 && reply[244] == 4 && !memcmp(reply + 245, server_addr, 4));
+    return reply[242];
+}
+
+/* Address offered or acked to the client, as an index from the first */
+static int yiaddr(void)
+{
+    CHECK(!memcmp(reply + 16, first_addr, 3));
+    return reply[19] - first_addr[3];
+}
+
+/* Discover and request, returning the lease index or -1 */
+static int lease_for(dhcps_t *s, int client, uint32_t now)
+{
+    if(transact(s, build(client, DISCOVER, NULL, NULL, NULL, false), now) != OFFER)
+        return -1;
+    uint8_t addr[4];
+    memcpy(addr, reply + 16, 4);
+    if(transact(s, build(client, REQUEST, NULL, addr, server_addr, false), now) != ACK)
+        return -1;
+    CHECK(!memcmp(reply + 16, addr, 4));
+    return yiaddr();
+}
+
+static uint8_t addr_of(int i, uint8_t *addr)
+{
+    memcpy(addr, first_addr, 4);
+    addr[3] += i;
+    return addr[3];
+}
+
+static void init(dhcps_t *s, uint8_t max_leases, uint32_t lease_time, uint32_t now)
+{
+    CHECK(dhcps_init(s, first_addr, max_leases, lease_time, now));
+    memcpy(s->server_addr, server_addr, 4);
+    memcpy(s->netmask, (uint8_t[]){ 255, 255, 255, 0 }, 4);
+}
+
+/* Every lease is in exactly one list, matching its state, and the hash
+   has exactly the leases that remember a client */
+static void check_consistent(const dhcps_t *s)
+{
+    int seen[256] = { 0 };
+    int n = 0;
+
+    uint8_t prev = DHCPS_NONE;
+    for(uint8_t i = s->free_head; i != DHCPS_NONE && n <= s->max_leases; i = s->leases[i].next, n++) {
+        CHECK(s->leases[i].state == DHCPS_LEASE_FREE || s->leases[i].state == DHCPS_LEASE_EXPIRED);
+        CHECK(s->leases[i].prev == prev);
+        seen[i]++;
+        prev = i;
+    }
+    CHECK(s->free_tail == prev);
+
+    for(int slot = 0; slot < DHCPS_WHEEL_SLOTS; slot++) {
+        prev = DHCPS_NONE;
+        for(uint8_t i = s->wheel[slot]; i != DHCPS_NONE && n <= s->max_leases; i = s->leases[i].next, n++) {
+            const dhcps_lease_t *l = &s->leases[i];
+            CHECK(l->state == DHCPS_LEASE_OFFERED || l->state == DHCPS_LEASE_BOUND
+                  || l->state == DHCPS_LEASE_DECLINED);
+            CHECK(((l->expires >> DHCPS_WHEEL_SHIFT) % DHCPS_WHEEL_SLOTS) == (uint32_t)slot);
+            CHECK(l->prev == prev);
+            seen[i]++;
+            prev = i;
+        }
+    }
+    CHECK(n == s->max_leases);
+    for(int i = 0; i < s->max_leases; i++) {
+        CHECK(seen[i] == 1);
+    }
+
+    int hashed = 0;
+    for(int b = 0; b <= s->hash_mask; b++) {
+        for(uint8_t i = s->hash[b]; i != DHCPS_NONE && hashed <= s->max_leases; i = s->leases[i].hnext) {
+            uint8_t st = s->leases[i].state;
+            CHECK(st == DHCPS_LEASE_OFFERED || st == DHCPS_LEASE_BOUND || st == DHCPS_LEASE_EXPIRED);
+            CHECK(dhcps_find(s, s->leases[i].hwaddr) == &s->leases[i]);
+            hashed++;
+        }
+    }
+    int expected = 0;
+    for(int i = 0; i < s->max_leases; i++) {
+        uint8_t st = s->leases[i].state;
+        expected += st == DHCPS_LEASE_OFFERED || st == DHCPS_LEASE_BOUND || st == DHCPS_LEASE_EXPIRED;
+    }
+    CHECK(hashed == expected);
+}
+
+static void test_bind(void)
+{
+    dhcps_t s;
+    init(&s, 4, 3600, 1000);
+
+    CHECK(transact(&s, build(1, DISCOVER, NULL, NULL, NULL, false), 1000) == OFFER);
+    CHECK(yiaddr() == 0);
+    /* Lease time, then netmask */
+    CHECK(reply[249] == 51 && reply[250] == 4);
+    CHECK(reply[251] == 0 && reply[252] == 0 && reply[253] == 0x0e && reply[254] == 0x10);
+    CHECK(reply[255] == 1 && reply[256] == 4 && reply[257] == 255 && reply[260] == 0);
+    CHECK(reply[261] == 255);
+    CHECK(dhcps_find(&s, msg + 28)->state == DHCPS_LEASE_OFFERED);
+
+    /* A second discover gets the same offer */
+    CHECK(transact(&s, build(1, DISCOVER, NULL, NULL, NULL, false), 1001) == OFFER);
+    CHECK(yiaddr() == 0);
+
+    uint8_t addr[4];
+    addr_of(0, addr);
+    CHECK(transact(&s, build(1, REQUEST, NULL, addr, server_addr, false), 1002) == ACK);
+    CHECK(yiaddr() == 0);
+    CHECK(dhcps_find(&s, msg + 28)->state == DHCPS_LEASE_BOUND);
+
+    /* Renewing, from ciaddr */
+    CHECK(transact(&s, build(1, REQUEST, addr, NULL, NULL, false), 2000) == ACK);
+    CHECK(!memcmp(reply + 12, addr, 4));
+    CHECK(dhcps_find(&s, msg + 28)->expires == 2000 + 3600);
+
+    CHECK(lease_for(&s, 2, 2001) == 1);
+    check_consistent(&s);
+    dhcps_free(&s);
+}
+
+static void test_pad_and_malformed(void)
+{
+    dhcps_t s;
+    init(&s, 4, 3600, 0);
+
+    CHECK(transact(&s, build(1, DISCOVER, NULL, NULL, NULL, true), 0) == OFFER);
+
+    size_t len = build(2, DISCOVER, NULL, NULL, NULL, false);
+    CHECK(dhcps_handle(&s, msg, 239, 0, reply) == 0);
+    msg[236] = 0;
+    CHECK(dhcps_handle(&s, msg, len, 0, reply) == 0);
+    len = build(2, DISCOVER, NULL, NULL, NULL, false);
+    msg[2] = 16;
+    CHECK(dhcps_handle(&s, msg, len, 0, reply) == 0);
+    /* Option running past the end */
+    len = build(2, DISCOVER, NULL, NULL, NULL, false);
+    msg[241] = 200;
+    CHECK(dhcps_handle(&s, msg, len, 0, reply) == 0);
+    /* No message type */
+    len = build(2, DISCOVER, NULL, NULL, NULL, false);
+    msg[240] = 255;
+    CHECK(dhcps_handle(&s, msg, len, 0, reply) == 0);
+    CHECK(dhcps_find(&s, msg + 28) == NULL);
+    check_consistent(&s);
+    dhcps_free(&s);
+}
+
+static void test_exhaustion(void)
+{
+    dhcps_t s;
+    init(&s, 3, 3600, 0);
+
+    for(int c = 1; c <= 3; c++) {
+        CHECK(lease_for(&s, c, 0) == c - 1);
+    }
+    CHECK(transact(&s, build(4, DISCOVER, NULL, NULL, NULL, false), 10) == 0);
+
+    /* Released, the address goes to the next client */
+    uint8_t addr[4];
+    addr_of(1, addr);
+    CHECK(transact(&s, build(2, RELEASE, addr, NULL, server_addr, false), 20) == 0);
+    CHECK(dhcps_find(&s, msg + 28)->state == DHCPS_LEASE_EXPIRED);
+    CHECK(lease_for(&s, 4, 30) == 1);
+    mac_of(msg + 28, 2);
+    CHECK(dhcps_find(&s, msg + 28) == NULL);
+    check_consistent(&s);
+    dhcps_free(&s);
+}
+
+static void test_expiry(void)
+{
+    dhcps_t s;
+    const uint32_t start = 0xfffff000; /* Wraps around during the test */
+    init(&s, 4, 600, start);
+
+    CHECK(lease_for(&s, 1, start) == 0);
+    CHECK(transact(&s, build(2, DISCOVER, NULL, NULL, NULL, false), start) == OFFER);
+
+    /* The offer goes after DHCPSERVER_OFFER_TIME, give or take a slot */
+    dhcps_expire(&s, start + DHCPSERVER_OFFER_TIME - 1);
+    mac_of(msg + 28, 2);
+    CHECK(dhcps_find(&s, msg + 28)->state == DHCPS_LEASE_OFFERED);
+    dhcps_expire(&s, start + DHCPSERVER_OFFER_TIME + (1 << DHCPS_WHEEL_SHIFT));
+    CHECK(dhcps_find(&s, msg + 28)->state == DHCPS_LEASE_EXPIRED);
+
+    /* The lease is longer than a turn of the wheel */
+    mac_of(msg + 28, 1);
+    for(uint32_t t = start; (int32_t)(t - (start + 590)) < 0; t += 7) {
+        dhcps_expire(&s, t);
+        CHECK(dhcps_find(&s, msg + 28)->state == DHCPS_LEASE_BOUND);
+    }
+    dhcps_expire(&s, start + 600 + (1 << DHCPS_WHEEL_SHIFT));
+    CHECK(dhcps_find(&s, msg + 28)->state == DHCPS_LEASE_EXPIRED);
+    check_consistent(&s);
+
+    /* After a long time without messages */
+    CHECK(lease_for(&s, 3, start + 1000) >= 0);
+    CHECK(transact(&s, build(4, DISCOVER, NULL, NULL, NULL, false), start + 100000) == OFFER);
+    mac_of(msg + 28, 3);
+    CHECK(dhcps_find(&s, msg + 28)->state == DHCPS_LEASE_EXPIRED);
+    check_consistent(&s);
+    dhcps_free(&s);
+}
+
+static void test_sticky(void)
+{
+    dhcps_t s;
+    init(&s, 8, 100, 0);
+
+    CHECK(lease_for(&s, 1, 0) == 0);
+    CHECK(lease_for(&s, 2, 0) == 1);
+    dhcps_expire(&s, 200);
+
+    /* Coming back after the lease ran out, clients get their old address */
+    CHECK(transact(&s, build(2, DISCOVER, NULL, NULL, NULL, false), 300) == OFFER);
+    CHECK(yiaddr() == 1);
+    /* New clients get the addresses never used first */
+    CHECK(lease_for(&s, 3, 300) == 2);
+
+    /* A client asking for a free address gets it */
+    uint8_t addr[4];
+    addr_of(6, addr);
+    CHECK(transact(&s, build(4, DISCOVER, NULL, addr, NULL, false), 300) == OFFER);
+    CHECK(yiaddr() == 6);
+    /* ...but not someone else's */
+    addr_of(2, addr);
+    CHECK(transact(&s, build(5, DISCOVER, NULL, addr, NULL, false), 300) == OFFER);
+    CHECK(yiaddr() != 2);
+    check_consistent(&s);
+    dhcps_free(&s);
+}
+
+static void test_request_checks(void)
+{
+    dhcps_t s;
+    init(&s, 4, 3600, 0);
+    uint8_t addr[4];
+
+    CHECK(lease_for(&s, 1, 0) == 0);
+
+    /* Someone else's address */
+    addr_of(0, addr);
+    CHECK(transact(&s, build(2, REQUEST, NULL, addr, NULL, false), 1) == NAK);
+    CHECK(reply[249] == 255);
+    CHECK(reply[16] == 0 && reply[19] == 0);
+    /* Out of range */
+    addr_of(4, addr);
+    CHECK(transact(&s, build(2, REQUEST, NULL, addr, NULL, false), 1) == NAK);
+    memcpy(addr, (uint8_t[]){ 10, 0, 0, 3 }, 4);
+    CHECK(transact(&s, build(2, REQUEST, NULL, addr, NULL, false), 1) == NAK);
+    /* No address at all */
+    CHECK(transact(&s, build(2, REQUEST, NULL, NULL, NULL, false), 1) == NAK);
+
+    /* Init-reboot to a free address is fine */
+    addr_of(3, addr);
+    CHECK(transact(&s, build(2, REQUEST, NULL, addr, NULL, false), 1) == ACK);
+    CHECK(yiaddr() == 3);
+
+    /* Moving to another address gives up the old one */
+    addr_of(2, addr);
+    CHECK(transact(&s, build(2, REQUEST, NULL, addr, NULL, false), 2) == ACK);
+    CHECK(s.leases[3].state == DHCPS_LEASE_FREE);
+    check_consistent(&s);
+
+    /* The client took another server's offer */
+    CHECK(transact(&s, build(3, DISCOVER, NULL, NULL, NULL, false), 3) == OFFER);
+    int offered = yiaddr();
+    addr_of(offered, addr);
+    CHECK(transact(&s, build(3, REQUEST, NULL, addr, other_server, false), 3) == 0);
+    CHECK(dhcps_find(&s, msg + 28)->state == DHCPS_LEASE_EXPIRED);
+    /* ...which leaves the address for others */
+    CHECK(lease_for(&s, 4, 4) >= 0);
+    check_consistent(&s);
+    dhcps_free(&s);
+}
+
+static void test_decline(void)
+{
+    dhcps_t s;
+    init(&s, 2, 600, 0);
+    uint8_t addr[4];
+
+    CHECK(lease_for(&s, 1, 0) == 0);
+    addr_of(0, addr);
+    CHECK(transact(&s, build(1, DECLINE, NULL, addr, server_addr, false), 1) == 0);
+    CHECK(s.leases[0].state == DHCPS_LEASE_DECLINED);
+    CHECK(dhcps_find(&s, msg + 28) == NULL);
+
+    /* Not handed out, or acked, until a lease time later */
+    CHECK(transact(&s, build(1, DISCOVER, NULL, NULL, NULL, false), 2) == OFFER);
+    CHECK(yiaddr() == 1);
+    CHECK(transact(&s, build(2, DISCOVER, NULL, NULL, NULL, false), 2) == 0);
+    CHECK(transact(&s, build(2, REQUEST, NULL, addr, NULL, false), 2) == NAK);
+    check_consistent(&s);
+
+    CHECK(transact(&s, build(2, DISCOVER, NULL, NULL, NULL, false), 700) == OFFER);
+    check_consistent(&s);
+    dhcps_free(&s);
+}
+
+static void test_limits(void)
+{
+    dhcps_t s;
+
+    /* Only the last octet counts up */
+    uint8_t high[4] = { 192, 168, 4, 250 };
+    CHECK(dhcps_init(&s, high, 100, 3600, 0));
+    CHECK(s.max_leases == 5);
+    dhcps_free(&s);
+
+    uint8_t low[4] = { 10, 0, 0, 0 };
+    CHECK(dhcps_init(&s, low, 255, 3600, 0));
+    CHECK(s.max_leases < DHCPS_NONE);
+    memcpy(s.server_addr, server_addr, 4);
+    check_consistent(&s);
+    dhcps_free(&s);
+}
+
+/* Clients coming and going at random, checking nobody shares an address */
+static void test_churn(void)
+{
+    dhcps_t s;
+    const int clients = 600;
+    int *bound = calloc(clients, sizeof(int));
+    int owner[256];
+    uint32_t now = 0;
+
+    init(&s, 200, 300, now);
+    for(int i = 0; i < 256; i++) {
+        owner[i] = -1;
+    }
+    srand(1);
+    for(int round = 0; round < 100000; round++) {
+        int c = rand() % clients;
+        uint8_t addr[4];
+
+        now += rand() % 3;
+        dhcps_expire(&s, now);
+        switch(rand() % 8) {
+        case 0:
+            if(bound[c]) {
+                addr_of(bound[c] - 1, addr);
+                transact(&s, build(c, RELEASE, addr, NULL, server_addr, false), now);
+                bound[c] = 0;
+            }
+            break;
+        case 1:
+            transact(&s, build(c, DISCOVER, NULL, NULL, NULL, false), now);
+            break;
+        default: {
+            int i = lease_for(&s, c, now);
+            if(i >= 0) {
+                /* Nobody else still holds it */
+                if(owner[i] >= 0 && owner[i] != c && bound[owner[i]] == i + 1) {
+                    const dhcps_lease_t *l;
+                    mac_of(msg + 28, owner[i]);
+                    l = dhcps_find(&s, msg + 28);
+                    CHECK(!l || l != &s.leases[i] || l->state != DHCPS_LEASE_BOUND);
+                }
+                if(bound[c] && bound[c] != i + 1)
+                    owner[bound[c] - 1] = -1;
+                owner[i] = c;
+                bound[c] = i + 1;
+            }
+            break;
+        }
+        }
+        if(round % 1000 == 0)
+            check_consistent(&s);
+    }
+    check_consistent(&s);
+    dhcps_free(&s);
+    free(bound);
+}
+
+int main(void)
+{
+    test_bind();
+    test_pad_and_malformed();
+    test_exhaustion();
+    test_expiry();
+    test_sticky();
+    test_request_checks();
+    test_decline();
+    test_limits();
+    test_churn();
+
+    return check_done("dhcpserver");
+}
@@ -0,0 +1,11 @@
+# Component makefile for extras/dlog
+#
+# Deferred binary logging, see dlog.h. Records are decoded on a host with
+# utils/dlog_decode.py.
+
+INC_DIRS += $(dlog_ROOT)
+
+# args for passing into compile rule generation
+dlog_SRC_DIR = $(dlog_ROOT)
+
+$(eval $(call component_compile_rules,dlog))
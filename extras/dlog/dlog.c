@@ -0,0 +1,182 @@
+/* Deferred binary logging
+ *
+ * See dlog.h
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <esp8266.h>
+#include <esp/wdev_regs.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "dlog.h"
+
+/* Record layout, in 32 bit words:
+ *   header   format index (offset / 4) << 16 | level << 4 | nargs
+ *   time     microseconds, WDEV.SYS_TIME
+ *   args     nargs words
+ */
+#define DLOG_ID_LOST 0xffff     /* One argument, the number of records lost */
+
+_Static_assert((DLOG_BUFFER_WORDS & (DLOG_BUFFER_WORDS - 1)) == 0, "DLOG_BUFFER_WORDS must be a power of two");
+
+extern const char _dlog_fmt_start[];
+
+static uint32_t buffer[DLOG_BUFFER_WORDS];
+static volatile uint32_t head, tail;        /* Words ever read and written */
+static uint32_t lost, total_lost;
+static dlog_output_t task_output;
+
+static inline uint32_t space(void)
+{
+    return DLOG_BUFFER_WORDS - (tail - head);
+}
+
+static inline void put(const uint32_t *words, unsigned n)
+{
+    uint32_t t = tail;
+
+    for (unsigned i = 0; i < n; i++) {
+        buffer[(t + i) & (DLOG_BUFFER_WORDS - 1)] = words[i];
+    }
+    tail = t + n;
+}
+
+void dlog_write(unsigned level, const char *fmt, unsigned nargs, ...)
+{
+    uint32_t rec[2 + DLOG_MAX_ARGS];
+    va_list ap;
+
+    rec[0] = (uint32_t)(fmt - _dlog_fmt_start) / 4 << 16 | level << 4 | nargs;
+    rec[1] = WDEV.SYS_TIME;
+    va_start(ap, nargs);
+    for (unsigned i = 0; i < nargs; i++) {
+        rec[2 + i] = va_arg(ap, uint32_t);
+    }
+    va_end(ap);
+
+    /* Interrupts off rather than a critical section, so it works from
+       interrupt handlers and costs less */
+    uint32_t ps = _xt_disable_interrupts();
+    if (lost && space() >= 3 + 2 + nargs) {
+        uint32_t note[3] = { DLOG_ID_LOST << 16 | DLOG_LEVEL_WARN << 4 | 1, rec[1], lost };
+        put(note, 3);
+        lost = 0;
+    }
+    if (!lost && space() >= 2 + nargs) {
+        put(rec, 2 + nargs);
+    } else {
+        lost++;
+        total_lost++;
+    }
+    _xt_restore_interrupts(ps);
+}
+
+uint32_t dlog_lost(void)
+{
+    return total_lost;
+}
+
+size_t dlog_read(uint32_t *dest, size_t max_words)
+{
+    uint32_t h = head, t = tail;
+    size_t done = 0;
+
+    while (h != t) {
+        unsigned n = dlog_record_words(buffer[h & (DLOG_BUFFER_WORDS - 1)]);
+        if (done + n > max_words) {
+            break;
+        }
+        for (unsigned i = 0; i < n; i++) {
+            dest[done++] = buffer[(h + i) & (DLOG_BUFFER_WORDS - 1)];
+        }
+        h += n;
+    }
+    head = h;
+    return done;
+}
+
+/* Copy a format string out of flash a word at a time, as byte loads from
+   flash need the (slow) unaligned load exception handler */
+static void copy_fmt(char *dest, const char *src, size_t len)
+{
+    const uint32_t *p = (const uint32_t *)src;
+
+    for (size_t i = 0; i + 4 <= len; i += 4) {
+        uint32_t w = *p++;
+        memcpy(dest + i, &w, 4);
+        if (!(w & 0xff) || !(w & 0xff00) || !(w & 0xff0000) || !(w & 0xff000000)) {
+            return;
+        }
+    }
+    dest[len - 1] = 0;
+}
+
+int dlog_format(const uint32_t *rec, char *buf, size_t len)
+{
+    static const char levels[] = "?EWID";
+    uint32_t id = rec[0] >> 16;
+    unsigned level = (rec[0] >> 4) & 7;
+    const uint32_t *a = rec + 2;
+    char fmt[128];
+    int n;
+
+    n = snprintf(buf, len, "%u.%06u %c ", rec[1] / 1000000, rec[1] % 1000000,
+                 level < sizeof(levels) - 1 ? levels[level] : '?');
+    if (n < 0 || n >= len) {
+        return n;
+    }
+    if (id == DLOG_ID_LOST) {
+        return n + snprintf(buf + n, len - n, "(%u log records lost)", a[0]);
+    }
+    copy_fmt(fmt, _dlog_fmt_start + id * 4, sizeof(fmt));
+    /* Every argument is one word, passing unused ones does no harm */
+    return n + snprintf(buf + n, len - n, fmt, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+static void output_hex(const uint32_t *rec, unsigned n)
+{
+    char line[4 + (2 + DLOG_MAX_ARGS) * 8 + 2];
+    char *p = line;
+
+    memcpy(p, "DL:", 3);
+    p += 3;
+    for (unsigned i = 0; i < n; i++) {
+        /* Little endian bytes, like the binary format */
+        for (int b = 0; b < 32; b += 8) {
+            p += sprintf(p, "%02x", (rec[i] >> b) & 0xff);
+        }
+    }
+    *p++ = '\n';
+    fwrite(line, 1, p - line, stdout);
+}
+
+static void dlog_task(void *params)
+{
+    uint32_t batch[32];
+    char line[160];
+    size_t n;
+
+    for (;;) {
+        while ((n = dlog_read(batch, 32)) != 0) {
+            for (size_t i = 0; i < n; i += dlog_record_words(batch[i])) {
+                if (task_output == DLOG_OUTPUT_HEX) {
+                    output_hex(batch + i, dlog_record_words(batch[i]));
+                } else {
+                    dlog_format(batch + i, line, sizeof(line));
+                    puts(line);
+                }
+            }
+        }
+        vTaskDelay(DLOG_TASK_PERIOD_MS / portTICK_PERIOD_MS);
+    }
+}
+
+bool dlog_start(unsigned priority, dlog_output_t output)
+{
+    task_output = output;
+    return xTaskCreate(dlog_task, "dlog", 384, NULL, priority, NULL) == pdPASS;
+}
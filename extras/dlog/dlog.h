@@ -0,0 +1,115 @@
+/* Deferred binary logging
+ *
+ * DLOGI("adc %d at %u", value, when) stores a record of a few words (the
+ * format string's index, the level, a timestamp in microseconds and the
+ * raw arguments) in a RAM buffer and returns, without running printf or
+ * waiting on the UART. It is safe from tasks and interrupt handlers.
+ *
+ * The format strings are placed together in flash (section .irom0.dlog,
+ * between _dlog_fmt_start and _dlog_fmt_end), so a record only carries an
+ * index into this table. Records are formatted later, either on the
+ * device by the task started with dlog_start(), or on a host by
+ * utils/dlog_decode.py reading the table from the program's ELF file.
+ *
+ * Arguments must be 32 bit or smaller (int, char, pointers): there are no
+ * 64 bit or floating point arguments, and at most DLOG_MAX_ARGS of them.
+ * Strings passed for %s must still exist when the record is formatted,
+ * which in practice means string constants. Format strings don't end in
+ * a newline, one is added to each record.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _DLOG_H
+#define _DLOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Buffer size in 32 bit words, a power of two */
+#ifndef DLOG_BUFFER_WORDS
+#define DLOG_BUFFER_WORDS 1024
+#endif
+
+/* How often the dlog_start() task empties the buffer */
+#ifndef DLOG_TASK_PERIOD_MS
+#define DLOG_TASK_PERIOD_MS 100
+#endif
+
+#define DLOG_MAX_ARGS 6
+
+#define DLOG_LEVEL_ERROR 1
+#define DLOG_LEVEL_WARN  2
+#define DLOG_LEVEL_INFO  3
+#define DLOG_LEVEL_DEBUG 4
+
+/* Calls above this level are compiled out, define it before including
+   dlog.h or with -D to change it for a file or a program */
+#ifndef DLOG_LEVEL
+#define DLOG_LEVEL DLOG_LEVEL_INFO
+#endif
+
+#define DLOG_NARGS(...) DLOG_NARGS_(0, ##__VA_ARGS__, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define DLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, n, ...) n
+
+#ifdef __cplusplus
+#define DLOG_STATIC_ASSERT static_assert
+#else
+#define DLOG_STATIC_ASSERT _Static_assert
+#endif
+
+#define DLOG_AT(level, fmt, ...) do { \
+        static const char _dlog_fmt[] __attribute__((section(".irom0.dlog"), aligned(4))) = fmt; \
+        DLOG_STATIC_ASSERT(DLOG_NARGS(__VA_ARGS__) <= DLOG_MAX_ARGS, "Too many arguments for DLOG"); \
+        if ((level) <= DLOG_LEVEL) { \
+            dlog_write((level), _dlog_fmt, DLOG_NARGS(__VA_ARGS__), ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define DLOGE(fmt, ...) DLOG_AT(DLOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define DLOGW(fmt, ...) DLOG_AT(DLOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define DLOGI(fmt, ...) DLOG_AT(DLOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define DLOGD(fmt, ...) DLOG_AT(DLOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+
+/* Used by the macros above. 'fmt' must be in the .irom0.dlog section. */
+void dlog_write(unsigned level, const char *fmt, unsigned nargs, ...);
+
+/* How the dlog_start() task outputs records */
+typedef enum {
+    DLOG_OUTPUT_TEXT,       /* Formatted with printf() */
+    DLOG_OUTPUT_HEX,        /* "DL:" lines of hex for utils/dlog_decode.py,
+                               no formatting on the device at all */
+} dlog_output_t;
+
+/* Start a task which writes out logged records every DLOG_TASK_PERIOD_MS.
+   Returns false if the task couldn't be created. */
+bool dlog_start(unsigned priority, dlog_output_t output);
+
+/* Instead of dlog_start(): move whole records, up to max_words words, to
+   'dest', e.g. to send them over the network. utils/dlog_decode.py reads
+   these words as a binary file if the file starts with "DLG1". Only one
+   task may read. Returns the number of words. */
+size_t dlog_read(uint32_t *dest, size_t max_words);
+
+/* Format one record from dlog_read() into 'buf', without a newline */
+int dlog_format(const uint32_t *record, char *buf, size_t len);
+
+/* Number of words in the record starting with 'header' */
+static inline unsigned dlog_record_words(uint32_t header)
+{
+    return 2 + (header & 0xf);
+}
+
+/* Records dropped as the buffer was full */
+uint32_t dlog_lost(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DLOG_H */
@@ -0,0 +1,191 @@
+/* Edge event ring buffer and pulse timing for extras/gpio_capture
+ *
+ * The GPIO interrupt handler is the only producer of events and one task
+ * the only consumer, so no locking is needed on a single core CPU. The
+ * number of entries must be a power of two; head and tail count events
+ * ever read and written, so all entries can be used.
+ *
+ * capture_pulse_t turns the timestamps of one pin's edges into a count,
+ * period and frequency, ignoring edges that follow the last one closer
+ * than a debounce time. This all happens in the consumer task.
+ *
+ * No dependencies beyond the C library, extras/gpio_capture/tests builds
+ * it on a host.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _CAPTURE_RING_H
+#define _CAPTURE_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t ccount;            /* CPU cycle counter when it was seen */
+    uint8_t pin;
+    uint8_t level;              /* Pin level when it was seen */
+} gpio_capture_event_t;
+
+typedef struct {
+    gpio_capture_event_t *buf;
+    uint32_t mask;              /* entries - 1 */
+    volatile uint32_t head;     /* Only written by the consumer */
+    volatile uint32_t tail;     /* Only written by the producer */
+    volatile uint32_t dropped;  /* Events lost as the ring was full */
+} capture_ring_t;
+
+/* Only the compiler can reorder accesses on a single core */
+#define CAPTURE_RING_FENCE() __asm__ volatile ("" ::: "memory")
+
+static inline void capture_ring_init(capture_ring_t *r, gpio_capture_event_t *buf, uint32_t entries)
+{
+    r->buf = buf;
+    r->mask = entries - 1;
+    r->head = r->tail = 0;
+    r->dropped = 0;
+}
+
+static inline uint32_t capture_ring_used(const capture_ring_t *r)
+{
+    return r->tail - r->head;
+}
+
+/* Producer side. Returns false, and counts the event as dropped, if the
+   ring is full. */
+static inline bool capture_ring_put(capture_ring_t *r, uint32_t ccount, uint8_t pin, uint8_t level)
+{
+    uint32_t tail = r->tail;
+
+    if (tail - r->head > r->mask) {
+        r->dropped++;
+        return false;
+    }
+    gpio_capture_event_t *e = &r->buf[tail & r->mask];
+    e->ccount = ccount;
+    e->pin = pin;
+    e->level = level;
+    CAPTURE_RING_FENCE();
+    r->tail = tail + 1;
+    return true;
+}
+
+/* Consumer side. Copies out up to 'max' events, returns how many. */
+static inline size_t capture_ring_get(capture_ring_t *r, gpio_capture_event_t *out, size_t max)
+{
+    uint32_t head = r->head;
+    uint32_t n = r->tail - head;
+
+    if (n > max) {
+        n = max;
+    }
+    CAPTURE_RING_FENCE();
+    for (uint32_t i = 0; i < n; i++) {
+        out[i] = r->buf[(head + i) & r->mask];
+    }
+    CAPTURE_RING_FENCE();
+    r->head = head + n;
+    return n;
+}
+
+typedef struct {
+    uint32_t debounce;          /* Cycles, see capture_pulse_init() */
+    uint32_t last;              /* ccount of the last edge accepted */
+    bool started;
+    uint32_t edges;             /* Edges accepted */
+    uint32_t bounces;           /* Edges ignored */
+    uint64_t period_sum;        /* Cycles between accepted edges */
+    uint32_t periods;
+    uint32_t period_min;
+    uint32_t period_max;
+} capture_pulse_t;
+
+typedef struct {
+    uint32_t edges;
+    uint32_t bounces;
+    uint32_t periods;           /* Number of periods averaged */
+    uint32_t period;            /* Mean period in cycles, 0 if none */
+    uint32_t period_min;
+    uint32_t period_max;
+} capture_pulse_stats_t;
+
+/* Edges less than 'debounce' cycles after the last accepted one are
+   ignored. ccount wraps around every 2^32 cycles (54 s at 80 MHz), call
+   capture_pulse_restart() if the input may have been quiet for that
+   long. */
+static inline void capture_pulse_init(capture_pulse_t *p, uint32_t debounce)
+{
+    p->debounce = debounce;
+    p->started = false;
+    p->edges = p->bounces = p->periods = 0;
+    p->period_sum = 0;
+    p->period_min = UINT32_MAX;
+    p->period_max = 0;
+}
+
+/* Don't measure the period from the last edge to the next one */
+static inline void capture_pulse_restart(capture_pulse_t *p)
+{
+    p->started = false;
+}
+
+/* Add the timestamp of one edge, returns false if it was a bounce */
+static inline bool capture_pulse_add(capture_pulse_t *p, uint32_t ccount)
+{
+    if (p->started) {
+        uint32_t period = ccount - p->last;
+        if (period < p->debounce) {
+            p->bounces++;
+            return false;
+        }
+        p->period_sum += period;
+        p->periods++;
+        if (period < p->period_min) {
+            p->period_min = period;
+        }
+        if (period > p->period_max) {
+            p->period_max = period;
+        }
+    }
+    p->started = true;
+    p->last = ccount;
+    p->edges++;
+    return true;
+}
+
+/* Get what was measured since the last call, and start again. The time
+   of the last edge is kept, so no period is lost between calls. */
+static inline void capture_pulse_take(capture_pulse_t *p, capture_pulse_stats_t *s)
+{
+    s->edges = p->edges;
+    s->bounces = p->bounces;
+    s->periods = p->periods;
+    s->period = p->periods ? (uint32_t)(p->period_sum / p->periods) : 0;
+    s->period_min = p->periods ? p->period_min : 0;
+    s->period_max = p->period_max;
+
+    p->edges = p->bounces = p->periods = 0;
+    p->period_sum = 0;
+    p->period_min = UINT32_MAX;
+    p->period_max = 0;
+}
+
+/* Frequency in mHz of edges 'period' cycles apart on a 'mhz' MHz CPU */
+static inline uint32_t capture_pulse_millihz(uint32_t period, uint32_t mhz)
+{
+    if (!period) {
+        return 0;
+    }
+    return (uint32_t)(((uint64_t)mhz * 1000000000 + period / 2) / period);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CAPTURE_RING_H */
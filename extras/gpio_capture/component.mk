@@ -0,0 +1,12 @@
+# Component makefile for extras/gpio_capture
+#
+# Timestamps GPIO edges in the interrupt handler and hands them to a
+# task in batches, see gpio_capture.h and examples/pulse_counter.
+# tests/ has host tests for the ring buffer and pulse timing.
+
+INC_DIRS += $(gpio_capture_ROOT)
+
+# args for passing into compile rule generation
+gpio_capture_SRC_DIR = $(gpio_capture_ROOT)
+
+$(eval $(call component_compile_rules,gpio_capture))
@@ -0,0 +1,91 @@
+/* GPIO edge capture
+ *
+ * See gpio_capture.h
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdlib.h>
+#include <esp8266.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "xtensa_ops.h"
+#include "gpio_capture.h"
+
+static capture_ring_t ring;
+static uint32_t batch;
+
+/* Task waiting in gpio_capture_read(), if any */
+static volatile TaskHandle_t reader;
+
+static void IRAM capture_isr(uint32_t status)
+{
+    uint32_t ccount, in = GPIO.IN;
+    RSR(ccount, ccount);
+
+    while (status) {
+        uint8_t pin = __builtin_ctz(status);
+        status &= status - 1;
+        capture_ring_put(&ring, ccount, pin, (in >> pin) & 1);
+    }
+
+    if (reader && capture_ring_used(&ring) >= batch) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(reader, &woken);
+        reader = NULL;
+        portEND_SWITCHING_ISR(woken);
+    }
+}
+
+bool gpio_capture_init(uint32_t entries, uint32_t batch_size)
+{
+    gpio_capture_event_t *buf = malloc(entries * sizeof(gpio_capture_event_t));
+
+    if (!buf) {
+        return false;
+    }
+    capture_ring_init(&ring, buf, entries);
+    batch = batch_size ? batch_size : 1;
+    gpio_capture_hook = capture_isr;
+    return true;
+}
+
+bool gpio_capture_add(uint8_t gpio_num, gpio_inttype_t type)
+{
+    if (gpio_num > 15 || !ring.buf) {
+        return false;
+    }
+    gpio_capture_mask |= BIT(gpio_num);
+    gpio_set_interrupt(gpio_num, type);
+    return true;
+}
+
+void gpio_capture_remove(uint8_t gpio_num)
+{
+    if (gpio_num > 15) {
+        return;
+    }
+    gpio_set_interrupt(gpio_num, GPIO_INTTYPE_NONE);
+    gpio_capture_mask &= ~BIT(gpio_num);
+}
+
+size_t gpio_capture_read(gpio_capture_event_t *events, size_t max, TickType_t timeout)
+{
+    if (capture_ring_used(&ring) < batch && timeout) {
+        ulTaskNotifyTake(pdTRUE, 0);
+        taskENTER_CRITICAL();
+        reader = xTaskGetCurrentTaskHandle();
+        bool ready = capture_ring_used(&ring) >= batch;
+        taskEXIT_CRITICAL();
+        if (!ready) {
+            ulTaskNotifyTake(pdTRUE, timeout);
+        }
+        reader = NULL;
+    }
+    return capture_ring_get(&ring, events, max);
+}
+
+uint32_t gpio_capture_dropped(void)
+{
+    return ring.dropped;
+}
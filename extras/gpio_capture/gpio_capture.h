@@ -0,0 +1,59 @@
+/* GPIO edge capture
+ *
+ * For inputs that change too often to wake a task on every edge, like
+ * flow meters, anemometers and other pulse outputs at a few kHz. The GPIO
+ * interrupt handler only records each edge (pin, level and CPU cycle
+ * count) in a ring buffer; a task reads them in batches and does the
+ * debouncing and timing, e.g. with capture_pulse_t from capture_ring.h.
+ *
+ * The reading task is woken when a batch of events is waiting or its
+ * timeout runs out, whichever comes first. Pins not used for capture
+ * keep their gpXX_interrupt_handler(), but a program that defines its
+ * own gpio_interrupt_handler() can't use this.
+ *
+ * Timestamps are taken when the interrupt handler runs, so they are
+ * late by the interrupt latency (a few us, more while interrupts are
+ * disabled) and edges seen in the same interrupt share one.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _GPIO_CAPTURE_H
+#define _GPIO_CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "FreeRTOS.h"
+#include "esp/gpio.h"
+#include "capture_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Allocate a ring of 'entries' (a power of two) events, and wake the
+   reader once 'batch' of them are waiting. Returns false if out of
+   memory. */
+bool gpio_capture_init(uint32_t entries, uint32_t batch);
+
+/* Record edges of 'type' on GPIO 0..15, which should be set up as an
+   input first. */
+bool gpio_capture_add(uint8_t gpio_num, gpio_inttype_t type);
+
+/* Stop recording edges of a pin, and disable its interrupt */
+void gpio_capture_remove(uint8_t gpio_num);
+
+/* Wait up to 'timeout' ticks for a batch of events, then read up to
+   'max' of them. Only one task may call this. Returns the number of
+   events read. */
+size_t gpio_capture_read(gpio_capture_event_t *events, size_t max, TickType_t timeout);
+
+/* Events lost since gpio_capture_init() because the ring was full */
+uint32_t gpio_capture_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _GPIO_CAPTURE_H */
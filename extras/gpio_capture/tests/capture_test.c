@@ -0,0 +1,125 @@
+/* Host unit tests for capture_ring.h: the event ring, and pulse timing
+ * on synthetic edges with jitter, contact bounce and the cycle counter
+ * wrapping around.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "capture_ring.h"
+#include "check.h"
+
+#define MHZ 80
+
+static void test_ring(void)
+{
+    gpio_capture_event_t buf[8], out[16];
+    capture_ring_t r;
+
+    capture_ring_init(&r, buf, 8);
+    CHECK(capture_ring_used(&r) == 0);
+    CHECK(capture_ring_get(&r, out, 16) == 0);
+    for (int i = 0; i < 5; i++) {
+        CHECK(capture_ring_put(&r, 1000 + i, i, i & 1));
+    }
+    CHECK(capture_ring_get(&r, out, 3) == 3);
+    CHECK(out[0].ccount == 1000 && out[2].pin == 2 && out[2].level == 0 && out[1].level == 1);
+
+    /* Wraps around the end, and drops what doesn't fit */
+    for (int i = 5; i < 20; i++) {
+        capture_ring_put(&r, 1000 + i, i, 0);
+    }
+    CHECK(capture_ring_used(&r) == 8);
+    CHECK(r.dropped == 9);
+    CHECK(capture_ring_get(&r, out, 16) == 8);
+    for (int i = 0; i < 8; i++) {
+        CHECK(out[i].ccount == (uint32_t)(1003 + i));
+    }
+    CHECK(capture_ring_put(&r, 1, 1, 1));
+}
+
+static void test_counter_wrap(void)
+{
+    gpio_capture_event_t buf[4], out[4];
+    capture_ring_t r;
+
+    capture_ring_init(&r, buf, 4);
+    r.head = r.tail = UINT32_MAX - 1;
+    for (int i = 0; i < 4; i++) {
+        CHECK(capture_ring_put(&r, i, 0, 0));
+    }
+    CHECK(!capture_ring_put(&r, 4, 0, 0));
+    CHECK(capture_ring_get(&r, out, 4) == 4 && out[3].ccount == 3);
+    CHECK(r.tail == 2 && capture_ring_used(&r) == 0);
+}
+
+static uint32_t lcg = 12345;
+
+static uint32_t rnd(uint32_t n)
+{
+    lcg = lcg * 1103515245 + 12345;
+    return (lcg >> 8) % n;
+}
+
+/* 1 kHz rising edges with +-2 us jitter, starting just before ccount
+   wraps around, each followed by some contact bounce */
+static void test_pulse(void)
+{
+    const uint32_t period = 1000 * MHZ;
+    capture_pulse_t p;
+    capture_pulse_stats_t s;
+    uint32_t t = UINT32_MAX - 10 * period;
+    int bounces = 0;
+
+    capture_pulse_init(&p, 100 * MHZ);
+    for (int i = 0; i < 1000; i++) {
+        uint32_t edge = t + i * period + rnd(4 * MHZ) - 2 * MHZ;
+        CHECK(capture_pulse_add(&p, edge));
+        for (int b = rnd(4); b > 0; b--) {
+            CHECK(!capture_pulse_add(&p, edge + b * 5 * MHZ));
+            bounces++;
+        }
+    }
+    capture_pulse_take(&p, &s);
+    CHECK(s.edges == 1000);
+    CHECK(s.bounces == (uint32_t)bounces);
+    CHECK(s.periods == 999);
+    CHECK(s.period > period - 10 && s.period < period + 10);
+    CHECK(s.period_min >= period - 4 * MHZ && s.period_max <= period + 4 * MHZ);
+    uint32_t mhz = capture_pulse_millihz(s.period, MHZ);
+    CHECK(mhz > 999900 && mhz < 1000100);
+
+    /* Taking the stats starts a new measurement, from the last edge */
+    capture_pulse_add(&p, t + 1000 * period);
+    capture_pulse_take(&p, &s);
+    CHECK(s.edges == 1 && s.periods == 1);
+    capture_pulse_take(&p, &s);
+    CHECK(s.edges == 0 && s.period == 0 && s.period_min == 0 && s.period_max == 0);
+
+    /* After a restart the next gap isn't a period */
+    capture_pulse_restart(&p);
+    capture_pulse_add(&p, 5);
+    capture_pulse_take(&p, &s);
+    CHECK(s.edges == 1 && s.periods == 0);
+}
+
+static void test_millihz(void)
+{
+    CHECK(capture_pulse_millihz(0, MHZ) == 0);
+    CHECK(capture_pulse_millihz(80, 80) == 1000000000);
+    CHECK(capture_pulse_millihz(160000000, 160) == 1000);
+    /* Rounded to nearest */
+    CHECK(capture_pulse_millihz(3 * MHZ * 1000, MHZ) == 333333);
+    CHECK(capture_pulse_millihz(6 * 1000, 1) == 166667);
+}
+
+int main(void)
+{
+    test_ring();
+    test_counter_wrap();
+    test_pulse();
+    test_millihz();
+
+    return check_done("capture_ring");
+}
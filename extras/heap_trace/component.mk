@@ -0,0 +1,19 @@
+# Component makefile for extras/heap_trace
+#
+# Adding this component wraps the heap functions at link time, see
+# heap_trace.h. Set HEAP_TRACE_RECORDS to change the ring buffer size.
+
+INC_DIRS += $(heap_trace_ROOT)
+
+HEAP_TRACE_RECORDS ?= 256
+HEAP_TRACE_WRAP = malloc calloc zalloc \
+	slab_malloc slab_calloc slab_realloc slab_free \
+	pvPortMalloc vPortFree
+
+LDFLAGS += $(foreach fn,$(HEAP_TRACE_WRAP),-Wl,--wrap=$(fn))
+
+# args for passing into compile rule generation
+heap_trace_SRC_DIR = $(heap_trace_ROOT)
+heap_trace_CFLAGS = $(CFLAGS) -DHEAP_TRACE_RECORDS=$(HEAP_TRACE_RECORDS)
+
+$(eval $(call component_compile_rules,heap_trace))
@@ -0,0 +1,327 @@
+/* Heap allocation tracer
+ *
+ * See heap_trace.h for usage.
+ *
+ * The allocation functions are wrapped with the linker's --wrap option
+ * (see component.mk), so every call from other objects, including the
+ * binary SDK libraries, arrives at a __wrap_ function here. free() and
+ * realloc() are already wrapped by the core to go to slab_free() and
+ * slab_realloc() (core/slab_libc.c), so they are traced there.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <espressif/esp_common.h>
+#include <lwip/sockets.h>
+#include "heap_trace.h"
+
+#define MAX_TASKS 32
+
+#define STREAM_BATCH 16
+
+extern bool esp_in_isr;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_zalloc(size_t size);
+void *__real_slab_malloc(size_t size);
+void *__real_slab_calloc(size_t nmemb, size_t size);
+void *__real_slab_realloc(void *ptr, size_t size);
+void __real_slab_free(void *ptr);
+void *__real_pvPortMalloc(size_t size);
+void __real_vPortFree(void *ptr);
+
+static heap_trace_record_t ring[HEAP_TRACE_RECORDS];
+static uint32_t ring_head, ring_tail;    /* Free running, ring_head - ring_tail records in use */
+static uint32_t lost;
+static heap_trace_mode_t trace_mode;
+static volatile bool active;
+static int depth;                        /* Nesting of wrapped calls */
+
+static TaskHandle_t tasks[MAX_TASKS];
+static uint8_t n_tasks;
+static uint8_t last_task_id;
+
+static TaskHandle_t stream_task;
+
+/* All ring and task table state is only touched inside a critical
+   section, the same one newlib's malloc lock uses. */
+
+static bool ring_put(uint32_t ptr, uint32_t caller, uint32_t time, uint32_t info)
+{
+    if(ring_head - ring_tail == HEAP_TRACE_RECORDS) {
+        if(trace_mode == HEAP_TRACE_STREAM) {
+            lost++;
+            return false;
+        }
+        ring_tail++;
+    }
+    heap_trace_record_t *r = &ring[ring_head % HEAP_TRACE_RECORDS];
+    r->ptr = ptr;
+    r->caller = caller;
+    r->time = time;
+    r->info = info;
+    ring_head++;
+    return true;
+}
+
+/* Small id for the current task, emitting a HEAP_TRACE_TASK record with
+   the task's name the first time it's seen. */
+static uint8_t current_task_id(void)
+{
+    if(esp_in_isr) {
+        return 0;
+    }
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    if(task == NULL) {
+        return 0;
+    }
+    if(last_task_id && tasks[last_task_id - 1] == task) {
+        return last_task_id;
+    }
+    for(int i = 0; i < n_tasks; i++) {
+        if(tasks[i] == task) {
+            last_task_id = i + 1;
+            return last_task_id;
+        }
+    }
+    if(n_tasks == MAX_TASKS) {
+        return 0xff;
+    }
+    tasks[n_tasks++] = task;
+    last_task_id = n_tasks;
+
+    uint32_t name[3] = { 0 };
+    strncpy((char *)name, pcTaskGetName(task), sizeof(name));
+    ring_put(name[0], name[1], name[2], HEAP_TRACE_INFO(0, HEAP_TRACE_TASK, last_task_id));
+    return last_task_id;
+}
+
+/* Called inside the critical section, for outermost calls only */
+static void record(heap_trace_op_t op, void *ptr, size_t size, void *caller)
+{
+    if(stream_task != NULL && !esp_in_isr && xTaskGetCurrentTaskHandle() == stream_task) {
+        return;
+    }
+    uint32_t now = sdk_system_get_time();
+    if(lost && ring_head - ring_tail < HEAP_TRACE_RECORDS - 1) {
+        if(ring_put(0, 0, now, HEAP_TRACE_INFO(lost, HEAP_TRACE_LOST, 0))) {
+            lost = 0;
+        }
+    }
+    uint8_t task = current_task_id();
+    ring_put((uint32_t)ptr, (uint32_t)caller, now, HEAP_TRACE_INFO(size, op, task));
+}
+
+/* Each wrapper runs the real function inside a critical section so nested
+   calls (pvPortMalloc -> slab_malloc -> malloc) can be recognised and
+   only the outermost one recorded. */
+#define TRACE_BEGIN()                                   \
+    if(!active) goto untraced;                          \
+    taskENTER_CRITICAL();                               \
+    bool outer = (depth++ == 0)
+
+#define TRACE_END()                                     \
+    depth--;                                            \
+    taskEXIT_CRITICAL()
+
+static inline void *trace_alloc(void *ptr, size_t size, void *caller, bool outer)
+{
+    if(outer) {
+        record(ptr ? HEAP_TRACE_ALLOC : HEAP_TRACE_FAIL, ptr, size, caller);
+    }
+    return ptr;
+}
+
+static inline void *trace_realloc(void *old, void *ptr, size_t size, void *caller, bool outer)
+{
+    if(outer) {
+        if(ptr == NULL && size != 0) {
+            record(HEAP_TRACE_FAIL, old, size, caller);
+        } else {
+            if(old != NULL) {
+                record(HEAP_TRACE_FREE, old, 0, caller);
+            }
+            if(ptr != NULL) {
+                record(HEAP_TRACE_ALLOC, ptr, size, caller);
+            }
+        }
+    }
+    return ptr;
+}
+
+#define WRAP_ALLOC(name, args, real_args, size_expr)                    \
+    void *__wrap_##name args                                            \
+    {                                                                   \
+        void *caller = __builtin_return_address(0);                     \
+        TRACE_BEGIN();                                                  \
+        void *ptr = trace_alloc(__real_##name real_args, size_expr, caller, outer); \
+        TRACE_END();                                                    \
+        return ptr;                                                     \
+    untraced:                                                           \
+        return __real_##name real_args;                                 \
+    }
+
+#define WRAP_FREE(name)                                                 \
+    void __wrap_##name(void *ptr)                                       \
+    {                                                                   \
+        void *caller = __builtin_return_address(0);                     \
+        TRACE_BEGIN();                                                  \
+        __real_##name(ptr);                                             \
+        if(outer && ptr != NULL) {                                      \
+            record(HEAP_TRACE_FREE, ptr, 0, caller);                    \
+        }                                                               \
+        TRACE_END();                                                    \
+        return;                                                         \
+    untraced:                                                           \
+        __real_##name(ptr);                                             \
+    }
+
+#define WRAP_REALLOC(name)                                              \
+    void *__wrap_##name(void *old, size_t size)                         \
+    {                                                                   \
+        void *caller = __builtin_return_address(0);                     \
+        TRACE_BEGIN();                                                  \
+        void *ptr = trace_realloc(old, __real_##name(old, size), size, caller, outer); \
+        TRACE_END();                                                    \
+        return ptr;                                                     \
+    untraced:                                                           \
+        return __real_##name(old, size);                                \
+    }
+
+WRAP_ALLOC(malloc, (size_t size), (size), size)
+WRAP_ALLOC(calloc, (size_t nmemb, size_t size), (nmemb, size), nmemb * size)
+WRAP_ALLOC(zalloc, (size_t size), (size), size)
+WRAP_ALLOC(slab_malloc, (size_t size), (size), size)
+WRAP_ALLOC(slab_calloc, (size_t nmemb, size_t size), (nmemb, size), nmemb * size)
+WRAP_ALLOC(pvPortMalloc, (size_t size), (size), size)
+WRAP_REALLOC(slab_realloc)
+WRAP_FREE(slab_free)
+WRAP_FREE(vPortFree)
+
+void heap_trace_start(heap_trace_mode_t mode)
+{
+    taskENTER_CRITICAL();
+    ring_head = ring_tail = 0;
+    lost = 0;
+    n_tasks = 0;
+    last_task_id = 0;
+    trace_mode = mode;
+    active = true;
+    taskEXIT_CRITICAL();
+}
+
+void heap_trace_stop(void)
+{
+    active = false;
+}
+
+int heap_trace_read(heap_trace_record_t *records, int max)
+{
+    int n = 0;
+    taskENTER_CRITICAL();
+    while(n < max && ring_tail != ring_head) {
+        records[n++] = ring[ring_tail % HEAP_TRACE_RECORDS];
+        ring_tail++;
+    }
+    taskEXIT_CRITICAL();
+    return n;
+}
+
+static void print_record(const heap_trace_record_t *r)
+{
+    printf("HT:%08x%08x%08x%08x\n", r->ptr, r->caller, r->time, r->info);
+}
+
+void heap_trace_dump(void)
+{
+    uint32_t head = ring_head;
+    for(uint32_t i = ring_tail; i != head; i++) {
+        print_record(&ring[i % HEAP_TRACE_RECORDS]);
+    }
+    if(lost) {
+        printf("HT: %u records lost\n", lost);
+    }
+}
+
+static void stream_uart_task(void *pvParameters)
+{
+    heap_trace_record_t batch[STREAM_BATCH];
+    while(1) {
+        int n = heap_trace_read(batch, STREAM_BATCH);
+        for(int i = 0; i < n; i++) {
+            print_record(&batch[i]);
+        }
+        if(n < STREAM_BATCH) {
+            vTaskDelay(10 / portTICK_PERIOD_MS);
+        }
+    }
+}
+
+bool heap_trace_stream_uart(void)
+{
+    if(stream_task != NULL) {
+        return false;
+    }
+    if(xTaskCreate(stream_uart_task, "heap_trace", 256, NULL, 1, &stream_task) != pdPASS) {
+        return false;
+    }
+    heap_trace_start(HEAP_TRACE_STREAM);
+    return true;
+}
+
+static void stream_tcp_task(void *pvParameters)
+{
+    uint16_t port = (uint32_t)pvParameters;
+    heap_trace_record_t batch[STREAM_BATCH];
+    struct sockaddr_in addr;
+    int listener;
+
+    listener = lwip_socket(AF_INET, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if(listener < 0 || lwip_bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0
+       || lwip_listen(listener, 1) < 0) {
+        printf("heap_trace: can't listen on port %u\n", port);
+        stream_task = NULL;
+        vTaskDelete(NULL);
+    }
+
+    while(1) {
+        int s = lwip_accept(listener, NULL, NULL);
+        if(s < 0) {
+            continue;
+        }
+        heap_trace_start(HEAP_TRACE_STREAM);
+        if(lwip_write(s, "HTR1", 4) == 4) {
+            while(1) {
+                int n = heap_trace_read(batch, STREAM_BATCH);
+                if(n == 0) {
+                    vTaskDelay(10 / portTICK_PERIOD_MS);
+                    continue;
+                }
+                if(lwip_write(s, batch, n * sizeof(heap_trace_record_t)) < 0) {
+                    break;
+                }
+            }
+        }
+        heap_trace_stop();
+        lwip_close(s);
+    }
+}
+
+bool heap_trace_stream_tcp(uint16_t port)
+{
+    if(stream_task != NULL) {
+        return false;
+    }
+    return xTaskCreate(stream_tcp_task, "heap_trace", 384, (void *)(uint32_t)port,
+                       1, &stream_task) == pdPASS;
+}
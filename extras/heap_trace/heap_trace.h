@@ -0,0 +1,98 @@
+/* Heap allocation tracer
+ *
+ * Adding this component to a program wraps malloc, calloc, zalloc, the
+ * slab allocator (used by lwIP, and by free() and realloc(), see slab.h)
+ * and pvPortMalloc/vPortFree (used by FreeRTOS and the binary SDK
+ * libraries) at link time. While tracing is running, each allocation and free is
+ * stored as a 16 byte record (pointer, caller PC, size, task, timestamp)
+ * in a RAM ring buffer.
+ *
+ * Records can be streamed to a host as "HT:" hex lines on the console
+ * UART (they can be mixed with normal output) or as raw binary over a TCP
+ * connection, and are also printed after a crash by dump_heapinfo().
+ * utils/heap_trace.py turns a capture into per-callsite live/peak usage,
+ * per-task totals and a heap fragmentation map.
+ *
+ * Only the outermost call is recorded, so for example pvPortMalloc()
+ * passing a large block on to malloc() is one record. newlib's internal
+ * _malloc_r() calls (stdio buffers etc.) are not traced.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _HEAP_TRACE_H
+#define _HEAP_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Ring buffer size in records (16 bytes each) */
+#ifndef HEAP_TRACE_RECORDS
+#define HEAP_TRACE_RECORDS 256
+#endif
+
+typedef enum {
+    HEAP_TRACE_ALLOC = 0,   /* ptr allocated, size bytes */
+    HEAP_TRACE_FREE  = 1,   /* ptr freed */
+    HEAP_TRACE_FAIL  = 2,   /* allocation of size bytes failed */
+    HEAP_TRACE_TASK  = 3,   /* task id first seen, ptr/caller/time hold its name */
+    HEAP_TRACE_LOST  = 4,   /* size records were dropped as the ring was full */
+} heap_trace_op_t;
+
+/* info: size (20 bits) | op (3 bits) << 20 | task id (8 bits) << 23.
+   Task id 0 is an interrupt handler or code run before the scheduler. */
+typedef struct {
+    uint32_t ptr;
+    uint32_t caller;
+    uint32_t time;          /* sdk_system_get_time() microseconds */
+    uint32_t info;
+} heap_trace_record_t;
+
+#define HEAP_TRACE_INFO(size, op, task) (((size) & 0xfffff) | ((op) << 20) | ((uint32_t)(task) << 23))
+#define HEAP_TRACE_SIZE(info) ((info) & 0xfffff)
+#define HEAP_TRACE_OP(info) (((info) >> 20) & 0x7)
+#define HEAP_TRACE_TASK_ID(info) ((info) >> 23)
+
+typedef enum {
+    /* Keep the most recent HEAP_TRACE_RECORDS records, for inspection after
+       the fact (or a crash). */
+    HEAP_TRACE_OVERWRITE,
+    /* Keep records until they are read or streamed, dropping (and counting)
+       new records when the ring is full. */
+    HEAP_TRACE_STREAM,
+} heap_trace_mode_t;
+
+/* Start recording. Any records already in the buffer are discarded. */
+void heap_trace_start(heap_trace_mode_t mode);
+
+/* Stop recording. Records in the buffer can still be read. */
+void heap_trace_stop(void);
+
+/* Copy up to 'max' of the oldest records out of the ring buffer and
+   remove them. Returns the number of records copied. */
+int heap_trace_read(heap_trace_record_t *records, int max);
+
+/* Start a task that prints records to stdout as "HT:<32 hex digits>"
+   lines as they arrive. Starts tracing in HEAP_TRACE_STREAM mode. */
+bool heap_trace_stream_uart(void);
+
+/* Start a task that listens on TCP 'port' and sends records to the first
+   client that connects, as the 4 bytes "HTR1" then raw little endian
+   records. Starts tracing in HEAP_TRACE_STREAM mode once a client
+   connects. Allocations made by the streaming task itself aren't
+   traced. */
+bool heap_trace_stream_tcp(uint16_t port);
+
+/* Print every record still in the buffer as "HT:" lines, without
+   allocating or blocking. Called by dump_heapinfo() after a crash. */
+void heap_trace_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _HEAP_TRACE_H */
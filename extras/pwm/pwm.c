@@ -6,64 +6,110 @@
  * BSD Licensed as described in the file LICENSE
  */
 #include "pwm.h"
+#include "pwm_table.h"
 
 #include <espressif/esp_common.h>
 #include <espressif/sdk_private.h>
 #include <FreeRTOS.h>
+#include <task.h>
 #include <esp8266.h>
 
-typedef struct PWMPinDefinition
-{
-    uint8_t pin;
-    uint8_t divider;
-} PWMPin;
-
-typedef enum {
-    PERIOD_ON   = 0,
-    PERIOD_OFF  = 1
-} pwm_step_t;
-
-
 typedef struct pwmInfoDefinition
 {
     uint8_t running;
+    /* Timer running, false while all channels are constant */
+    bool ticking;
+    bool stagger;
 
     uint16_t freq;
-    uint16_t dutyCicle;
+    uint16_t duty[MAX_PWM_PINS];
 
     /* private */
     uint32_t _maxLoad;
-    uint32_t _onLoad;
-    uint32_t _offLoad;
-    pwm_step_t _step;
+    uint32_t _minStep;
+
+    /* The interrupt handler plays tables[active], and switches to the
+       other one at the start of a period if pending is set */
+    pwm_table_t tables[2];
+    volatile uint8_t active;
+    volatile bool pending;
+    uint8_t step;
 
     uint16_t usedPins;
-    PWMPin pins[8];
+    uint16_t masks[MAX_PWM_PINS];
 } PWMInfo;
 
-static PWMInfo pwmInfo;
+static PWMInfo pwmInfo = { .stagger = true };
 
-static void frc1_interrupt_handler(void)
+static void IRAM frc1_interrupt_handler(void)
 {
-    uint8_t i = 0;
-    bool out = true;
-    uint32_t load = pwmInfo._onLoad;
-    pwm_step_t step = PERIOD_ON;
+    if (pwmInfo.step == 0 && pwmInfo.pending)
+    {
+        pwmInfo.active ^= 1;
+        pwmInfo.pending = false;
+    }
+
+    const pwm_table_t *t = &pwmInfo.tables[pwmInfo.active];
+    const pwm_step_t *s = &t->steps[pwmInfo.step];
+
+    /* Reload first, so the time taken here doesn't add to the period */
+    timer_set_load(FRC1, s->ticks);
+    GPIO.OUT_SET = s->set;
+    GPIO.OUT_CLEAR = s->clear;
+
+    if (++pwmInfo.step == t->nsteps)
+    {
+        pwmInfo.step = 0;
+    }
+}
+
+static void pwm_timer_stop(void)
+{
+    timer_set_interrupts(FRC1, false);
+    timer_set_run(FRC1, false);
+    pwmInfo.ticking = false;
+    pwmInfo.pending = false;
+}
+
+/* Rebuild the table for the current duty cycles and hand it over to the
+   interrupt handler, or write the levels if nothing switches */
+static void pwm_update(void)
+{
+    pwm_table_t table;
 
-    if (pwmInfo._step == PERIOD_ON)
+    if (!pwmInfo.running)
     {
-        out = false;
-        load = pwmInfo._offLoad;
-        step = PERIOD_OFF;
+        return;
     }
+    pwm_table_build(&table, pwmInfo._maxLoad, pwmInfo._minStep,
+                    pwmInfo.usedPins, pwmInfo.masks, pwmInfo.duty, pwmInfo.stagger);
 
-    for (; i < pwmInfo.usedPins; ++i)
+    if (table.nsteps == 1)
     {
-        gpio_write(pwmInfo.pins[i].pin, out);
+        // Constant output, no need for the timer
+        pwm_timer_stop();
+        GPIO.OUT_SET = table.steps[0].set;
+        GPIO.OUT_CLEAR = table.steps[0].clear;
+        return;
+    }
+
+    if (!pwmInfo.ticking)
+    {
+        pwmInfo.tables[pwmInfo.active] = table;
+        pwmInfo.step = 0;
+        frc1_interrupt_handler();
+
+        timer_set_reload(FRC1, false);
+        timer_set_interrupts(FRC1, true);
+        timer_set_run(FRC1, true);
+        pwmInfo.ticking = true;
+        return;
     }
 
-    timer_set_load(FRC1, load);
-    pwmInfo._step = step;
+    taskENTER_CRITICAL();
+    pwmInfo.tables[pwmInfo.active ^ 1] = table;
+    pwmInfo.pending = true;
+    taskEXIT_CRITICAL();
 }
 
 void pwm_init(uint8_t npins, uint8_t* pins)
@@ -75,32 +121,33 @@ void pwm_init(uint8_t npins, uint8_t* pins)
         return;
     }
 
-    /* Initialize */
-    pwmInfo._maxLoad = 0;
-    pwmInfo._onLoad = 0;
-    pwmInfo._offLoad = 0;
-    pwmInfo._step = PERIOD_ON;
+    uint8_t i = 0;
+    for (; i < npins; ++i)
+    {
+        if (pins[i] > 15)
+        {
+            printf("Incorrect PWM pin (%d)\n", pins[i]);
+            return;
+        }
+    }
+
+    /* Stop timers and mask interrupts */
+    pwm_stop();
 
     /* Save pins information */
     pwmInfo.usedPins = npins;
 
-    uint8_t i = 0;
-    for (; i < npins; ++i)
+    for (i = 0; i < npins; ++i)
     {
-        pwmInfo.pins[i].pin = pins[i];
+        pwmInfo.masks[i] = BIT(pins[i]);
+        pwmInfo.duty[i] = 0;
 
         /* configure GPIOs */
         gpio_enable(pins[i], GPIO_OUTPUT);
     }
 
-    /* Stop timers and mask interrupts */
-    pwm_stop();
-
     /* set up ISRs */
     _xt_isr_attach(INUM_TIMER_FRC1, frc1_interrupt_handler);
-
-    /* Flag not running */
-    pwmInfo.running = 0;
 }
 
 void pwm_set_freq(uint16_t freq)
@@ -108,16 +155,18 @@ void pwm_set_freq(uint16_t freq)
     pwmInfo.freq = freq;
 
     /* Stop now to avoid load being used */
-    if (pwmInfo.running)
-    {
-        pwm_stop();
-        pwmInfo.running = 1;
-    }
+    bool running = pwmInfo.running;
+    pwm_stop();
 
     timer_set_frequency(FRC1, freq);
     pwmInfo._maxLoad = timer_get_load(FRC1);
+    pwmInfo._minStep = (uint64_t)pwmInfo._maxLoad * freq * PWM_MIN_STEP_US / 1000000;
+    if (pwmInfo._minStep == 0)
+    {
+        pwmInfo._minStep = 1;
+    }
 
-    if (pwmInfo.running)
+    if (running)
     {
         pwm_start();
     }
@@ -125,22 +174,36 @@ void pwm_set_freq(uint16_t freq)
 
 void pwm_set_duty(uint16_t duty)
 {
-    bool output;
+    for (uint8_t i = 0; i < pwmInfo.usedPins; ++i)
+    {
+        pwmInfo.duty[i] = duty;
+    }
+    pwm_update();
+}
 
-    pwmInfo.dutyCicle = duty;
-    if (duty > 0 && duty < UINT16_MAX) {
-        pwm_restart();
-	return;
+void pwm_set_channel_duty(uint8_t channel, uint16_t duty)
+{
+    if (channel >= pwmInfo.usedPins)
+    {
+        return;
     }
+    pwmInfo.duty[channel] = duty;
+    pwm_update();
+}
 
-    // 0% and 100% duty cycle are special cases: constant output.
-    pwm_stop();
-    pwmInfo.running = 1;
-    output = (duty == UINT16_MAX);
+void pwm_set_duties(const uint16_t *duty)
+{
     for (uint8_t i = 0; i < pwmInfo.usedPins; ++i)
     {
-	gpio_write(pwmInfo.pins[i].pin, output);
+        pwmInfo.duty[i] = duty[i];
     }
+    pwm_update();
+}
+
+void pwm_set_stagger(bool stagger)
+{
+    pwmInfo.stagger = stagger;
+    pwm_update();
 }
 
 void pwm_restart()
@@ -154,28 +217,12 @@ void pwm_restart()
 
 void pwm_start()
 {
-    pwmInfo._onLoad = pwmInfo.dutyCicle * pwmInfo._maxLoad / UINT16_MAX;
-    pwmInfo._offLoad = pwmInfo._maxLoad - pwmInfo._onLoad;
-    pwmInfo._step = PERIOD_ON;
-
-    // Trigger ON
-    uint8_t i = 0;
-    for (; i < pwmInfo.usedPins; ++i)
-    {
-        gpio_write(pwmInfo.pins[i].pin, true);
-    }
-
-    timer_set_load(FRC1, pwmInfo._onLoad);
-    timer_set_reload(FRC1, false);
-    timer_set_interrupts(FRC1, true);
-    timer_set_run(FRC1, true);
-
     pwmInfo.running = 1;
+    pwm_update();
 }
 
 void pwm_stop()
 {
-    timer_set_interrupts(FRC1, false);
-    timer_set_run(FRC1, false);
+    pwm_timer_stop();
     pwmInfo.running = 0;
 }
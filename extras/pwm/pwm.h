@@ -1,4 +1,10 @@
 /* Implementation of PWM support for the Espressif SDK.
+ *
+ * Each pin is a channel with its own duty cycle, all at the same
+ * frequency. The channels are staggered over the period so they don't
+ * all switch at once, and edges of channels that do coincide are written
+ * to the GPIOs together. Duty changes take effect at the start of the
+ * next period. See pwm_table.h for the limits on very short pulses.
  *
  * Part of esp-open-rtos
  * Copyright (C) 2015 Guillem Pascual Ginovart (https://github.com/gpascualg)
@@ -9,16 +15,31 @@
 #define EXTRAS_PWM_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #define MAX_PWM_PINS    8
 
+/* Shortest time between two output changes, in us. The interrupt
+   handler has to finish in between. */
+#ifndef PWM_MIN_STEP_US
+#define PWM_MIN_STEP_US 4
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Use GPIOs pins[0..npins-1] (0..15) as channels 0..npins-1 */
 void pwm_init(uint8_t npins, uint8_t* pins);
 void pwm_set_freq(uint16_t freq);
+/* Set the duty cycle of all channels, 0 is off, UINT16_MAX on */
 void pwm_set_duty(uint16_t duty);
+/* Set the duty cycle of one channel */
+void pwm_set_channel_duty(uint8_t channel, uint16_t duty);
+/* Set the duty cycle of every channel at once, duty[0..npins-1] */
+void pwm_set_duties(const uint16_t *duty);
+/* Switch all channels in phase (false) or staggered (true, the default) */
+void pwm_set_stagger(bool stagger);
 
 void pwm_restart();
 void pwm_start();
@@ -0,0 +1,161 @@
+/* Edge tables for extras/pwm
+ *
+ * A table describes one PWM period as a list of steps. Each step sets and
+ * clears the GPIO masks given, then waits 'ticks' timer ticks for the
+ * next one. Step 0 is at the start of the period and writes the level of
+ * every channel, so a new table can take over from the old one there
+ * without glitches. The other steps only have the channels that change.
+ * Edges of different channels that fall at the same time share a step.
+ *
+ * Channel c of n is turned on 'c * period / n' into the period when the
+ * channels are staggered, so they don't all switch at once. Steps are
+ * kept at least 'min_step' ticks apart, for the time the interrupt
+ * handler needs. An edge that would come sooner moves to the step before
+ * it, which can make a pulse up to min_step ticks longer or shorter.
+ * Pulses or gaps shorter than that disappear.
+ *
+ * No dependencies beyond the C library, extras/pwm/tests builds it on a
+ * host.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef EXTRAS_PWM_TABLE_H_
+#define EXTRAS_PWM_TABLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef MAX_PWM_PINS
+#define MAX_PWM_PINS    8
+#endif
+
+#define PWM_TABLE_STEPS (2 * MAX_PWM_PINS + 1)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+    uint32_t ticks;             /* Until the next step */
+    uint16_t set;               /* GPIOs to set high */
+    uint16_t clear;             /* GPIOs to set low */
+} pwm_step_t;
+
+typedef struct
+{
+    uint8_t nsteps;
+    pwm_step_t steps[PWM_TABLE_STEPS];
+} pwm_table_t;
+
+/* Build the table for 'n' channels, driving the GPIOs in masks[] with
+   duty[] (0 is always off, UINT16_MAX always on) and a period of 'period'
+   timer ticks. */
+static inline void pwm_table_build(pwm_table_t *t, uint32_t period, uint32_t min_step,
+                                   uint8_t n, const uint16_t *masks, const uint16_t *duty,
+                                   bool stagger)
+{
+    struct {
+        uint32_t at;
+        uint16_t mask;
+        bool on;
+    } edges[2 * MAX_PWM_PINS];
+    uint8_t nedges = 0;
+    uint16_t high = 0, all = 0;
+
+    for (uint8_t c = 0; c < n; c++) {
+        uint32_t on = (uint64_t)duty[c] * period / UINT16_MAX;
+        uint32_t phase = stagger ? (uint64_t)c * period / n : 0;
+        uint32_t off = phase + on;
+
+        all |= masks[c];
+        if (on == period || (on && (phase == 0 || off > period))) {
+            high |= masks[c];
+        }
+        if (on == 0 || on == period) {
+            continue;
+        }
+        if (off >= period) {
+            off -= period;
+        }
+        /* Edges at 0 are taken care of by the levels of step 0 */
+        if (phase) {
+            edges[nedges].at = phase;
+            edges[nedges].mask = masks[c];
+            edges[nedges++].on = true;
+        }
+        if (off) {
+            edges[nedges].at = off;
+            edges[nedges].mask = masks[c];
+            edges[nedges++].on = false;
+        }
+    }
+
+    /* Insertion sort, there are only a few */
+    for (uint8_t i = 1; i < nedges; i++) {
+        for (uint8_t j = i; j > 0 && edges[j - 1].at > edges[j].at; j--) {
+            __typeof__(edges[0]) e = edges[j];
+            edges[j] = edges[j - 1];
+            edges[j - 1] = e;
+        }
+    }
+
+    pwm_step_t *s = &t->steps[0];
+    uint32_t at = 0;
+    s->set = high;
+    s->clear = all & ~high;
+    for (uint8_t i = 0; i < nedges; i++) {
+        /* Too close to the end of the period, step 0 writes the level */
+        if (edges[i].at + min_step > period) {
+            break;
+        }
+        if (edges[i].at >= at + min_step) {
+            s->ticks = edges[i].at - at;
+            at = edges[i].at;
+            s++;
+            s->set = s->clear = 0;
+        }
+        /* Step 0 writes levels, other steps only changes. There an edge
+           moved into a step changing the same channel cancels it. */
+        if (s == &t->steps[0]) {
+            if (edges[i].on) {
+                s->set |= edges[i].mask;
+                s->clear &= ~edges[i].mask;
+            } else {
+                s->clear |= edges[i].mask;
+                s->set &= ~edges[i].mask;
+            }
+        } else if (edges[i].on) {
+            if (s->clear & edges[i].mask) {
+                s->clear &= ~edges[i].mask;
+            } else {
+                s->set |= edges[i].mask;
+            }
+        } else {
+            if (s->set & edges[i].mask) {
+                s->set &= ~edges[i].mask;
+            } else {
+                s->clear |= edges[i].mask;
+            }
+        }
+    }
+    s->ticks = period - at;
+
+    /* Drop steps left with nothing to do */
+    pwm_step_t *last = &t->steps[0];
+    for (pwm_step_t *p = &t->steps[1]; p <= s; p++) {
+        if (p->set | p->clear) {
+            *++last = *p;
+        } else {
+            last->ticks += p->ticks;
+        }
+    }
+    t->nsteps = last - &t->steps[0] + 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EXTRAS_PWM_TABLE_H_ */
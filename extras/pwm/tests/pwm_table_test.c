@@ -0,0 +1,210 @@
+/* Host unit tests for pwm_table.h: plays the tables over a period and
+ * checks the time each channel is on, plus the time a table build takes.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "pwm_table.h"
+#include "check.h"
+
+/* 1 kHz at 80 MHz / 16, 4 us steps */
+#define PERIOD   5000
+#define MIN_STEP 20
+
+static const uint16_t masks[MAX_PWM_PINS] = {
+    1 << 0, 1 << 2, 1 << 4, 1 << 5, 1 << 12, 1 << 13, 1 << 14, 1 << 15
+};
+
+/* Check the steps are sane, and return the ticks each channel is on */
+static void play(const pwm_table_t *t, uint8_t n, uint32_t *on)
+{
+    uint32_t total = 0;
+    uint16_t level = 0;
+
+    CHECK(t->nsteps >= 1 && t->nsteps <= PWM_TABLE_STEPS);
+    for (uint8_t c = 0; c < n; c++) {
+        on[c] = 0;
+    }
+    for (uint8_t i = 0; i < t->nsteps; i++) {
+        const pwm_step_t *s = &t->steps[i];
+        CHECK((s->set & s->clear) == 0);
+        CHECK(s->ticks >= MIN_STEP);
+        if (i > 0) {
+            CHECK(s->set | s->clear);
+            /* Only changes after step 0 */
+            CHECK((s->set & level) == 0 && (s->clear & ~level) == 0);
+        }
+        level = (level | s->set) & ~s->clear;
+        for (uint8_t c = 0; c < n; c++) {
+            if (level & masks[c]) {
+                on[c] += s->ticks;
+            }
+        }
+        total += s->ticks;
+    }
+    CHECK(total == PERIOD);
+}
+
+static uint32_t expected(uint16_t duty)
+{
+    return (uint64_t)duty * PERIOD / UINT16_MAX;
+}
+
+static void test_constant(void)
+{
+    pwm_table_t t;
+    uint16_t duty[3] = { 0, UINT16_MAX, 0 };
+    uint32_t on[3];
+
+    pwm_table_build(&t, PERIOD, MIN_STEP, 3, masks, duty, true);
+    CHECK(t.nsteps == 1);
+    CHECK(t.steps[0].set == masks[1]);
+    CHECK(t.steps[0].clear == (masks[0] | masks[2]));
+    play(&t, 3, on);
+    CHECK(on[0] == 0 && on[1] == PERIOD && on[2] == 0);
+}
+
+static void test_stagger(void)
+{
+    pwm_table_t t;
+    uint16_t duty[4] = { 16384, 16384, 16384, 16384 };
+    uint32_t on[4];
+
+    /* In phase all channels switch together */
+    pwm_table_build(&t, PERIOD, MIN_STEP, 4, masks, duty, false);
+    CHECK(t.nsteps == 2);
+    CHECK(t.steps[1].clear == (masks[0] | masks[1] | masks[2] | masks[3]));
+
+    /* Staggered, each channel takes over from the one before */
+    pwm_table_build(&t, PERIOD, MIN_STEP, 4, masks, duty, true);
+    CHECK(t.nsteps == 4);
+    for (uint8_t i = 1; i < 4; i++) {
+        CHECK(t.steps[i].set == masks[i] && t.steps[i].clear == masks[i - 1]);
+    }
+    play(&t, 4, on);
+    for (uint8_t c = 0; c < 4; c++) {
+        CHECK(on[c] == PERIOD / 4);
+    }
+
+    /* 50% on two channels, the second wraps around the period */
+    duty[0] = duty[1] = 32768;
+    pwm_table_build(&t, PERIOD, MIN_STEP, 2, masks, duty, true);
+    CHECK(t.nsteps == 2);
+    CHECK(t.steps[0].set == masks[0] && t.steps[0].clear == masks[1]);
+    CHECK(t.steps[0].ticks == PERIOD / 2);
+    CHECK(t.steps[1].set == masks[1] && t.steps[1].clear == masks[0]);
+}
+
+static void test_short_pulses(void)
+{
+    pwm_table_t t;
+    uint16_t duty[2];
+    uint32_t on[2];
+
+    /* A pulse shorter than a step disappears */
+    duty[0] = UINT16_MAX * (MIN_STEP / 2) / PERIOD;
+    pwm_table_build(&t, PERIOD, MIN_STEP, 1, masks, duty, false);
+    CHECK(t.nsteps == 1 && t.steps[0].clear == masks[0]);
+
+    /* and so does a gap */
+    duty[0] = UINT16_MAX - duty[0];
+    pwm_table_build(&t, PERIOD, MIN_STEP, 1, masks, duty, false);
+    CHECK(t.nsteps == 1 && t.steps[0].set == masks[0]);
+
+    /* Both edges of the second channel fall in the step that turns the
+       first one off, so that step only does that */
+    duty[0] = 32768;
+    duty[1] = UINT16_MAX * (MIN_STEP / 2) / PERIOD;
+    pwm_table_build(&t, PERIOD, MIN_STEP, 2, masks, duty, true);
+    CHECK(t.nsteps == 2);
+    CHECK(t.steps[1].set == 0 && t.steps[1].clear == masks[0]);
+    play(&t, 2, on);
+    CHECK(on[1] == 0);
+
+    /* Edges a little further apart keep their own steps */
+    duty[1] = UINT16_MAX * (3 * MIN_STEP) / PERIOD;
+    pwm_table_build(&t, PERIOD, MIN_STEP, 2, masks, duty, true);
+    CHECK(t.nsteps == 3);
+    play(&t, 2, on);
+    CHECK(on[1] + 1 >= expected(duty[1]) && on[1] <= expected(duty[1]) + 1);
+}
+
+static uint32_t lcg = 12345;
+
+static uint32_t rnd(uint32_t n)
+{
+    lcg = lcg * 1103515245 + 12345;
+    return (lcg >> 8) % n;
+}
+
+static uint16_t rnd_duty(void)
+{
+    switch (rnd(8)) {
+    case 0: return 0;
+    case 1: return UINT16_MAX;
+    case 2: return rnd(UINT16_MAX / 100);
+    case 3: return UINT16_MAX - rnd(UINT16_MAX / 100);
+    default: return rnd(UINT16_MAX + 1);
+    }
+}
+
+/* Any duty cycles: the on time is off by less than two steps, for the
+   edges at each end of the pulse */
+static void test_random(void)
+{
+    pwm_table_t t;
+    uint16_t duty[MAX_PWM_PINS];
+    uint32_t on[MAX_PWM_PINS];
+
+    for (int i = 0; i < 100000; i++) {
+        uint8_t n = 1 + rnd(MAX_PWM_PINS);
+        bool stagger = rnd(2);
+        for (uint8_t c = 0; c < n; c++) {
+            duty[c] = rnd_duty();
+        }
+        pwm_table_build(&t, PERIOD, MIN_STEP, n, masks, duty, stagger);
+        play(&t, n, on);
+        for (uint8_t c = 0; c < n; c++) {
+            uint32_t e = expected(duty[c]);
+            CHECK(on[c] + 2 * MIN_STEP > e && on[c] < e + 2 * MIN_STEP);
+        }
+        if (failures) {
+            return;
+        }
+    }
+}
+
+static void bench(void)
+{
+    static pwm_table_t t;
+    uint16_t duty[MAX_PWM_PINS];
+    struct timespec start, end;
+    const int runs = 1000000;
+
+    for (uint8_t c = 0; c < MAX_PWM_PINS; c++) {
+        duty[c] = rnd(UINT16_MAX);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < runs; i++) {
+        duty[i & 7] += 257;
+        pwm_table_build(&t, PERIOD, MIN_STEP, MAX_PWM_PINS, masks, duty, true);
+        __asm__ volatile("" : : "g"(&t) : "memory");
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    printf("pwm_table_build, %d channels: %.0f ns\n", MAX_PWM_PINS, ns / runs);
+}
+
+int main(void)
+{
+    test_constant();
+    test_stagger();
+    test_short_pulses();
+    test_random();
+    bench();
+
+    return check_done("pwm_table");
+}
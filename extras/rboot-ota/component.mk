@@ -4,7 +4,12 @@
 # when just including rboot-api.h :(
 INC_DIRS += $(rboot-ota_ROOT) $(ROOT)bootloader $(ROOT)bootloader/rboot
 
+# Set to 1 to allow HTTPS downloads in ota-http.c (program must also
+# include the extras/mbedtls component)
+OTA_HTTP_TLS ?= 0
+
+rboot-ota_CFLAGS = $(CFLAGS) -DOTA_HTTP_TLS=$(OTA_HTTP_TLS)
+
 rboot-ota_SRC_DIR =  $(rboot-ota_ROOT)
 
 $(eval $(call component_compile_rules,rboot-ota))
-
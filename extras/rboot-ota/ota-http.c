@@ -0,0 +1,593 @@
+/* HTTP(S) pull OTA support
+ *
+ * For details of use see ota-http.h
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <FreeRTOS.h>
+#include <task.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include "lwip/netdb.h"
+
+#include <espressif/spi_flash.h>
+#include <sysparam.h>
+
+#include "ota-http.h"
+#include "rboot-api.h"
+
+#ifndef OTA_HTTP_TLS
+#define OTA_HTTP_TLS 0
+#endif
+
+#if OTA_HTTP_TLS
+#include "mbedtls/config.h"
+#include "mbedtls/net.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#endif
+
+#define MAX_IMAGE_SIZE 0x100000 /*1MB images max at the moment */
+
+/* Size of the receive buffer, also the longest response header line we can
+   parse. Allocated from the heap for the duration of each connection. */
+#define OTA_HTTP_BUF_SIZE 1024
+
+#define OTA_HTTP_DEFAULT_TIMEOUT 10000
+#define OTA_HTTP_RETRY_DELAY_MS 2000
+
+/* Save download progress to sysparam once every this many sectors. Each save
+   is a small sysparam write, so 1 gives the finest resume granularity. */
+#ifndef OTA_HTTP_SAVE_SECTORS
+#define OTA_HTTP_SAVE_SECTORS 1
+#endif
+
+#define MAX_ETAG_LEN 64
+
+/* sysparam keys holding resume state */
+#define KEY_SOURCE "ota_http.src"
+#define KEY_ETAG   "ota_http.etag"
+#define KEY_LENGTH "ota_http.len"
+#define KEY_OFFSET "ota_http.offs"
+
+typedef struct {
+    uint32_t offset;      /* Bytes of the image known to be in flash (sector aligned) */
+    uint32_t total_len;   /* Full image length, 0 if not known yet */
+    char etag[MAX_ETAG_LEN];
+} ota_http_progress_t;
+
+typedef struct {
+    int fd;
+#if OTA_HTTP_TLS
+    struct ota_http_tls *tls;
+#endif
+} http_conn_t;
+
+#if OTA_HTTP_TLS
+struct ota_http_tls {
+    mbedtls_net_context net_ctx;
+    mbedtls_ssl_context ssl_ctx;
+    mbedtls_ssl_config ssl_conf;
+    mbedtls_ctr_drbg_context drbg_ctx;
+    mbedtls_entropy_context entropy_ctx;
+    mbedtls_x509_crt ca_cert;
+};
+#endif
+
+static ota_http_result_t http_fetch(const ota_http_request_t *req, uint32_t slot_offs,
+                                    const char *source, ota_http_progress_t *progress,
+                                    ota_http_progress_cb progress_cb);
+
+/* Source identifier stored in sysparam so we only resume the same download */
+static char *make_source_id(const ota_http_request_t *req, int port, int ota_slot)
+{
+    size_t len = strlen(req->host) + strlen(req->path) + 24;
+    char *source = malloc(len);
+    if(source) {
+        snprintf(source, len, "%d|%s:%d%s", ota_slot, req->host, port, req->path);
+    }
+    return source;
+}
+
+static void load_progress(const char *source, ota_http_progress_t *progress)
+{
+    char *saved_source = NULL;
+    int32_t offset, total_len;
+
+    memset(progress, 0, sizeof(ota_http_progress_t));
+    if(sysparam_get_string(KEY_SOURCE, &saved_source) != SYSPARAM_OK) {
+        return;
+    }
+    bool same = !strcmp(saved_source, source);
+    free(saved_source);
+    if(!same
+       || sysparam_get_int32(KEY_OFFSET, &offset) != SYSPARAM_OK
+       || sysparam_get_int32(KEY_LENGTH, &total_len) != SYSPARAM_OK
+       || offset < 0 || offset % SECTOR_SIZE || offset > MAX_IMAGE_SIZE) {
+        return;
+    }
+    progress->offset = offset;
+    progress->total_len = total_len;
+    sysparam_get_data_static(KEY_ETAG, (uint8_t *)progress->etag,
+                             MAX_ETAG_LEN - 1, NULL, NULL);
+}
+
+static void start_progress(const char *source, const ota_http_progress_t *progress)
+{
+    /* Write offset first, so a stale source never pairs with a new offset */
+    sysparam_set_int32(KEY_OFFSET, 0);
+    sysparam_set_int32(KEY_LENGTH, progress->total_len);
+    sysparam_set_string(KEY_ETAG, progress->etag);
+    sysparam_set_string(KEY_SOURCE, source);
+}
+
+void ota_http_clear_progress(void)
+{
+    sysparam_set_data(KEY_SOURCE, NULL, 0, false);
+    sysparam_set_data(KEY_ETAG, NULL, 0, false);
+    sysparam_set_data(KEY_LENGTH, NULL, 0, false);
+    sysparam_set_data(KEY_OFFSET, NULL, 0, false);
+}
+
+ota_http_result_t ota_http_download(const ota_http_request_t *req, int ota_slot,
+                                    int max_attempts, ota_http_progress_cb progress_cb)
+{
+    rboot_config rboot_config = rboot_get_config();
+    /* Validate the OTA slot parameter */
+    if(ota_slot < 0 || rboot_config.current_rom == ota_slot || rboot_config.count <= ota_slot) {
+        return OTA_HTTP_ERR_SLOT;
+    }
+    uint32_t slot_offs = rboot_config.roms[ota_slot];
+
+#if !OTA_HTTP_TLS
+    if(req->use_tls) {
+        return OTA_HTTP_ERR_NOTLS;
+    }
+#endif
+
+    int port = req->port ? req->port : (req->use_tls ? 443 : 80);
+    char *source = make_source_id(req, port, ota_slot);
+    if(!source) {
+        return OTA_HTTP_ERR_NOMEM;
+    }
+
+    ota_http_progress_t progress;
+    load_progress(source, &progress);
+    if(progress.offset) {
+        printf("OTA HTTP: resuming %s at offset 0x%x\n", source, progress.offset);
+    }
+
+    ota_http_result_t res;
+    int attempt = 0;
+    while(1) {
+        res = http_fetch(req, slot_offs, source, &progress, progress_cb);
+        if(++attempt >= max_attempts) {
+            break;
+        }
+        /* Only transient network failures are worth another connection */
+        if(res != OTA_HTTP_ERR_DNS && res != OTA_HTTP_ERR_CONNECT && res != OTA_HTTP_ERR_IO) {
+            break;
+        }
+        printf("OTA HTTP: attempt %d failed (%d), retrying from 0x%x\n",
+               attempt, res, progress.offset);
+        vTaskDelay(OTA_HTTP_RETRY_DELAY_MS / portTICK_PERIOD_MS);
+    }
+
+    if(res == OTA_HTTP_OK || res == OTA_HTTP_ERR_VERIFY) {
+        /* Either done, or the flash contents are bad and resuming won't help */
+        ota_http_clear_progress();
+    }
+    free(source);
+    return res;
+}
+
+/* Transport: plain lwIP socket or TLS on top of it */
+
+static ota_http_result_t conn_open(http_conn_t *conn, const ota_http_request_t *req, int port)
+{
+    const struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *res;
+    char port_str[8];
+
+    conn->fd = -1;
+#if OTA_HTTP_TLS
+    conn->tls = NULL;
+#endif
+
+    snprintf(port_str, sizeof(port_str), "%d", port);
+    int err = getaddrinfo(req->host, port_str, &hints, &res);
+    if(err != 0 || res == NULL) {
+        if(res)
+            freeaddrinfo(res);
+        return OTA_HTTP_ERR_DNS;
+    }
+
+    conn->fd = socket(res->ai_family, res->ai_socktype, 0);
+    if(conn->fd < 0) {
+        freeaddrinfo(res);
+        return OTA_HTTP_ERR_NOMEM;
+    }
+
+    int timeout = req->timeout ? req->timeout : OTA_HTTP_DEFAULT_TIMEOUT;
+    setsockopt(conn->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(conn->fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    if(connect(conn->fd, res->ai_addr, res->ai_addrlen) != 0) {
+        freeaddrinfo(res);
+        return OTA_HTTP_ERR_CONNECT;
+    }
+    freeaddrinfo(res);
+
+#if OTA_HTTP_TLS
+    if(req->use_tls) {
+        struct ota_http_tls *tls = malloc(sizeof(struct ota_http_tls));
+        if(!tls) {
+            return OTA_HTTP_ERR_NOMEM;
+        }
+        conn->tls = tls;
+        mbedtls_net_init(&tls->net_ctx);
+        mbedtls_ssl_init(&tls->ssl_ctx);
+        mbedtls_ssl_config_init(&tls->ssl_conf);
+        mbedtls_x509_crt_init(&tls->ca_cert);
+        mbedtls_ctr_drbg_init(&tls->drbg_ctx);
+        mbedtls_entropy_init(&tls->entropy_ctx);
+        /* mbedtls reads/writes our already connected socket */
+        tls->net_ctx.fd = conn->fd;
+
+        const char *pers = "ota-http";
+        if(mbedtls_ctr_drbg_seed(&tls->drbg_ctx, mbedtls_entropy_func, &tls->entropy_ctx,
+                                 (const unsigned char *)pers, strlen(pers))
+           || mbedtls_ssl_config_defaults(&tls->ssl_conf, MBEDTLS_SSL_IS_CLIENT,
+                                          MBEDTLS_SSL_TRANSPORT_STREAM,
+                                          MBEDTLS_SSL_PRESET_DEFAULT)) {
+            return OTA_HTTP_ERR_CONNECT;
+        }
+
+        if(req->ca_cert) {
+            if(mbedtls_x509_crt_parse(&tls->ca_cert, (const unsigned char *)req->ca_cert,
+                                      strlen(req->ca_cert) + 1) < 0) {
+                return OTA_HTTP_ERR_CONNECT;
+            }
+            mbedtls_ssl_conf_ca_chain(&tls->ssl_conf, &tls->ca_cert, NULL);
+            mbedtls_ssl_conf_authmode(&tls->ssl_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+        } else {
+            mbedtls_ssl_conf_authmode(&tls->ssl_conf, MBEDTLS_SSL_VERIFY_NONE);
+        }
+        mbedtls_ssl_conf_rng(&tls->ssl_conf, mbedtls_ctr_drbg_random, &tls->drbg_ctx);
+
+        if(mbedtls_ssl_setup(&tls->ssl_ctx, &tls->ssl_conf)
+           || mbedtls_ssl_set_hostname(&tls->ssl_ctx, req->host)) {
+            return OTA_HTTP_ERR_CONNECT;
+        }
+        mbedtls_ssl_set_bio(&tls->ssl_ctx, &tls->net_ctx, mbedtls_net_send, mbedtls_net_recv, NULL);
+
+        int ret;
+        while((ret = mbedtls_ssl_handshake(&tls->ssl_ctx)) != 0) {
+            if(ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+                printf("OTA HTTP: TLS handshake failed -0x%x\n", -ret);
+                return OTA_HTTP_ERR_CONNECT;
+            }
+        }
+    }
+#endif
+    return OTA_HTTP_OK;
+}
+
+static void conn_close(http_conn_t *conn)
+{
+#if OTA_HTTP_TLS
+    if(conn->tls) {
+        mbedtls_ssl_close_notify(&conn->tls->ssl_ctx);
+        mbedtls_ssl_free(&conn->tls->ssl_ctx);
+        mbedtls_ssl_config_free(&conn->tls->ssl_conf);
+        mbedtls_ctr_drbg_free(&conn->tls->drbg_ctx);
+        mbedtls_entropy_free(&conn->tls->entropy_ctx);
+        mbedtls_x509_crt_free(&conn->tls->ca_cert);
+        free(conn->tls);
+        conn->tls = NULL;
+    }
+#endif
+    if(conn->fd >= 0) {
+        close(conn->fd);
+        conn->fd = -1;
+    }
+}
+
+/* Returns bytes read, 0 on orderly close, negative on error/timeout */
+static int conn_read(http_conn_t *conn, uint8_t *buf, size_t len)
+{
+#if OTA_HTTP_TLS
+    if(conn->tls) {
+        int r = mbedtls_ssl_read(&conn->tls->ssl_ctx, buf, len);
+        return (r == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) ? 0 : r;
+    }
+#endif
+    return read(conn->fd, buf, len);
+}
+
+static bool conn_write_all(http_conn_t *conn, const char *buf, size_t len)
+{
+    while(len) {
+        int w;
+#if OTA_HTTP_TLS
+        if(conn->tls) {
+            w = mbedtls_ssl_write(&conn->tls->ssl_ctx, (const unsigned char *)buf, len);
+        } else
+#endif
+        w = write(conn->fd, buf, len);
+        if(w <= 0) {
+            return false;
+        }
+        buf += w;
+        len -= w;
+    }
+    return true;
+}
+
+/* Response header parsing */
+
+typedef struct {
+    int status;
+    int32_t content_length;  /* -1 if not present */
+    int32_t range_start;     /* From Content-Range, -1 if not present */
+    int32_t range_total;     /* From Content-Range, -1 if unknown ("*") */
+    char etag[MAX_ETAG_LEN];
+} http_response_t;
+
+/* Parse one zero-terminated header line into 'resp'. Unknown headers are ignored. */
+static void parse_header_line(char *line, http_response_t *resp)
+{
+    char *value = strchr(line, ':');
+    if(!value) {
+        return;
+    }
+    *value++ = 0;
+    while(*value == ' ' || *value == '\t') {
+        value++;
+    }
+
+    if(!strcasecmp(line, "Content-Length")) {
+        resp->content_length = strtol(value, NULL, 10);
+    }
+    else if(!strcasecmp(line, "Content-Range")) {
+        /* bytes <start>-<end>/<total> */
+        if(strncasecmp(value, "bytes ", 6)) {
+            return;
+        }
+        resp->range_start = strtol(value + 6, NULL, 10);
+        char *total = strchr(value, '/');
+        if(total && total[1] != '*') {
+            resp->range_total = strtol(total + 1, NULL, 10);
+        }
+    }
+    else if(!strcasecmp(line, "ETag")) {
+        /* Only strong validators can be used with If-Range */
+        if(strncmp(value, "W/", 2) && strlen(value) < MAX_ETAG_LEN) {
+            strcpy(resp->etag, value);
+        }
+    }
+}
+
+/* Read and parse the status line and headers.
+
+   On success, the first '*body_len' bytes of 'buf' are the start of the
+   response body. */
+static ota_http_result_t read_response_header(http_conn_t *conn, uint8_t *buf, size_t buf_size,
+                                              http_response_t *resp, size_t *body_len)
+{
+    size_t len = 0;
+    bool status_line = true;
+
+    resp->status = 0;
+    resp->content_length = -1;
+    resp->range_start = -1;
+    resp->range_total = -1;
+    resp->etag[0] = 0;
+
+    while(1) {
+        /* Consume every complete line currently in the buffer */
+        char *eol;
+        while((eol = memchr(buf, '\n', len)) != NULL) {
+            size_t line_len = (uint8_t *)eol - buf + 1;
+            *eol = 0;
+            if(eol > (char *)buf && eol[-1] == '\r') {
+                eol[-1] = 0;
+            }
+            char *line = (char *)buf;
+
+            if(status_line) {
+                /* HTTP/1.x NNN Reason */
+                if(strncmp(line, "HTTP/1.", 7) || !strchr(line, ' ')) {
+                    return OTA_HTTP_ERR_HTTP;
+                }
+                resp->status = strtol(strchr(line, ' ') + 1, NULL, 10);
+                status_line = false;
+            }
+            else if(line[0] == 0) {
+                /* Blank line, end of headers */
+                len -= line_len;
+                memmove(buf, buf + line_len, len);
+                *body_len = len;
+                return OTA_HTTP_OK;
+            }
+            else {
+                parse_header_line(line, resp);
+            }
+            len -= line_len;
+            memmove(buf, buf + line_len, len);
+        }
+
+        if(len == buf_size) {
+            return OTA_HTTP_ERR_HTTP; /* header line too long */
+        }
+        int r = conn_read(conn, buf + len, buf_size - len);
+        if(r <= 0) {
+            return OTA_HTTP_ERR_IO;
+        }
+        len += r;
+    }
+}
+
+static ota_http_result_t http_fetch(const ota_http_request_t *req, uint32_t slot_offs,
+                                    const char *source, ota_http_progress_t *progress,
+                                    ota_http_progress_cb progress_cb)
+{
+    int port = req->port ? req->port : (req->use_tls ? 443 : 80);
+    http_conn_t conn;
+    ota_http_result_t res = conn_open(&conn, req, port);
+    if(res != OTA_HTTP_OK) {
+        conn_close(&conn);
+        return res;
+    }
+
+    uint8_t *buf = malloc(OTA_HTTP_BUF_SIZE);
+    if(!buf) {
+        conn_close(&conn);
+        return OTA_HTTP_ERR_NOMEM;
+    }
+
+    /* Build request. Range is only sent when resuming. */
+    int req_len = snprintf((char *)buf, OTA_HTTP_BUF_SIZE,
+                           "GET %s HTTP/1.1\r\n"
+                           "Host: %s\r\n"
+                           "User-Agent: esp-open-rtos\r\n"
+                           "Connection: close\r\n",
+                           req->path, req->host);
+    if(progress->offset) {
+        req_len += snprintf((char *)buf + req_len, OTA_HTTP_BUF_SIZE - req_len,
+                            "Range: bytes=%u-\r\n", progress->offset);
+        if(progress->etag[0]) {
+            req_len += snprintf((char *)buf + req_len, OTA_HTTP_BUF_SIZE - req_len,
+                                "If-Range: %s\r\n", progress->etag);
+        }
+    }
+    req_len += snprintf((char *)buf + req_len, OTA_HTTP_BUF_SIZE - req_len, "\r\n");
+    if(req_len >= OTA_HTTP_BUF_SIZE) {
+        res = OTA_HTTP_ERR_NOMEM;
+        goto out;
+    }
+    if(!conn_write_all(&conn, (char *)buf, req_len)) {
+        res = OTA_HTTP_ERR_IO;
+        goto out;
+    }
+
+    http_response_t resp;
+    size_t body_len;
+    res = read_response_header(&conn, buf, OTA_HTTP_BUF_SIZE, &resp, &body_len);
+    if(res != OTA_HTTP_OK) {
+        goto out;
+    }
+
+    uint32_t total_len;
+    if(resp.status == 206 && progress->offset
+       && resp.range_start == progress->offset) {
+        /* Server honoured the range, carry on where we left off */
+        total_len = resp.range_total > 0 ? resp.range_total : progress->total_len;
+    }
+    else if(resp.status == 200) {
+        /* New download, or the server ignored/rejected our range */
+        if(progress->offset) {
+            printf("OTA HTTP: server sent full image, restarting download\n");
+        }
+        progress->offset = 0;
+        progress->total_len = resp.content_length > 0 ? resp.content_length : 0;
+        strcpy(progress->etag, resp.etag);
+        start_progress(source, progress);
+        total_len = progress->total_len;
+    }
+    else {
+        printf("OTA HTTP: unexpected HTTP status %d\n", resp.status);
+        if(resp.status == 416) {
+            /* Our saved offset is past the end of whatever is there now */
+            ota_http_clear_progress();
+            progress->offset = 0;
+        }
+        res = OTA_HTTP_ERR_HTTP;
+        goto out;
+    }
+
+    if(total_len > MAX_IMAGE_SIZE) {
+        res = OTA_HTTP_ERR_TOO_BIG;
+        goto out;
+    }
+
+    /* rboot_write_init() erases sectors as they're reached, so restarting at
+       a sector boundary also discards anything after the last saved offset */
+    rboot_write_status ws = rboot_write_init(slot_offs + progress->offset);
+    uint32_t written = progress->offset;
+    uint32_t saved_sector = progress->offset / SECTOR_SIZE;
+
+    while(1) {
+        if(body_len) {
+            if(written + body_len > (total_len ? total_len : MAX_IMAGE_SIZE)) {
+                res = OTA_HTTP_ERR_TOO_BIG;
+                goto out;
+            }
+            if(!rboot_write_flash(&ws, buf, body_len)) {
+                res = OTA_HTTP_ERR_FLASH;
+                goto out;
+            }
+            written += body_len;
+
+            /* ws.start_addr is the first byte not yet written to flash */
+            uint32_t sector = (ws.start_addr - slot_offs) / SECTOR_SIZE;
+            if(sector >= saved_sector + OTA_HTTP_SAVE_SECTORS) {
+                saved_sector = sector;
+                progress->offset = sector * SECTOR_SIZE;
+                sysparam_set_int32(KEY_OFFSET, progress->offset);
+            }
+            if(progress_cb) {
+                progress_cb(written, total_len);
+            }
+        }
+
+        if(total_len && written == total_len) {
+            break;
+        }
+
+        int r = conn_read(&conn, buf, OTA_HTTP_BUF_SIZE);
+        if(r == 0 && !total_len) {
+            break; /* no length given, server closing marks the end */
+        }
+        if(r <= 0) {
+            res = OTA_HTTP_ERR_IO;
+            goto out;
+        }
+        body_len = r;
+    }
+
+    if(ws.extra_count) {
+        /* Flush a trailing partial word (valid images are padded, so this
+           will normally fail verification below anyway) */
+        uint8_t pad[4] = { 0xff, 0xff, 0xff, 0xff };
+        if(!rboot_write_flash(&ws, pad, 4 - ws.extra_count)) {
+            res = OTA_HTTP_ERR_FLASH;
+            goto out;
+        }
+    }
+
+    const char *err = "Unknown validation error";
+    uint32_t image_length;
+    if(!rboot_verify_image(slot_offs, &image_length, &err) || image_length != written) {
+        printf("OTA HTTP: image verify failed: %s\n", err);
+        res = OTA_HTTP_ERR_VERIFY;
+        goto out;
+    }
+    res = OTA_HTTP_OK;
+
+ out:
+    free(buf);
+    conn_close(&conn);
+    return res;
+}
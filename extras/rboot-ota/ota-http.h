@@ -0,0 +1,81 @@
+#ifndef _OTA_HTTP_H
+#define _OTA_HTTP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* HTTP(S) Pull OTA Support
+ *
+ * Downloads a firmware image from an HTTP/1.1 server into an rboot slot.
+ *
+ * The image body is streamed straight into flash via rboot_write_flash().
+ * Download progress is recorded in sysparam every time a flash sector has
+ * been completely written, so if the connection drops (or the device resets)
+ * the next call to ota_http_download() for the same URL and slot picks up
+ * from the last complete sector using a "Range:" request instead of starting
+ * over. If the server returned an ETag, it is sent back in "If-Range:" so a
+ * changed image on the server restarts the download from the beginning.
+ *
+ * TLS is available if the component is built with OTA_HTTP_TLS=1 and the
+ * program includes extras/mbedtls (see examples/aws_iot for the mbedtls
+ * setup.)
+ *
+ * For testing on a local Linux machine, utils/ota_http_server.py serves a
+ * directory with Range support and can deliberately drop connections.
+ *
+ * Does not change the current firmware slot, or reboot.
+ */
+
+typedef enum {
+    OTA_HTTP_OK          = 0,   /* Image downloaded and verified */
+    OTA_HTTP_ERR_SLOT    = -1,  /* Invalid or currently running OTA slot */
+    OTA_HTTP_ERR_DNS     = -2,  /* Host name lookup failed */
+    OTA_HTTP_ERR_CONNECT = -3,  /* Couldn't connect (or TLS handshake failed) */
+    OTA_HTTP_ERR_IO      = -4,  /* Socket send/receive failed or timed out */
+    OTA_HTTP_ERR_HTTP    = -5,  /* Unexpected HTTP status or malformed response */
+    OTA_HTTP_ERR_TOO_BIG = -6,  /* Image larger than the slot allows */
+    OTA_HTTP_ERR_FLASH   = -7,  /* Writing to flash failed */
+    OTA_HTTP_ERR_VERIFY  = -8,  /* rboot_verify_image() rejected the image */
+    OTA_HTTP_ERR_NOMEM   = -9,  /* Unable to allocate memory */
+    OTA_HTTP_ERR_NOTLS   = -10, /* TLS requested but not compiled in */
+} ota_http_result_t;
+
+/* Called after each chunk of the body has been written to flash.
+
+   'total_len' is the full image length if the server sent it, or 0 if
+   unknown. On a resumed download 'bytes_written' starts at the resume
+   offset. */
+typedef void (*ota_http_progress_cb)(size_t bytes_written, size_t total_len);
+
+typedef struct {
+    const char *host;
+    int port;              /* 0 selects 80 (or 443 with use_tls) */
+    const char *path;      /* Absolute path, ie "/firmware/app.bin" */
+    int timeout;           /* Milliseconds for any single send/receive, not
+                              the whole download. 0 selects a default. */
+    bool use_tls;          /* Requires OTA_HTTP_TLS=1 */
+    const char *ca_cert;   /* PEM CA certificate for TLS. NULL disables
+                              server verification (not recommended) */
+} ota_http_request_t;
+
+/* Download the image described by 'req' into rboot slot 'ota_slot'.
+
+   If a previous download of the same host/port/path into the same slot was
+   interrupted, it is resumed. At most 'max_attempts' connections are made
+   (each reconnect resumes from the last complete sector); pass 0 for a
+   single attempt.
+
+   Returns OTA_HTTP_OK once the whole image is in flash and
+   rboot_verify_image() accepts it, otherwise one of the ota_http_result_t
+   error codes. The resume state is kept after errors and discarded on
+   success or when the server image changes.
+ */
+ota_http_result_t ota_http_download(const ota_http_request_t *req, int ota_slot,
+                                    int max_attempts, ota_http_progress_cb progress_cb);
+
+/* Forget any recorded partial download, so the next call to
+   ota_http_download() starts from the beginning. */
+void ota_http_clear_progress(void);
+
+#endif
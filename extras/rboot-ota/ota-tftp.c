@@ -242,23 +242,81 @@ static char *tftp_get_field(int field, struct netbuf *netbuf)
 
 #define TFTP_TIMEOUT_RETRANSMITS 10
 
+/* Received data is staged in a word aligned, sector sized buffer and only
+   written out once a whole flash sector has been received (or the transfer
+   ends.) This means netbuf segments can be copied in regardless of their
+   alignment, and each sector is erased then programmed as full pages.
+*/
+typedef struct {
+    uint32_t sector_offs;   /* flash offset of the sector being staged */
+    uint32_t fill;          /* bytes staged so far */
+    uint32_t *buf;          /* SECTOR_SIZE bytes */
+} tftp_flash_writer_t;
+
+static bool tftp_flash_flush(tftp_flash_writer_t *writer)
+{
+    if(writer->fill == 0) {
+        return true;
+    }
+    /* pad a final partial word, flash writes must be multiples of 4 bytes */
+    uint32_t len = (writer->fill + 3) & ~3;
+    memset((uint8_t *)writer->buf + writer->fill, 0xff, len - writer->fill);
+
+    if(sdk_spi_flash_erase_sector(writer->sector_offs / SECTOR_SIZE) != SPI_FLASH_RESULT_OK
+       || sdk_spi_flash_write(writer->sector_offs, writer->buf, len) != SPI_FLASH_RESULT_OK) {
+        return false;
+    }
+    writer->sector_offs += SECTOR_SIZE;
+    writer->fill = 0;
+    return true;
+}
+
+static bool tftp_flash_stage(tftp_flash_writer_t *writer, const uint8_t *data, uint32_t len)
+{
+    while(len) {
+        uint32_t n = SECTOR_SIZE - writer->fill;
+        if(n > len) {
+            n = len;
+        }
+        memcpy((uint8_t *)writer->buf + writer->fill, data, n);
+        writer->fill += n;
+        data += n;
+        len -= n;
+        if(writer->fill == SECTOR_SIZE && !tftp_flash_flush(writer)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 static err_t tftp_receive_data(struct netconn *nc, size_t write_offs, size_t limit_offs, size_t *received_len, ip_addr_t *peer_addr, int peer_port, tftp_receive_cb receive_cb)
 {
     *received_len = 0;
     const int DATA_PACKET_SZ = 512 + 4; /*( packet size plus header */
     uint32_t start_offs = write_offs;
     int block = 1;
+    err_t err;
 
     struct netbuf *netbuf = 0;
     int retries = TFTP_TIMEOUT_RETRANSMITS;
 
+    tftp_flash_writer_t writer = {
+        .sector_offs = write_offs,
+        .fill = 0,
+        .buf = malloc(SECTOR_SIZE),
+    };
+    if(!writer.buf) {
+        tftp_send_error(nc, TFTP_ERR_FULL, "Out of memory");
+        return ERR_MEM;
+    }
+
     while(1)
     {
         if(peer_addr) {
             netconn_disconnect(nc);
         }
 
-        err_t err = netconn_recv(nc, &netbuf);
+        err = netconn_recv(nc, &netbuf);
 
         if(peer_addr) {
             if(netbuf) {
@@ -283,18 +341,19 @@ static err_t tftp_receive_data(struct netconn *nc, size_t write_offs, size_t lim
                 continue;
             }
             tftp_send_error(nc, TFTP_ERR_ILLEGAL, "Timeout");
-            return ERR_TIMEOUT;
+            goto out;
         }
         else if(err != ERR_OK) {
             tftp_send_error(nc, TFTP_ERR_ILLEGAL, "Failed to receive packet");
-            return err;
+            goto out;
         }
 
         uint16_t opcode = netbuf_read_u16_n(netbuf, 0);
         if(opcode != TFTP_OP_DATA) {
             tftp_send_error(nc, TFTP_ERR_ILLEGAL, "Unknown opcode");
             netbuf_delete(netbuf);
-            return ERR_VAL;
+            err = ERR_VAL;
+            goto out;
         }
 
         uint16_t client_block = netbuf_read_u16_n(netbuf, 2);
@@ -307,58 +366,44 @@ static err_t tftp_receive_data(struct netconn *nc, size_t write_offs, size_t lim
             }
             else {
                 tftp_send_error(nc, TFTP_ERR_ILLEGAL, "Block# out of order");
-                return ERR_VAL;
+                err = ERR_VAL;
+                goto out;
             }
         }
 
         /* Reset retry count if we got valid data */
         retries = TFTP_TIMEOUT_RETRANSMITS;
 
-        if(write_offs % SECTOR_SIZE == 0) {
-            sdk_spi_flash_erase_sector(write_offs / SECTOR_SIZE);
-        }
-
-        /* One UDP packet can be more than one netbuf segment, so iterate all the
-           segments in the netbuf and write them to flash
-        */
-        int offset = 0;
         int len = netbuf_len(netbuf);
 
         if(write_offs + len >= limit_offs) {
+            netbuf_delete(netbuf);
             tftp_send_error(nc, TFTP_ERR_FULL, "Image too large");
-            return ERR_VAL;
+            err = ERR_VAL;
+            goto out;
         }
 
-        bool first_chunk = true;
+        /* One UDP packet can be more than one netbuf segment, so stage each
+           segment (skipping the 4 byte TFTP header) into the sector buffer.
+        */
+        int skip = 4;
         do
         {
             uint16_t chunk_len;
-            uint32_t *chunk;
+            uint8_t *chunk;
             netbuf_data(netbuf, (void **)&chunk, &chunk_len);
-            if(first_chunk) {
-                chunk++; /* skip the 4 byte TFTP header */
-                chunk_len -= 4; /* assuming this netbuf chunk is at least 4 bytes! */
-                first_chunk = false;
+            if(skip) {
+                int n = (chunk_len < skip) ? chunk_len : skip;
+                chunk += n;
+                chunk_len -= n;
+                skip -= n;
             }
-            if(chunk_len && ((uint32_t)chunk % 4)) {
-                /* sdk_spi_flash_write requires a word aligned
-                   buffer, so if the UDP payload is unaligned
-                   (common) then we copy the first word to the stack
-                   and write that to flash, then move the rest of the
-                   buffer internally to sit on an aligned offset.
-
-                   Assuming chunk_len is always a multiple of 4 bytes.
-                */
-                uint32_t first_word;
-                memcpy(&first_word, chunk, 4);
-                sdk_spi_flash_write(write_offs+offset, &first_word, 4);
-                memmove(LWIP_MEM_ALIGN(chunk),&chunk[1],chunk_len-4);
-                chunk = LWIP_MEM_ALIGN(chunk);
-                offset += 4;
-                chunk_len -= 4;
+            if(!tftp_flash_stage(&writer, chunk, chunk_len)) {
+                netbuf_delete(netbuf);
+                tftp_send_error(nc, TFTP_ERR_ILLEGAL, "Flash write failed");
+                err = ERR_IF;
+                goto out;
             }
-            sdk_spi_flash_write(write_offs+offset, chunk, chunk_len);
-            offset += chunk_len;
         } while(netbuf_next(netbuf) >= 0);
 
         netbuf_delete(netbuf);
@@ -366,22 +411,29 @@ static err_t tftp_receive_data(struct netconn *nc, size_t write_offs, size_t lim
         *received_len += len - 4;
 
         if(len < DATA_PACKET_SZ) {
-            /* This was the last block, but verify the image before we ACK
-               it so the client gets an indication if things were successful.
+            /* This was the last block, so write out the partial sector and
+               verify the image before we ACK it so the client gets an
+               indication if things were successful.
             */
-            const char *err = "Unknown validation error";
+            if(!tftp_flash_flush(&writer)) {
+                tftp_send_error(nc, TFTP_ERR_ILLEGAL, "Flash write failed");
+                err = ERR_IF;
+                goto out;
+            }
+            const char *verify_err = "Unknown validation error";
             uint32_t image_length;
-            if(!rboot_verify_image(start_offs, &image_length, &err)
+            if(!rboot_verify_image(start_offs, &image_length, &verify_err)
                || image_length != *received_len) {
-                tftp_send_error(nc, TFTP_ERR_ILLEGAL, err);
-                return ERR_VAL;
+                tftp_send_error(nc, TFTP_ERR_ILLEGAL, verify_err);
+                err = ERR_VAL;
+                goto out;
             }
         }
 
-        err_t ack_err = tftp_send_ack(nc, block);
-        if(ack_err != ERR_OK) {
+        err = tftp_send_ack(nc, block);
+        if(err != ERR_OK) {
             printf("OTA TFTP failed to send ACK.\r\n");
-            return ack_err;
+            goto out;
         }
 
         // Make sure ack was successful before calling callback.
@@ -390,12 +442,17 @@ static err_t tftp_receive_data(struct netconn *nc, size_t write_offs, size_t lim
         }
 
         if(len < DATA_PACKET_SZ) {
-            return ERR_OK;
+            err = ERR_OK;
+            goto out;
         }
 
         block++;
         write_offs += 512;
     }
+
+ out:
+    free(writer.buf);
+    return err;
 }
 
 static err_t tftp_send_ack(struct netconn *nc, int block)
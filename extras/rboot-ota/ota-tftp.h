@@ -45,7 +45,9 @@ void ota_tftp_init_server(int listen_port);
    Does not change the current firmware slot, or reboot.
 
    receive_cb: called repeatedly after each successful packet that
-   has been written to flash and ACKed.  Can pass NULL to omit.
+   has been ACKed.  Data is written to flash a whole sector at a
+   time, so the last (up to 4KB) bytes received may still be
+   buffered in RAM.  Can pass NULL to omit.
  */
 err_t ota_tftp_download(const char *server, int port, const char *filename,
                         int timeout, int ota_slot, tftp_receive_cb receive_cb);
@@ -0,0 +1,10 @@
+# Component makefile for extras/shell
+#
+# Command shell on UART0 and TCP, see shell.h. Needs extras/uart_ring.
+
+INC_DIRS += $(shell_ROOT)
+
+# args for passing into compile rule generation
+shell_SRC_DIR = $(shell_ROOT)
+
+$(eval $(call component_compile_rules,shell))
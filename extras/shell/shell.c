@@ -0,0 +1,178 @@
+/* Shell sessions on UART0 and TCP
+ *
+ * See shell.h
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <lwip/api.h>
+
+#include "uart_ring.h"
+#include "ringbuf.h"
+#include "shell_core.h"
+
+/* Stack of the session tasks, in words. Commands run on it. */
+#ifndef SHELL_TASK_STACK
+#define SHELL_TASK_STACK 1024
+#endif
+
+/* How long output waits for space in the UART buffer when it is full */
+#ifndef SHELL_UART_TX_TIMEOUT_MS
+#define SHELL_UART_TX_TIMEOUT_MS 1000
+#endif
+
+/* Output buffer of a TCP session, a power of two. It is sent after each
+   batch of input, or when it fills up. */
+#ifndef SHELL_TCP_TX_SIZE
+#define SHELL_TCP_TX_SIZE 512
+#endif
+
+/* TCP sessions without input for this long are closed */
+#ifndef SHELL_TCP_IDLE_MS
+#define SHELL_TCP_IDLE_MS (10 * 60 * 1000)
+#endif
+
+typedef struct {
+    shell_t sh;
+    struct netconn *nc;
+    ringbuf_t tx;
+    uint8_t tx_buf[SHELL_TCP_TX_SIZE];
+} tcp_session_t;
+
+static size_t uart_out(void *ctx, const void *data, size_t len)
+{
+    return uart_ring_write(0, data, len, SHELL_UART_TX_TIMEOUT_MS / portTICK_PERIOD_MS);
+}
+
+static void uart_task(void *arg)
+{
+    shell_t *sh = arg;
+    char buf[16];
+
+    shell_begin(sh);
+    while (1) {
+        size_t n = uart_ring_read(0, buf, sizeof(buf), portMAX_DELAY);
+        if (!shell_input(sh, buf, n)) {
+            /* There is no leaving the serial port, start over */
+            sh->done = false;
+            shell_begin(sh);
+        }
+    }
+}
+
+bool shell_start_uart(unsigned priority)
+{
+    shell_t *sh = malloc(sizeof(shell_t));
+
+    if (!sh) {
+        return false;
+    }
+    shell_init(sh, uart_out, NULL, false);
+    if (xTaskCreate(uart_task, "shell", SHELL_TASK_STACK, sh, priority, NULL) != pdPASS) {
+        free(sh);
+        return false;
+    }
+    return true;
+}
+
+static void tcp_flush(tcp_session_t *s)
+{
+    const uint8_t *data;
+    size_t n;
+
+    while ((n = ringbuf_peek(&s->tx, &data)) > 0) {
+        if (netconn_write(s->nc, data, n, NETCONN_COPY) != ERR_OK) {
+            /* The connection is gone, the session ends at the next read */
+            ringbuf_skip(&s->tx, ringbuf_used(&s->tx));
+            return;
+        }
+        ringbuf_skip(&s->tx, n);
+    }
+}
+
+static size_t tcp_out(void *ctx, const void *data, size_t len)
+{
+    tcp_session_t *s = ctx;
+    size_t done = 0;
+
+    while (done < len) {
+        done += ringbuf_put(&s->tx, (const uint8_t *)data + done, len - done);
+        if (done < len) {
+            tcp_flush(s);
+        }
+    }
+    return len;
+}
+
+static void tcp_session(struct netconn *nc)
+{
+    tcp_session_t *s = malloc(sizeof(tcp_session_t));
+    bool open = true;
+
+    if (!s) {
+        return;
+    }
+    s->nc = nc;
+    ringbuf_init(&s->tx, s->tx_buf, sizeof(s->tx_buf));
+    shell_init(&s->sh, tcp_out, s, true);
+    netconn_set_recvtimeout(nc, SHELL_TCP_IDLE_MS);
+    shell_begin(&s->sh);
+    tcp_flush(s);
+
+    while (open) {
+        struct netbuf *netbuf;
+        void *data;
+        u16_t len;
+
+        /* Fails when the client closes, or after SHELL_TCP_IDLE_MS */
+        if (netconn_recv(nc, &netbuf) != ERR_OK) {
+            break;
+        }
+        /* Straight from the received pbufs */
+        do {
+            netbuf_data(netbuf, &data, &len);
+            open = shell_input(&s->sh, data, len);
+        } while (open && netbuf_next(netbuf) >= 0);
+        netbuf_delete(netbuf);
+        tcp_flush(s);
+    }
+    free(s);
+}
+
+static void tcp_task(void *arg)
+{
+    uint16_t port = (uintptr_t)arg;
+    struct netconn *listener = netconn_new(NETCONN_TCP);
+
+    if (!listener || netconn_bind(listener, IP_ADDR_ANY, port) != ERR_OK
+        || netconn_listen(listener) != ERR_OK) {
+        printf("shell: Failed to listen on port %u\n", port);
+        if (listener) {
+            netconn_delete(listener);
+        }
+        vTaskDelete(NULL);
+        return;
+    }
+    while (1) {
+        struct netconn *nc;
+
+        if (netconn_accept(listener, &nc) != ERR_OK) {
+            continue;
+        }
+        tcp_session(nc);
+        netconn_close(nc);
+        netconn_delete(nc);
+    }
+}
+
+bool shell_start_tcp(uint16_t port, unsigned priority)
+{
+    return xTaskCreate(tcp_task, "shell_tcp", SHELL_TASK_STACK, (void *)(uintptr_t)port,
+                       priority, NULL) == pdPASS;
+}
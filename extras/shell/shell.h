@@ -0,0 +1,69 @@
+/* Command shell with line editing, history and tab completion
+ *
+ * Commands are tables of shell_cmd_t, const so they stay in flash, handed
+ * to shell_register(). Each session (UART0, or a TCP connection) runs in
+ * its own task and only blocks that task while waiting for input.
+ *
+ * Keys: left/right, home/end (or ^A/^E), backspace/delete, ^K/^U/^W to
+ * delete to the end, to the start or a word, up/down (or ^P/^N) for
+ * history, tab to complete a command name, ^C to drop the line, ^L to
+ * redraw it and ^D on an empty line to leave a TCP session.
+ *
+ * Commands write with shell_printf()/shell_write(), which go to the
+ * session they run in. Output is queued in a ring and sent by the
+ * interrupt (UART) or in batches (TCP). Plain printf() still goes to
+ * stdout on the serial port. Sessions can run commands at the same time,
+ * so commands must be safe to call from several tasks.
+ *
+ * The TCP shell has no authentication, only use it on trusted networks.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _SHELL_H
+#define _SHELL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct shell shell_t;
+
+/* argv[0] is the command name. Returns 0 on success. */
+typedef int (*shell_fn_t)(shell_t *sh, int argc, char *argv[]);
+
+typedef struct {
+    const char *name;
+    const char *args;           /* Shown by 'help', may be NULL */
+    const char *help;
+    shell_fn_t fn;
+} shell_cmd_t;
+
+/* Make the 'count' commands of 'cmds' available, in addition to the
+   built-in 'help' and 'history'. The table isn't copied. Register before
+   starting sessions. Returns false if SHELL_MAX_TABLES are registered. */
+bool shell_register(const shell_cmd_t *cmds, size_t count);
+
+/* Shell on UART0, which must be set up by extras/uart_ring (linked in, it
+   is). Don't read stdin anywhere else. Returns false if the task can't be
+   created. */
+bool shell_start_uart(unsigned priority);
+
+/* Accept shell sessions on a TCP 'port' (23 for telnet), one at a time.
+   Returns false if the task can't be created. */
+bool shell_start_tcp(uint16_t port, unsigned priority);
+
+/* Output to the session, '\n' becoming "\r\n" */
+size_t shell_write(shell_t *sh, const void *data, size_t len);
+
+int shell_printf(shell_t *sh, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SHELL_H */
@@ -0,0 +1,637 @@
+/* Shell line editing, history, completion and command dispatch
+ *
+ * See shell_core.h
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "shell_core.h"
+
+#define CTRL(c) ((c) & 0x1f)
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+#define TELNET_SE   240
+#define TELNET_SB   250
+#define TELNET_WILL 251
+#define TELNET_IAC  255
+#define TELNET_OPT_ECHO 1
+#define TELNET_OPT_SGA  3   /* Suppress go ahead */
+
+enum { ESC_NONE, ESC_START, ESC_CSI, ESC_SS3 };
+enum { IAC_NONE, IAC_CMD, IAC_OPTION, IAC_SB, IAC_SB_IAC };
+
+static int cmd_help(shell_t *sh, int argc, char *argv[]);
+static int cmd_history(shell_t *sh, int argc, char *argv[]);
+static int cmd_exit(shell_t *sh, int argc, char *argv[]);
+
+static const shell_cmd_t builtin[] = {
+    { "help", "[command]", "List the commands, or show one", cmd_help },
+    { "history", NULL, "Show past command lines", cmd_history },
+    { "exit", NULL, "Leave the session", cmd_exit },
+};
+
+static const shell_cmd_t *tables[SHELL_MAX_TABLES];
+static size_t table_counts[SHELL_MAX_TABLES];
+static uint8_t ntables;
+
+bool shell_register(const shell_cmd_t *cmds, size_t count)
+{
+    if (ntables >= SHELL_MAX_TABLES) {
+        return false;
+    }
+    tables[ntables] = cmds;
+    table_counts[ntables] = count;
+    ntables++;
+    return true;
+}
+
+void shell_unregister_all(void)
+{
+    ntables = 0;
+}
+
+/* Command 'i' of all tables, NULL past the last */
+static const shell_cmd_t *command(size_t i)
+{
+    if (i < ARRAY_SIZE(builtin)) {
+        return &builtin[i];
+    }
+    i -= ARRAY_SIZE(builtin);
+    for (int t = 0; t < ntables; t++) {
+        if (i < table_counts[t]) {
+            return &tables[t][i];
+        }
+        i -= table_counts[t];
+    }
+    return NULL;
+}
+
+const shell_cmd_t *shell_find(const char *name)
+{
+    const shell_cmd_t *cmd;
+
+    for (size_t i = 0; (cmd = command(i)); i++) {
+        if (strcmp(cmd->name, name) == 0) {
+            return cmd;
+        }
+    }
+    return NULL;
+}
+
+static void out(shell_t *sh, const void *data, size_t len)
+{
+    if (len) {
+        sh->out(sh->ctx, data, len);
+    }
+}
+
+static void out_str(shell_t *sh, const char *s)
+{
+    out(sh, s, strlen(s));
+}
+
+size_t shell_write(shell_t *sh, const void *data, size_t len)
+{
+    const char *p = data;
+    const char *end = p + len;
+
+    while (p < end) {
+        const char *nl = memchr(p, '\n', end - p);
+        if (!nl) {
+            out(sh, p, end - p);
+            break;
+        }
+        out(sh, p, nl - p);
+        out(sh, "\r\n", 2);
+        p = nl + 1;
+    }
+    return len;
+}
+
+int shell_printf(shell_t *sh, const char *fmt, ...)
+{
+    char buf[SHELL_PRINTF_LEN];
+    va_list ap;
+
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n > 0) {
+        shell_write(sh, buf, n < (int)sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+    }
+    return n;
+}
+
+int shell_split(char *line, char *argv[], int max)
+{
+    int argc = 0;
+    char *p = line;
+
+    while (argc < max) {
+        while (*p == ' ') {
+            p++;
+        }
+        if (!*p) {
+            break;
+        }
+        char *w = p;
+        bool quoted = false;
+        argv[argc++] = w;
+        for (; *p && (quoted || *p != ' '); p++) {
+            if (*p == '"') {
+                quoted = !quoted;
+            } else {
+                *w++ = *p;
+            }
+        }
+        if (*p) {
+            p++;
+        }
+        *w = 0;
+    }
+    return argc;
+}
+
+/* Screen handling. sh->cur is where the terminal's cursor is, as an index
+   into the line. */
+
+static void move_to(shell_t *sh, uint8_t pos)
+{
+    char seq[8];
+
+    if (pos == sh->cur) {
+        return;
+    }
+    snprintf(seq, sizeof(seq), "\x1b[%u%c", pos < sh->cur ? sh->cur - pos : pos - sh->cur,
+             pos < sh->cur ? 'D' : 'C');
+    out_str(sh, seq);
+    sh->cur = pos;
+}
+
+/* Show the line from 'from' on, erasing what was after it if it got
+   shorter, and put the cursor back */
+static void redraw(shell_t *sh, uint8_t from, bool erase)
+{
+    move_to(sh, from);
+    out(sh, sh->line + from, sh->len - from);
+    sh->cur = sh->len;
+    if (erase) {
+        out_str(sh, "\x1b[K");
+    }
+    move_to(sh, sh->pos);
+}
+
+static void new_line(shell_t *sh)
+{
+    sh->len = sh->pos = sh->cur = 0;
+    sh->history_pos = 0;
+    out_str(sh, SHELL_PROMPT);
+}
+
+static void insert(shell_t *sh, const char *s, size_t n)
+{
+    uint8_t from = sh->pos;
+
+    if (n > (size_t)(SHELL_LINE_LEN - 1 - sh->len)) {
+        n = SHELL_LINE_LEN - 1 - sh->len;
+    }
+    if (!n) {
+        return;
+    }
+    memmove(sh->line + from + n, sh->line + from, sh->len - from);
+    memcpy(sh->line + from, s, n);
+    sh->len += n;
+    sh->pos += n;
+    redraw(sh, from, false);
+}
+
+/* Delete line[from..to-1] */
+static void delete(shell_t *sh, uint8_t from, uint8_t to)
+{
+    if (to <= from) {
+        return;
+    }
+    memmove(sh->line + from, sh->line + to, sh->len - to);
+    sh->len -= to - from;
+    if (sh->pos >= to) {
+        sh->pos -= to - from;
+    } else if (sh->pos > from) {
+        sh->pos = from;
+    }
+    redraw(sh, from, true);
+}
+
+static void set_line(shell_t *sh, const char *s)
+{
+    size_t n = strlen(s);
+
+    if (n > SHELL_LINE_LEN - 1) {
+        n = SHELL_LINE_LEN - 1;
+    }
+    memcpy(sh->line, s, n);
+    sh->len = sh->pos = n;
+    redraw(sh, 0, true);
+}
+
+/* History */
+
+/* The line 'back' lines ago (1 is the last one), or NULL */
+static const char *history_get(const shell_t *sh, unsigned back)
+{
+    int end = sh->history_len;
+
+    while (end > 0 && back > 0) {
+        int start = end - 1;
+        while (start > 0 && sh->history[start - 1]) {
+            start--;
+        }
+        if (--back == 0) {
+            return sh->history + start;
+        }
+        end = start;
+    }
+    return NULL;
+}
+
+/* Add the NUL terminated 'line' of 'len' characters */
+static void history_add(shell_t *sh, const char *line, size_t len)
+{
+    const char *last = history_get(sh, 1);
+
+    if (!len || len + 1 > SHELL_HISTORY_SIZE || (last && strcmp(last, line) == 0)) {
+        return;
+    }
+    while (sh->history_len + len + 1 > SHELL_HISTORY_SIZE) {
+        size_t first = strlen(sh->history) + 1;
+        memmove(sh->history, sh->history + first, sh->history_len - first);
+        sh->history_len -= first;
+    }
+    memcpy(sh->history + sh->history_len, line, len + 1);
+    sh->history_len += len + 1;
+}
+
+/* Up (1) or down (-1) through the history. Below the last line is an
+   empty one. */
+static void history_move(shell_t *sh, int dir)
+{
+    if (dir < 0 && sh->history_pos == 0) {
+        return;
+    }
+    unsigned back = sh->history_pos + dir;
+    if (back == 0) {
+        sh->history_pos = 0;
+        set_line(sh, "");
+        return;
+    }
+    const char *line = history_get(sh, back);
+    if (!line) {
+        out_str(sh, "\a");
+        return;
+    }
+    sh->history_pos = back;
+    set_line(sh, line);
+}
+
+/* Complete the command name at the start of the line */
+static void complete(shell_t *sh)
+{
+    const shell_cmd_t *cmd, *match = NULL;
+    uint8_t start = sh->pos;
+    size_t common = 0;
+    int count = 0;
+
+    if (memchr(sh->line, ' ', start)) {
+        out_str(sh, "\a");
+        return;
+    }
+    for (size_t i = 0; (cmd = command(i)); i++) {
+        if (strncmp(cmd->name, sh->line, start) != 0) {
+            continue;
+        }
+        if (count++ == 0) {
+            match = cmd;
+            common = strlen(cmd->name);
+        } else {
+            size_t k = start;
+            while (k < common && cmd->name[k] == match->name[k]) {
+                k++;
+            }
+            common = k;
+        }
+    }
+    if (!count) {
+        out_str(sh, "\a");
+        return;
+    }
+    insert(sh, match->name + start, common - start);
+    if (count == 1) {
+        if (sh->pos == sh->len || sh->line[sh->pos] != ' ') {
+            insert(sh, " ", 1);
+        }
+        return;
+    }
+    if (common > start) {
+        return;
+    }
+    /* Nothing to add, show the choices */
+    move_to(sh, sh->len);
+    out_str(sh, "\r\n");
+    for (size_t i = 0; (cmd = command(i)); i++) {
+        if (strncmp(cmd->name, sh->line, start) == 0) {
+            out_str(sh, cmd->name);
+            out_str(sh, "  ");
+        }
+    }
+    out_str(sh, "\r\n" SHELL_PROMPT);
+    sh->cur = 0;
+    redraw(sh, 0, false);
+}
+
+static void execute(shell_t *sh)
+{
+    char *argv[SHELL_MAX_ARGS];
+
+    move_to(sh, sh->len);
+    out_str(sh, "\r\n");
+    sh->line[sh->len] = 0;
+    history_add(sh, sh->line, sh->len);
+
+    int argc = shell_split(sh->line, argv, SHELL_MAX_ARGS);
+    if (argc) {
+        const shell_cmd_t *cmd = shell_find(argv[0]);
+        if (cmd) {
+            cmd->fn(sh, argc, argv);
+        } else {
+            shell_printf(sh, "Unknown command '%s', try 'help'\n", argv[0]);
+        }
+    }
+    if (!sh->done) {
+        new_line(sh);
+    }
+}
+
+/* Returns true if 'c' belongs to a telnet command */
+static bool telnet_filter(shell_t *sh, uint8_t c)
+{
+    switch (sh->iac) {
+    case IAC_CMD:
+        if (c == TELNET_IAC) {
+            /* An escaped 255, not a character the shell takes */
+            sh->iac = IAC_NONE;
+        } else if (c == TELNET_SB) {
+            sh->iac = IAC_SB;
+        } else {
+            /* WILL, WONT, DO and DONT have an option byte */
+            sh->iac = c >= TELNET_WILL ? IAC_OPTION : IAC_NONE;
+        }
+        return true;
+    case IAC_OPTION:
+        sh->iac = IAC_NONE;
+        return true;
+    case IAC_SB:
+        if (c == TELNET_IAC) {
+            sh->iac = IAC_SB_IAC;
+        }
+        return true;
+    case IAC_SB_IAC:
+        sh->iac = c == TELNET_SE ? IAC_NONE : IAC_SB;
+        return true;
+    default:
+        if (c != TELNET_IAC) {
+            return false;
+        }
+        sh->iac = IAC_CMD;
+        return true;
+    }
+}
+
+/* Cursor keys and delete: 'A' to 'D' for the arrows, 'H' home, 'F' end,
+   'X' delete */
+static void edit_key(shell_t *sh, uint8_t code)
+{
+    switch (code) {
+    case 'A':
+        history_move(sh, 1);
+        break;
+    case 'B':
+        history_move(sh, -1);
+        break;
+    case 'C':
+        if (sh->pos < sh->len) {
+            move_to(sh, ++sh->pos);
+        }
+        break;
+    case 'D':
+        if (sh->pos > 0) {
+            move_to(sh, --sh->pos);
+        }
+        break;
+    case 'H':
+        move_to(sh, sh->pos = 0);
+        break;
+    case 'F':
+        move_to(sh, sh->pos = sh->len);
+        break;
+    case 'X':
+        if (sh->pos < sh->len) {
+            delete(sh, sh->pos, sh->pos + 1);
+        }
+        break;
+    }
+}
+
+static void escape(shell_t *sh, uint8_t c)
+{
+    if (sh->esc == ESC_START) {
+        sh->esc = c == '[' ? ESC_CSI : c == 'O' ? ESC_SS3 : ESC_NONE;
+        sh->esc_arg = 0;
+        return;
+    }
+    if (sh->esc == ESC_CSI && c >= 0x20 && c < 0x40) {
+        /* Parameters, only a single number is used */
+        if (c >= '0' && c <= '9') {
+            sh->esc_arg = sh->esc_arg * 10 + c - '0';
+        }
+        return;
+    }
+    sh->esc = ESC_NONE;
+    if (c == '~') {
+        /* VT220 style home, end and delete */
+        c = sh->esc_arg == 1 || sh->esc_arg == 7 ? 'H'
+            : sh->esc_arg == 4 || sh->esc_arg == 8 ? 'F'
+            : sh->esc_arg == 3 ? 'X' : 0;
+    }
+    edit_key(sh, c);
+}
+
+static void key(shell_t *sh, uint8_t c)
+{
+    char last = sh->last;
+    uint8_t from;
+
+    sh->last = c;
+    switch (c) {
+    case '\n':
+        if (last == '\r') {
+            break;
+        }
+        /* fall through */
+    case '\r':
+        execute(sh);
+        break;
+    case 0x1b:
+        sh->esc = ESC_START;
+        break;
+    case '\b':
+    case 0x7f:
+        if (sh->pos > 0) {
+            delete(sh, sh->pos - 1, sh->pos);
+        }
+        break;
+    case '\t':
+        complete(sh);
+        break;
+    case CTRL('A'):
+        edit_key(sh, 'H');
+        break;
+    case CTRL('E'):
+        edit_key(sh, 'F');
+        break;
+    case CTRL('B'):
+        edit_key(sh, 'D');
+        break;
+    case CTRL('F'):
+        edit_key(sh, 'C');
+        break;
+    case CTRL('P'):
+        edit_key(sh, 'A');
+        break;
+    case CTRL('N'):
+        edit_key(sh, 'B');
+        break;
+    case CTRL('K'):
+        delete(sh, sh->pos, sh->len);
+        break;
+    case CTRL('U'):
+        delete(sh, 0, sh->pos);
+        break;
+    case CTRL('W'):
+        from = sh->pos;
+        while (from > 0 && sh->line[from - 1] == ' ') {
+            from--;
+        }
+        while (from > 0 && sh->line[from - 1] != ' ') {
+            from--;
+        }
+        delete(sh, from, sh->pos);
+        break;
+    case CTRL('C'):
+        move_to(sh, sh->len);
+        out_str(sh, "^C\r\n");
+        new_line(sh);
+        break;
+    case CTRL('L'):
+        out_str(sh, "\x1b[H\x1b[2J" SHELL_PROMPT);
+        sh->cur = 0;
+        redraw(sh, 0, false);
+        break;
+    case CTRL('D'):
+        if (sh->len == 0) {
+            out_str(sh, "\r\n");
+            sh->done = true;
+        } else {
+            edit_key(sh, 'X');
+        }
+        break;
+    default:
+        if (c >= ' ' && c < 0x7f) {
+            char ch = c;
+            insert(sh, &ch, 1);
+        }
+        break;
+    }
+}
+
+void shell_init(shell_t *sh, shell_out_t out, void *ctx, bool telnet)
+{
+    memset(sh, 0, sizeof(*sh));
+    sh->out = out;
+    sh->ctx = ctx;
+    sh->telnet = telnet;
+}
+
+void shell_begin(shell_t *sh)
+{
+    static const uint8_t options[] = {
+        /* The server echoes, and the client sends keys as they are typed */
+        TELNET_IAC, TELNET_WILL, TELNET_OPT_ECHO,
+        TELNET_IAC, TELNET_WILL, TELNET_OPT_SGA,
+    };
+
+    if (sh->telnet) {
+        out(sh, options, sizeof(options));
+    }
+    new_line(sh);
+}
+
+bool shell_input(shell_t *sh, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+
+    for (size_t i = 0; i < len && !sh->done; i++) {
+        if (sh->telnet && telnet_filter(sh, p[i])) {
+            continue;
+        }
+        if (sh->esc) {
+            escape(sh, p[i]);
+        } else {
+            key(sh, p[i]);
+        }
+    }
+    return !sh->done;
+}
+
+/* Built-in commands */
+
+static int cmd_help(shell_t *sh, int argc, char *argv[])
+{
+    const shell_cmd_t *cmd;
+
+    if (argc >= 2) {
+        cmd = shell_find(argv[1]);
+        if (!cmd) {
+            shell_printf(sh, "Unknown command '%s'\n", argv[1]);
+            return 1;
+        }
+        shell_printf(sh, "%s %s\n    %s\n", cmd->name, cmd->args ? cmd->args : "", cmd->help);
+        return 0;
+    }
+    for (size_t i = 0; (cmd = command(i)); i++) {
+        shell_printf(sh, "%-10s %-24s %s\n", cmd->name, cmd->args ? cmd->args : "", cmd->help);
+    }
+    return 0;
+}
+
+static int cmd_history(shell_t *sh, int argc, char *argv[])
+{
+    int n = 1;
+
+    (void)argc;
+    (void)argv;
+    for (uint16_t i = 0; i < sh->history_len; i += strlen(sh->history + i) + 1) {
+        shell_printf(sh, "%3d  %s\n", n++, sh->history + i);
+    }
+    return 0;
+}
+
+static int cmd_exit(shell_t *sh, int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+    sh->done = true;
+    return 0;
+}
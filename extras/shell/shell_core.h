@@ -0,0 +1,103 @@
+/* Shell sessions without the I/O: line editing, history, completion and
+ * running commands
+ *
+ * The caller feeds received bytes to shell_input() and provides a function
+ * to send output. Output is written in small pieces (an echoed character,
+ * an escape sequence to move the cursor), so that function should queue
+ * it rather than send each piece.
+ *
+ * The terminal is expected to understand the VT100 sequences for moving
+ * the cursor and erasing to the end of the line, which all common ones
+ * do. With 'telnet' set, telnet commands are taken out of the input and
+ * shell_begin() asks the client to send each key as it is typed.
+ *
+ * No dependencies beyond the C library, extras/shell/tests builds it on a
+ * host.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _SHELL_CORE_H
+#define _SHELL_CORE_H
+
+#include "shell.h"
+
+/* Longest command line, less one */
+#ifndef SHELL_LINE_LEN
+#define SHELL_LINE_LEN 80
+#endif
+
+#ifndef SHELL_MAX_ARGS
+#define SHELL_MAX_ARGS 10
+#endif
+
+/* Bytes kept of past lines, per session */
+#ifndef SHELL_HISTORY_SIZE
+#define SHELL_HISTORY_SIZE 256
+#endif
+
+/* Command tables shell_register() takes */
+#ifndef SHELL_MAX_TABLES
+#define SHELL_MAX_TABLES 8
+#endif
+
+/* Longest shell_printf() output, the rest is cut off */
+#ifndef SHELL_PRINTF_LEN
+#define SHELL_PRINTF_LEN 128
+#endif
+
+#define SHELL_PROMPT "> "
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Send 'len' bytes, returns the number sent */
+typedef size_t (*shell_out_t)(void *ctx, const void *data, size_t len);
+
+struct shell {
+    shell_out_t out;
+    void *ctx;
+    bool telnet;
+    bool done;                  /* The user left */
+
+    char line[SHELL_LINE_LEN];
+    uint8_t len;
+    uint8_t pos;                /* Cursor in the line */
+    uint8_t cur;                /* Cursor on the screen */
+
+    uint8_t esc;                /* Escape sequence state */
+    uint8_t esc_arg;
+    uint8_t iac;                /* Telnet command state */
+    char last;                  /* Last byte, to take CR LF as one */
+
+    /* Past lines, oldest first, each ending in a NUL */
+    char history[SHELL_HISTORY_SIZE];
+    uint16_t history_len;
+    uint8_t history_pos;        /* Lines back while browsing, 0 if not */
+};
+
+void shell_init(shell_t *sh, shell_out_t out, void *ctx, bool telnet);
+
+/* Start the session: telnet options if needed, and the prompt */
+void shell_begin(shell_t *sh);
+
+/* Handle received bytes, running the commands entered. Returns false once
+   the user has left the session. */
+bool shell_input(shell_t *sh, const void *data, size_t len);
+
+/* Split 'line' into at most 'max' words at spaces, in place. Double quotes
+   keep spaces in a word. Returns the number of words. */
+int shell_split(char *line, char *argv[], int max);
+
+/* The command called 'name', or NULL */
+const shell_cmd_t *shell_find(const char *name);
+
+/* Forget the registered tables, for tests */
+void shell_unregister_all(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SHELL_CORE_H */
@@ -0,0 +1,400 @@
+/* Host unit tests for shell_core.c: types keys at a session and checks
+ * what a VT100 terminal would show, and the commands that get run.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "shell_core.h"
+#include "check.h"
+
+/* The terminal: the current screen line, the cursor, and everything
+   received */
+static char screen[256];
+static int column;
+static int bells;
+static int esc_state, esc_arg;
+static char raw[4096];
+static size_t raw_len;
+
+/* What the commands got */
+static char ran[256];
+
+static bool sh_telnet;
+static int runs;
+
+static void screen_clear(void)
+{
+    memset(screen, ' ', sizeof(screen) - 1);
+    screen[sizeof(screen) - 1] = 0;
+    column = 0;
+}
+
+static void terminal(char c)
+{
+    static int iac_skip;
+
+    /* Telnet options, checked separately */
+    if (sh_telnet && (iac_skip || (uint8_t)c == 0xff)) {
+        iac_skip = iac_skip ? iac_skip - 1 : 2;
+        return;
+    }
+    if (esc_state == 1) {
+        esc_state = c == '[' ? 2 : 0;
+        esc_arg = 0;
+        return;
+    }
+    if (esc_state == 2) {
+        if (c >= '0' && c <= '9') {
+            esc_arg = esc_arg * 10 + c - '0';
+            return;
+        }
+        esc_state = 0;
+        int n = esc_arg ? esc_arg : 1;
+        switch (c) {
+        case 'C':
+            column += n;
+            break;
+        case 'D':
+            column -= n;
+            CHECK(column >= 0);
+            break;
+        case 'K':
+            memset(screen + column, ' ', sizeof(screen) - 1 - column);
+            break;
+        case 'H':
+            column = 0;
+            break;
+        case 'J':
+            screen_clear();
+            break;
+        default:
+            CHECK(!"unknown escape sequence");
+        }
+        return;
+    }
+    switch (c) {
+    case 0x1b:
+        esc_state = 1;
+        break;
+    case '\r':
+        column = 0;
+        break;
+    case '\n':
+        screen_clear();
+        break;
+    case '\a':
+        bells++;
+        break;
+    default:
+        CHECK(c >= ' ' && c < 0x7f);
+        screen[column++] = c;
+        break;
+    }
+}
+
+static size_t output(void *ctx, const void *data, size_t len)
+{
+    const char *p = data;
+
+    CHECK(ctx == (void *)output);
+    CHECK(raw_len + len <= sizeof(raw));
+    if (raw_len + len <= sizeof(raw)) {
+        memcpy(raw + raw_len, data, len);
+        raw_len += len;
+    }
+    for (size_t i = 0; i < len; i++) {
+        terminal(p[i]);
+    }
+    return len;
+}
+
+static int cmd_echo(shell_t *sh, int argc, char *argv[])
+{
+    ran[0] = 0;
+    for (int i = 0; i < argc; i++) {
+        strcat(ran, i ? "|" : "");
+        strcat(ran, argv[i]);
+    }
+    runs++;
+    shell_printf(sh, "got %d\n", argc);
+    return 0;
+}
+
+static const shell_cmd_t commands[] = {
+    { "echo", "[words]", "Show the words", cmd_echo },
+    { "set", "<name> <value>", "Set", cmd_echo },
+    { "setup", NULL, "Set up", cmd_echo },
+    { "status", NULL, "Status", cmd_echo },
+};
+
+static shell_t sh;
+
+static void start(bool telnet)
+{
+    screen_clear();
+    bells = 0;
+    raw_len = 0;
+    runs = 0;
+    ran[0] = 0;
+    sh_telnet = telnet;
+    shell_init(&sh, output, (void *)output, telnet);
+    shell_begin(&sh);
+}
+
+static bool type(const char *keys)
+{
+    return shell_input(&sh, keys, strlen(keys));
+}
+
+/* The screen shows the prompt and 'line', with the cursor at 'pos' */
+static bool shows(const char *line, int pos)
+{
+    char expect[256];
+    int n = snprintf(expect, sizeof(expect), "%s%s", SHELL_PROMPT, line);
+
+    if (memcmp(screen, expect, n) != 0 || screen[n] != ' ') {
+        printf("screen '%.*s', expected '%s'\n", n + 2, screen, expect);
+        return false;
+    }
+    if (column != (int)strlen(SHELL_PROMPT) + pos) {
+        printf("cursor at %d, expected %d\n", column - (int)strlen(SHELL_PROMPT), pos);
+        return false;
+    }
+    return true;
+}
+
+static void test_editing(void)
+{
+    start(false);
+    CHECK(shows("", 0));
+
+    type("echo hello");
+    CHECK(shows("echo hello", 10));
+    /* Left twice, insert */
+    type("\x1b[D\x1b[DX");
+    CHECK(shows("echo helXlo", 9));
+    /* Backspace, delete */
+    type("\x7f\x1b[3~");
+    CHECK(shows("echo helo", 8));
+    /* Home, right, end */
+    type("\x1b[H\x1b[C");
+    CHECK(shows("echo helo", 1));
+    type("\x1bOF");
+    CHECK(shows("echo helo", 9));
+    type("\x01");
+    CHECK(shows("echo helo", 0));
+    type("\x1b[4~");
+    CHECK(shows("echo helo", 9));
+    /* Kill a word, and the rest of the line */
+    type("\x17");
+    CHECK(shows("echo ", 5));
+    type("one two\x02\x02\x02\x0b");
+    CHECK(shows("echo one ", 9));
+    type("\x01\x06\x06\x15");
+    CHECK(shows("ho one ", 0));
+    type("\x05\x03");
+    CHECK(shows("", 0));
+    /* ^D deletes under the cursor */
+    type("abc\x02\x04");
+    CHECK(shows("ab", 2));
+    /* ^L redraws */
+    type("\x0c");
+    CHECK(shows("ab", 2));
+    CHECK(runs == 0);
+
+    /* Nothing past the line length */
+    type("\x15");
+    for (int i = 0; i < SHELL_LINE_LEN + 10; i++) {
+        type("x");
+    }
+    CHECK(sh.len == SHELL_LINE_LEN - 1);
+    type("\x15");
+    CHECK(shows("", 0));
+}
+
+static void test_commands(void)
+{
+    shell_register(commands, sizeof(commands) / sizeof(commands[0]));
+    start(false);
+
+    type("echo  a \"b c\"  d\"\"e\r");
+    CHECK(runs == 1);
+    CHECK(strcmp(ran, "echo|a|b c|de") == 0);
+    CHECK(strstr(raw, "got 4\r\n" SHELL_PROMPT) != NULL);
+    CHECK(shows("", 0));
+
+    /* CR LF is one line, and so is a lone LF */
+    type("echo 1\r\necho 2\n");
+    CHECK(runs == 3);
+    CHECK(strcmp(ran, "echo|2") == 0);
+
+    /* Empty lines run nothing */
+    type("\r   \r");
+    CHECK(runs == 3);
+
+    raw_len = 0;
+    type("nope\r");
+    CHECK(runs == 3);
+    raw[raw_len] = 0;
+    CHECK(strstr(raw, "Unknown command 'nope'") != NULL);
+
+    raw_len = 0;
+    type("help\r");
+    raw[raw_len] = 0;
+    CHECK(strstr(raw, "echo ") != NULL && strstr(raw, "Set up") != NULL);
+    raw_len = 0;
+    type("help set\r");
+    raw[raw_len] = 0;
+    CHECK(strstr(raw, "set <name> <value>\r\n") != NULL);
+
+    /* Too many words are cut off */
+    char line[SHELL_LINE_LEN];
+    strcpy(line, "echo");
+    for (int i = 0; i < SHELL_MAX_ARGS + 5; i++) {
+        strcat(line, " w");
+    }
+    type(line);
+    type("\r");
+    CHECK(strstr(ran, "|w|w") && strlen(ran) == 4 + 2 * (SHELL_MAX_ARGS - 1));
+
+    /* Long output is cut, not overrun */
+    CHECK(shell_printf(&sh, "%300s", "x") == 300);
+
+    CHECK(type("exit\r") == false);
+    CHECK(type("echo\r") == false);
+    CHECK(runs == 4);
+    shell_unregister_all();
+}
+
+static void test_history(void)
+{
+    shell_register(commands, sizeof(commands) / sizeof(commands[0]));
+    start(false);
+
+    type("echo 1\recho 2\recho 2\recho 3\r");
+    /* Up, up */
+    type("\x1b[A");
+    CHECK(shows("echo 3", 6));
+    type("\x1b[A");
+    CHECK(shows("echo 2", 6));
+    /* No repeats */
+    type("\x1b[A");
+    CHECK(shows("echo 1", 6));
+    type("\x1b[A");
+    CHECK(shows("echo 1", 6));
+    CHECK(bells == 1);
+    /* Down, and down to an empty line */
+    type("\x0e");
+    CHECK(shows("echo 2", 6));
+    type("\x1b[B\x1b[B");
+    CHECK(shows("", 0));
+    type("\x1b[B");
+    CHECK(shows("", 0));
+
+    /* Edit a recalled line */
+    type("\x10\x7f" "9\r");
+    CHECK(strcmp(ran, "echo|9") == 0);
+    type("\x10");
+    CHECK(shows("echo 9", 6));
+    type("\x03");
+
+    /* Old lines make room for new ones */
+    char line[40];
+    for (int i = 0; i < 100; i++) {
+        snprintf(line, sizeof(line), "echo line %d\r", i);
+        type(line);
+    }
+    CHECK(sh.history_len <= SHELL_HISTORY_SIZE);
+    type("\x1b[A");
+    CHECK(shows("echo line 99", 12));
+    int back = 1;
+    while (bells == 1 && back < 100) {
+        type("\x1b[A");
+        back++;
+    }
+    CHECK(back > 10 && back < 40);
+    type("\x03");
+
+    raw_len = 0;
+    type("history\r");
+    raw[raw_len] = 0;
+    CHECK(strstr(raw, "echo line 99\r\n") != NULL);
+    CHECK(strstr(raw, "echo line 1\r\n") == NULL);
+    shell_unregister_all();
+}
+
+static void test_complete(void)
+{
+    shell_register(commands, sizeof(commands) / sizeof(commands[0]));
+    start(false);
+
+    type("ec\t");
+    CHECK(shows("echo ", 5));
+    type("\x15" "se\t");
+    CHECK(shows("set", 3));
+    /* set, setup: nothing more to add, so list them */
+    raw_len = 0;
+    type("\t");
+    raw[raw_len] = 0;
+    CHECK(strstr(raw, "set  setup  \r\n") != NULL);
+    CHECK(shows("set", 3));
+    type("u\t");
+    CHECK(shows("setup ", 6));
+    /* Only the command name */
+    type("\t");
+    CHECK(bells == 1);
+    type("\x15x\t");
+    CHECK(bells == 2);
+    /* In the middle of the line */
+    type("\x15st abc\x01\x06\x06\t");
+    CHECK(shows("status abc", 6));
+    type("\x03");
+
+    /* 'h' is help and history */
+    type("h\t");
+    CHECK(shows("h", 1));
+    type("i\t");
+    CHECK(shows("history ", 8));
+    shell_unregister_all();
+}
+
+static void test_telnet(void)
+{
+    shell_register(commands, sizeof(commands) / sizeof(commands[0]));
+    start(true);
+
+    /* Options offered first */
+    CHECK(raw_len > 6 && memcmp(raw, "\xff\xfb\x01\xff\xfb\x03", 6) == 0);
+
+    /* Replies, a subnegotiation and an escaped 255 in the input */
+    const char input[] = "ec\xff\xfd\x01ho\xff\xfa\x18\x01\xff\xff\xff\xf0 x\xff\xffy\xff\xf1\r\0";
+    CHECK(shell_input(&sh, input, sizeof(input) - 1));
+    CHECK(runs == 1);
+    CHECK(strcmp(ran, "echo|xy") == 0);
+
+    /* ^D leaves */
+    CHECK(type("ab\x04") == true);
+    CHECK(type("\x15\x04") == false);
+    shell_unregister_all();
+
+    /* Only so many tables */
+    for (int i = 0; i < SHELL_MAX_TABLES; i++) {
+        CHECK(shell_register(commands, 1));
+    }
+    CHECK(!shell_register(commands, 1));
+    shell_unregister_all();
+}
+
+int main(void)
+{
+    test_editing();
+    test_commands();
+    test_history();
+    test_complete();
+    test_telnet();
+
+    return check_done("shell");
+}
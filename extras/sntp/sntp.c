@@ -37,6 +37,7 @@
 #include "lwip/opt.h"
 
 #include "sntp.h"
+#include "sntp_filter.h"
 
 #include "lwip/timers.h"
 #include "lwip/udp.h"
@@ -126,6 +127,19 @@
 #define SNTP_CHECK_RESPONSE         0
 #endif
 
+/** Set this to 1 to send each request to all servers at once, and use the
+ * reply with the lowest round trip delay. Offsets are then computed from all
+ * four timestamps, which needs SNTP_GET_SYSTEM_TIME. Replies are always
+ * checked against the address and timestamp of the request.
+ * Only for the raw API.
+ */
+#ifndef SNTP_PARALLEL_REQUESTS
+#define SNTP_PARALLEL_REQUESTS      0
+#endif
+#if SNTP_PARALLEL_REQUESTS && SNTP_SOCKET
+#error "SNTP_PARALLEL_REQUESTS needs the raw API"
+#endif
+
 /** According to the RFC, this shall be a random delay
  * between 1 and 5 minutes (in milliseconds) to prevent load peaks.
  * This can be defined to a random generation function,
@@ -169,6 +183,18 @@
 #define SNTP_RECEIVE_TIME_SIZE      1
 #endif
 
+/** SNTP macro to get the delay until the next update (in milliseconds),
+ * given the configured update delay.
+ */
+#ifndef SNTP_GET_UPDATE_DELAY
+#define SNTP_GET_UPDATE_DELAY(max_ms)     (max_ms)
+#endif
+
+/** SNTP macro called before each request */
+#ifndef SNTP_ON_REQUEST
+#define SNTP_ON_REQUEST()
+#endif
+
 /** SNTP macro to get system time, used with SNTP_CHECK_RESPONSE >= 2
  * to send in request and compare in response.
  */
@@ -272,7 +298,7 @@ static struct udp_pcb* sntp_pcb;
 static char* sntp_server_addresses[SNTP_NUM_SERVERS_SUPPORTED];
 /** The currently used server (initialized to 0) */
 static u8_t sntp_num_servers;
-#if (SNTP_NUM_SERVERS_SUPPORTED > 1)
+#if (SNTP_NUM_SERVERS_SUPPORTED > 1) && !SNTP_PARALLEL_REQUESTS
 static u8_t sntp_current_server;
 #else
 #define sntp_current_server 0
@@ -300,6 +326,7 @@ static ip_addr_t sntp_last_server_address;
 static u32_t sntp_last_timestamp_sent[2];
 #endif /* SNTP_CHECK_RESPONSE >= 2 */
 
+#if !SNTP_PARALLEL_REQUESTS
 /**
  * SNTP processing of received timestamp
  */
@@ -325,6 +352,7 @@ sntp_process(u32_t *receive_timestamp)
   LWIP_DEBUGF(SNTP_DEBUG_TRACE, ("sntp_process: %s", ctime(&t)));
 #endif /* SNTP_CALC_TIME_US */
 }
+#endif /* !SNTP_PARALLEL_REQUESTS */
 
 /**
  * Initialize request struct to be sent to server.
@@ -369,6 +397,7 @@ sntp_request(void *arg)
   ip_addr_t          sntp_server_address;
 
   LWIP_UNUSED_ARG(arg);
+  SNTP_ON_REQUEST();
 
   /* if we got a valid SNTP server address... */
   if (ipaddr_aton(SNTP_SERVER_ADDRESS, &sntp_server_address)) {
@@ -431,7 +460,7 @@ sntp_thread(void *arg)
   LWIP_UNUSED_ARG(arg);
   while(1) {
     sntp_request(NULL);
-    sys_msleep(sntp_update_delay);
+    sys_msleep(SNTP_GET_UPDATE_DELAY(sntp_update_delay));
   }
 }
 
@@ -476,6 +505,253 @@ sntp_retry(void* arg)
 #endif /* SNTP_RETRY_TIMEOUT_EXP */
 }
 
+#if SNTP_PARALLEL_REQUESTS
+
+#define SNTP_SERVER_IDLE            0
+#define SNTP_SERVER_RESOLVING       1
+#define SNTP_SERVER_SENT            2
+#define SNTP_SERVER_DONE            3
+
+/** State of each server in the current round of requests */
+static struct {
+  ip_addr_t addr;
+  /** Transmit timestamp of the request, sent back as originate timestamp */
+  sntp_timestamp_t sent;
+  u8_t state;
+} sntp_servers[SNTP_NUM_SERVERS_SUPPORTED];
+
+/** Best reply of the current round */
+static sntp_filter_t sntp_filter;
+
+static sntp_timestamp_t
+sntp_get_timestamp(void)
+{
+  u32_t sec, us;
+  SNTP_GET_SYSTEM_TIME(sec, us);
+  return sntp_timestamp(sec, us);
+}
+
+static sntp_timestamp_t
+sntp_read_timestamp(const u32_t *ts)
+{
+  return ((sntp_timestamp_t)ntohl(ts[0]) << 32) | ntohl(ts[1]);
+}
+
+/**
+ * End of a round of requests: all servers replied or the time is up.
+ * Set the time from the best reply, or try again if there was none.
+ *
+ * @param arg is unused (only necessary to conform to sys_timeout)
+ */
+static void
+sntp_round_done(void* arg)
+{
+  u8_t i;
+
+  LWIP_UNUSED_ARG(arg);
+
+  /* late replies and DNS results are ignored */
+  for (i = 0; i < sntp_num_servers; i++) {
+    sntp_servers[i].state = SNTP_SERVER_IDLE;
+  }
+
+  if (sntp_filter.count) {
+    u32_t sec, us;
+    int64_t t;
+
+    SNTP_RESET_RETRY_TIMEOUT();
+    SNTP_GET_SYSTEM_TIME(sec, us);
+    t = (int64_t)sec * 1000000 + us + sntp_filter.best.offset;
+    SNTP_SET_SYSTEM_TIME_US((time_t)(t / 1000000), (u32_t)(t % 1000000));
+    LWIP_DEBUGF(SNTP_DEBUG_TRACE, ("sntp_round_done: %"U16_F" replies, server %"U16_F
+      " offset %"S32_F" us delay %"S32_F" us\n", (u16_t)sntp_filter.count,
+      (u16_t)sntp_filter.best.server, (s32_t)sntp_filter.best.offset,
+      (s32_t)sntp_filter.best.delay));
+
+    /* Set up timeout for next request */
+    u32_t delay = SNTP_GET_UPDATE_DELAY(sntp_update_delay);
+    sys_timeout(delay, sntp_request, NULL);
+    LWIP_DEBUGF(SNTP_DEBUG_STATE, ("sntp_round_done: Scheduled next time request: %"U32_F" ms\n",
+      delay));
+  } else {
+    sntp_retry(NULL);
+  }
+}
+
+/** End the round early once no server is left to reply */
+static void
+sntp_round_check(void)
+{
+  u8_t i;
+
+  for (i = 0; i < sntp_num_servers; i++) {
+    if ((sntp_servers[i].state == SNTP_SERVER_RESOLVING) ||
+        (sntp_servers[i].state == SNTP_SERVER_SENT)) {
+      return;
+    }
+  }
+  sys_untimeout(sntp_round_done, NULL);
+  sntp_round_done(NULL);
+}
+
+/** UDP recv callback for the sntp pcb */
+static void
+sntp_recv(void *arg, struct udp_pcb* pcb, struct pbuf *p, ip_addr_t *addr, u16_t port)
+{
+  /* T4, as soon as possible */
+  sntp_timestamp_t t4 = sntp_get_timestamp();
+  u8_t li_vn_mode, stratum;
+  /* originate, receive and transmit timestamps */
+  u32_t timestamps[6];
+  sntp_timestamp_t t1;
+  sntp_sample_t sample;
+  u8_t i;
+
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(pcb);
+
+  if ((port != SNTP_PORT) || (p->tot_len != SNTP_MSG_LEN)) {
+    LWIP_DEBUGF(SNTP_DEBUG_WARN, ("sntp_recv: Invalid packet length: %"U16_F"\n", p->tot_len));
+    pbuf_free(p);
+    return;
+  }
+  pbuf_copy_partial(p, &li_vn_mode, 1, SNTP_OFFSET_LI_VN_MODE);
+  pbuf_copy_partial(p, &stratum, 1, SNTP_OFFSET_STRATUM);
+  pbuf_copy_partial(p, timestamps, sizeof(timestamps), SNTP_OFFSET_ORIGINATE_TIME);
+  pbuf_free(p);
+
+  /* find the request this replies to */
+  t1 = sntp_read_timestamp(&timestamps[0]);
+  for (i = 0; i < sntp_num_servers; i++) {
+    if ((sntp_servers[i].state == SNTP_SERVER_SENT) && (sntp_servers[i].sent == t1) &&
+        ip_addr_cmp(addr, &sntp_servers[i].addr)) {
+      break;
+    }
+  }
+  if (i == sntp_num_servers) {
+    LWIP_DEBUGF(SNTP_DEBUG_WARN, ("sntp_recv: Reply to no pending request\n"));
+    return;
+  }
+  sntp_servers[i].state = SNTP_SERVER_DONE;
+
+  if (((li_vn_mode & SNTP_MODE_MASK) != SNTP_MODE_SERVER) ||
+      ((li_vn_mode & SNTP_LI_MASK) == (SNTP_LI_ALARM_CONDITION << 6))) {
+    LWIP_DEBUGF(SNTP_DEBUG_WARN, ("sntp_recv: Invalid mode or server not synchronized: %"U16_F"\n",
+      (u16_t)li_vn_mode));
+  } else if ((stratum == SNTP_STRATUM_KOD) || (stratum > 15)) {
+    LWIP_DEBUGF(SNTP_DEBUG_STATE, ("sntp_recv: Kiss-of-Death or invalid stratum from server %"U16_F"\n",
+      (u16_t)i));
+  } else {
+    sntp_sample_compute(&sample, t1, sntp_read_timestamp(&timestamps[2]),
+                        sntp_read_timestamp(&timestamps[4]), t4);
+    sample.server = i;
+    if (!sntp_filter_add(&sntp_filter, &sample)) {
+      LWIP_DEBUGF(SNTP_DEBUG_WARN, ("sntp_recv: Round trip delay out of range\n"));
+    }
+  }
+  sntp_round_check();
+}
+
+/** Send an sntp request to a server, whose address is resolved */
+static void
+sntp_send_request(u8_t server)
+{
+  struct pbuf* p;
+  p = pbuf_alloc(PBUF_TRANSPORT, SNTP_MSG_LEN, PBUF_RAM);
+  if (p != NULL) {
+    struct sntp_msg *sntpmsg = (struct sntp_msg *)p->payload;
+    LWIP_DEBUGF(SNTP_DEBUG_STATE, ("sntp_send_request: Sending request to server %"U16_F"\n",
+      (u16_t)server));
+    /* initialize request message, with T1 as transmit timestamp */
+    sntp_initialize_request(sntpmsg);
+    sntp_servers[server].sent = sntp_get_timestamp();
+    sntpmsg->transmit_timestamp[0] = htonl((u32_t)(sntp_servers[server].sent >> 32));
+    sntpmsg->transmit_timestamp[1] = htonl((u32_t)sntp_servers[server].sent);
+    sntp_servers[server].state = SNTP_SERVER_SENT;
+    /* send request */
+    udp_sendto(sntp_pcb, p, &sntp_servers[server].addr, SNTP_PORT);
+    pbuf_free(p);
+  } else {
+    LWIP_DEBUGF(SNTP_DEBUG_SERIOUS, ("sntp_send_request: Out of memory\n"));
+    sntp_servers[server].state = SNTP_SERVER_DONE;
+  }
+}
+
+#if SNTP_SERVER_DNS
+/**
+ * DNS found callback when using DNS names as server address.
+ */
+static void
+sntp_dns_found(const char* hostname, ip_addr_t *ipaddr, void *arg)
+{
+  u8_t server = (u8_t)(mem_ptr_t)arg;
+
+  LWIP_UNUSED_ARG(hostname);
+
+  if (sntp_servers[server].state != SNTP_SERVER_RESOLVING) {
+    /* the round is over */
+    return;
+  }
+  if (ipaddr != NULL) {
+    /* Address resolved, send request */
+    LWIP_DEBUGF(SNTP_DEBUG_STATE, ("sntp_dns_found: Server address resolved, sending request\n"));
+    ip_addr_set(&sntp_servers[server].addr, ipaddr);
+    sntp_send_request(server);
+  } else {
+    LWIP_DEBUGF(SNTP_DEBUG_WARN_STATE, ("sntp_dns_found: Failed to resolve server address\n"));
+    sntp_servers[server].state = SNTP_SERVER_DONE;
+    sntp_round_check();
+  }
+}
+#endif /* SNTP_SERVER_DNS */
+
+/**
+ * Send out an sntp request to all servers via raw API, and collect the
+ * replies for SNTP_RECV_TIMEOUT.
+ *
+ * @param arg is unused (only necessary to conform to sys_timeout)
+ */
+static void
+sntp_request(void *arg)
+{
+  err_t err;
+  u8_t i;
+
+  LWIP_UNUSED_ARG(arg);
+  SNTP_ON_REQUEST();
+
+  sntp_filter_reset(&sntp_filter);
+  for (i = 0; i < sntp_num_servers; i++) {
+    sntp_servers[i].state = SNTP_SERVER_RESOLVING;
+  }
+  /* the round can't end before all requests are out */
+  sys_timeout((u32_t)SNTP_RECV_TIMEOUT, sntp_round_done, NULL);
+
+  for (i = 0; i < sntp_num_servers; i++) {
+    /* initialize SNTP server address */
+#if SNTP_SERVER_DNS
+    err = dns_gethostbyname(sntp_server_addresses[i], &sntp_servers[i].addr,
+      sntp_dns_found, (void *)(mem_ptr_t)i);
+    if (err == ERR_INPROGRESS) {
+      /* DNS request sent, wait for sntp_dns_found being called */
+      continue;
+    }
+#else /* SNTP_SERVER_DNS */
+    err = ipaddr_aton(sntp_server_addresses[i], &sntp_servers[i].addr)
+      ? ERR_OK : ERR_ARG;
+#endif /* SNTP_SERVER_DNS */
+
+    if (err == ERR_OK) {
+      sntp_send_request(i);
+    } else {
+      LWIP_DEBUGF(SNTP_DEBUG_WARN_STATE, ("sntp_request: Invalid server address %"U16_F"\n", (u16_t)i));
+      sntp_servers[i].state = SNTP_SERVER_DONE;
+    }
+  }
+}
+
+#else /* SNTP_PARALLEL_REQUESTS */
+
 #if (SNTP_NUM_SERVERS_SUPPORTED > 1)
 /**
  * If Kiss-of-Death is received (or another packet parsing error),
@@ -580,9 +856,10 @@ sntp_recv(void *arg, struct udp_pcb* pcb, struct pbuf *p, ip_addr_t *addr, u16_t
     sntp_process(receive_timestamp);
 
     /* Set up timeout for next request */
-    sys_timeout(sntp_update_delay, sntp_request, NULL);
+    u32_t delay = SNTP_GET_UPDATE_DELAY(sntp_update_delay);
+    sys_timeout(delay, sntp_request, NULL);
     LWIP_DEBUGF(SNTP_DEBUG_STATE, ("sntp_recv: Scheduled next time request: %"U32_F" ms\n",
-      sntp_update_delay));
+      delay));
   } else if (err == SNTP_ERR_KOD) {
     /* Kiss-of-death packet. Use another server or increase UPDATE_DELAY. */
     sntp_try_next_server(NULL);
@@ -658,6 +935,7 @@ sntp_request(void *arg)
   err_t err;
 
   LWIP_UNUSED_ARG(arg);
+  SNTP_ON_REQUEST();
 
   /* initialize SNTP server address */
 #if SNTP_SERVER_DNS
@@ -683,6 +961,8 @@ sntp_request(void *arg)
   }
 }
 
+#endif /* SNTP_PARALLEL_REQUESTS */
+
 /**
  * Initialize this module when using raw API.
  * Send out request instantly or after SNTP_STARTUP_DELAY.
@@ -730,7 +1010,7 @@ int sntp_set_servers(char *server_url[], int num_servers)
 
   /* Allocate memory and copy servers */
   for (i = 0; i < num_servers; i++) {
-    sntp_server_addresses[i] = malloc(strlen(server_url[i]));
+    sntp_server_addresses[i] = malloc(strlen(server_url[i]) + 1);
     if (sntp_server_addresses[i]) {
    	  strcpy(sntp_server_addresses[i], server_url[i]);
     } else {
@@ -11,6 +11,7 @@
 #include <stdint.h>
 #include <sys/time.h>
 #include <time.h>
+#include "sntp_clock.h"
 
 /*
  * Function used by lwIP sntp module to update the date/time,
@@ -18,6 +19,23 @@
  */
 #define SNTP_SET_SYSTEM_TIME_US(sec, us) sntp_update_rtc(sec, us)
 
+/*
+ * Functions used by lwIP sntp module to keep the RTC time running between
+ * updates, and to space them as the clock discipline asks.
+ */
+#define SNTP_ON_REQUEST()               sntp_anchor_rtc()
+#define SNTP_GET_UPDATE_DELAY(max_ms)   sntp_get_update_delay(max_ms)
+
+/*
+ * Function used by lwIP sntp module to timestamp requests and replies
+ */
+#define SNTP_GET_SYSTEM_TIME(sec, us)   sntp_get_rtc_utc(&(sec), &(us))
+
+/*
+ * Send requests to all servers at once and keep the best reply
+ */
+#define SNTP_PARALLEL_REQUESTS      1
+
 /*
  * For the lwIP implementation of SNTP to allow using names for NTP servers.
  */
@@ -39,8 +57,6 @@ void sntp_initialize(const struct timezone *tz);
 
 /*
  * Sets time zone. Allowed values are in the range [-11, 13].
- * NOTE: Settings do not take effect until SNTP time is updated. It is
- * recommended to set these parameters only during initialization.
  * WARNING: tz->tz_dsttime doesn't have the same meaning as the standard 
  * implementation. If it is set to 1, a dst hour will be applied. If set
  * to zero, time will not be modified.
@@ -48,29 +64,59 @@ void sntp_initialize(const struct timezone *tz);
 void sntp_set_timezone(const struct timezone *tz);
 
 /*
- * Set SNTP servers. Up to SNTP_NUM_SERVERS_SUPPORTED can be set.
+ * Set SNTP servers. Up to SNTP_NUM_SERVERS_SUPPORTED can be set. Each
+ * update queries all of them, and uses the reply with the shortest round
+ * trip.
  * Returns 0 if OK, less than 0 if error.
  * NOTE: This function must NOT be called before sntp_initialize().
  */
 int sntp_set_servers(char *server_url[], int num_servers);
 
 /*
- * Sets the update delay in ms. If requested value is less than 15s,
- * a 15s update interval will be set.
+ * Sets the longest update delay in ms. If requested value is less than 15s,
+ * a 15s update interval will be set. Updates start 64s apart, and get
+ * further apart up to this delay (but no more than 2^14s) as the RTC rate
+ * is learned.
  */
 void sntp_set_update_delay(uint32_t ms);
 
 /*
  * Returns the time read from RTC counter, in seconds from Epoch. If
- * us is not null, it will be filled with the microseconds.
+ * us is not null, it will be filled with the microseconds. Safe to call
+ * from any task or interrupt. Small corrections are slewed in, so the
+ * time only goes back when an update is more than SNTP_CLOCK_STEP_US off.
  */
 time_t sntp_get_rtc_time(int32_t *us);
 
+/*
+ * Returns the UTC time read from RTC counter, in seconds and microseconds
+ * from Epoch. Used by the SNTP module.
+ */
+void sntp_get_rtc_utc(uint32_t *sec, uint32_t *us);
+
 /*
  * Update RTC timer. This function is called by the SNTP module each time
  * an SNTP update is received.
  */
 void sntp_update_rtc(time_t t, uint32_t us);
 
+/*
+ * Moves the RTC time reference along. This function is called by the SNTP
+ * module before each request.
+ */
+void sntp_anchor_rtc(void);
+
+/*
+ * Returns the delay until the next update, up to max_ms. This function is
+ * called by the SNTP module after each update.
+ */
+uint32_t sntp_get_update_delay(uint32_t max_ms);
+
+/*
+ * Get the state of the clock discipline: last offset, jitter, RTC rate
+ * correction and update interval.
+ */
+void sntp_get_clock_stats(sntp_clock_stats_t *stats);
+
 #endif /* _SNTP_H_ */
 
@@ -0,0 +1,205 @@
+/*
+ * Clock discipline for the SNTP time keeping.
+ *
+ * See sntp_clock.h
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+
+#include <stddef.h>
+#include "sntp_clock.h"
+
+#define FRAC_MASK	((1U << SNTP_CLOCK_RATE_SHIFT) - 1)
+
+// Keeps the compiler from moving memory accesses across it. The clock is
+// only shared between tasks and interrupts of a single core.
+#define barrier()	__asm__ volatile("" : : : "memory")
+
+// Time since the anchor of 'p' at 'tick', in fractions of a us
+static int64_t clock_elapsed(const sntp_clock_params_t *p, uint32_t tick) {
+	uint32_t d = tick - p->tick;
+	int64_t slewed = (int64_t)p->rate + p->slew;
+
+	if (d <= p->slew_ticks) {
+		return p->frac + d * slewed;
+	}
+	return p->frac + p->slew_ticks * slewed + (int64_t)(d - p->slew_ticks) * p->rate;
+}
+
+// The parameters in use. Only for the updating task, which is the only one
+// changing them.
+static inline const sntp_clock_params_t *current(const sntp_clock_t *c) {
+	return &c->params[c->gen & 1];
+}
+
+static void publish(sntp_clock_t *c, const sntp_clock_params_t *p) {
+	c->params[(c->gen + 1) & 1] = *p;
+	barrier();
+	c->gen++;
+}
+
+// New parameters for the same time as 'p', anchored at 'tick'
+static void reanchor(sntp_clock_params_t *np, const sntp_clock_params_t *p, uint32_t tick) {
+	int64_t e = clock_elapsed(p, tick);
+	uint32_t d = tick - p->tick;
+
+	np->tick = tick;
+	np->us = p->us + (e >> SNTP_CLOCK_RATE_SHIFT);
+	np->frac = e & FRAC_MASK;
+	np->rate = p->rate;
+	np->slew = p->slew;
+	np->slew_ticks = d < p->slew_ticks ? p->slew_ticks - d : 0;
+}
+
+void sntp_clock_init(sntp_clock_t *c, uint32_t (*counter)(void), uint32_t rate) {
+	sntp_clock_params_t p = { .rate = rate };
+
+	c->counter = counter;
+	c->nominal = rate;
+	c->synced = false;
+	c->spike = false;
+	c->fll_reset = true;
+	c->poll = SNTP_CLOCK_MIN_POLL;
+	c->max_poll = SNTP_CLOCK_MAX_POLL;
+	c->poll_count = 0;
+	c->stats = (sntp_clock_stats_t) {
+		.jitter = SNTP_CLOCK_MIN_JITTER_US,
+		.poll = 1U << c->poll,
+	};
+	p.tick = counter();
+	publish(c, &p);
+}
+
+int64_t sntp_clock_read(const sntp_clock_t *c) {
+	sntp_clock_params_t p;
+	uint32_t gen, tick;
+
+	do {
+		gen = c->gen;
+		barrier();
+		// Read after the generation, so it can't be before the anchor
+		tick = c->counter();
+		p = c->params[gen & 1];
+		barrier();
+	} while (gen != c->gen);
+
+	return p.us + (clock_elapsed(&p, tick) >> SNTP_CLOCK_RATE_SHIFT);
+}
+
+void sntp_clock_anchor(sntp_clock_t *c) {
+	sntp_clock_params_t np;
+
+	reanchor(&np, current(c), c->counter());
+	publish(c, &np);
+}
+
+static void adjust_poll(sntp_clock_t *c, uint32_t offset) {
+	uint32_t jitter = c->stats.jitter;
+
+	if (offset <= 2 * jitter) {
+		// Within the noise, the rate is good enough to wait longer
+		if (++c->poll_count >= 4) {
+			c->poll_count = 0;
+			if (c->poll < c->max_poll) {
+				c->poll++;
+			}
+		}
+	} else if (offset > 4 * jitter) {
+		// The rate changed, or is not known well enough yet
+		c->poll_count = 0;
+		if (c->poll > SNTP_CLOCK_MIN_POLL) {
+			c->poll--;
+		}
+	} else if (c->poll_count > 0) {
+		c->poll_count--;
+	}
+
+	jitter = (3 * jitter + offset) / 4;
+	c->stats.jitter = jitter > SNTP_CLOCK_MIN_JITTER_US ? jitter : SNTP_CLOCK_MIN_JITTER_US;
+	c->stats.poll = 1U << c->poll;
+}
+
+void sntp_clock_update(sntp_clock_t *c, int64_t us) {
+	const sntp_clock_params_t *p = current(c);
+	sntp_clock_params_t np;
+	uint32_t tick = c->counter();
+	int64_t offset, owed, rate, limit;
+	uint32_t elapsed, d;
+
+	reanchor(&np, p, tick);
+	offset = us - np.us;
+	c->stats.updates++;
+	c->stats.offset = offset > INT32_MAX ? INT32_MAX : offset < INT32_MIN ? INT32_MIN : offset;
+
+	if (!c->synced || offset >= SNTP_CLOCK_STEP_US || offset <= -SNTP_CLOCK_STEP_US) {
+		// Ignore a single outlier once synced, but check again soon
+		if (c->synced && !c->spike) {
+			publish(c, &np);
+			c->spike = true;
+			c->poll = c->max_poll < SNTP_CLOCK_MIN_POLL ? c->max_poll : SNTP_CLOCK_MIN_POLL;
+			c->stats.poll = 1U << c->poll;
+			return;
+		}
+		np.us = us;
+		np.frac = 0;
+		np.slew = 0;
+		np.slew_ticks = 0;
+		publish(c, &np);
+
+		c->synced = true;
+		c->spike = false;
+		c->fll_reset = true;
+		c->last_tick = tick;
+		c->poll = c->max_poll < SNTP_CLOCK_MIN_POLL ? c->max_poll : SNTP_CLOCK_MIN_POLL;
+		c->poll_count = 0;
+		c->stats.poll = 1U << c->poll;
+		c->stats.steps++;
+		return;
+	}
+	c->spike = false;
+
+	// Part of the last offset still to be slewed out doesn't come from
+	// the rate
+	d = tick - p->tick;
+	owed = d < p->slew_ticks ? ((int64_t)(p->slew_ticks - d) * p->slew) >> SNTP_CLOCK_RATE_SHIFT : 0;
+	elapsed = tick - c->last_tick;
+	rate = p->rate;
+	if (elapsed) {
+		int64_t err = ((offset - owed) << SNTP_CLOCK_RATE_SHIFT) / elapsed;
+		// Take all of the first estimate, then average
+		rate += c->fll_reset ? err : err / 2;
+		limit = (int64_t)c->nominal * SNTP_CLOCK_MAX_FREQ_PPM / 1000000;
+		if (rate > c->nominal + limit) {
+			rate = c->nominal + limit;
+		} else if (rate < c->nominal - limit) {
+			rate = c->nominal - limit;
+		}
+		c->fll_reset = false;
+	}
+	c->last_tick = tick;
+
+	adjust_poll(c, offset < 0 ? -offset : offset);
+
+	// Slew the offset out at SNTP_CLOCK_SLEW_PPM
+	np.rate = rate;
+	np.slew_ticks = (((uint64_t)(offset < 0 ? -offset : offset) * (1000000 / SNTP_CLOCK_SLEW_PPM))
+			 << SNTP_CLOCK_RATE_SHIFT) / rate;
+	np.slew = np.slew_ticks ? (offset << SNTP_CLOCK_RATE_SHIFT) / np.slew_ticks : 0;
+	publish(c, &np);
+
+	c->stats.freq = (rate - (int64_t)c->nominal) * 1000000000 / c->nominal;
+}
+
+uint32_t sntp_clock_poll(sntp_clock_t *c, uint8_t max_poll) {
+	c->max_poll = max_poll < SNTP_CLOCK_MAX_POLL ? max_poll : SNTP_CLOCK_MAX_POLL;
+	if (c->poll > c->max_poll) {
+		c->poll = c->max_poll;
+		c->stats.poll = 1U << c->poll;
+	}
+	return 1U << c->poll;
+}
+
+void sntp_clock_get_stats(const sntp_clock_t *c, sntp_clock_stats_t *stats) {
+	*stats = c->stats;
+}
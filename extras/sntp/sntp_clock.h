@@ -0,0 +1,141 @@
+/*
+ * Clock discipline for the SNTP time keeping.
+ *
+ * The time is kept as a linear function of a free running 32 bit counter
+ * (the RTC timer): an anchor (counter value and time) and a rate in us per
+ * counter tick. Each SNTP sample is compared against the clock:
+ *
+ * - Offsets under SNTP_CLOCK_STEP_US are slewed out, by running the clock
+ *   up to SNTP_CLOCK_SLEW_PPM faster or slower until they are gone, so
+ *   the time never jumps or goes backwards.
+ * - What is left of the offset since the last sample, after the slew, is
+ *   the error of the rate. It corrects the rate (a frequency locked loop).
+ * - Once the offsets stay within the jitter of the samples the poll
+ *   interval doubles, up to the maximum, and halves when they don't.
+ * - A first sample, or two offsets in a row over SNTP_CLOCK_STEP_US, step
+ *   the clock to the sample.
+ *
+ * Reading the clock takes no lock and can be done from any task or
+ * interrupt: the updating task writes new parameters into a second copy
+ * and then flips a generation count. Readers take the copy the count
+ * points to, and start over if the count changed meanwhile. Only one task
+ * may update the clock.
+ *
+ * Counter differences are taken modulo 2^32, so the clock must be updated
+ * or sntp_clock_anchor()'d at least once per counter wrap.
+ *
+ * No dependencies beyond the C library, extras/sntp/tests builds it on a
+ * host.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+
+#ifndef _SNTP_CLOCK_H_
+#define _SNTP_CLOCK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Larger offsets step the clock instead of slewing it
+#ifndef SNTP_CLOCK_STEP_US
+#define SNTP_CLOCK_STEP_US		128000
+#endif
+
+// Largest rate change while slewing, in ppm of the rate
+#ifndef SNTP_CLOCK_SLEW_PPM
+#define SNTP_CLOCK_SLEW_PPM		500
+#endif
+
+// Poll interval limits, log2 of seconds
+#ifndef SNTP_CLOCK_MIN_POLL
+#define SNTP_CLOCK_MIN_POLL		6
+#endif
+#ifndef SNTP_CLOCK_MAX_POLL
+#define SNTP_CLOCK_MAX_POLL		14
+#endif
+
+// Jitter is never taken to be less than this, in us
+#ifndef SNTP_CLOCK_MIN_JITTER_US
+#define SNTP_CLOCK_MIN_JITTER_US	1000
+#endif
+
+// Largest correction of the rate, in ppm of the initial rate
+#ifndef SNTP_CLOCK_MAX_FREQ_PPM
+#define SNTP_CLOCK_MAX_FREQ_PPM		20000
+#endif
+
+// Rates are in us per counter tick, with this many fractional bits
+#define SNTP_CLOCK_RATE_SHIFT		24
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	uint32_t tick;		// Counter value at the anchor
+	uint32_t frac;		// Time at the anchor: us, and fraction of
+	int64_t us;		// a us in SNTP_CLOCK_RATE_SHIFT bits
+	uint32_t rate;		// us per tick
+	int32_t slew;		// Added to the rate for slew_ticks after the
+	uint32_t slew_ticks;	// anchor
+} sntp_clock_params_t;
+
+typedef struct {
+	int32_t offset;		// Last offset of a sample from the clock, us
+	uint32_t jitter;	// Average size of the offsets, us
+	int32_t freq;		// Rate correction from the initial rate, ppb
+	uint32_t poll;		// Poll interval, s
+	uint32_t updates;	// Samples taken
+	uint32_t steps;		// Of which stepped the clock
+} sntp_clock_stats_t;
+
+typedef struct {
+	uint32_t (*counter)(void);
+	volatile uint32_t gen;
+	sntp_clock_params_t params[2];
+
+	// Only used by the updating task
+	uint32_t nominal;	// Initial rate
+	uint32_t last_tick;	// Counter at the last sample
+	bool synced;
+	bool spike;		// Last offset was over SNTP_CLOCK_STEP_US
+	bool fll_reset;		// Rate not corrected since the last step
+	uint8_t poll;		// log2 of the poll interval, in s
+	uint8_t max_poll;
+	int8_t poll_count;
+	sntp_clock_stats_t stats;
+} sntp_clock_t;
+
+/*
+ * Start the clock at 0 us, with 'rate' us per tick of 'counter'.
+ */
+void sntp_clock_init(sntp_clock_t *c, uint32_t (*counter)(void), uint32_t rate);
+
+/*
+ * Returns the time in us.
+ */
+int64_t sntp_clock_read(const sntp_clock_t *c);
+
+/*
+ * Take a sample of the time, 'us', and discipline the clock with it.
+ */
+void sntp_clock_update(sntp_clock_t *c, int64_t us);
+
+/*
+ * Move the anchor to the current counter value, without changing the time.
+ */
+void sntp_clock_anchor(sntp_clock_t *c);
+
+/*
+ * Limit the poll interval to 2^max_poll s, and return the current one.
+ */
+uint32_t sntp_clock_poll(sntp_clock_t *c, uint8_t max_poll);
+
+void sntp_clock_get_stats(const sntp_clock_t *c, sntp_clock_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SNTP_CLOCK_H_ */
@@ -0,0 +1,103 @@
+/*
+ * SNTP samples: offset and round trip delay from the four timestamps of a
+ * request and its reply, and picking the best of several replies.
+ *
+ * T1 is the local time the request was sent, T2 and T3 the server time it
+ * was received and the reply sent, T4 the local time the reply arrived:
+ *
+ *   offset = ((T2 - T1) + (T3 - T4)) / 2
+ *   delay  = (T4 - T1) - (T3 - T2)
+ *
+ * The offset is exact if the network takes as long each way, and off by
+ * up to half the delay if it doesn't. So of several samples, the one with
+ * the lowest delay is kept (the clock filter of NTP).
+ *
+ * Timestamps are NTP's 32.32 fixed point seconds since 1900. Only
+ * differences are taken, modulo 2^64, so they work across the 2036
+ * rollover for clocks less than 68 years apart.
+ *
+ * No dependencies beyond the C library, extras/sntp/tests builds it on a
+ * host.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+
+#ifndef _SNTP_FILTER_H_
+#define _SNTP_FILTER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Replies with a longer round trip are not used, in us
+#ifndef SNTP_MAX_DELAY_US
+#define SNTP_MAX_DELAY_US		1000000
+#endif
+
+// Rounding can make the delay to a close server a little negative.
+// It is taken as 0 down to this, and the reply not used below it.
+#define SNTP_MIN_DELAY_US		-1000
+
+// Seconds from 1900 to 1970
+#define SNTP_UNIX_EPOCH			2208988800UL
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint64_t sntp_timestamp_t;
+
+typedef struct {
+	int64_t offset;		// Server time minus local time, us
+	int64_t delay;		// Round trip, us
+	uint8_t server;
+} sntp_sample_t;
+
+typedef struct {
+	uint8_t count;		// Samples used
+	sntp_sample_t best;	// The one with the lowest delay
+} sntp_filter_t;
+
+// Timestamp of a Unix time, us rounded to the nearest fraction
+static inline sntp_timestamp_t sntp_timestamp(uint32_t sec, uint32_t us) {
+	return ((uint64_t)(uint32_t)(sec + SNTP_UNIX_EPOCH) << 32) |
+		((((uint64_t)us << 32) + 500000) / 1000000);
+}
+
+// a - b in us, rounded to nearest
+static inline int64_t sntp_timestamp_diff(sntp_timestamp_t a, sntp_timestamp_t b) {
+	int64_t d = (int64_t)(a - b);
+
+	return (d >> 32) * 1000000 + (((d & 0xffffffff) * 1000000 + (1U << 31)) >> 32);
+}
+
+static inline void sntp_sample_compute(sntp_sample_t *s, sntp_timestamp_t t1,
+		sntp_timestamp_t t2, sntp_timestamp_t t3, sntp_timestamp_t t4) {
+	s->offset = (sntp_timestamp_diff(t2, t1) + sntp_timestamp_diff(t3, t4)) / 2;
+	s->delay = sntp_timestamp_diff(t4, t1) - sntp_timestamp_diff(t3, t2);
+}
+
+static inline void sntp_filter_reset(sntp_filter_t *f) {
+	f->count = 0;
+}
+
+// Returns false if the sample is not usable
+static inline bool sntp_filter_add(sntp_filter_t *f, const sntp_sample_t *s) {
+	if (s->delay > SNTP_MAX_DELAY_US || s->delay < SNTP_MIN_DELAY_US) {
+		return false;
+	}
+	if (!f->count || s->delay < f->best.delay) {
+		f->best = *s;
+		if (f->best.delay < 0) {
+			f->best.delay = 0;
+		}
+	}
+	f->count++;
+	return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SNTP_FILTER_H_ */
@@ -13,15 +13,12 @@
 #include <esp/rtc_regs.h>
 #include "sntp.h"
 
-#define TIMER_COUNT			RTC.COUNTER
+// Time kept on the RTC timer, disciplined by the SNTP updates
+static sntp_clock_t clk;
 
-// daylight settings
-// Base calculated with value obtained from NTP server (64 bits)
-#define sntp_base	(*((uint64_t*)RTC.SCRATCH))
-// Timer value when base was obtained
-#define tim_ref 	(RTC.SCRATCH[2])
-// Calibration value
-#define cal 		(RTC.SCRATCH[3])
+static uint32_t rtc_counter(void) {
+	return RTC.COUNTER;
+}
 
 // Timezone related data.
 static struct timezone stz;
@@ -30,7 +27,6 @@ static struct timezone stz;
 void sntp_init(void);
 
 // Sets time zone.
-// NOTE: Settings do not take effect until SNTP time is updated.
 void sntp_set_timezone(const struct timezone *tz) {
 	if (tz) {
 		stz = *tz;
@@ -48,40 +44,30 @@ void sntp_initialize(const struct timezone *tz) {
 		stz.tz_minuteswest = 0;
 		stz.tz_dsttime = 0;
 	}
-	sntp_base = 0;
-	// To avoid div by 0 exceptions if requesting time before SNTP config
-	cal = 1;
-	tim_ref = TIMER_COUNT;
+	// The calibration is the RTC period in us, with 12 fractional bits.
+	// It is only the starting point, the updates correct the rate.
+	sntp_clock_init(&clk, rtc_counter,
+			sdk_system_rtc_clock_cali_proc() << (SNTP_CLOCK_RATE_SHIFT - 12));
 	sntp_init();
 }
 
-// Check if a timer wrap has occurred. Compensate sntp_base reference
-// if affirmative.
-// TODO: think about multitasking and race conditions
-static inline void sntp_check_timer_wrap(uint32_t current_value) {
-	if (current_value < tim_ref) {
-		// Timer wrap has occurred, compensate by subtracting 2^32 to ref.
-		sntp_base -= 1LLU<<32;
-		// DEBUG
-		printf("\nTIMER WRAPPED!\n");
-	}
-}
-
 // Return secs. If us is not a null pointer, fill it with usecs
-inline time_t sntp_get_rtc_time(int32_t *us) {
-	time_t secs;
-	uint32_t tim;
-	uint64_t base;
-
-	tim = TIMER_COUNT;
-	// Check for timer wrap
-	sntp_check_timer_wrap(tim);
-	base = sntp_base + tim - tim_ref;
-	secs = base * cal / (1000000U<<12);
+time_t sntp_get_rtc_time(int32_t *us) {
+	// Apply daylight and timezone correction
+	int64_t t = sntp_clock_read(&clk) +
+		(int64_t)(stz.tz_minuteswest + stz.tz_dsttime * 60) * 60 * 1000000;
+
 	if (us) {
-		*us = base * cal % (1000000U<<12);
+		*us = t % 1000000;
 	}
-	return secs;
+	return t / 1000000;
+}
+
+void sntp_get_rtc_utc(uint32_t *sec, uint32_t *us) {
+	int64_t t = sntp_clock_read(&clk);
+
+	*sec = t / 1000000;
+	*us = t % 1000000;
 }
 
 // Syscall implementation. doesn't seem to use tzp.
@@ -97,16 +83,23 @@ int _gettimeofday_r(struct _reent *r, struct timeval *tp, void *tzp) {
 
 // Update RTC timer. Called by SNTP module each time it receives an update.
 void sntp_update_rtc(time_t t, uint32_t us) {
-	// Apply daylight and timezone correction
-	t += (stz.tz_minuteswest + stz.tz_dsttime * 60) * 60;
-	// DEBUG: Compute and print drift
-	int64_t sntp_current = sntp_base + TIMER_COUNT - tim_ref;
-	int64_t sntp_correct = (((uint64_t)us + (uint64_t)t * 1000000U)<<12) / cal;
-	printf("\nRTC Adjust: drift = %ld ticks, cal = %d\n", (time_t)(sntp_correct - sntp_current), cal);
+	sntp_clock_update(&clk, (int64_t)t * 1000000 + us);
+}
 
-	tim_ref = TIMER_COUNT;
-	cal = sdk_system_rtc_clock_cali_proc();
+// Called by SNTP module before each request. The clock has to be anchored
+// at least once per RTC timer wrap, even when no updates arrive.
+void sntp_anchor_rtc(void) {
+	sntp_clock_anchor(&clk);
+}
+
+// Called by SNTP module after an update, for the delay until the next one
+uint32_t sntp_get_update_delay(uint32_t max_ms) {
+	uint8_t max_poll = 31 - __builtin_clz(max_ms / 1000);
+	uint32_t ms = sntp_clock_poll(&clk, max_poll) * 1000;
 
-	sntp_base = (((uint64_t)us + (uint64_t)t * 1000000U)<<12) / cal;
+	return ms < max_ms ? ms : max_ms;
 }
 
+void sntp_get_clock_stats(sntp_clock_stats_t *stats) {
+	sntp_clock_get_stats(&clk, stats);
+}
@@ -0,0 +1,300 @@
+/* Host tests for sntp_clock.c: the clock runs on a simulated RTC counter
+ * that is off from its calibration and wanders, disciplined by samples
+ * with network jitter.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "sntp_clock.h"
+#include "check.h"
+
+/* Calibrated RTC period, 5.5 us */
+#define CAL_US   5.5
+#define NOMINAL  ((uint32_t)(CAL_US * (1 << SNTP_CLOCK_RATE_SHIFT)))
+#define EPOCH_US 1500000000000000LL
+
+/* Simulated time and counter */
+static double now_us;
+static double next_poll_us;
+static double period_us;
+static double tick_base;
+static uint32_t tick_start;
+static void (*counter_hook)(void);
+
+static uint32_t counter(void)
+{
+    if (counter_hook) {
+        void (*hook)(void) = counter_hook;
+        counter_hook = NULL;
+        hook();
+    }
+    return tick_start + (uint32_t)(uint64_t)(tick_base + now_us / period_us);
+}
+
+/* Change the period from now on, keeping the count */
+static void set_drift(double ppm)
+{
+    tick_base += now_us / period_us;
+    period_us = CAL_US * (1 + ppm * 1e-6);
+    tick_base -= now_us / period_us;
+}
+
+static void sim_start(double ppm, uint32_t start)
+{
+    now_us = 0;
+    next_poll_us = 0;
+    tick_base = 0;
+    tick_start = start;
+    period_us = CAL_US;
+    set_drift(ppm);
+}
+
+static uint32_t lcg = 12345;
+
+static double jitter(double us)
+{
+    lcg = lcg * 1103515245 + 12345;
+    return ((lcg >> 8) / (double)(1 << 24) * 2 - 1) * us;
+}
+
+typedef struct {
+    uint32_t polls;
+    double max_error;       /* Of reads, us */
+    bool monotonic;
+} sim_result_t;
+
+/* Run for 'seconds', polling when the clock asks to, with samples off by
+   up to 'noise' us. Reads the clock in between. */
+static void sim_run(sntp_clock_t *c, double seconds, double noise, sim_result_t *r)
+{
+    double end = now_us + seconds * 1e6;
+    int64_t last = sntp_clock_read(c);
+
+    r->polls = 0;
+    r->max_error = 0;
+    r->monotonic = true;
+    while (now_us < end) {
+        if (now_us >= next_poll_us) {
+            sntp_clock_update(c, EPOCH_US + (int64_t)(now_us + jitter(noise)));
+            r->polls++;
+            next_poll_us = now_us + sntp_clock_poll(c, SNTP_CLOCK_MAX_POLL) * 1e6;
+        }
+        /* Read at random times until the next poll */
+        double until = fmin(next_poll_us, end);
+        for (int i = 16; i > 0; i--) {
+            now_us += (until - now_us) / i * (1 + jitter(0.5));
+            now_us = fmin(now_us, until);
+            int64_t t = sntp_clock_read(c);
+            if (t < last) {
+                r->monotonic = false;
+            }
+            last = t;
+            double e = fabs((double)(t - EPOCH_US) - now_us);
+            if (e > r->max_error) {
+                r->max_error = e;
+            }
+        }
+        now_us = until;
+    }
+}
+
+static void test_free_running(void)
+{
+    sntp_clock_t c;
+
+    sim_start(0, 1000);
+    sntp_clock_init(&c, counter, NOMINAL);
+    CHECK(sntp_clock_read(&c) == 0);
+    now_us = 1e6;
+    CHECK(llabs(sntp_clock_read(&c) - 1000000) <= 6);
+
+    /* Across the counter wrapping, with the anchor moved along */
+    sim_start(0, UINT32_MAX - 1000);
+    sntp_clock_init(&c, counter, NOMINAL);
+    for (int i = 1; i <= 10; i++) {
+        now_us = i * 3600e6;
+        sntp_clock_anchor(&c);
+        CHECK(llabs(sntp_clock_read(&c) - (int64_t)now_us) <= 6);
+    }
+}
+
+static void test_step(void)
+{
+    sntp_clock_t c;
+    sntp_clock_stats_t s;
+
+    sim_start(0, 0);
+    sntp_clock_init(&c, counter, NOMINAL);
+    now_us = 5e6;
+    sntp_clock_update(&c, EPOCH_US);
+    CHECK(sntp_clock_read(&c) == EPOCH_US);
+
+    /* A single outlier is ignored */
+    now_us += 64e6;
+    sntp_clock_update(&c, EPOCH_US + 64000000 + 10 * SNTP_CLOCK_STEP_US);
+    CHECK(llabs(sntp_clock_read(&c) - EPOCH_US - 64000000) < 20);
+    sntp_clock_get_stats(&c, &s);
+    CHECK(s.steps == 1 && s.updates == 2);
+
+    /* Small offsets are slewed, the clock catches up at the slew rate */
+    now_us += 64e6;
+    sntp_clock_update(&c, EPOCH_US + 128000000 + 10000);
+    int64_t t0 = sntp_clock_read(&c);
+    CHECK(llabs(t0 - EPOCH_US - 128000000) < 20);
+    /* and the rate takes it as a frequency error */
+    sntp_clock_get_stats(&c, &s);
+    CHECK(s.freq > 70000 && s.freq < 80000);
+    double rate = 1 + s.freq * 1e-9;
+    now_us += 1e6;
+    CHECK(llabs(sntp_clock_read(&c) - t0 - (int64_t)(1e6 * rate) - SNTP_CLOCK_SLEW_PPM) < 20);
+    now_us += 60e6;
+    CHECK(llabs(sntp_clock_read(&c) - t0 - (int64_t)(61e6 * rate) - 10000) < 20);
+
+    /* Two outliers in a row step the clock */
+    now_us += 64e6;
+    sntp_clock_update(&c, EPOCH_US + (int64_t)now_us - 1000000);
+    now_us += 64e6;
+    sntp_clock_update(&c, EPOCH_US + (int64_t)now_us - 1000000);
+    CHECK(sntp_clock_read(&c) == EPOCH_US + (int64_t)now_us - 1000000);
+    sntp_clock_get_stats(&c, &s);
+    CHECK(s.steps == 2 && s.poll == 1U << SNTP_CLOCK_MIN_POLL);
+}
+
+/* The RTC is 300 ppm off its calibration, the samples have +-5 ms of
+   jitter. The rate is learned, and the poll interval goes up. */
+static void test_converge(void)
+{
+    sntp_clock_t c;
+    sntp_clock_stats_t s;
+    sim_result_t r;
+
+    sim_start(300, UINT32_MAX - 100000);
+    sntp_clock_init(&c, counter, NOMINAL);
+
+    sim_run(&c, 86400, 5000, &r);
+    sntp_clock_get_stats(&c, &s);
+    printf("converge, first day: %u polls, freq %+d ppb, poll %u s, max error %.1f ms\n",
+           r.polls, s.freq, s.poll, r.max_error / 1000);
+    CHECK(r.monotonic);
+    CHECK(s.steps == 1);
+    CHECK(fabs(s.freq / 1000.0 - 300) < 5);
+
+    sim_run(&c, 2 * 86400, 5000, &r);
+    sntp_clock_get_stats(&c, &s);
+    printf("converge, next two days: %u polls, freq %+d ppb, poll %u s, max error %.1f ms\n",
+           r.polls, s.freq, s.poll, r.max_error / 1000);
+    CHECK(r.monotonic);
+    CHECK(s.steps == 1);
+    CHECK(s.poll == 1U << SNTP_CLOCK_MAX_POLL);
+    /* Polling every 64 s would take 4050 */
+    CHECK(r.polls < 40);
+    CHECK(fabs(s.freq / 1000.0 - 300) < 1);
+    CHECK(r.max_error < 15000);
+}
+
+/* The RTC speeds up by 20 ppm over 12 hours, say it got colder. The
+   clock follows without stepping. */
+static void test_wander(void)
+{
+    sntp_clock_t c;
+    sntp_clock_stats_t s;
+    sim_result_t r;
+    double max_error = 0;
+    uint32_t polls = 0;
+
+    sim_start(-100, 0);
+    sntp_clock_init(&c, counter, NOMINAL);
+    sim_run(&c, 2 * 86400, 2000, &r);
+
+    for (int i = 1; i <= 120; i++) {
+        set_drift(-100 - i / 6.0);
+        sim_run(&c, 360, 2000, &r);
+        CHECK(r.monotonic);
+        max_error = fmax(max_error, r.max_error);
+        polls += r.polls;
+    }
+    sim_run(&c, 86400, 2000, &r);
+    sntp_clock_get_stats(&c, &s);
+    printf("wander: %u polls, freq %+d ppb, poll %u s, max error %.1f ms\n",
+           polls + r.polls, s.freq, s.poll, fmax(max_error, r.max_error) / 1000);
+    CHECK(r.monotonic);
+    CHECK(s.steps == 1);
+    CHECK(fabs(s.freq / 1000.0 + 120) < 1);
+    CHECK(max_error < SNTP_CLOCK_STEP_US);
+}
+
+/* A sudden 50 ppm change is too much at the longest poll interval. The
+   clock steps after two large offsets, and settles again. */
+static void test_jump(void)
+{
+    sntp_clock_t c;
+    sntp_clock_stats_t s;
+    sim_result_t r;
+
+    sim_start(200, 0);
+    sntp_clock_init(&c, counter, NOMINAL);
+    sim_run(&c, 2 * 86400, 2000, &r);
+    CHECK(sntp_clock_poll(&c, SNTP_CLOCK_MAX_POLL) == 1U << SNTP_CLOCK_MAX_POLL);
+
+    set_drift(250);
+    sim_run(&c, 86400, 2000, &r);
+    sim_run(&c, 86400, 2000, &r);
+    sntp_clock_get_stats(&c, &s);
+    printf("jump: %u polls, freq %+d ppb, poll %u s, max error %.1f ms\n",
+           r.polls, s.freq, s.poll, r.max_error / 1000);
+    CHECK(s.steps == 2);
+    CHECK(r.monotonic);
+    CHECK(fabs(s.freq / 1000.0 - 250) < 1);
+    CHECK(r.max_error < 15000);
+}
+
+/* Updates from an "interrupt" in the middle of a read */
+static sntp_clock_t *racing;
+
+static void race_update(void)
+{
+    sntp_clock_update(racing, EPOCH_US + (int64_t)now_us + 20000);
+}
+
+static void race_anchor(void)
+{
+    sntp_clock_anchor(racing);
+}
+
+static void test_read_race(void)
+{
+    sntp_clock_t c;
+
+    racing = &c;
+    sim_start(0, UINT32_MAX - 10);
+    sntp_clock_init(&c, counter, NOMINAL);
+    sntp_clock_update(&c, EPOCH_US);
+
+    now_us += 100e6;
+    int64_t t = sntp_clock_read(&c);
+    counter_hook = race_update;
+    int64_t t2 = sntp_clock_read(&c);
+    CHECK(t2 >= t && t2 - t < 20);
+    uint32_t gen = c.gen;
+
+    now_us += 1e6;
+    counter_hook = race_anchor;
+    int64_t t3 = sntp_clock_read(&c);
+    CHECK(c.gen == gen + 1);
+    CHECK(t3 - t2 > 1000000 && t3 - t2 < 1000000 + 2 * SNTP_CLOCK_SLEW_PPM);
+}
+
+int main(void)
+{
+    test_free_running();
+    test_step();
+    test_converge();
+    test_wander();
+    test_jump();
+    test_read_race();
+
+    return check_done("sntp_clock");
+}
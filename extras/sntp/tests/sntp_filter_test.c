@@ -0,0 +1,125 @@
+/* Host unit tests for sntp_filter.h: offset and delay from the four
+ * timestamps, across the NTP era rollover, and keeping the reply with
+ * the lowest delay.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "sntp_filter.h"
+#include "check.h"
+
+/* 2026-01-01 */
+#define NOW 1767225600U
+
+/* Timestamp 'us' from 'sec' */
+static sntp_timestamp_t ts(uint32_t sec, int64_t us)
+{
+    sec += us / 1000000;
+    us %= 1000000;
+    if (us < 0) {
+        sec--;
+        us += 1000000;
+    }
+    return sntp_timestamp(sec, us);
+}
+
+static void test_timestamp(void)
+{
+    CHECK(sntp_timestamp(0, 0) == (uint64_t)SNTP_UNIX_EPOCH << 32);
+    CHECK((uint32_t)sntp_timestamp(NOW, 500000) == 0x80000000);
+    CHECK(sntp_timestamp_diff(ts(NOW, 1), ts(NOW, 0)) == 1);
+    CHECK(sntp_timestamp_diff(ts(NOW, 0), ts(NOW, 1)) == -1);
+    CHECK(sntp_timestamp_diff(ts(NOW, 2500000), ts(NOW, 0)) == 2500000);
+    CHECK(sntp_timestamp_diff(ts(NOW, 0), ts(NOW, 2500000)) == -2500000);
+    /* Local clock right after boot, 56 years behind */
+    CHECK(sntp_timestamp_diff(ts(NOW, 0), ts(3, 0)) == (int64_t)(NOW - 3) * 1000000);
+}
+
+static void test_sample(void)
+{
+    sntp_sample_t s;
+
+    /* Local clock 250 ms behind, 20 ms each way, 1 ms in the server */
+    int64_t off = 250000;
+    sntp_sample_compute(&s, ts(NOW, 0), ts(NOW, off + 20000),
+                        ts(NOW, off + 21000), ts(NOW, 41000));
+    CHECK(s.offset == off);
+    CHECK(s.delay == 40000);
+
+    /* and ahead */
+    off = -3000000;
+    sntp_sample_compute(&s, ts(NOW, 0), ts(NOW, off + 20000),
+                        ts(NOW, off + 21000), ts(NOW, 41000));
+    CHECK(s.offset == off);
+    CHECK(s.delay == 40000);
+
+    /* 30 ms out, 10 ms back: off by half the difference */
+    sntp_sample_compute(&s, ts(NOW, 0), ts(NOW, 30000), ts(NOW, 30000), ts(NOW, 40000));
+    CHECK(s.offset == 10000);
+    CHECK(s.delay == 40000);
+
+    /* The first sync after boot */
+    sntp_sample_compute(&s, ts(5, 0), ts(NOW, 10000), ts(NOW, 10000), ts(5, 20000));
+    CHECK(s.offset == (int64_t)(NOW - 5) * 1000000);
+    CHECK(s.delay == 20000);
+}
+
+/* The server is in the next NTP era, its seconds wrapped around */
+static void test_era(void)
+{
+    sntp_sample_t s;
+    uint32_t wrap = (uint32_t)(0 - SNTP_UNIX_EPOCH);     /* 2036-02-07 */
+
+    sntp_sample_compute(&s, ts(wrap - 1, 0), ts(wrap, 500000),
+                        ts(wrap, 500000), ts(wrap - 1, 1000000));
+    CHECK(s.offset == 1000000);
+    CHECK(s.delay == 1000000);
+    CHECK(sntp_timestamp(wrap, 0) >> 32 == 0);
+}
+
+static void test_filter(void)
+{
+    sntp_filter_t f;
+    sntp_sample_t s;
+
+    sntp_filter_reset(&f);
+    CHECK(f.count == 0);
+
+    s = (sntp_sample_t) { .offset = 1000, .delay = 80000, .server = 0 };
+    CHECK(sntp_filter_add(&f, &s));
+    s = (sntp_sample_t) { .offset = 2000, .delay = 30000, .server = 1 };
+    CHECK(sntp_filter_add(&f, &s));
+    s = (sntp_sample_t) { .offset = 3000, .delay = 50000, .server = 2 };
+    CHECK(sntp_filter_add(&f, &s));
+    CHECK(f.count == 3);
+    CHECK(f.best.server == 1 && f.best.offset == 2000 && f.best.delay == 30000);
+
+    /* Delays out of range are not used */
+    s = (sntp_sample_t) { .offset = 4000, .delay = SNTP_MAX_DELAY_US + 1, .server = 3 };
+    CHECK(!sntp_filter_add(&f, &s));
+    s = (sntp_sample_t) { .offset = 4000, .delay = SNTP_MIN_DELAY_US - 1, .server = 3 };
+    CHECK(!sntp_filter_add(&f, &s));
+    CHECK(f.count == 3 && f.best.server == 1);
+
+    /* A little negative is from rounding */
+    s = (sntp_sample_t) { .offset = 5000, .delay = -10, .server = 3 };
+    CHECK(sntp_filter_add(&f, &s));
+    CHECK(f.best.server == 3 && f.best.delay == 0);
+
+    sntp_filter_reset(&f);
+    s = (sntp_sample_t) { .offset = 6000, .delay = 900000, .server = 2 };
+    CHECK(sntp_filter_add(&f, &s));
+    CHECK(f.count == 1 && f.best.server == 2);
+}
+
+int main(void)
+{
+    test_timestamp();
+    test_sample();
+    test_era();
+    test_filter();
+
+    return check_done("sntp_filter");
+}
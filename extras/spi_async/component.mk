@@ -0,0 +1,11 @@
+# Component makefile for extras/spi_async
+#
+# Interrupt driven, queued SPI master driver for HSPI, see spi_async.h
+# and examples/spi_async_bench. tests/ has host tests for the queue.
+
+INC_DIRS += $(spi_async_ROOT)
+
+# args for passing into compile rule generation
+spi_async_SRC_DIR = $(spi_async_ROOT)
+
+$(eval $(call component_compile_rules,spi_async))
@@ -0,0 +1,249 @@
+/* Interrupt driven, queued SPI master driver
+ *
+ * See spi_async.h
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <esp8266.h>
+#include <esp/spi.h>
+#include <esp/gpio.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Everything the interrupt handler calls has to be in IRAM */
+#define SPI_QUEUE_INLINE static inline __attribute__((always_inline))
+#include "spi_async.h"
+
+#define BUS 1
+
+#define SLAVE0_INT_STATUS (SPI_SLAVE0_TRANS_DONE | SPI_SLAVE0_WR_STA_DONE | SPI_SLAVE0_RD_STA_DONE | \
+                           SPI_SLAVE0_WR_BUF_DONE | SPI_SLAVE0_RD_BUF_DONE)
+
+#define USER0_PHASES (SPI_USER0_COMMAND | SPI_USER0_ADDR | SPI_USER0_DUMMY | SPI_USER0_MISO | SPI_USER0_MOSI)
+
+static spi_queue_t queue;
+static spi_async_stats_t stats;
+
+/* The bus is shared with spi_device_t users. spi_async takes it as a
+   device with the settings the bus had at spi_async_init(), and puts back
+   the registers it reprograms before giving it back. */
+static spi_device_t dev = { .bus = BUS, .cs_gpio = SPI_CS_NONE };
+static TaskHandle_t volatile owner;
+static unsigned holds;
+static uint32_t saved_user0, saved_user1, saved_user2, saved_addr;
+
+/* CS0 is driven by the bus, each block is a separate transaction for the
+   device then so it gets the command and address again, like
+   spi_transfer() does it */
+static bool hw_cs;
+
+static inline bool swap_bytes(void)
+{
+    return SPI(BUS).USER0 & SPI_USER0_WR_BYTE_ORDER;
+}
+
+static void IRAM start_chunk(const spi_async_trans_t *t, const spi_chunk_t *c)
+{
+    uint32_t user0 = SPI(BUS).USER0 & ~USER0_PHASES;
+    uint32_t user1 = 0;
+
+    if (c->first || (hw_cs && t->cs_gpio == SPI_ASYNC_CS_NONE)) {
+        if (t->cmd_bits) {
+            uint16_t command = t->cmd << (16 - t->cmd_bits);
+            command = (command >> 8) | (command << 8);
+            SPI(BUS).USER2 = VAL2FIELD_M(SPI_USER2_COMMAND_BITLEN, t->cmd_bits - 1) |
+                             VAL2FIELD_M(SPI_USER2_COMMAND_VALUE, command);
+            user0 |= SPI_USER0_COMMAND;
+        }
+        if (t->addr_bits) {
+            SPI(BUS).ADDR = t->addr << (32 - t->addr_bits);
+            user1 |= VAL2FIELD_M(SPI_USER1_ADDR_BITLEN, t->addr_bits - 1);
+            user0 |= SPI_USER0_ADDR;
+        }
+        if (t->dummy_bits) {
+            user1 |= VAL2FIELD_M(SPI_USER1_DUMMY_CYCLELEN, t->dummy_bits - 1);
+            user0 |= SPI_USER0_DUMMY;
+        }
+    }
+    if (c->bytes) {
+        uint32_t bits = c->bytes * 8 - 1;
+        user1 |= VAL2FIELD_M(SPI_USER1_MOSI_BITLEN, bits) | VAL2FIELD_M(SPI_USER1_MISO_BITLEN, bits);
+        user0 |= SPI_USER0_MOSI;
+    }
+    SPI(BUS).USER0 = user0;
+    SPI(BUS).USER1 = user1;
+    SPI(BUS).CMD |= SPI_CMD_USR;
+}
+
+/* Start the next chunk, if there is one. Interrupts must be disabled. */
+static void IRAM start_next(void)
+{
+    spi_async_trans_t *t = queue.head;
+    spi_chunk_t c;
+
+    if (!spi_queue_load(&queue, (uint32_t *)SPI(BUS).W, swap_bytes(), &c)) {
+        return;
+    }
+    if (c.first) {
+        stats.transactions++;
+        if (t->before) {
+            t->before(t);
+        }
+        if (t->cs_gpio != SPI_ASYNC_CS_NONE) {
+            gpio_write(t->cs_gpio, false);
+        }
+    }
+    stats.chunks++;
+    stats.bytes += c.bytes;
+    start_chunk(t, &c);
+}
+
+static void IRAM spi_async_isr(void)
+{
+    BaseType_t woken = pdFALSE;
+
+    /* The interrupt is shared with SPI0 and I2S */
+    if (!(DPORT.SPI_INT_STATUS & DPORT_SPI_INT_STATUS_SPI1)) {
+        return;
+    }
+    SPI(BUS).SLAVE0 &= ~SLAVE0_INT_STATUS;
+    stats.interrupts++;
+
+    spi_async_trans_t *t = spi_queue_unload(&queue, (uint32_t *)SPI(BUS).W, swap_bytes());
+    if (t && t->cs_gpio != SPI_ASYNC_CS_NONE && !(t->flags & SPI_ASYNC_KEEP_CS)) {
+        gpio_write(t->cs_gpio, true);
+    }
+    /* Keep the bus busy before doing anything else */
+    start_next();
+
+    if (t) {
+        TaskHandle_t task = t->task;
+        t->status = SPI_ASYNC_DONE;
+        if (t->done) {
+            t->done(t);
+        }
+        if (task) {
+            vTaskNotifyGiveFromISR(task, &woken);
+        }
+    }
+    portEND_SWITCHING_ISR(woken);
+}
+
+bool spi_async_init(uint8_t bus)
+{
+    spi_settings_t s;
+
+    if (bus != BUS) {
+        return false;
+    }
+    spi_get_settings(BUS, &s);
+    dev.settings = s;
+    hw_cs = !s.minimal_pins;
+    spi_queue_init(&queue);
+
+    SPI(BUS).SLAVE0 = (SPI(BUS).SLAVE0 & ~SLAVE0_INT_STATUS) | SPI_SLAVE0_TRANS_DONE_EN;
+    _xt_isr_attach(INUM_SPI, spi_async_isr);
+    _xt_isr_unmask(BIT(INUM_SPI));
+    return true;
+}
+
+bool spi_async_acquire(TickType_t timeout)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    if (owner == self) {
+        holds++;
+        return true;
+    }
+    if (!spi_device_acquire(&dev, timeout)) {
+        return false;
+    }
+    saved_user0 = SPI(BUS).USER0 & USER0_PHASES;
+    saved_user1 = SPI(BUS).USER1;
+    saved_user2 = SPI(BUS).USER2;
+    saved_addr = SPI(BUS).ADDR;
+    holds = 1;
+    owner = self;
+    return true;
+}
+
+void spi_async_release(void)
+{
+    if (--holds) {
+        return;
+    }
+    while (spi_async_busy()) {
+        vTaskDelay(1);
+    }
+    SPI(BUS).USER0 = (SPI(BUS).USER0 & ~USER0_PHASES) | saved_user0;
+    SPI(BUS).USER1 = saved_user1;
+    SPI(BUS).USER2 = saved_user2;
+    SPI(BUS).ADDR = saved_addr;
+    /* In case the next device relies on anything else written here */
+    spi_device_invalidate(BUS);
+    owner = NULL;
+    spi_device_release(&dev);
+}
+
+/* Safe to call with interrupts already disabled, e.g. from a callback */
+bool IRAM spi_async_queue(spi_async_trans_t *t)
+{
+    uint32_t ps = _xt_disable_interrupts();
+
+    if (!owner || t->status == SPI_ASYNC_QUEUED || t->status == SPI_ASYNC_ACTIVE) {
+        _xt_restore_interrupts(ps);
+        return false;
+    }
+    if (spi_queue_push(&queue, t)) {
+        start_next();
+    }
+    _xt_restore_interrupts(ps);
+    return true;
+}
+
+bool spi_async_wait(spi_async_trans_t *t, TickType_t timeout)
+{
+    TimeOut_t to;
+
+    vTaskSetTimeOutState(&to);
+    while (t->status == SPI_ASYNC_QUEUED || t->status == SPI_ASYNC_ACTIVE) {
+        if (xTaskCheckForTimeOut(&to, &timeout)) {
+            return false;
+        }
+        ulTaskNotifyTake(pdTRUE, timeout);
+    }
+    return true;
+}
+
+bool spi_async_transfer(spi_async_trans_t *t, TickType_t timeout)
+{
+    TimeOut_t to;
+    bool done;
+
+    vTaskSetTimeOutState(&to);
+    if (!spi_async_acquire(timeout)) {
+        return false;
+    }
+    t->task = xTaskGetCurrentTaskHandle();
+    if (!spi_async_queue(t)) {
+        spi_async_release();
+        return false;
+    }
+    xTaskCheckForTimeOut(&to, &timeout);
+    done = spi_async_wait(t, timeout);
+    spi_async_release();
+    return done;
+}
+
+bool spi_async_busy(void)
+{
+    return !spi_queue_empty(&queue);
+}
+
+void spi_async_get_stats(spi_async_stats_t *s)
+{
+    uint32_t ps = _xt_disable_interrupts();
+    *s = stats;
+    _xt_restore_interrupts(ps);
+}
@@ -0,0 +1,86 @@
+/* Interrupt driven, queued SPI master driver for HSPI (bus 1)
+ *
+ * spi_transfer() waits for every 64 byte block to be clocked out, so the
+ * CPU is busy for the whole transfer. Here transactions are queued
+ * instead: the caller fills in a spi_async_trans_t and returns, and the
+ * SPI interrupt refills W0-W15 after each block and starts the next
+ * transaction as soon as one finishes. When a transaction is done its
+ * 'done' callback runs (in the interrupt handler) and/or its task gets a
+ * notification.
+ *
+ * Each transaction is
+ *
+ *   [COMMAND]+[ADDRESS]+[DUMMY]+[DATA]
+ *
+ * with the data sent and received at the same time. Data longer than 64
+ * bytes goes out in blocks, the bus's own CS0 goes high between blocks,
+ * so give a cs_gpio for devices that need CS held for the whole
+ * transaction.
+ *
+ * Set up the bus with spi_init() first; its mode, clock and bit order at
+ * spi_async_init() are applied whenever spi_async takes the bus. Data is
+ * sent in memory order with either byte order. The bus is shared with
+ * spi_device_t users (see esp/spi.h): spi_async holds the bus lock while
+ * transactions are queued, and restores the registers it changes before
+ * giving it back. Transaction and data buffers must stay in RAM until the
+ * transaction is done.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _SPI_ASYNC_H
+#define _SPI_ASYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+#include "spi_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t chunks;
+    uint32_t bytes;
+    uint32_t interrupts;
+} spi_async_stats_t;
+
+/* Start using the bus (only 1, HSPI, is supported) for queued
+   transactions. Returns false for other buses. */
+bool spi_async_init(uint8_t bus);
+
+/* Take the bus lock for queuing transactions, waiting up to 'timeout'
+   ticks for other devices to give it back. Calls from the task holding it
+   nest. Returns false on timeout. */
+bool spi_async_acquire(TickType_t timeout);
+
+/* Undo spi_async_acquire(). The last one waits for the queue to empty
+   before giving the bus back. */
+void spi_async_release(void);
+
+/* Queue t, it is started as soon as the ones before it are done. A task
+   must hold the bus with spi_async_acquire(), and 'done' callbacks can
+   chain transactions while it does. Returns false if t is already queued
+   or nobody holds the bus. */
+bool spi_async_queue(spi_async_trans_t *t);
+
+/* Take the bus, queue t and wait up to 'timeout' ticks for it to be done,
+   using the calling task's notification, then give the bus back. Returns
+   false on timeout, the bus is held until t is done even then. */
+bool spi_async_transfer(spi_async_trans_t *t, TickType_t timeout);
+
+/* Wait for a transaction queued with t->task set to this task */
+bool spi_async_wait(spi_async_trans_t *t, TickType_t timeout);
+
+/* Whether any transaction is queued or running */
+bool spi_async_busy(void);
+
+void spi_async_get_stats(spi_async_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SPI_ASYNC_H */
@@ -0,0 +1,218 @@
+/* Transaction queue for extras/spi_async
+ *
+ * Transactions are caller owned descriptors, linked into a FIFO; the
+ * driver never allocates. The data phase of the transaction at the head
+ * is moved through the 64 byte W0-W15 buffer a chunk at a time:
+ * spi_queue_load() fills the buffer with the next chunk and says which
+ * phases it has, spi_queue_unload() copies received bytes out once the
+ * chunk is sent and pops the transaction after its last chunk. Command,
+ * address and dummy phases only go with the first chunk of a
+ * transaction.
+ *
+ * No dependencies beyond the C library, extras/spi_async/tests builds it
+ * on a host.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _SPI_QUEUE_H
+#define _SPI_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPI_QUEUE_CHUNK 64
+
+/* The driver makes sure these are inlined into its interrupt handler */
+#ifndef SPI_QUEUE_INLINE
+#define SPI_QUEUE_INLINE static inline
+#endif
+
+/* No chip select GPIO, use the bus's own CS0 (if set up) */
+#define SPI_ASYNC_CS_NONE 0xff
+
+/* Leave the CS GPIO low after this transaction, for the next one */
+#define SPI_ASYNC_KEEP_CS 0x01
+
+typedef enum {
+    SPI_ASYNC_IDLE = 0,
+    SPI_ASYNC_QUEUED,
+    SPI_ASYNC_ACTIVE,
+    SPI_ASYNC_DONE,
+} spi_async_status_t;
+
+typedef struct spi_async_trans spi_async_trans_t;
+
+typedef void (*spi_async_cb_t)(spi_async_trans_t *t);
+
+struct spi_async_trans {
+    uint16_t cmd;               /* cmd_bits (0..16) of command */
+    uint8_t cmd_bits;
+    uint8_t addr_bits;          /* addr_bits (0..32) of address */
+    uint32_t addr;
+    uint8_t dummy_bits;         /* 0..255 dummy clocks before the data */
+    uint8_t cs_gpio;            /* GPIO held low for the whole transaction */
+    uint8_t flags;              /* SPI_ASYNC_KEEP_CS */
+    const void *tx;             /* len bytes to send, zeros if NULL */
+    void *rx;                   /* len bytes received, dropped if NULL */
+    uint32_t len;
+
+    /* Called from the interrupt handler just before the transaction
+       starts, e.g. to set a display's D/C pin. Optional. */
+    spi_async_cb_t before;
+    /* Called from the interrupt handler when it is done. Optional. */
+    spi_async_cb_t done;
+    void *arg;                  /* For the callbacks */
+    void *task;                 /* TaskHandle_t notified when done, or NULL */
+
+    /* Driver state */
+    volatile spi_async_status_t status;
+    spi_async_trans_t *next;
+};
+
+typedef struct {
+    spi_async_trans_t *head;
+    spi_async_trans_t *tail;
+    uint32_t offset;            /* Data bytes of head already loaded */
+    uint32_t chunk;             /* Size of the chunk in the buffer */
+} spi_queue_t;
+
+typedef struct {
+    uint32_t bytes;             /* Data bytes in this chunk */
+    bool first;                 /* Has the command/address/dummy phases */
+    bool last;
+} spi_chunk_t;
+
+SPI_QUEUE_INLINE void spi_queue_init(spi_queue_t *q)
+{
+    q->head = q->tail = NULL;
+    q->offset = q->chunk = 0;
+}
+
+SPI_QUEUE_INLINE bool spi_queue_empty(const spi_queue_t *q)
+{
+    return q->head == NULL;
+}
+
+/* Append t. Returns true if the queue was empty, then the caller has to
+   start the bus. */
+SPI_QUEUE_INLINE bool spi_queue_push(spi_queue_t *q, spi_async_trans_t *t)
+{
+    t->next = NULL;
+    t->status = SPI_ASYNC_QUEUED;
+    if (q->tail) {
+        q->tail->next = t;
+        q->tail = t;
+        return false;
+    }
+    q->head = q->tail = t;
+    q->offset = q->chunk = 0;
+    return true;
+}
+
+/* The bus sends the words of W with the lowest address byte first when the
+   byte order is little endian, the other way round otherwise. */
+SPI_QUEUE_INLINE uint32_t spi_queue_swap(uint32_t v)
+{
+    return (v << 24) | ((v << 8) & 0x00ff0000) | ((v >> 8) & 0x0000ff00) | (v >> 24);
+}
+
+/* Copy len bytes into the words at w, which only allow 32 bit access */
+SPI_QUEUE_INLINE void spi_queue_put_words(uint32_t *w, const uint8_t *src, uint32_t len, bool swap)
+{
+    uint32_t words = (len + 3) / 4;
+
+    for (uint32_t i = 0; i < words; i++) {
+        uint32_t v;
+        if (src == NULL) {
+            v = 0;
+        } else if (!((uintptr_t)src & 3) && i * 4 + 4 <= len) {
+            v = ((const uint32_t *)src)[i];
+        } else {
+            const uint8_t *p = src + i * 4;
+            uint32_t n = len - i * 4 < 4 ? len - i * 4 : 4;
+            v = 0;
+            for (uint32_t j = 0; j < n; j++) {
+                v |= (uint32_t)p[j] << (j * 8);
+            }
+        }
+        w[i] = swap ? spi_queue_swap(v) : v;
+    }
+}
+
+SPI_QUEUE_INLINE void spi_queue_get_words(uint8_t *dst, const uint32_t *w, uint32_t len, bool swap)
+{
+    uint32_t words = (len + 3) / 4;
+
+    for (uint32_t i = 0; i < words; i++) {
+        uint32_t v = swap ? spi_queue_swap(w[i]) : w[i];
+        if (!((uintptr_t)dst & 3) && i * 4 + 4 <= len) {
+            ((uint32_t *)dst)[i] = v;
+        } else {
+            uint8_t *p = dst + i * 4;
+            uint32_t n = len - i * 4 < 4 ? len - i * 4 : 4;
+            for (uint32_t j = 0; j < n; j++) {
+                p[j] = v >> (j * 8);
+            }
+        }
+    }
+}
+
+/* Fill w with the next chunk of the transaction at the head. Returns false
+   if the queue is empty. */
+SPI_QUEUE_INLINE bool spi_queue_load(spi_queue_t *q, uint32_t *w, bool swap, spi_chunk_t *c)
+{
+    spi_async_trans_t *t = q->head;
+
+    if (!t) {
+        return false;
+    }
+    uint32_t left = t->len - q->offset;
+    c->bytes = left < SPI_QUEUE_CHUNK ? left : SPI_QUEUE_CHUNK;
+    c->first = q->offset == 0;
+    c->last = c->bytes == left;
+    q->chunk = c->bytes;
+    if (c->first) {
+        t->status = SPI_ASYNC_ACTIVE;
+    }
+    spi_queue_put_words(w, t->tx ? (const uint8_t *)t->tx + q->offset : NULL, c->bytes, swap);
+    return true;
+}
+
+/* The chunk from spi_queue_load() has been sent. Copy out what was
+   received and move on. Returns the transaction if that was its last
+   chunk, it is no longer in the queue then. */
+SPI_QUEUE_INLINE spi_async_trans_t *spi_queue_unload(spi_queue_t *q, const uint32_t *w, bool swap)
+{
+    spi_async_trans_t *t = q->head;
+
+    if (!t) {
+        return NULL;
+    }
+    if (t->rx && q->chunk) {
+        spi_queue_get_words((uint8_t *)t->rx + q->offset, w, q->chunk, swap);
+    }
+    q->offset += q->chunk;
+    q->chunk = 0;
+    if (q->offset < t->len) {
+        return NULL;
+    }
+    q->head = t->next;
+    if (!q->head) {
+        q->tail = NULL;
+    }
+    q->offset = 0;
+    t->next = NULL;
+    return t;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SPI_QUEUE_H */
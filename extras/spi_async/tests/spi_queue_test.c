@@ -0,0 +1,175 @@
+/* Host unit tests for spi_queue.h. A loop standing in for the SPI
+ * interrupt handler moves transactions through a fake W0-W15 buffer
+ * that is looped back, so everything sent should be received.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "spi_queue.h"
+#include "check.h"
+
+static uint32_t W[16];
+
+/* Chunks seen by the fake bus */
+static spi_chunk_t chunks[64];
+static int nchunks;
+
+static spi_async_trans_t *completed[16];
+static int ncompleted;
+
+/* What spi_async.c does in its interrupt handler, with the bus being a
+   loopback */
+static void run(spi_queue_t *q, bool swap)
+{
+    spi_chunk_t c;
+
+    nchunks = ncompleted = 0;
+    while (spi_queue_load(q, W, swap, &c)) {
+        CHECK(nchunks < 64);
+        chunks[nchunks++] = c;
+        spi_async_trans_t *t = spi_queue_unload(q, W, swap);
+        CHECK(!!t == c.last);
+        if (t) {
+            t->status = SPI_ASYNC_DONE;
+            completed[ncompleted++] = t;
+        }
+    }
+}
+
+static void test_push(void)
+{
+    spi_async_trans_t a = { 0 }, b = { 0 };
+    spi_queue_t q;
+
+    spi_queue_init(&q);
+    CHECK(spi_queue_empty(&q));
+    CHECK(spi_queue_push(&q, &a));
+    CHECK(a.status == SPI_ASYNC_QUEUED);
+    /* Already running, the interrupt handler starts the next one */
+    CHECK(!spi_queue_push(&q, &b));
+    CHECK(q.head == &a && q.tail == &b && a.next == &b);
+    run(&q, false);
+    CHECK(spi_queue_empty(&q) && q.tail == NULL);
+    CHECK(ncompleted == 2 && completed[0] == &a && completed[1] == &b);
+    CHECK(spi_queue_push(&q, &b));
+}
+
+static void test_chunks(void)
+{
+    static uint8_t tx[150];
+    spi_async_trans_t t = { .tx = tx, .len = sizeof(tx) };
+    spi_queue_t q;
+
+    spi_queue_init(&q);
+    spi_queue_push(&q, &t);
+    run(&q, false);
+    CHECK(nchunks == 3);
+    CHECK(chunks[0].bytes == 64 && chunks[0].first && !chunks[0].last);
+    CHECK(chunks[1].bytes == 64 && !chunks[1].first && !chunks[1].last);
+    CHECK(chunks[2].bytes == 22 && !chunks[2].first && chunks[2].last);
+    CHECK(t.status == SPI_ASYNC_DONE);
+
+    /* Exact multiple of the buffer */
+    t.len = 128;
+    spi_queue_push(&q, &t);
+    run(&q, false);
+    CHECK(nchunks == 2 && chunks[1].bytes == 64 && chunks[1].last);
+
+    /* Command only, no data phase */
+    t.len = 0;
+    spi_queue_push(&q, &t);
+    run(&q, false);
+    CHECK(nchunks == 1 && chunks[0].bytes == 0 && chunks[0].first && chunks[0].last);
+    CHECK(ncompleted == 1);
+}
+
+static void test_words(void)
+{
+    const uint8_t bytes[] = { 1, 2, 3, 4, 5, 6 };
+    uint8_t out[8];
+
+    memset(W, 0xaa, sizeof(W));
+    spi_queue_put_words(W, bytes, 6, false);
+    CHECK(W[0] == 0x04030201 && W[1] == 0x0605);
+    spi_queue_put_words(W, bytes, 6, true);
+    CHECK(W[0] == 0x01020304 && W[1] == 0x05060000);
+    spi_queue_put_words(W, NULL, 5, false);
+    CHECK(W[0] == 0 && W[1] == 0 && W[2] == 0xaaaaaaaa);
+
+    /* Only len bytes are written out */
+    memset(out, 0xee, sizeof(out));
+    W[0] = 0x04030201;
+    W[1] = 0x08070605;
+    spi_queue_get_words(out + 1, W, 5, false);
+    CHECK(out[0] == 0xee && memcmp(out + 1, "\1\2\3\4\5", 5) == 0 && out[6] == 0xee);
+}
+
+static void test_loopback(void)
+{
+    static uint8_t tx[300], rx[304];
+    spi_queue_t q;
+
+    for (size_t i = 0; i < sizeof(tx); i++) {
+        tx[i] = i * 7 + 1;
+    }
+    spi_queue_init(&q);
+    /* Every alignment of both buffers, both byte orders */
+    for (int swap = 0; swap < 2; swap++) {
+        for (int a = 0; a < 4; a++) {
+            for (int b = 0; b < 4; b++) {
+                spi_async_trans_t t = { .tx = tx + a, .rx = rx + b, .len = 257 + a };
+                memset(rx, 0, sizeof(rx));
+                spi_queue_push(&q, &t);
+                run(&q, swap);
+                CHECK(memcmp(rx + b, tx + a, t.len) == 0);
+                CHECK(rx[b + t.len] == 0 && (b == 0 || rx[b - 1] == 0));
+            }
+        }
+    }
+
+    /* No tx sends zeros */
+    spi_async_trans_t t = { .rx = rx, .len = 70 };
+    memset(rx, 0x55, sizeof(rx));
+    spi_queue_push(&q, &t);
+    run(&q, false);
+    CHECK(rx[0] == 0 && rx[69] == 0 && rx[70] == 0x55);
+}
+
+static void test_chain(void)
+{
+    static uint8_t cmd[1] = { 0x2c }, data[100], rx[100];
+    spi_async_trans_t a = { .tx = cmd, .len = 1, .flags = SPI_ASYNC_KEEP_CS };
+    spi_async_trans_t b = { .tx = data, .rx = rx, .len = sizeof(data) };
+    spi_async_trans_t c = { .len = 0 };
+    spi_queue_t q;
+
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = i;
+    }
+    spi_queue_init(&q);
+    spi_queue_push(&q, &a);
+    spi_queue_push(&q, &b);
+    spi_queue_push(&q, &c);
+    run(&q, false);
+    CHECK(nchunks == 4);
+    CHECK(chunks[0].first && chunks[0].last && chunks[0].bytes == 1);
+    CHECK(chunks[1].first && !chunks[1].last);
+    CHECK(!chunks[2].first && chunks[2].last && chunks[2].bytes == 36);
+    CHECK(chunks[3].first && chunks[3].last);
+    CHECK(ncompleted == 3 && completed[0] == &a && completed[1] == &b && completed[2] == &c);
+    CHECK(memcmp(rx, data, sizeof(data)) == 0);
+}
+
+int main(void)
+{
+    test_push();
+    test_chunks();
+    test_words();
+    test_loopback();
+    test_chain();
+
+    return check_done("spi_queue");
+}
@@ -28,7 +28,7 @@
 #include <stdio.h>
 
 #if (configUSE_COUNTING_SEMAPHORES == 0)
- #error "You need to define configUSE_COUNTING_SEMAPHORES in a local FreeRTOSConfig.h, see examples/terminal/FreeRTOSConfig.h"
+ #error "You need to define configUSE_COUNTING_SEMAPHORES in a local FreeRTOSConfig.h, see README.txt"
 #endif
 
 // IRQ driven UART RX driver for ESP8266 written for use with esp-open-rtos
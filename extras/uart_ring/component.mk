@@ -0,0 +1,13 @@
+# Component makefile for extras/uart_ring
+#
+# Interrupt driven, buffered UART driver. Linking it routes stdin and
+# stdout through it, see uart_ring.h and examples/uart_ring_bench.
+# Replaces extras/stdin_uart_interrupt.
+
+INC_DIRS += $(uart_ring_ROOT)
+
+# args for passing into compile rule generation
+uart_ring_SRC_DIR = $(uart_ring_ROOT)
+uart_ring_WHOLE_ARCHIVE = yes
+
+$(eval $(call component_compile_rules,uart_ring))
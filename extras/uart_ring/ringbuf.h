@@ -0,0 +1,141 @@
+/* Single producer, single consumer byte ring buffer
+ *
+ * One side (e.g. a task) only calls the put functions and the other (e.g.
+ * an interrupt handler) only the get functions, then no locking is needed
+ * on a single core CPU. The size must be a power of two. head and tail
+ * count bytes ever read and written, so all of the buffer can be used.
+ *
+ * No dependencies beyond the C library, extras/uart_ring/tests builds it
+ * on a host.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _RINGBUF_H
+#define _RINGBUF_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint8_t *buf;
+    uint32_t mask;                  /* size - 1 */
+    volatile uint32_t head;         /* Only written by the consumer */
+    volatile uint32_t tail;         /* Only written by the producer */
+} ringbuf_t;
+
+/* Only the compiler can reorder accesses on a single core */
+#define RINGBUF_FENCE() __asm__ volatile ("" ::: "memory")
+
+static inline void ringbuf_init(ringbuf_t *r, uint8_t *buf, uint32_t size)
+{
+    r->buf = buf;
+    r->mask = size - 1;
+    r->head = r->tail = 0;
+}
+
+static inline uint32_t ringbuf_used(const ringbuf_t *r)
+{
+    return r->tail - r->head;
+}
+
+static inline uint32_t ringbuf_free(const ringbuf_t *r)
+{
+    return r->mask + 1 - ringbuf_used(r);
+}
+
+/* Copy in as much of data[0..len-1] as fits, returns the number of bytes */
+static inline size_t ringbuf_put(ringbuf_t *r, const void *data, size_t len)
+{
+    uint32_t tail = r->tail;
+    uint32_t n = ringbuf_free(r);
+    uint32_t pos = tail & r->mask;
+
+    if (len < n) {
+        n = len;
+    }
+    uint32_t first = r->mask + 1 - pos;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(r->buf + pos, data, first);
+    memcpy(r->buf, (const uint8_t *)data + first, n - first);
+    RINGBUF_FENCE();
+    r->tail = tail + n;
+    return n;
+}
+
+/* Contiguous block that can be read, returns its length */
+static inline size_t ringbuf_peek(const ringbuf_t *r, const uint8_t **data)
+{
+    uint32_t head = r->head;
+    uint32_t n = r->tail - head;
+    uint32_t pos = head & r->mask;
+
+    RINGBUF_FENCE();
+    if (n > r->mask + 1 - pos) {
+        n = r->mask + 1 - pos;
+    }
+    *data = r->buf + pos;
+    return n;
+}
+
+/* Drop n bytes after ringbuf_peek() */
+static inline void ringbuf_skip(ringbuf_t *r, size_t n)
+{
+    RINGBUF_FENCE();
+    r->head += n;
+}
+
+/* Copy out up to len bytes, returns the number of bytes */
+static inline size_t ringbuf_get(ringbuf_t *r, void *data, size_t len)
+{
+    size_t done = 0;
+    const uint8_t *p;
+
+    while (done < len) {
+        size_t n = ringbuf_peek(r, &p);
+        if (n == 0) {
+            break;
+        }
+        if (n > len - done) {
+            n = len - done;
+        }
+        memcpy((uint8_t *)data + done, p, n);
+        ringbuf_skip(r, n);
+        done += n;
+    }
+    return done;
+}
+
+/* Producer side of ringbuf_peek(): contiguous free space, returns its
+   length. Fill it and call ringbuf_commit(). */
+static inline size_t ringbuf_reserve(const ringbuf_t *r, uint8_t **data)
+{
+    uint32_t tail = r->tail;
+    uint32_t n = ringbuf_free(r);
+    uint32_t pos = tail & r->mask;
+
+    if (n > r->mask + 1 - pos) {
+        n = r->mask + 1 - pos;
+    }
+    *data = r->buf + pos;
+    return n;
+}
+
+static inline void ringbuf_commit(ringbuf_t *r, size_t n)
+{
+    RINGBUF_FENCE();
+    r->tail += n;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RINGBUF_H */
@@ -0,0 +1,181 @@
+/* Host unit tests for ringbuf.h, with a thread standing in for the UART
+ * interrupt. The stream test relies on the host being x86 (stores aren't
+ * reordered), like ringbuf.h relies on the ESP8266 having one core.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+#include "ringbuf.h"
+#include "check.h"
+
+static void test_basic(void)
+{
+    uint8_t buf[8], out[16];
+    ringbuf_t r;
+
+    ringbuf_init(&r, buf, sizeof(buf));
+    CHECK(ringbuf_used(&r) == 0);
+    CHECK(ringbuf_free(&r) == 8);
+    CHECK(ringbuf_get(&r, out, sizeof(out)) == 0);
+    CHECK(ringbuf_put(&r, "abcde", 5) == 5);
+    CHECK(ringbuf_used(&r) == 5);
+    CHECK(ringbuf_get(&r, out, 3) == 3 && memcmp(out, "abc", 3) == 0);
+    /* Wraps around the end, and stops when full */
+    CHECK(ringbuf_put(&r, "fghijklmn", 9) == 6);
+    CHECK(ringbuf_free(&r) == 0);
+    CHECK(ringbuf_put(&r, "x", 1) == 0);
+    CHECK(ringbuf_get(&r, out, sizeof(out)) == 8 && memcmp(out, "defghijk", 8) == 0);
+    CHECK(ringbuf_used(&r) == 0);
+}
+
+static void test_peek_reserve(void)
+{
+    uint8_t buf[8];
+    const uint8_t *p;
+    uint8_t *w;
+    ringbuf_t r;
+
+    ringbuf_init(&r, buf, sizeof(buf));
+    ringbuf_put(&r, "012345", 6);
+    CHECK(ringbuf_peek(&r, &p) == 6 && p == buf);
+    ringbuf_skip(&r, 4);
+    /* Free space is split by the end of the buffer */
+    CHECK(ringbuf_reserve(&r, &w) == 2 && w == buf + 6);
+    memcpy(w, "67", 2);
+    ringbuf_commit(&r, 2);
+    CHECK(ringbuf_reserve(&r, &w) == 4 && w == buf);
+    memcpy(w, "89", 2);
+    ringbuf_commit(&r, 2);
+    CHECK(ringbuf_used(&r) == 6);
+    CHECK(ringbuf_peek(&r, &p) == 4 && memcmp(p, "4567", 4) == 0);
+    ringbuf_skip(&r, 4);
+    CHECK(ringbuf_peek(&r, &p) == 2 && memcmp(p, "89", 2) == 0);
+}
+
+/* head and tail count bytes, check they can wrap around */
+static void test_counter_wrap(void)
+{
+    uint8_t buf[16], out[16];
+    ringbuf_t r;
+
+    ringbuf_init(&r, buf, sizeof(buf));
+    r.head = r.tail = 0xfffffffa;
+    CHECK(ringbuf_put(&r, "0123456789abcdef", 16) == 16);
+    CHECK(ringbuf_used(&r) == 16 && ringbuf_free(&r) == 0);
+    CHECK(r.tail == 10);
+    CHECK(ringbuf_get(&r, out, 16) == 16 && memcmp(out, "0123456789abcdef", 16) == 0);
+}
+
+/* Random operations against a simple model */
+static void test_model(void)
+{
+    uint8_t buf[64], in[100], out[100];
+    uint8_t next_in = 0, next_out = 0;
+    uint32_t used = 0;
+    ringbuf_t r;
+
+    srand(1);
+    ringbuf_init(&r, buf, sizeof(buf));
+    for (int i = 0; i < 100000; i++) {
+        size_t len = rand() % sizeof(in);
+        if (rand() & 1) {
+            for (size_t j = 0; j < len; j++) {
+                in[j] = next_in + j;
+            }
+            size_t n = ringbuf_put(&r, in, len);
+            CHECK(n == (len < 64 - used ? len : 64 - used));
+            next_in += n;
+            used += n;
+        } else {
+            size_t n = ringbuf_get(&r, out, len);
+            CHECK(n == (len < used ? len : used));
+            for (size_t j = 0; j < n; j++) {
+                if (out[j] != (uint8_t)(next_out + j)) {
+                    CHECK(out[j] == (uint8_t)(next_out + j));
+                    break;
+                }
+            }
+            next_out += n;
+            used -= n;
+        }
+        CHECK(ringbuf_used(&r) == used);
+    }
+}
+
+#define STREAM_BYTES 2000000
+
+static ringbuf_t stream;
+
+/* Drains the ring a FIFO-load at a time, like the UART interrupt */
+static void *consumer(void *arg)
+{
+    ringbuf_t *r = arg;
+    uint32_t received = 0;
+    uint8_t expect = 0;
+    bool ok = true;
+    const uint8_t *p;
+
+    while (received < STREAM_BYTES) {
+        size_t n = ringbuf_peek(r, &p);
+        if (n == 0) {
+            sched_yield();
+            continue;
+        }
+        if (n > 127) {
+            n = 127;
+        }
+        for (size_t i = 0; i < n; i++) {
+            ok &= p[i] == expect++;
+        }
+        ringbuf_skip(r, n);
+        received += n;
+    }
+    return ok ? r : NULL;
+}
+
+static void test_stream(void)
+{
+    static uint8_t buf[1024];
+    uint8_t chunk[300];
+    uint8_t next = 0;
+    uint32_t sent = 0;
+    pthread_t t;
+    void *ok;
+
+    ringbuf_init(&stream, buf, sizeof(buf));
+    pthread_create(&t, NULL, consumer, &stream);
+    while (sent < STREAM_BYTES) {
+        size_t len = 1 + rand() % sizeof(chunk);
+        if (len > STREAM_BYTES - sent) {
+            len = STREAM_BYTES - sent;
+        }
+        for (size_t i = 0; i < len; i++) {
+            chunk[i] = next + i;
+        }
+        size_t n = ringbuf_put(&stream, chunk, len);
+        if (n < len) {
+            sched_yield();
+        }
+        next += n;
+        sent += n;
+    }
+    pthread_join(t, &ok);
+    CHECK(ok);
+    CHECK(ringbuf_used(&stream) == 0);
+}
+
+int main(void)
+{
+    test_basic();
+    test_peek_reserve();
+    test_counter_wrap();
+    test_model();
+    test_stream();
+
+    return check_done("ringbuf");
+}
@@ -0,0 +1,429 @@
+/* Interrupt driven, buffered UART driver
+ *
+ * See uart_ring.h
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/reent.h>
+#include <esp8266.h>
+#include <esp/uart.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "xtensa_ops.h"
+#include "espressif/esp_misc.h"
+#include "ringbuf.h"
+#include "uart_ring.h"
+
+typedef struct {
+    ringbuf_t tx;                       /* Writers -> interrupt */
+    ringbuf_t rx;                       /* Interrupt -> reader */
+    SemaphoreHandle_t tx_lock;          /* Held by writers, one at a time */
+    SemaphoreHandle_t tx_sem;
+    SemaphoreHandle_t rx_sem;
+    volatile uint32_t tx_wait_free;     /* Give tx_sem once this much is free */
+    volatile bool rx_waiting;           /* Give rx_sem once data arrives */
+    uart_ring_stats_t stats;
+} uart_ring_t;
+
+static uart_ring_t *uarts[2];
+static TickType_t stdout_timeout = portMAX_DELAY;
+
+/* Move as much as fits from the ring to the TX FIFO */
+static void IRAM tx_fill(uart_ring_t *u, int num)
+{
+    size_t space = UART_FIFO_MAX - FIELD2VAL(UART_STATUS_TXFIFO_COUNT, UART(num).STATUS);
+    const uint8_t *p;
+    size_t n;
+
+    while (space && (n = ringbuf_peek(&u->tx, &p)) != 0) {
+        if (n > space) {
+            n = space;
+        }
+        for (size_t i = 0; i < n; i++) {
+            UART(num).FIFO = p[i];
+        }
+        ringbuf_skip(&u->tx, n);
+        space -= n;
+        u->stats.tx_bytes += n;
+    }
+}
+
+static void IRAM rx_drain(uart_ring_t *u, int num)
+{
+    size_t count = FIELD2VAL(UART_STATUS_RXFIFO_COUNT, UART(num).STATUS);
+    uint8_t *p;
+
+    while (count) {
+        size_t n = ringbuf_reserve(&u->rx, &p);
+        if (n == 0) {
+            u->stats.rx_dropped += count;
+            while (count--) {
+                (void)UART(num).FIFO;
+            }
+            break;
+        }
+        if (n > count) {
+            n = count;
+        }
+        for (size_t i = 0; i < n; i++) {
+            p[i] = UART(num).FIFO;
+        }
+        ringbuf_commit(&u->rx, n);
+        count -= n;
+        u->stats.rx_bytes += n;
+    }
+}
+
+static void IRAM uart_ring_handle(int num, BaseType_t *woken)
+{
+    uart_ring_t *u = uarts[num];
+    uint32_t status;
+
+    if (!u || !(status = UART(num).INT_STATUS)) {
+        return;
+    }
+    if (status & (UART_INT_STATUS_RXFIFO_FULL | UART_INT_STATUS_RXFIFO_TIMEOUT)) {
+        u->stats.rx_interrupts++;
+        rx_drain(u, num);
+        if (u->rx_waiting) {
+            u->rx_waiting = false;
+            xSemaphoreGiveFromISR(u->rx_sem, woken);
+        }
+    }
+    if (status & UART_INT_STATUS_TXFIFO_EMPTY) {
+        u->stats.tx_interrupts++;
+        tx_fill(u, num);
+        if (ringbuf_used(&u->tx) == 0) {
+            UART(num).INT_ENABLE &= ~UART_INT_ENABLE_TXFIFO_EMPTY;
+        }
+        if (u->tx_wait_free && ringbuf_free(&u->tx) >= u->tx_wait_free) {
+            u->tx_wait_free = 0;
+            xSemaphoreGiveFromISR(u->tx_sem, woken);
+        }
+    }
+    UART(num).INT_CLEAR = status;
+}
+
+/* Both UARTs share one interrupt */
+static void IRAM uart_ring_isr(void)
+{
+    BaseType_t woken = pdFALSE;
+
+    uart_ring_handle(0, &woken);
+    uart_ring_handle(1, &woken);
+    portEND_SWITCHING_ISR(woken);
+}
+
+/* Whether a task can block here and the UART interrupt can run */
+static bool interrupts_running(void)
+{
+    uint32_t ps, intenable;
+
+    if (sdk_NMIIrqIsOn || xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+        return false;
+    }
+    RSR(ps, ps);
+    RSR(intenable, intenable);
+    return (ps & 0xf) == 0 && (intenable & BIT(INUM_UART));
+}
+
+/* Send what is queued, then 'data', waiting on the FIFO */
+static size_t write_polled(uart_ring_t *u, int num, const uint8_t *data, size_t len)
+{
+    const uint8_t *p;
+    size_t n;
+
+    if (u) {
+        while ((n = ringbuf_peek(&u->tx, &p)) != 0) {
+            for (size_t i = 0; i < n; i++) {
+                uart_putc(num, p[i]);
+            }
+            ringbuf_skip(&u->tx, n);
+        }
+    }
+    for (size_t i = 0; i < len; i++) {
+        uart_putc(num, data[i]);
+    }
+    return len;
+}
+
+/* Start sending, topping up the FIFO directly so short writes don't
+   need an interrupt at all */
+static void tx_start(uart_ring_t *u, int num)
+{
+    taskENTER_CRITICAL();
+    tx_fill(u, num);
+    if (ringbuf_used(&u->tx)) {
+        UART(num).INT_ENABLE |= UART_INT_ENABLE_TXFIFO_EMPTY;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/* Wait for tx_wait_free bytes of space, called with tx_lock held */
+static bool tx_wait(uart_ring_t *u, uint32_t want, TimeOut_t *t, TickType_t *timeout)
+{
+    u->tx_wait_free = want;
+    if (ringbuf_free(&u->tx) >= want) {
+        u->tx_wait_free = 0;
+        return true;
+    }
+    u->stats.tx_waits++;
+    if (xTaskCheckForTimeOut(t, timeout) || !xSemaphoreTake(u->tx_sem, *timeout)) {
+        u->tx_wait_free = 0;
+        return false;
+    }
+    return true;
+}
+
+static size_t write_locked(uart_ring_t *u, int num, const uint8_t *data, size_t len, TickType_t timeout)
+{
+    TimeOut_t t;
+    size_t done = 0;
+
+    vTaskSetTimeOutState(&t);
+    for (;;) {
+        done += ringbuf_put(&u->tx, data + done, len - done);
+        tx_start(u, num);
+        if (done == len) {
+            break;
+        }
+        /* Wait for half the ring to empty, so we're woken less often */
+        uint32_t want = (u->tx.mask + 1) / 2;
+        if (want > len - done) {
+            want = len - done;
+        }
+        if (!tx_wait(u, want, &t, &timeout)) {
+            break;
+        }
+    }
+    u->stats.tx_dropped += len - done;
+    return done;
+}
+
+size_t uart_ring_write(int uart_num, const void *data, size_t len, TickType_t timeout)
+{
+    uart_ring_t *u = uarts[uart_num];
+    size_t n;
+
+    if (!u || !interrupts_running()) {
+        return write_polled(u, uart_num, data, len);
+    }
+    if (!xSemaphoreTake(u->tx_lock, timeout)) {
+        u->stats.tx_dropped += len;
+        return 0;
+    }
+    n = write_locked(u, uart_num, data, len, timeout);
+    xSemaphoreGive(u->tx_lock);
+    return n;
+}
+
+size_t uart_ring_read(int uart_num, void *data, size_t len, TickType_t timeout)
+{
+    uart_ring_t *u = uarts[uart_num];
+    TimeOut_t t;
+    size_t n;
+
+    if (!u || len == 0) {
+        return 0;
+    }
+    vTaskSetTimeOutState(&t);
+    while ((n = ringbuf_get(&u->rx, data, len)) == 0) {
+        u->rx_waiting = true;
+        if (ringbuf_used(&u->rx)) {
+            u->rx_waiting = false;
+            continue;
+        }
+        if (xTaskCheckForTimeOut(&t, &timeout) || !xSemaphoreTake(u->rx_sem, timeout)) {
+            u->rx_waiting = false;
+            return ringbuf_get(&u->rx, data, len);
+        }
+    }
+    return n;
+}
+
+size_t uart_ring_available(int uart_num)
+{
+    uart_ring_t *u = uarts[uart_num];
+
+    return u ? ringbuf_used(&u->rx) : 0;
+}
+
+bool uart_ring_flush(int uart_num, TickType_t timeout)
+{
+    uart_ring_t *u = uarts[uart_num];
+    TimeOut_t t;
+    bool ok = true;
+
+    if (!u || !interrupts_running()) {
+        write_polled(u, uart_num, NULL, 0);
+        uart_flush_txfifo(uart_num);
+        return true;
+    }
+    vTaskSetTimeOutState(&t);
+    if (!xSemaphoreTake(u->tx_lock, timeout)) {
+        return false;
+    }
+    while (ok && ringbuf_used(&u->tx)) {
+        ok = tx_wait(u, u->tx.mask + 1, &t, &timeout);
+    }
+    while (ok && FIELD2VAL(UART_STATUS_TXFIFO_COUNT, UART(uart_num).STATUS)) {
+        ok = !xTaskCheckForTimeOut(&t, &timeout);
+        vTaskDelay(1);
+    }
+    xSemaphoreGive(u->tx_lock);
+    return ok;
+}
+
+void uart_ring_set_stdout_timeout(TickType_t timeout)
+{
+    stdout_timeout = timeout;
+}
+
+void uart_ring_get_stats(int uart_num, uart_ring_stats_t *stats)
+{
+    uart_ring_t *u = uarts[uart_num];
+
+    if (u) {
+        *stats = u->stats;
+    } else {
+        memset(stats, 0, sizeof(*stats));
+    }
+}
+
+static bool power_of_two(uint32_t n)
+{
+    return n && !(n & (n - 1));
+}
+
+bool uart_ring_init(int uart_num, uint32_t tx_size, uint32_t rx_size)
+{
+    uart_ring_t *u;
+    uint8_t *buf;
+
+    if (uarts[uart_num]) {
+        return true;
+    }
+    if (!power_of_two(tx_size) || !power_of_two(rx_size)) {
+        return false;
+    }
+    u = calloc(1, sizeof(*u));
+    buf = malloc(tx_size + rx_size);
+    if (u && buf) {
+        u->tx_lock = xSemaphoreCreateMutex();
+        u->tx_sem = xSemaphoreCreateBinary();
+        u->rx_sem = xSemaphoreCreateBinary();
+    }
+    if (!u || !buf || !u->tx_lock || !u->tx_sem || !u->rx_sem) {
+        if (u) {
+            if (u->tx_lock) vSemaphoreDelete(u->tx_lock);
+            if (u->tx_sem) vSemaphoreDelete(u->tx_sem);
+            if (u->rx_sem) vSemaphoreDelete(u->rx_sem);
+        }
+        free(u);
+        free(buf);
+        return false;
+    }
+    ringbuf_init(&u->tx, buf, tx_size);
+    ringbuf_init(&u->rx, buf + tx_size, rx_size);
+
+    uint32_t conf1 = UART(uart_num).CONF1;
+    conf1 = SET_FIELD(conf1, UART_CONF1_RXFIFO_FULL_THRESHOLD, UART_RING_RX_THRESHOLD);
+    conf1 = SET_FIELD(conf1, UART_CONF1_TXFIFO_EMPTY_THRESHOLD, UART_RING_TX_THRESHOLD);
+    conf1 = SET_FIELD(conf1, UART_CONF1_RX_TIMEOUT_THRESHOLD, UART_RING_RX_TIMEOUT);
+    UART(uart_num).CONF1 = conf1 | UART_CONF1_RX_TIMEOUT_ENABLE;
+    UART(uart_num).INT_CLEAR = 0x1ff;
+
+    uarts[uart_num] = u;
+    _xt_isr_attach(INUM_UART, uart_ring_isr);
+    UART(uart_num).INT_ENABLE = UART_INT_ENABLE_RXFIFO_FULL | UART_INT_ENABLE_RXFIFO_TIMEOUT;
+    _xt_isr_unmask(BIT(INUM_UART));
+    return true;
+}
+
+/* The SDK's own output (os_printf) */
+static void uart_ring_putc1(char c)
+{
+    uart_ring_write(0, &c, 1, stdout_timeout);
+}
+
+/* Runs before user_init() */
+static void __attribute__((constructor)) uart_ring_stdio_init(void)
+{
+    if (uart_ring_init(0, UART_RING_STDOUT_TX_SIZE, UART_RING_STDIN_RX_SIZE)) {
+        sdk_os_install_putc1(uart_ring_putc1);
+    }
+}
+
+/* Replaces the weak _write_r in core/newlib_syscalls.c, with the same
+   CR/LF handling */
+long _write_r(struct _reent *r, int fd, const char *ptr, int len)
+{
+    uart_ring_t *u = uarts[0];
+    bool buffered = u && interrupts_running();
+    int start = 0;
+
+    if (fd != r->_stdout->_file) {
+        r->_errno = EBADF;
+        return -1;
+    }
+    if (buffered && !xSemaphoreTake(u->tx_lock, stdout_timeout)) {
+        u->stats.tx_dropped += len;
+        return len;
+    }
+    for (int i = 0; i <= len; i++) {
+        if (i < len && ptr[i] != '\r' && ptr[i] != '\n') {
+            continue;
+        }
+        const uint8_t *seg = (const uint8_t *)ptr + start;
+        const uint8_t *eol = (const uint8_t *)"\r\n";
+        size_t n = i - start;
+        bool lf = i < len && ptr[i] == '\n';
+        if (buffered) {
+            write_locked(u, 0, seg, n, stdout_timeout);
+            if (lf) {
+                write_locked(u, 0, eol, 2, stdout_timeout);
+            }
+        } else {
+            write_polled(u, 0, seg, n);
+            if (lf) {
+                write_polled(u, 0, eol, 2);
+            }
+        }
+        start = i + 1;
+    }
+    if (buffered) {
+        xSemaphoreGive(u->tx_lock);
+    }
+    return len;
+}
+
+/* Replaces _read_stdin_r in core/newlib_syscalls.c */
+long _read_stdin_r(struct _reent *r, int fd, char *ptr, int len)
+{
+    uart_ring_t *u = uarts[0];
+    int i = 0;
+
+    if (u && interrupts_running()) {
+        return uart_ring_read(0, ptr, len, portMAX_DELAY);
+    }
+    /* Same as the core version, after anything already received */
+    if (u) {
+        i = ringbuf_get(&u->rx, ptr, len);
+    }
+    if (i == 0) {
+        uart_rxfifo_wait(0, 1);
+    }
+    for (; i < len; i++) {
+        int ch = uart_getc_nowait(0);
+        if (ch < 0) {
+            break;
+        }
+        ptr[i] = ch;
+    }
+    return i;
+}
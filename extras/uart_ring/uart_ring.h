@@ -0,0 +1,106 @@
+/* Interrupt driven, buffered UART driver
+ *
+ * Each UART gets a transmit and a receive ring buffer in RAM. Writers
+ * copy into the transmit ring and return; the UART interrupt refills the
+ * hardware FIFO from it, about UART_FIFO_MAX - UART_RING_TX_THRESHOLD
+ * bytes at a time. The receive interrupt fires when the FIFO reaches
+ * UART_RING_RX_THRESHOLD bytes or the line has been idle for
+ * UART_RING_RX_TIMEOUT byte times, and moves everything into the receive
+ * ring. Waiting tasks are woken once per interrupt, not once per byte.
+ *
+ * Linking this component sends stdout (printf etc.) and the SDK's own
+ * output on UART0 through the ring and reads stdin from it, so a burst of
+ * logging no longer stalls the task for as long as it takes to send. It
+ * replaces extras/stdin_uart_interrupt, don't link both.
+ *
+ * Where the UART interrupt can't run (before the scheduler starts, in
+ * interrupt handlers, critical sections and the crash handler) output
+ * falls back to waiting on the FIFO, after sending whatever is queued.
+ *
+ * Any number of tasks may write to a UART, but only one task should read
+ * from each. UART1 has no RX pin on the ESP8266, so only its transmit
+ * side is useful.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _UART_RING_H
+#define _UART_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Buffer sizes for UART0, set up for stdio by a constructor. Powers of
+   two. */
+#ifndef UART_RING_STDOUT_TX_SIZE
+#define UART_RING_STDOUT_TX_SIZE 1024
+#endif
+
+#ifndef UART_RING_STDIN_RX_SIZE
+#define UART_RING_STDIN_RX_SIZE 128
+#endif
+
+/* Refill the TX FIFO when it has fewer than this many bytes left */
+#ifndef UART_RING_TX_THRESHOLD
+#define UART_RING_TX_THRESHOLD 16
+#endif
+
+/* Empty the RX FIFO when it holds this many bytes ... */
+#ifndef UART_RING_RX_THRESHOLD
+#define UART_RING_RX_THRESHOLD 64
+#endif
+
+/* ... or when nothing has arrived for this many byte times */
+#ifndef UART_RING_RX_TIMEOUT
+#define UART_RING_RX_TIMEOUT 4
+#endif
+
+typedef struct {
+    uint32_t tx_bytes;
+    uint32_t tx_interrupts;
+    uint32_t tx_waits;          /* Times a writer waited for space */
+    uint32_t tx_dropped;        /* Bytes not written by a write timing out */
+    uint32_t rx_bytes;
+    uint32_t rx_interrupts;
+    uint32_t rx_dropped;        /* Bytes lost as the RX ring was full */
+} uart_ring_stats_t;
+
+/* Set up buffers of tx_size and rx_size bytes (powers of two) for UART
+   'uart_num' and enable its interrupts. The UART's baud rate and pins
+   should already be set up. Returns false if out of memory. UART0 is set
+   up automatically. */
+bool uart_ring_init(int uart_num, uint32_t tx_size, uint32_t rx_size);
+
+/* Queue up to 'len' bytes for sending, waiting up to 'timeout' ticks for
+   space in the buffer (0 never waits). Returns the number of bytes
+   queued. */
+size_t uart_ring_write(int uart_num, const void *data, size_t len, TickType_t timeout);
+
+/* Wait up to 'timeout' ticks for received data, then read up to 'len'
+   bytes. Returns the number of bytes read. */
+size_t uart_ring_read(int uart_num, void *data, size_t len, TickType_t timeout);
+
+/* Number of received bytes waiting to be read */
+size_t uart_ring_available(int uart_num);
+
+/* Wait up to 'timeout' ticks for everything written to be sent */
+bool uart_ring_flush(int uart_num, TickType_t timeout);
+
+/* How long printf() etc. wait for space in the UART0 buffer. The default
+   portMAX_DELAY never loses output; with 0 they never block, and output
+   that doesn't fit is dropped (and counted in tx_dropped). */
+void uart_ring_set_stdout_timeout(TickType_t timeout);
+
+void uart_ring_get_stats(int uart_num, uart_ring_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UART_RING_H */
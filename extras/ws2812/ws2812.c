@@ -18,6 +18,7 @@
 #include "task.h"
 #include <stdint.h>
 
+#include "esp/spi.h"
 #include "esp/spi2.h"
 #include "hw_timer.h"
 #include "ws2812.h"
@@ -50,6 +51,32 @@ static ws2812_driver_t * ws = &ws_driver;
 static ws2812_fade_inout_t fade_st;
 static ws2812_fade_inout_t * fade = &fade_st;
 
+/* prediv==2==40mhz, postdiv==2==20mhz, high to low byte order */
+static const spi_device_t ws_spi = {
+   .bus = HSPIBUS,
+   .settings = { SPI_MODE0, SPI_GET_FREQ_DIV(2, 2), true, SPI_BIG_ENDIAN, false },
+   .cs_gpio = SPI_CS_NONE
+};
+
+/* An animation frame is sent a pixel per timer interrupt, which can't take
+ * the bus mutex (FRC1 is timing critical, so its handler can't call
+ * FreeRTOS at all, see portmacro.h). animTask tries to take it before each
+ * frame (skipping the frame if another device has the bus) and sets
+ * frame_has_bus, the interrupt sends the frame and clears it, and animTask
+ * polls it every tick to give the bus back. So the bus is only held while
+ * a frame is on the wire, give or take a tick. */
+static volatile bool frame_has_bus;
+
+static void ws2812_bus_take(void)
+{
+   spi_device_acquire(&ws_spi, portMAX_DELAY);
+}
+
+static void ws2812_bus_give(void)
+{
+   spi_device_release(&ws_spi);
+}
+
 // float patterns [] [3] = {
 //   { 0.5, 0, 0 },  // red
 //   { 0, 0.5, 0 },  // green
@@ -167,14 +194,19 @@ void IRAM ws2812_sendPixel_params(uint8_t r, uint8_t g, uint8_t b)
 void IRAM ws2812_showColor(uint16_t count, uint8_t r , uint8_t g , uint8_t b)
 {
    uint16_t pixel;
+   ws2812_bus_take();
    for (pixel = 0; pixel < count; pixel++)
       ws2812_sendPixel_params(r, g, b);
+   ws2812_bus_give();
    ws2812_show();  // latch the colors
 }
 
 void ws2812_showit_fade(void)
 {
    static uint32_t intr_restore;
+
+   if (!frame_has_bus)
+      return;
    sdk_os_delay_us(1);
    intr_restore = _xt_disable_interrupts();
    if (ws->cur_pixel < PIXEL_COUNT)
@@ -184,7 +216,9 @@ void ws2812_showit_fade(void)
       ws->cur_pixel++;
       // _xt_isr_unmask( (1<<INUM_TIMER_FRC1) | (1<<INUM_TICK) | (1<<INUM_SOFT) | (1<<INUM_TIMER_FRC2) );
    } else {
+      /* Frame done, the bus goes back until the next one */
       ws->cur_pixel = 0;
+      frame_has_bus = false;
    }
    _xt_restore_interrupts(intr_restore);
    sdk_os_delay_us(1);
@@ -274,9 +308,10 @@ void ws2812_set_brightness(uint8_t b)
 /* Stop currently running animation, if any. */
 void ws2812_anim_stop(void)
 {
-   ws2812_clear();
+   /* Stop first, so animTask gives the bus back for the clear */
    ws->state = WS2812_ANIM_INVALID;
    ws->cur_anim = WS_STATE_DOIT_STOPPED;
+   ws2812_clear();
 }
 
 /* Used for init only since hw_timer delay is 10us, so about the same. */
@@ -291,16 +326,36 @@ void ws2812_clear(void)
    ws->r = 0;
    ws->g = 0;
    ws->b = 0;
+   ws2812_bus_take();
    ws2812_sendPixels();
+   ws2812_bus_give();
 }
 
 void animTask(void *p)
 {
+   bool holding = false;
+
    while(1)
    {
       int anim = ws->cur_anim;
+
+      /* Give the bus back after a frame, or when the animation stopped
+         half way through one */
+      if (holding && (!frame_has_bus || ws->state != WS_STATE_DOIT_ACTIVE))
+      {
+         frame_has_bus = false;
+         spi_device_release(&ws_spi);
+         holding = false;
+      }
       if (ws->state == WS_STATE_DOIT_ACTIVE)
       {
+         /* Next frame, unless another device is using the bus */
+         if (!holding && spi_device_acquire(&ws_spi, 0))
+         {
+            holding = true;
+            ws->cur_pixel = 0;
+            frame_has_bus = true;
+         }
          switch ( anim )
          {
             case WS2812_ANIM_FADE_INOUT:
@@ -312,25 +367,19 @@ void animTask(void *p)
          }
       }
       // vTaskDelayMs(MS_DIV_PER_CB(fade->period, 255));
-      vTaskDelayMs(15);
+      /* Check every tick for the end of a frame on the wire */
+      if (holding)
+         vTaskDelay(1);
+      else
+         vTaskDelayMs(15);
    }
 }
 
 bool ws2812_spi_init(void)
 {
-   spi_init_gpio(HSPIBUS, SPI_CLK_USE_DIV);
-   spi_clock(HSPIBUS, 2, 2); // prediv==2==40mhz, postdiv==2==20mhz
-   spi_tx_byte_order(HSPIBUS, SPI_BYTE_ORDER_HIGH_TO_LOW);
-   spi_rx_byte_order(HSPIBUS, SPI_BYTE_ORDER_HIGH_TO_LOW);
-
-   /* Mode 0: CPOL=0, CPHA=0 */
-   /* uint8 spi_no, uint8 spi_cpha,uint8 spi_cpol */
-   spi_mode(HSPIBUS, 0, 0);
-
-   SET_PERI_REG_MASK(SPI_USER(HSPIBUS), SPI_CS_SETUP|SPI_CS_HOLD);
-   CLEAR_PERI_REG_MASK(SPI_USER(HSPIBUS), SPI_FLASH_MODE);
-
-   return true;
+   /* Sets up the pins, the settings are applied when taking the bus, so
+      other devices can share it */
+   return spi_set_settings(HSPIBUS, &ws_spi.settings);
 }
 
 bool ws2812_init(void)
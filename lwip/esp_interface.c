@@ -45,17 +45,92 @@
 #include <lwip/stats.h>
 #include <lwip/snmp.h>
 #include "netif/etharp.h"
+#include "esp_netstats.h"
 
 /* declared in libnet80211.a */
 int8_t sdk_ieee80211_output_pbuf(struct netif *ifp, struct pbuf* pb);
 
+/* The MAC layer sends each pbuf it is given as a separate frame, so a
+ * pbuf chain (TCP header + referenced data, UDP header + netbuf_ref'd
+ * payload, IP fragments) has to be coalesced into a single pbuf first.
+ *
+ * Coalescing uses a small pool of full size frame buffers, allocated on
+ * first use and kept for the life of the program. The pool holds one
+ * reference to each frame, so a frame is free again once the MAC layer
+ * has released its own reference after transmission. If every frame is
+ * still queued in the MAC layer, a frame is allocated from the heap
+ * instead.
+ *
+ * Single pbufs (the common case for TCP data written with NETCONN_COPY)
+ * are passed through without copying.
+ */
+#ifndef ESP_TX_POOL_SIZE
+#define ESP_TX_POOL_SIZE 2
+#endif
+
+#define TX_FRAME_LEN (1500 + SIZEOF_ETH_HDR)
+
+static struct pbuf *tx_pool[ESP_TX_POOL_SIZE];
+static void *tx_pool_payload[ESP_TX_POOL_SIZE];
+
+/* Return a single pbuf of 'len' bytes for a coalesced frame, with a
+   reference held by the caller. Only called from the tcpip thread. */
+static struct pbuf *
+tx_frame_alloc(u16_t len)
+{
+  int i;
+  struct pbuf *q;
+
+  if (len <= TX_FRAME_LEN) {
+    for (i = 0; i < ESP_TX_POOL_SIZE; i++) {
+      q = tx_pool[i];
+      if (q == NULL) {
+        q = pbuf_alloc(PBUF_RAW, TX_FRAME_LEN, PBUF_RAM);
+        if (q == NULL) {
+          break;
+        }
+        tx_pool[i] = q;
+        tx_pool_payload[i] = q->payload;
+      } else if (q->ref != 1) {
+        continue; /* still queued in the MAC layer */
+      }
+      /* the MAC layer may have moved payload to add its own headers */
+      q->payload = tx_pool_payload[i];
+      q->len = q->tot_len = len;
+      q->next = NULL;
+      pbuf_ref(q);
+      return q;
+    }
+  }
+
+  NETSTATS_TX_POOL_MISS();
+  return pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+}
+
 static err_t
 low_level_output(struct netif *netif, struct pbuf *p)
 {
-  struct pbuf *q;
+  struct pbuf *q = p;
+
+  NETSTATS_TX(p);
+  if (p->next != NULL) {
+    q = tx_frame_alloc(p->tot_len);
+    if (q == NULL) {
+      LINK_STATS_INC(link.memerr);
+      LINK_STATS_INC(link.drop);
+      NETSTATS_DROP(NETSTATS_DROP_TX_MEM);
+      return ERR_MEM;
+    }
+    pbuf_copy_partial(p, q->payload, p->tot_len, 0);
+    NETSTATS_TX_COALESCED(p->tot_len);
+  }
+
+  if (sdk_ieee80211_output_pbuf(netif, q) != 0) {
+    NETSTATS_DROP(NETSTATS_DROP_TX_MAC);
+  }
 
-  for(q = p; q != NULL; q = q->next) {
-      sdk_ieee80211_output_pbuf(netif, q);
+  if (q != p) {
+    pbuf_free(q);
   }
 
   LINK_STATS_INC(link.xmit);
@@ -101,6 +176,7 @@ void ethernetif_input(struct netif *netif, struct pbuf *p)
     struct eth_hdr *ethhdr = p->payload;
   /* examine packet payloads ethernet header */
 
+    NETSTATS_RX(p);
 
     switch(htons(ethhdr->type)) {
 	/* IP or ARP packet? */
@@ -111,12 +187,14 @@ void ethernetif_input(struct netif *netif, struct pbuf *p)
 	if (netif->input(p, netif)!=ERR_OK)
 	{
 	    LWIP_DEBUGF(NETIF_DEBUG, ("ethernetif_input: IP input error\n"));
+	    NETSTATS_DROP(NETSTATS_DROP_RX_INPUT);
 	    pbuf_free(p);
 	    p = NULL;
 	}
 	break;
 
     default:
+	NETSTATS_DROP(NETSTATS_DROP_RX_ETHTYPE);
 	pbuf_free(p);
 	p = NULL;
 	break;
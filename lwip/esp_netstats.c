@@ -0,0 +1,207 @@
+/* Packet rate and latency statistics for the WiFi <-> lwIP boundary
+ *
+ * See esp_netstats.h for details.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <esp/interrupts.h>
+#include <espressif/esp_system.h>
+#include <xtensa_ops.h>
+
+#include "lwip/pbuf.h"
+#include "esp_netstats.h"
+
+static netstats_t stats;
+
+#if ESP_NETSTATS
+
+/* RX pbufs waiting to be delivered to a socket, with the CCOUNT they arrived
+   at. A pbuf that never reaches a socket (ARP, ICMP, dropped, ...) is simply
+   overwritten once this many newer frames have arrived. */
+#define RX_STAMPS 8
+
+typedef struct {
+    struct pbuf *p;
+    uint32_t ccount;
+} rx_stamp_t;
+
+static rx_stamp_t rx_stamps[RX_STAMPS];
+static uint8_t rx_stamp_next;
+
+static inline uint32_t get_ccount(void)
+{
+    uint32_t ccount;
+    RSR(ccount, ccount);
+    return ccount;
+}
+
+static void count_dir(netstats_dir_t *dir, struct pbuf *p)
+{
+    int chain_len = 0;
+    for(struct pbuf *q = p; q != NULL && chain_len < NETSTATS_CHAIN_BUCKETS; q = q->next) {
+        chain_len++;
+    }
+    dir->packets++;
+    dir->bytes += p->tot_len;
+    dir->chain_len[chain_len - 1]++;
+}
+
+/* Called from the WiFi task for each frame passed to ethernetif_input() */
+void netstats_rx(struct pbuf *p)
+{
+    uint32_t ccount = get_ccount();
+    count_dir(&stats.rx, p);
+
+    uint32_t old_ps = _xt_disable_interrupts();
+    int slot = rx_stamp_next;
+    for(int i = 0; i < RX_STAMPS; i++) {
+        /* A freed pbuf may come straight back, don't leave a stale stamp */
+        if(rx_stamps[i].p == p) {
+            slot = i;
+            break;
+        }
+    }
+    if(slot == rx_stamp_next) {
+        rx_stamp_next = (rx_stamp_next + 1) % RX_STAMPS;
+    }
+    rx_stamps[slot].p = p;
+    rx_stamps[slot].ccount = ccount;
+    _xt_restore_interrupts(old_ps);
+}
+
+/* Called from the tcpip thread when a received pbuf has been posted to a
+   netconn receive mailbox. */
+void netstats_rx_delivered(struct pbuf *p)
+{
+    uint32_t ccount = get_ccount();
+    uint32_t stamp = 0;
+    bool found = false;
+
+    uint32_t old_ps = _xt_disable_interrupts();
+    for(int i = 0; i < RX_STAMPS; i++) {
+        if(rx_stamps[i].p == p) {
+            stamp = rx_stamps[i].ccount;
+            rx_stamps[i].p = NULL;
+            found = true;
+            break;
+        }
+    }
+    _xt_restore_interrupts(old_ps);
+    if(!found) {
+        return; /* Reassembled, out of order TCP segment, or stamp overwritten */
+    }
+
+    uint32_t cycles = ccount - stamp;
+    uint32_t us = cycles / sdk_system_get_cpu_freq();
+    int bucket = 0;
+    if(us >= 16) {
+        bucket = 28 - __builtin_clz(us);
+        if(bucket >= NETSTATS_LATENCY_BUCKETS) {
+            bucket = NETSTATS_LATENCY_BUCKETS - 1;
+        }
+    }
+
+    if(stats.latency_samples == 0 || cycles < stats.latency_min) {
+        stats.latency_min = cycles;
+    }
+    if(cycles > stats.latency_max) {
+        stats.latency_max = cycles;
+    }
+    stats.latency_samples++;
+    stats.latency_total += cycles;
+    stats.latency_hist[bucket]++;
+}
+
+/* Called from low_level_output(), normally in the tcpip thread */
+void netstats_tx(struct pbuf *p)
+{
+    count_dir(&stats.tx, p);
+}
+
+void netstats_drop(netstats_drop_t reason)
+{
+    stats.drops[reason]++;
+}
+
+/* Called with the number of messages in the tcpip thread mailbox after each
+   post. Only the single consumer ring mailbox reports this. */
+void netstats_mbox_depth(uint32_t depth)
+{
+    if(depth > stats.tcpip_mbox_hwm) {
+        stats.tcpip_mbox_hwm = depth;
+    }
+}
+
+/* Called from low_level_output() when a pbuf chain is copied into one frame */
+void netstats_tx_coalesced(uint32_t bytes)
+{
+    stats.tx_coalesced++;
+    stats.tx_copied_bytes += bytes;
+}
+
+void netstats_tx_pool_miss(void)
+{
+    stats.tx_pool_misses++;
+}
+
+#endif /* ESP_NETSTATS */
+
+void netstats_get(netstats_t *out)
+{
+    /* Counters are only updated from task context, so masking interrupts
+       (and hence preemption) is enough for a consistent copy. */
+    uint32_t old_ps = _xt_disable_interrupts();
+    memcpy(out, &stats, sizeof(stats));
+    _xt_restore_interrupts(old_ps);
+}
+
+void netstats_reset(void)
+{
+    uint32_t old_ps = _xt_disable_interrupts();
+    memset(&stats, 0, sizeof(stats));
+    _xt_restore_interrupts(old_ps);
+}
+
+static void print_dir(const char *name, const netstats_dir_t *dir)
+{
+    printf("%s: %u packets %u bytes, chain length 1:%u 2:%u 3:%u 4+:%u\n",
+           name, dir->packets, dir->bytes, dir->chain_len[0],
+           dir->chain_len[1], dir->chain_len[2], dir->chain_len[3]);
+}
+
+void netstats_print(void)
+{
+    netstats_t s;
+    uint32_t mhz = sdk_system_get_cpu_freq();
+
+    if(!ESP_NETSTATS) {
+        printf("netstats: disabled (ESP_NETSTATS=0)\n");
+        return;
+    }
+    netstats_get(&s);
+
+    print_dir("RX", &s.rx);
+    print_dir("TX", &s.tx);
+    printf("TX coalesced: %u chains, %u bytes copied, %u pool misses\n",
+           s.tx_coalesced, s.tx_copied_bytes, s.tx_pool_misses);
+    printf("Drops: rx ethtype %u, rx input %u, rx recvmbox full %u, tx mac %u, tx mem %u\n",
+           s.drops[NETSTATS_DROP_RX_ETHTYPE], s.drops[NETSTATS_DROP_RX_INPUT],
+           s.drops[NETSTATS_DROP_RX_RECVMBOX], s.drops[NETSTATS_DROP_TX_MAC],
+           s.drops[NETSTATS_DROP_TX_MEM]);
+    printf("tcpip mbox high water mark: %u\n", s.tcpip_mbox_hwm);
+    if(s.latency_samples == 0) {
+        printf("RX to socket latency: no samples\n");
+        return;
+    }
+    printf("RX to socket latency: %u samples, min %uus avg %uus max %uus\n",
+           s.latency_samples, s.latency_min / mhz,
+           (uint32_t)(s.latency_total / s.latency_samples / mhz),
+           s.latency_max / mhz);
+    printf("  <16us:%u <32us:%u <64us:%u <128us:%u <256us:%u <512us:%u <1ms:%u >=1ms:%u\n",
+           s.latency_hist[0], s.latency_hist[1], s.latency_hist[2], s.latency_hist[3],
+           s.latency_hist[4], s.latency_hist[5], s.latency_hist[6], s.latency_hist[7]);
+}
@@ -39,13 +39,19 @@
 
 /* MBOX primitives */
 
-#define SYS_MBOX_NULL					( ( QueueHandle_t ) NULL )
+/* OR this flag into the size passed to sys_mbox_new() to create a mailbox
+   that only ever has one task fetching from it (any number of tasks or
+   ISRs may post.) These use a ring buffer and a task notification instead
+   of a FreeRTOS queue. See sys_arch.c. */
+#define SYS_MBOX_SINGLE_CONSUMER		0x10000
+
+#define SYS_MBOX_NULL					( ( sys_mbox_t ) NULL )
 #define SYS_SEM_NULL					( ( SemaphoreHandle_t ) NULL )
 #define SYS_DEFAULT_THREAD_STACK_DEPTH	configMINIMAL_STACK_SIZE
 
 typedef SemaphoreHandle_t sys_sem_t;
 typedef SemaphoreHandle_t sys_mutex_t;
-typedef QueueHandle_t sys_mbox_t;
+typedef struct sys_mbox *sys_mbox_t;
 typedef TaskHandle_t sys_thread_t;
 
 #define sys_mbox_valid( x ) ( ( ( *x ) == NULL) ? pdFALSE : pdTRUE )
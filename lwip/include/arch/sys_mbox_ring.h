@@ -0,0 +1,112 @@
+/* Single consumer mailbox ring for sys_arch.c
+ *
+ * The index logic of the SYS_MBOX_SINGLE_CONSUMER mailboxes: a power of
+ * two ring of void * with free running head and tail indexes (slot =
+ * index & mask). Any number of posters claim a slot and bump the head
+ * inside MBOX_RING_LOCK()/MBOX_RING_UNLOCK(), which disable interrupts on
+ * the ESP8266. The one consumer moves the tail without a lock.
+ *
+ * Before blocking, the consumer calls mbox_ring_prepare_wait(). It
+ * publishes that the consumer is waiting and looks at the ring once more,
+ * so a post racing with it is never missed. A post that finds the
+ * consumer waiting clears the flag and tells its caller to wake it.
+ *
+ * Define MBOX_RING_LOCK(state) and MBOX_RING_UNLOCK(state) before
+ * including this file ('state' is a uint32_t the lock may use). There are
+ * no other dependencies, lwip/tests builds it on a host.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _SYS_MBOX_RING_H
+#define _SYS_MBOX_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    volatile uint32_t head;     /* Only modified with the lock held */
+    volatile uint32_t tail;     /* Only modified by the consumer */
+    uint32_t mask;
+    volatile bool waiting;      /* Consumer is (about to be) blocked */
+    void * volatile *slots;     /* mask + 1 of them */
+} mbox_ring_t;
+
+/* 'n_slots' must be a power of two */
+static inline void mbox_ring_init(mbox_ring_t *r, void * volatile *slots, uint32_t n_slots)
+{
+    r->head = 0;
+    r->tail = 0;
+    r->mask = n_slots - 1;
+    r->waiting = false;
+    r->slots = slots;
+}
+
+static inline uint32_t mbox_ring_used(const mbox_ring_t *r)
+{
+    return r->head - r->tail;
+}
+
+/* Add 'msg'. Returns false if the ring is full. Otherwise sets '*depth' to
+   the messages in the ring after this one, and '*wake' if the consumer is
+   waiting and has to be woken. */
+static inline bool mbox_ring_post(mbox_ring_t *r, void *msg, uint32_t *depth, bool *wake)
+{
+    uint32_t state;
+
+    MBOX_RING_LOCK(state);
+    if (r->head - r->tail > r->mask) {
+        MBOX_RING_UNLOCK(state);
+        return false;
+    }
+    r->slots[r->head & r->mask] = msg;
+    r->head++;
+    *depth = r->head - r->tail;
+    *wake = r->waiting;
+    r->waiting = false;
+    MBOX_RING_UNLOCK(state);
+    return true;
+}
+
+/* Consumer only. Takes the oldest message, returns false if empty. */
+static inline bool mbox_ring_fetch(mbox_ring_t *r, void **msg)
+{
+    uint32_t tail = r->tail;
+
+    if (tail == r->head) {
+        return false;
+    }
+    *msg = r->slots[tail & r->mask];
+    r->tail = tail + 1;
+    return true;
+}
+
+/* Consumer only, after mbox_ring_fetch() found the ring empty. Returns
+   true with a message that arrived in between. Otherwise the consumer may
+   block until woken, and must call mbox_ring_cancel_wait() if it stops
+   waiting for any other reason (a wakeup left over from a race only costs
+   one more pass). */
+static inline bool mbox_ring_prepare_wait(mbox_ring_t *r, void **msg)
+{
+    r->waiting = true;
+    if (mbox_ring_fetch(r, msg)) {
+        r->waiting = false;
+        return true;
+    }
+    return false;
+}
+
+static inline void mbox_ring_cancel_wait(mbox_ring_t *r)
+{
+    r->waiting = false;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SYS_MBOX_RING_H */
@@ -0,0 +1,107 @@
+/* Packet rate and latency statistics for the WiFi <-> lwIP boundary
+ *
+ * Counts packets/bytes in each direction, pbuf chain lengths and drops, the
+ * tcpip thread mailbox high water mark, and the time (in CPU cycles) from a
+ * frame arriving in ethernetif_input() to it being posted to a netconn's
+ * receive mailbox (ie being available to a socket).
+ *
+ * Counters are plain 32-bit increments with no locking, so they cost a few
+ * instructions per packet and are left enabled by default. Set
+ * ESP_NETSTATS=0 (see lwipopts.h) to compile them out.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _ESP_NETSTATS_H
+#define _ESP_NETSTATS_H
+
+#include <stdint.h>
+#include "lwip/opt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct pbuf;
+
+typedef enum {
+    NETSTATS_DROP_RX_ETHTYPE = 0, /* RX frame not IP or ARP */
+    NETSTATS_DROP_RX_INPUT,       /* netif->input() failed, tcpip mailbox full or no memory */
+    NETSTATS_DROP_RX_RECVMBOX,    /* netconn receive mailbox full */
+    NETSTATS_DROP_TX_MAC,         /* 802.11 layer rejected a frame */
+    NETSTATS_DROP_TX_MEM,         /* No memory to coalesce a pbuf chain */
+    NETSTATS_DROP_COUNT
+} netstats_drop_t;
+
+/* pbuf chain length histogram buckets: 1, 2, 3, 4 or more pbufs */
+#define NETSTATS_CHAIN_BUCKETS 4
+
+/* RX to socket latency histogram buckets. Bucket 0 is under 16us, each
+   following bucket doubles, the last bucket is 1ms or more. */
+#define NETSTATS_LATENCY_BUCKETS 8
+
+typedef struct {
+    uint32_t packets;
+    uint32_t bytes;
+    uint32_t chain_len[NETSTATS_CHAIN_BUCKETS];
+} netstats_dir_t;
+
+typedef struct {
+    netstats_dir_t rx;
+    netstats_dir_t tx;
+    uint32_t drops[NETSTATS_DROP_COUNT];
+    uint32_t tx_coalesced;        /* TX pbuf chains copied into a single frame */
+    uint32_t tx_copied_bytes;     /* Bytes copied doing so */
+    uint32_t tx_pool_misses;      /* Frames allocated from the heap as the TX pool was busy */
+    uint16_t tcpip_mbox_hwm;      /* Most messages seen waiting for the tcpip thread */
+    uint32_t latency_samples;
+    uint32_t latency_min;         /* Cycles, RX to socket receive mailbox */
+    uint32_t latency_max;
+    uint64_t latency_total;
+    uint32_t latency_hist[NETSTATS_LATENCY_BUCKETS];
+} netstats_t;
+
+/* Copy a consistent snapshot of the counters into 'stats'. */
+void netstats_get(netstats_t *stats);
+
+/* Zero all counters. */
+void netstats_reset(void);
+
+/* Print the counters to stdout in human readable form. */
+void netstats_print(void);
+
+#if ESP_NETSTATS
+
+void netstats_rx(struct pbuf *p);
+void netstats_tx(struct pbuf *p);
+void netstats_drop(netstats_drop_t reason);
+void netstats_rx_delivered(struct pbuf *p);
+void netstats_mbox_depth(uint32_t depth);
+void netstats_tx_coalesced(uint32_t bytes);
+void netstats_tx_pool_miss(void);
+
+#define NETSTATS_RX(p)            netstats_rx(p)
+#define NETSTATS_TX(p)            netstats_tx(p)
+#define NETSTATS_DROP(reason)     netstats_drop(reason)
+#define NETSTATS_RX_DELIVERED(p)  netstats_rx_delivered(p)
+#define NETSTATS_MBOX_DEPTH(d)    netstats_mbox_depth(d)
+#define NETSTATS_TX_COALESCED(n)  netstats_tx_coalesced(n)
+#define NETSTATS_TX_POOL_MISS()   netstats_tx_pool_miss()
+
+#else
+
+#define NETSTATS_RX(p)
+#define NETSTATS_TX(p)
+#define NETSTATS_DROP(reason)
+#define NETSTATS_RX_DELIVERED(p)
+#define NETSTATS_MBOX_DEPTH(d)
+#define NETSTATS_TX_COALESCED(n)
+#define NETSTATS_TX_POOL_MISS()
+
+#endif /* ESP_NETSTATS */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_NETSTATS_H */
@@ -39,6 +39,14 @@
 #define ESP_TIMEWAIT_THRESHOLD              10000
 #define LWIP_TIMEVAL_PRIVATE                0
 
+/**
+ * ESP_NETSTATS==1: Count packets, drops and RX to socket latency at the
+ * WiFi/lwIP boundary. Cheap enough to leave on, see esp_netstats.h.
+ */
+#ifndef ESP_NETSTATS
+#define ESP_NETSTATS                        1
+#endif
+
 /*
    -----------------------------------------------
    ---------- Platform specific locking ----------
@@ -75,6 +83,13 @@
  */
 #define MEM_LIBC_MALLOC        1
 
+/* Small, short lived lwIP allocations (pbufs, pcbs, netconns...) are
+   served by the core slab allocator, see slab.h */
+#include <slab.h>
+#define mem_malloc                      slab_malloc
+#define mem_calloc                      slab_calloc
+#define mem_free                        slab_free
+
 /**
 * MEMP_MEM_MALLOC==1: Use mem_malloc/mem_free instead of the lwip pool allocator.
 * Especially useful with MEM_LIBC_MALLOC but handle with care regarding execution
@@ -250,8 +265,19 @@
  * be needed without this flag! Use this only if you need to!
  *
  * @todo: TCP and IP-frag do not work with this, yet:
+ *
+ * esp_interface.c coalesces pbuf chains into a single frame itself (see
+ * ESP_TX_POOL_SIZE), so this is off: TCP segments are sized to the data
+ * rather than always MSS-sized, and unbuffered writes aren't copied twice.
  */
-#define LWIP_NETIF_TX_SINGLE_PBUF             1
+#define LWIP_NETIF_TX_SINGLE_PBUF             0
+
+/**
+ * ESP_TX_POOL_SIZE: Number of full size frame buffers kept for coalescing
+ * chained TX pbufs (about 1.6KB each, allocated on first use). When all are
+ * queued in the MAC layer, frames are allocated from the heap.
+ */
+#define ESP_TX_POOL_SIZE                      2
 
 /*
    ------------------------------------
@@ -288,8 +314,11 @@
  * TCPIP_MBOX_SIZE: The mailbox size for the tcpip thread messages
  * The queue size value itself is platform-dependent, but is passed to
  * sys_mbox_new() when tcpip_init is called.
+ *
+ * Only the tcpip thread fetches from this mailbox, so it is created as a
+ * SYS_MBOX_SINGLE_CONSUMER mailbox (lock-free ring + task notification).
  */
-#define TCPIP_MBOX_SIZE                 16
+#define TCPIP_MBOX_SIZE                 (16 | SYS_MBOX_SINGLE_CONSUMER)
 
 /**
  * DEFAULT_UDP_RECVMBOX_SIZE: The mailbox size for the incoming packets on a
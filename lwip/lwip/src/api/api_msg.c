@@ -52,6 +52,8 @@
 #include "lwip/igmp.h"
 #include "lwip/dns.h"
 
+#include "esp_netstats.h"
+
 #include <string.h>
 
 #define SET_NONBLOCKING_CONNECT(conn, val)  do { if(val) { \
@@ -193,9 +195,11 @@ recv_udp(void *arg, struct udp_pcb *pcb, struct pbuf *p,
 
   len = p->tot_len;
   if (sys_mbox_trypost(&conn->recvmbox, buf) != ERR_OK) {
+    NETSTATS_DROP(NETSTATS_DROP_RX_RECVMBOX);
     netbuf_delete(buf);
     return;
   } else {
+    NETSTATS_RX_DELIVERED(p);
 #if LWIP_SO_RCVBUF
     SYS_ARCH_INC(conn->recv_avail, len);
 #endif /* LWIP_SO_RCVBUF */
@@ -250,8 +254,12 @@ recv_tcp(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
 
   if (sys_mbox_trypost(&conn->recvmbox, p) != ERR_OK) {
     /* don't deallocate p: it is presented to us later again from tcp_fasttmr! */
+    NETSTATS_DROP(NETSTATS_DROP_RX_RECVMBOX);
     return ERR_MEM;
   } else {
+    if (p != NULL) {
+      NETSTATS_RX_DELIVERED(p);
+    }
 #if LWIP_SO_RCVBUF
     SYS_ARCH_INC(conn->recv_avail, len);
 #endif /* LWIP_SO_RCVBUF */
@@ -49,6 +49,14 @@
 #include "lwip/mem.h"
 #include "lwip/stats.h"
 
+#include <stdlib.h>
+#include <esp/interrupts.h>
+#include "esp_netstats.h"
+
+#define MBOX_RING_LOCK( ulState )       ( ( ulState ) = _xt_disable_interrupts() )
+#define MBOX_RING_UNLOCK( ulState )     _xt_restore_interrupts( ulState )
+#include "arch/sys_mbox_ring.h"
+
 extern bool esp_in_isr;
 
 /* Based on the default xInsideISR mechanism to determine
@@ -62,23 +70,142 @@ static inline bool is_inside_isr()
     return esp_in_isr;
 }
 
+/*---------------------------------------------------------------------------*
+ * Mailboxes
+ *---------------------------------------------------------------------------*
+ * Most mailboxes are a FreeRTOS queue of void *.
+ *
+ * Mailboxes created with SYS_MBOX_SINGLE_CONSUMER in the size (the tcpip
+ * thread mailbox, see TCPIP_MBOX_SIZE in lwipopts.h) are a ring of void *
+ * instead (see arch/sys_mbox_ring.h). Posting only disables interrupts for
+ * the few instructions needed to claim a slot and bump the head index (there
+ * are no atomic instructions on the lx106), and the consumer is only woken
+ * with a task notification when it is actually blocked waiting. Fetching
+ * needs no locking at all as only the consumer ever moves the tail.
+ *
+ * The consuming task is whichever task first fetches from the mailbox.
+ *---------------------------------------------------------------------------*/
+struct sys_mbox
+{
+    QueueHandle_t xQueue;           /* Generic mailbox, NULL for a ring */
+
+    /* Single consumer ring */
+    mbox_ring_t xRing;
+    TaskHandle_t xConsumer;
+    void * volatile pvSlots[];
+};
+
+static bool prvRingPost( struct sys_mbox *pxMbox, void *pvMessage )
+{
+uint32_t ulDepth;
+bool xWake;
+
+    if( !mbox_ring_post( &pxMbox->xRing, pvMessage, &ulDepth, &xWake ) )
+    {
+        return false;
+    }
+
+    NETSTATS_MBOX_DEPTH( ulDepth );
+
+    if( xWake )
+    {
+        if( is_inside_isr() != pdFALSE )
+        {
+            portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+            vTaskNotifyGiveFromISR( pxMbox->xConsumer, &xHigherPriorityTaskWoken );
+        }
+        else
+        {
+            xTaskNotifyGive( pxMbox->xConsumer );
+        }
+    }
+    return true;
+}
+
+/* Block the consumer until a message arrives or xTicks pass.
+   Returns false on timeout. */
+static bool prvRingWait( struct sys_mbox *pxMbox, void **ppvBuffer, TickType_t xTicks )
+{
+TimeOut_t xTimeOut;
+
+    if( pxMbox->xConsumer == NULL )
+    {
+        pxMbox->xConsumer = xTaskGetCurrentTaskHandle();
+    }
+    configASSERT( pxMbox->xConsumer == xTaskGetCurrentTaskHandle() );
+
+    vTaskSetTimeOutState( &xTimeOut );
+    for( ;; )
+    {
+        if( mbox_ring_fetch( &pxMbox->xRing, ppvBuffer ) )
+        {
+            return true;
+        }
+
+        /* Publish that we're waiting, then look again so a post that raced
+           with us is never missed. */
+        if( mbox_ring_prepare_wait( &pxMbox->xRing, ppvBuffer ) )
+        {
+            return true;
+        }
+
+        if( xTaskCheckForTimeOut( &xTimeOut, &xTicks ) != pdFALSE )
+        {
+            mbox_ring_cancel_wait( &pxMbox->xRing );
+            return false;
+        }
+        ulTaskNotifyTake( pdTRUE, xTicks );
+    }
+}
+
 /*---------------------------------------------------------------------------*
  * Routine:  sys_mbox_new
  *---------------------------------------------------------------------------*
  * Description:
  *      Creates a new mailbox
  * Inputs:
- *      int size                -- Size of elements in the mailbox
+ *      int size                -- Size of elements in the mailbox, optionally
+ *                                 OR'd with SYS_MBOX_SINGLE_CONSUMER
  * Outputs:
  *      sys_mbox_t              -- Handle to new mailbox
  *---------------------------------------------------------------------------*/
 err_t sys_mbox_new( sys_mbox_t *pxMailBox, int iSize )
 {
-    err_t xReturn = ERR_MEM;
+err_t xReturn = ERR_MEM;
+struct sys_mbox *pxMbox;
 
-    *pxMailBox = xQueueCreate( iSize, sizeof( void * ) );
+    if( iSize & SYS_MBOX_SINGLE_CONSUMER )
+    {
+        /* Round the ring up to a power of two */
+        uint32_t ulSlots = 1;
+        while( ulSlots < ( iSize & ~SYS_MBOX_SINGLE_CONSUMER ) )
+        {
+            ulSlots <<= 1;
+        }
+        pxMbox = malloc( sizeof( struct sys_mbox ) + ulSlots * sizeof( void * ) );
+        if( pxMbox != NULL )
+        {
+            pxMbox->xQueue = NULL;
+            mbox_ring_init( &pxMbox->xRing, pxMbox->pvSlots, ulSlots );
+            pxMbox->xConsumer = NULL;
+        }
+    }
+    else
+    {
+        pxMbox = malloc( sizeof( struct sys_mbox ) );
+        if( pxMbox != NULL )
+        {
+            pxMbox->xQueue = xQueueCreate( iSize, sizeof( void * ) );
+            if( pxMbox->xQueue == NULL )
+            {
+                free( pxMbox );
+                pxMbox = NULL;
+            }
+        }
+    }
 
-    if( *pxMailBox != NULL )
+    *pxMailBox = pxMbox;
+    if( pxMbox != NULL )
     {
         xReturn = ERR_OK;
         SYS_STATS_INC_USED( mbox );
@@ -103,8 +230,16 @@ err_t sys_mbox_new( sys_mbox_t *pxMailBox, int iSize )
 void sys_mbox_free( sys_mbox_t *pxMailBox )
 {
 unsigned long ulMessagesWaiting;
+struct sys_mbox *pxMbox = *pxMailBox;
 
-    ulMessagesWaiting = uxQueueMessagesWaiting( *pxMailBox );
+    if( pxMbox->xQueue != NULL )
+    {
+        ulMessagesWaiting = uxQueueMessagesWaiting( pxMbox->xQueue );
+    }
+    else
+    {
+        ulMessagesWaiting = mbox_ring_used( &pxMbox->xRing );
+    }
     configASSERT( ( ulMessagesWaiting == 0 ) );
 
     #if SYS_STATS
@@ -118,7 +253,11 @@ unsigned long ulMessagesWaiting;
     }
     #endif /* SYS_STATS */
 
-    vQueueDelete( *pxMailBox );
+    if( pxMbox->xQueue != NULL )
+    {
+        vQueueDelete( pxMbox->xQueue );
+    }
+    free( pxMbox );
 }
 
 /*---------------------------------------------------------------------------*
@@ -132,7 +271,20 @@ unsigned long ulMessagesWaiting;
  *---------------------------------------------------------------------------*/
 void sys_mbox_post( sys_mbox_t *pxMailBox, void *pxMessageToPost )
 {
-    while( xQueueSendToBack( *pxMailBox, &pxMessageToPost, portMAX_DELAY ) != pdTRUE );
+struct sys_mbox *pxMbox = *pxMailBox;
+
+    if( pxMbox->xQueue == NULL )
+    {
+        /* Ring is full. There is no queue of blocked posters to join, so
+           sleep and retry. The consumer may be lower priority, so
+           yielding alone would not let it run. */
+        while( !prvRingPost( pxMbox, pxMessageToPost ) )
+        {
+            vTaskDelay( 1 );
+        }
+        return;
+    }
+    while( xQueueSendToBack( pxMbox->xQueue, &pxMessageToPost, portMAX_DELAY ) != pdTRUE );
 }
 
 /*---------------------------------------------------------------------------*
@@ -152,14 +304,19 @@ err_t sys_mbox_trypost( sys_mbox_t *pxMailBox, void *pxMessageToPost )
 {
 err_t xReturn;
 portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+struct sys_mbox *pxMbox = *pxMailBox;
 
-    if( is_inside_isr() != pdFALSE )
+    if( pxMbox->xQueue == NULL )
+    {
+        xReturn = prvRingPost( pxMbox, pxMessageToPost ) ? pdPASS : pdFAIL;
+    }
+    else if( is_inside_isr() != pdFALSE )
     {
-        xReturn = xQueueSendFromISR( *pxMailBox, &pxMessageToPost, &xHigherPriorityTaskWoken );
+        xReturn = xQueueSendFromISR( pxMbox->xQueue, &pxMessageToPost, &xHigherPriorityTaskWoken );
     }
     else
     {
-        xReturn = xQueueSend( *pxMailBox, &pxMessageToPost, ( TickType_t ) 0 );
+        xReturn = xQueueSend( pxMbox->xQueue, &pxMessageToPost, ( TickType_t ) 0 );
     }
 
     if( xReturn == pdPASS )
@@ -206,6 +363,8 @@ u32_t sys_arch_mbox_fetch( sys_mbox_t *pxMailBox, void **ppvBuffer, u32_t ulTime
 void *pvDummy;
 TickType_t xStartTime, xEndTime, xElapsed;
 unsigned long ulReturn;
+struct sys_mbox *pxMbox = *pxMailBox;
+BaseType_t xReceived;
 
     xStartTime = xTaskGetTickCount();
 
@@ -218,7 +377,16 @@ unsigned long ulReturn;
     {
         configASSERT( is_inside_isr() == ( portBASE_TYPE ) 0 );
 
-        if( pdTRUE == xQueueReceive( *pxMailBox, &( *ppvBuffer ), ulTimeOut/ portTICK_PERIOD_MS ) )
+        if( pxMbox->xQueue == NULL )
+        {
+            xReceived = prvRingWait( pxMbox, ppvBuffer, ulTimeOut / portTICK_PERIOD_MS ) ? pdTRUE : pdFALSE;
+        }
+        else
+        {
+            xReceived = xQueueReceive( pxMbox->xQueue, &( *ppvBuffer ), ulTimeOut/ portTICK_PERIOD_MS );
+        }
+
+        if( pdTRUE == xReceived )
         {
             xEndTime = xTaskGetTickCount();
             xElapsed = ( xEndTime - xStartTime ) * portTICK_PERIOD_MS;
@@ -234,7 +402,14 @@ unsigned long ulReturn;
     }
     else
     {
-        while( pdTRUE != xQueueReceive( *pxMailBox, &( *ppvBuffer ), portMAX_DELAY ) );
+        if( pxMbox->xQueue == NULL )
+        {
+            while( !prvRingWait( pxMbox, ppvBuffer, portMAX_DELAY ) );
+        }
+        else
+        {
+            while( pdTRUE != xQueueReceive( pxMbox->xQueue, &( *ppvBuffer ), portMAX_DELAY ) );
+        }
         xEndTime = xTaskGetTickCount();
         xElapsed = ( xEndTime - xStartTime ) * portTICK_PERIOD_MS;
 
@@ -269,19 +444,24 @@ void *pvDummy;
 unsigned long ulReturn;
 long lResult;
 portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+struct sys_mbox *pxMbox = *pxMailBox;
 
     if( ppvBuffer== NULL )
     {
         ppvBuffer = &pvDummy;
     }
 
-    if( is_inside_isr() != pdFALSE )
+    if( pxMbox->xQueue == NULL )
+    {
+        lResult = mbox_ring_fetch( &pxMbox->xRing, ppvBuffer ) ? pdPASS : pdFAIL;
+    }
+    else if( is_inside_isr() != pdFALSE )
     {
-        lResult = xQueueReceiveFromISR( *pxMailBox, &( *ppvBuffer ), &xHigherPriorityTaskWoken );
+        lResult = xQueueReceiveFromISR( pxMbox->xQueue, &( *ppvBuffer ), &xHigherPriorityTaskWoken );
     }
     else
     {
-        lResult = xQueueReceive( *pxMailBox, &( *ppvBuffer ), 0UL );
+        lResult = xQueueReceive( pxMbox->xQueue, &( *ppvBuffer ), 0UL );
     }
 
     if( lResult == pdPASS )
@@ -0,0 +1,191 @@
+/* Host unit tests for sys_mbox_ring.h, the single consumer tcpip mailbox.
+ *
+ * Threads stand in for the posting tasks and a POSIX semaphore for the
+ * consumer's task notification. The lock is a mutex instead of disabling
+ * interrupts, and the lock-free consumer relies on the host being x86
+ * (stores aren't reordered), like sys_arch.c relies on the ESP8266 having
+ * one core.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define MBOX_RING_LOCK(state) ((void)(state), pthread_mutex_lock(&lock))
+#define MBOX_RING_UNLOCK(state) pthread_mutex_unlock(&lock)
+#include "sys_mbox_ring.h"
+#include "check.h"
+
+/* Messages are (producer << 24) | sequence, offset by one so none are NULL */
+#define MSG(producer, seq) ((void *)(uintptr_t)(((producer) << 24) | ((seq) + 1)))
+#define MSG_PRODUCER(msg) ((uint32_t)(uintptr_t)(msg) >> 24)
+#define MSG_SEQ(msg) (((uint32_t)(uintptr_t)(msg) & 0xffffff) - 1)
+
+static void test_basic(void)
+{
+    void * volatile slots[4];
+    mbox_ring_t r;
+    uint32_t depth;
+    bool wake;
+    void *msg;
+
+    mbox_ring_init(&r, slots, 4);
+    CHECK(!mbox_ring_fetch(&r, &msg));
+    for (uint32_t i = 0; i < 4; i++) {
+        CHECK(mbox_ring_post(&r, MSG(0, i), &depth, &wake));
+        CHECK(depth == i + 1 && !wake);
+    }
+    CHECK(!mbox_ring_post(&r, MSG(0, 4), &depth, &wake));
+    CHECK(mbox_ring_used(&r) == 4);
+    for (int i = 0; i < 4; i++) {
+        CHECK(mbox_ring_fetch(&r, &msg) && msg == MSG(0, i));
+    }
+    CHECK(!mbox_ring_fetch(&r, &msg));
+
+    /* A waiting consumer is woken by the next post only */
+    CHECK(!mbox_ring_prepare_wait(&r, &msg));
+    CHECK(mbox_ring_post(&r, MSG(0, 5), &depth, &wake) && wake);
+    CHECK(mbox_ring_post(&r, MSG(0, 6), &depth, &wake) && !wake);
+    CHECK(mbox_ring_prepare_wait(&r, &msg) && msg == MSG(0, 5));
+    CHECK(!r.waiting);
+    CHECK(mbox_ring_fetch(&r, &msg) && msg == MSG(0, 6));
+    CHECK(!mbox_ring_prepare_wait(&r, &msg));
+    mbox_ring_cancel_wait(&r);
+    CHECK(mbox_ring_post(&r, MSG(0, 7), &depth, &wake) && !wake);
+    CHECK(mbox_ring_fetch(&r, &msg) && msg == MSG(0, 7));
+}
+
+/* The free running indexes wrap around */
+static void test_wrap(void)
+{
+    void * volatile slots[8];
+    mbox_ring_t r;
+    uint32_t depth;
+    bool wake;
+    void *msg;
+
+    mbox_ring_init(&r, slots, 8);
+    r.head = r.tail = UINT32_MAX - 5;
+    for (int i = 0; i < 100; i++) {
+        uint32_t n = i % 8 + 1;
+        for (uint32_t j = 0; j < n; j++) {
+            CHECK(mbox_ring_post(&r, MSG(1, j), &depth, &wake));
+        }
+        CHECK(mbox_ring_used(&r) == n);
+        if (n == 8) {
+            CHECK(!mbox_ring_post(&r, MSG(1, 8), &depth, &wake));
+        }
+        for (uint32_t j = 0; j < n; j++) {
+            CHECK(mbox_ring_fetch(&r, &msg) && msg == MSG(1, j));
+        }
+    }
+}
+
+#define PRODUCERS 4
+#define MESSAGES_PER_PRODUCER 200000
+#define RING_SLOTS 16
+
+static void * volatile stress_slots[RING_SLOTS];
+static mbox_ring_t stress_ring;
+static sem_t notify;
+static uint32_t overfull, wakes;
+
+static void *producer(void *arg)
+{
+    uint32_t p = (uintptr_t)arg;
+
+    for (uint32_t i = 0; i < MESSAGES_PER_PRODUCER; i++) {
+        uint32_t depth;
+        bool wake;
+        /* Full: let the consumer run, like sys_mbox_post() sleeps */
+        while (!mbox_ring_post(&stress_ring, MSG(p, i), &depth, &wake)) {
+            sched_yield();
+        }
+        if (wake) {
+            __atomic_add_fetch(&wakes, 1, __ATOMIC_RELAXED);
+            sem_post(&notify);
+        }
+        if (depth > RING_SLOTS) {
+            __atomic_store_n(&overfull, depth, __ATOMIC_RELAXED);
+        }
+    }
+    return NULL;
+}
+
+/* Blocks like prvRingWait() in sys_arch.c. A lost wakeup shows up as a
+   timeout with messages still to come. */
+static bool consumer_fetch(void **msg)
+{
+    for (;;) {
+        if (mbox_ring_fetch(&stress_ring, msg)) {
+            return true;
+        }
+        if (mbox_ring_prepare_wait(&stress_ring, msg)) {
+            return true;
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += 5;
+        while (sem_timedwait(&notify, &ts) != 0) {
+            if (errno == ETIMEDOUT) {
+                mbox_ring_cancel_wait(&stress_ring);
+                return false;
+            }
+        }
+    }
+}
+
+static void test_stress(void)
+{
+    pthread_t threads[PRODUCERS];
+    uint32_t next_seq[PRODUCERS] = { 0 };
+    uint32_t received = 0, bad = 0;
+
+    mbox_ring_init(&stress_ring, stress_slots, RING_SLOTS);
+    sem_init(&notify, 0, 0);
+    for (int p = 0; p < PRODUCERS; p++) {
+        pthread_create(&threads[p], NULL, producer, (void *)(uintptr_t)p);
+    }
+    while (received < PRODUCERS * MESSAGES_PER_PRODUCER) {
+        void *msg;
+        if (!consumer_fetch(&msg)) {
+            printf("stress: timed out after %u messages\n", received);
+            break;
+        }
+        uint32_t p = MSG_PRODUCER(msg);
+        /* Each producer's messages arrive in order, none lost or doubled */
+        if (p >= PRODUCERS || MSG_SEQ(msg) != next_seq[p]) {
+            bad++;
+        } else {
+            next_seq[p]++;
+        }
+        received++;
+    }
+    for (int p = 0; p < PRODUCERS; p++) {
+        pthread_join(threads[p], NULL);
+    }
+    CHECK(received == PRODUCERS * MESSAGES_PER_PRODUCER);
+    CHECK(bad == 0);
+    CHECK(overfull == 0);
+    CHECK(mbox_ring_used(&stress_ring) == 0);
+    printf("stress: %u messages from %d threads, %u wakeups\n", received, PRODUCERS, wakes);
+    sem_destroy(&notify);
+}
+
+int main(void)
+{
+    test_basic();
+    test_wrap();
+    test_stress();
+    return check_done("mbox_ring");
+}
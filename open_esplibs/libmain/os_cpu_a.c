@@ -33,9 +33,9 @@ void IRAM vPortYield(void) {
             movi   a0, _xt_user_exit       \n\
             s32i   a0, sp, 0               \n\
             call0  sdk__xt_int_enter       \n\
-            call0  vPortEnterCritical      \n\
+            call0  vPortEnterSwitchCritical \n\
             call0  vTaskSwitchContext      \n\
-            call0  vPortExitCritical       \n\
+            call0  vPortExitSwitchCritical \n\
             call0  sdk__xt_int_exit        \n\
     ");
 }
@@ -102,20 +102,15 @@ void IRAM sdk__xt_tick_timer_init(void) {
     WSR(ints_enabled | INTENABLE_CCOMPARE, intenable);
 }
 
+// The blob versions wrote INTENABLE directly, these also keep the state
+// used by critical sections with timing critical interrupts in sync.
 void IRAM sdk__xt_isr_unmask(uint32_t mask) {
-    uint32_t ints_enabled;
-
-    ints_enabled = 0;
-    XSR(ints_enabled, intenable);
-    WSR(ints_enabled | mask, intenable);
+    _xt_isr_unmask(mask);
 }
 
+// Note this takes the interrupts to keep enabled, not the ones to mask
 void IRAM sdk__xt_isr_mask(uint32_t mask) {
-    uint32_t ints_enabled;
-
-    ints_enabled = 0;
-    XSR(ints_enabled, intenable);
-    WSR(ints_enabled & mask, intenable);
+    _xt_isr_mask(~mask);
 }
 
 uint32_t IRAM sdk__xt_read_ints(void) {
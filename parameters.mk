@@ -118,6 +118,10 @@ CPPFLAGS	+= -mlongcalls -mtext-section-literals
 
 LDFLAGS		= -nostdlib -Wl,--no-check-sections -L$(BUILD_DIR)sdklib -L$(ROOT)lib -u $(ENTRY_SYMBOL) -Wl,-static -Wl,-Map=$(BUILD_DIR)$(PROGRAM).map $(EXTRA_LDFLAGS)
 
+# free() and realloc() go through the slab allocator (core/slab_libc.c),
+# as binary SDK libraries call them on blocks from pvPortMalloc()
+LDFLAGS		+= -Wl,--wrap=free -Wl,--wrap=realloc
+
 ifeq ($(WARNINGS_AS_ERRORS),1)
     C_CXX_FLAGS += -Werror
 endif
@@ -0,0 +1,120 @@
+#include <stdlib.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "lwip/sys.h"
+#include "espressif/esp_common.h"
+
+#include "testcase.h"
+
+DEFINE_SOLO_TESTCASE(07_mbox_single_consumer_stress)
+DEFINE_SOLO_TESTCASE(07_mbox_benchmark)
+
+#define PRODUCERS 3
+#define MESSAGES_PER_PRODUCER 5000
+
+/* Messages are (producer << 24) | sequence, offset by one so none are NULL */
+#define MSG(producer, seq) ((void *)(((producer) << 24) | ((seq) + 1)))
+#define MSG_PRODUCER(msg) ((uint32_t)(msg) >> 24)
+#define MSG_SEQ(msg) (((uint32_t)(msg) & 0xffffff) - 1)
+
+static sys_mbox_t mbox;
+static volatile int producers_done;
+
+static void producer_task(void *pvParameters)
+{
+    uint32_t producer = (uint32_t)pvParameters;
+    for(uint32_t i = 0; i < MESSAGES_PER_PRODUCER; i++) {
+        /* Mix blocking posts with tryposts that retry when the ring is full */
+        if(i & 1) {
+            sys_mbox_post(&mbox, MSG(producer, i));
+        } else {
+            while(sys_mbox_trypost(&mbox, MSG(producer, i)) != ERR_OK) {
+                vTaskDelay(1);
+            }
+        }
+    }
+    /* Read-modify-write from several tasks */
+    taskENTER_CRITICAL();
+    producers_done++;
+    taskEXIT_CRITICAL();
+    vTaskDelete(NULL);
+}
+
+/* Producers run below, at and above the consumer's priority so the ring is
+   seen both empty (consumer blocked on its notification) and full. */
+static void stress_task(void *pvParameters)
+{
+    uint32_t next_seq[PRODUCERS] = { 0 };
+
+    TEST_ASSERT_EQUAL_INT(ERR_OK, sys_mbox_new(&mbox, 16 | SYS_MBOX_SINGLE_CONSUMER));
+    for(int p = 0; p < PRODUCERS; p++) {
+        xTaskCreate(producer_task, "producer", 256, (void *)p, 1 + p, NULL);
+    }
+
+    for(int n = 0; n < PRODUCERS * MESSAGES_PER_PRODUCER; n++) {
+        void *msg;
+        u32_t r = sys_arch_mbox_fetch(&mbox, &msg, 1000);
+        TEST_ASSERT_NOT_EQUAL_MESSAGE(SYS_ARCH_TIMEOUT, r, "Timed out waiting for message");
+        uint32_t producer = MSG_PRODUCER(msg);
+        TEST_ASSERT_TRUE_MESSAGE(producer < PRODUCERS, "Corrupt message");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(next_seq[producer], MSG_SEQ(msg), "Message lost or reordered");
+        next_seq[producer]++;
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(SYS_MBOX_EMPTY, sys_arch_mbox_tryfetch(&mbox, NULL));
+    TEST_ASSERT_EQUAL_UINT32(SYS_ARCH_TIMEOUT, sys_arch_mbox_fetch(&mbox, NULL, 50));
+    while(producers_done < PRODUCERS) {
+        vTaskDelay(1);
+    }
+    sys_mbox_free(&mbox);
+    TEST_PASS();
+}
+
+static void a_07_mbox_single_consumer_stress(void)
+{
+    xTaskCreate(stress_task, "stress", 512, NULL, 2, NULL);
+}
+
+/* Benchmark: messages per second through a mailbox from a lower priority
+   producer to the consumer, as between the WiFi task and tcpip thread. */
+
+#define BENCH_MESSAGES 20000
+
+static void bench_producer_task(void *pvParameters)
+{
+    for(uint32_t i = 0; i < BENCH_MESSAGES; i++) {
+        sys_mbox_post(&mbox, MSG(0, i));
+    }
+    vTaskDelete(NULL);
+}
+
+static uint32_t bench_mbox(int size)
+{
+    TEST_ASSERT_EQUAL_INT(ERR_OK, sys_mbox_new(&mbox, size));
+    uint32_t start = sdk_system_get_time();
+    xTaskCreate(bench_producer_task, "bench", 256, NULL, 1, NULL);
+    for(int n = 0; n < BENCH_MESSAGES; n++) {
+        sys_arch_mbox_fetch(&mbox, NULL, 0);
+    }
+    uint32_t elapsed = sdk_system_get_time() - start;
+    sys_mbox_free(&mbox);
+    vTaskDelay(2); /* let the producer task be deleted */
+    return (uint64_t)BENCH_MESSAGES * 1000000 / elapsed;
+}
+
+static void bench_task(void *pvParameters)
+{
+    uint32_t queue_rate = bench_mbox(16);
+    uint32_t ring_rate = bench_mbox(16 | SYS_MBOX_SINGLE_CONSUMER);
+    printf("FreeRTOS queue mailbox: %u messages/s\n", queue_rate);
+    printf("Single consumer mailbox: %u messages/s\n", ring_rate);
+    TEST_ASSERT_TRUE_MESSAGE(ring_rate > queue_rate,
+                             "Single consumer mailbox should be faster than a queue");
+    TEST_PASS();
+}
+
+static void a_07_mbox_benchmark(void)
+{
+    xTaskCreate(bench_task, "bench", 512, NULL, 2, NULL);
+}
@@ -0,0 +1,133 @@
+#include <stdlib.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "slab.h"
+
+#include "testcase.h"
+
+DEFINE_SOLO_TESTCASE(08_slab_basic)
+DEFINE_SOLO_TESTCASE(08_slab_exhaust)
+DEFINE_SOLO_TESTCASE(08_slab_libc_free)
+
+static const size_t sizes[] = { 1, 16, 17, 24, 40, 41, 48, 64, 65, 128, 256 };
+
+#define N_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+static void a_08_slab_basic(void)
+{
+    void *ptrs[N_SIZES];
+
+    for(int i = 0; i < N_SIZES; i++) {
+        ptrs[i] = slab_malloc(sizes[i]);
+        TEST_ASSERT_NOT_NULL(ptrs[i]);
+        memset(ptrs[i], i, sizes[i]);
+    }
+    for(int i = 0; i < N_SIZES; i++) {
+        for(int j = 0; j < sizes[i]; j++) {
+            TEST_ASSERT_EQUAL_UINT8_MESSAGE(i, ((uint8_t *)ptrs[i])[j], "Allocations overlap");
+        }
+    }
+
+    /* A freed object is the next one handed out for its size class */
+    void *p = ptrs[3];
+    slab_free(p);
+    TEST_ASSERT_EQUAL_PTR(p, slab_malloc(sizes[3]));
+
+    /* Growing across size classes keeps the contents */
+    uint8_t *r = slab_realloc(ptrs[1], 200);
+    TEST_ASSERT_NOT_NULL(r);
+    for(int j = 0; j < 16; j++) {
+        TEST_ASSERT_EQUAL_UINT8(1, r[j]);
+    }
+    ptrs[1] = r;
+
+    /* Large allocations and blocks from malloc() go to newlib */
+    void *big = pvPortMalloc(1024);
+    TEST_ASSERT_NOT_NULL(big);
+    vPortFree(big);
+    void *from_malloc = malloc(32);
+    slab_free(from_malloc);
+
+    uint8_t *z = slab_calloc(10, 10);
+    for(int j = 0; j < 100; j++) {
+        TEST_ASSERT_EQUAL_UINT8(0, z[j]);
+    }
+    slab_free(z);
+
+    for(int i = 0; i < N_SIZES; i++) {
+        slab_free(ptrs[i]);
+    }
+    slab_print_stats();
+    TEST_PASS();
+}
+
+/* Fill the slab with one size class until it falls back to malloc(), then
+   free everything and check the pages (and extents) are given back. */
+
+#define EXHAUST_MAX 1024
+
+static void a_08_slab_exhaust(void)
+{
+    static void *ptrs[EXHAUST_MAX];
+    slab_stats_t before, full, after;
+    int n;
+
+    slab_get_stats(&before);
+    for(n = 0; n < EXHAUST_MAX; n++) {
+        ptrs[n] = slab_malloc(32);
+        TEST_ASSERT_NOT_NULL(ptrs[n]);
+        slab_get_stats(&full);
+        if(full.cls[2].fallbacks != before.cls[2].fallbacks) {
+            n++;
+            break;
+        }
+    }
+    printf("%d allocations until fallback, %u extents\n", n, full.extents);
+    TEST_ASSERT_EQUAL_UINT16(0, full.pages_free);
+    TEST_ASSERT_EQUAL_UINT32(before.cls[2].inuse + n - 1, full.cls[2].inuse);
+
+    for(int i = 0; i < n; i++) {
+        slab_free(ptrs[i]);
+    }
+    slab_get_stats(&after);
+    slab_print_stats();
+    TEST_ASSERT_EQUAL_UINT32(before.cls[2].inuse, after.cls[2].inuse);
+    TEST_ASSERT_TRUE_MESSAGE(after.extents <= before.extents,
+                             "Completely free extents should be returned to the heap");
+    TEST_PASS();
+}
+
+/* Binary SDK libraries call free() and realloc() on blocks from
+   pvPortMalloc(), which must end up back in the slab */
+
+static void a_08_slab_libc_free(void)
+{
+    slab_stats_t before, during, after;
+
+    slab_get_stats(&before);
+    void *p = pvPortMalloc(32);
+    TEST_ASSERT_NOT_NULL(p);
+    slab_get_stats(&during);
+    TEST_ASSERT_EQUAL_UINT32(before.cls[2].inuse + 1, during.cls[2].inuse);
+    free(p);
+    slab_get_stats(&after);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(before.cls[2].inuse, after.cls[2].inuse,
+                                     "free() should return slab blocks to the slab");
+
+    /* realloc() keeps the contents when moving to a bigger class */
+    uint8_t *r = pvPortMalloc(16);
+    TEST_ASSERT_NOT_NULL(r);
+    memset(r, 0x5a, 16);
+    r = realloc(r, 48);
+    TEST_ASSERT_NOT_NULL(r);
+    for(int j = 0; j < 16; j++) {
+        TEST_ASSERT_EQUAL_UINT8(0x5a, r[j]);
+    }
+    slab_get_stats(&during);
+    TEST_ASSERT_EQUAL_UINT32(before.cls[0].inuse, during.cls[0].inuse);
+    TEST_ASSERT_EQUAL_UINT32(before.cls[4].inuse + 1, during.cls[4].inuse);
+    free(r);
+    slab_get_stats(&after);
+    TEST_ASSERT_EQUAL_UINT32(before.cls[4].inuse, after.cls[4].inuse);
+    TEST_PASS();
+}
@@ -0,0 +1,80 @@
+#include <stdlib.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "tickless.h"
+#include "espressif/esp_common.h"
+
+#include "testcase.h"
+
+DEFINE_SOLO_TESTCASE(09_tickless_compensation)
+DEFINE_SOLO_TESTCASE(09_tickless_delay)
+
+#define TICK 800000   /* 10ms at 80MHz */
+
+static void a_09_tickless_compensation(void)
+{
+    tickless_sleep_t s;
+    uint32_t compare;
+
+    /* Nothing to gain from sleeping one tick, or with the tick imminent */
+    TEST_ASSERT_FALSE(tickless_plan(&s, 1000000, 0, TICK, 1));
+    TEST_ASSERT_FALSE(tickless_plan(&s, 1000, 0, TICK, 10));
+
+    /* Sleep 10 ticks: the tick interrupt handles the 10th */
+    TEST_ASSERT_TRUE(tickless_plan(&s, 1000000, 500000, TICK, 10));
+    TEST_ASSERT_EQUAL_UINT32(9, s.ticks);
+    TEST_ASSERT_EQUAL_UINT32(1000000 + 9 * TICK, s.target);
+
+    /* Tick interrupt woke us and moved CCOMPARE0 on */
+    TEST_ASSERT_EQUAL_UINT32(9, tickless_wake(&s, s.target + 100, s.target + TICK, &compare));
+    TEST_ASSERT_EQUAL_UINT32(s.target + TICK, compare);
+
+    /* Other interrupt before the first tick was due */
+    TEST_ASSERT_EQUAL_UINT32(0, tickless_wake(&s, 600000, s.target, &compare));
+    TEST_ASSERT_EQUAL_UINT32(1000000, compare);
+
+    /* Other interrupt part way through the third tick period */
+    TEST_ASSERT_EQUAL_UINT32(3, tickless_wake(&s, 1000000 + 2 * TICK + 5000, s.target, &compare));
+    TEST_ASSERT_EQUAL_UINT32(1000000 + 3 * TICK, compare);
+
+    /* ... just before a tick is due: count it now rather than race it */
+    TEST_ASSERT_EQUAL_UINT32(4, tickless_wake(&s, 1000000 + 3 * TICK - 10, s.target, &compare));
+    TEST_ASSERT_EQUAL_UINT32(1000000 + 4 * TICK, compare);
+
+    /* Target reached but its interrupt still pending: leave CCOMPARE0 */
+    TEST_ASSERT_EQUAL_UINT32(9, tickless_wake(&s, s.target + 10, s.target, &compare));
+    TEST_ASSERT_EQUAL_UINT32(s.target, compare);
+
+    /* Across CCOUNT wraparound */
+    TEST_ASSERT_TRUE(tickless_plan(&s, 0xfff00000, 0xffe00000, TICK, 5));
+    TEST_ASSERT_EQUAL_UINT32(2, tickless_wake(&s, 0xfff00000 + TICK + 10, s.target, &compare));
+    TEST_ASSERT_EQUAL_UINT32(0xfff00000 + 2 * TICK, compare);
+
+    /* Long sleeps are limited to 2^31 cycles */
+    TEST_ASSERT_TRUE(tickless_plan(&s, 1000000, 500000, TICK, portMAX_DELAY));
+    TEST_ASSERT_TRUE(s.target - 500000 < 0x80000000);
+    TEST_PASS();
+}
+
+/* Delays must take the same time whether or not the tick is suppressed */
+static void a_09_tickless_delay(void)
+{
+    tickless_stats_t stats;
+
+    tickless_reset_stats();
+    for (int i = 0; i < 5; i++) {
+        TickType_t ticks = xTaskGetTickCount();
+        uint32_t start = sdk_system_get_time();
+        vTaskDelay(200 / portTICK_PERIOD_MS);
+        uint32_t us = sdk_system_get_time() - start;
+        TEST_ASSERT_EQUAL_UINT32(200 / portTICK_PERIOD_MS, xTaskGetTickCount() - ticks);
+        TEST_ASSERT_INT_WITHIN_MESSAGE(portTICK_PERIOD_MS * 1000, 200000, us, "Delay length wrong");
+    }
+    tickless_get_stats(&stats);
+    printf("sleeps %u (%u early), slept %u ticks, awake %u ticks\n",
+           stats.sleeps, stats.early_wakes, stats.slept_ticks, stats.awake_ticks);
+#if configUSE_TICKLESS_IDLE
+    TEST_ASSERT_TRUE(stats.sleeps > 0);
+#endif
+    TEST_PASS();
+}
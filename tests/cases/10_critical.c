@@ -0,0 +1,78 @@
+#include <esp/timer.h>
+#include <xtensa_ops.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "espressif/esp_common.h"
+
+#include "testcase.h"
+
+DEFINE_SOLO_TESTCASE(10_timing_critical_interrupts)
+
+static volatile uint32_t frc1_count;
+
+static uint32_t read_intenable(void)
+{
+    uint32_t intenable;
+    RSR(intenable, intenable);
+    return intenable;
+}
+
+static void IRAM frc1_isr(void)
+{
+    frc1_count++;
+}
+
+/* Count FRC1 interrupts (at 10kHz) during a 5ms critical section */
+static uint32_t count_in_critical(void)
+{
+    taskENTER_CRITICAL();
+    uint32_t before = frc1_count;
+    sdk_os_delay_us(5000);
+    uint32_t after = frc1_count;
+    taskEXIT_CRITICAL();
+    return after - before;
+}
+
+static void a_10_timing_critical_interrupts(void)
+{
+    _xt_isr_attach(INUM_TIMER_FRC1, frc1_isr);
+    timer_set_frequency(FRC1, 10000);
+    timer_set_interrupts(FRC1, true);
+    timer_set_run(FRC1, true);
+
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, count_in_critical(),
+                                     "Interrupts should be masked by default");
+
+    TEST_ASSERT_TRUE(vPortSetTimingCriticalInterrupts(BIT(INUM_TIMER_FRC1)));
+    uint32_t n = count_in_critical();
+    printf("%u FRC1 interrupts during critical section\n", n);
+    TEST_ASSERT_UINT32_WITHIN_MESSAGE(2, 50, n, "Timing critical interrupt was held off");
+
+    /* Other interrupts are still held off, and unmasking one inside a
+       critical section takes effect when it ends */
+    uint32_t ticks = xTaskGetTickCount();
+    taskENTER_CRITICAL();
+    _xt_isr_mask(BIT(INUM_TIMER_FRC2));
+    _xt_isr_unmask(BIT(INUM_TIMER_FRC2));
+    uint32_t inside = read_intenable();
+    sdk_os_delay_us(30000);
+    uint32_t ticks_inside = xTaskGetTickCount();
+    taskEXIT_CRITICAL();
+    TEST_ASSERT_EQUAL_UINT32(ticks, ticks_inside);
+    TEST_ASSERT_EQUAL_UINT32(BIT(INUM_TIMER_FRC1), inside);
+    TEST_ASSERT_NOT_EQUAL(0, read_intenable() & BIT(INUM_TIMER_FRC2));
+
+    /* Nested sections keep them masked until the outermost one ends */
+    taskENTER_CRITICAL();
+    taskENTER_CRITICAL();
+    taskEXIT_CRITICAL();
+    inside = read_intenable();
+    taskEXIT_CRITICAL();
+    TEST_ASSERT_EQUAL_UINT32(0, inside & BIT(INUM_TICK));
+    TEST_ASSERT_NOT_EQUAL(0, read_intenable() & BIT(INUM_TICK));
+
+    TEST_ASSERT_TRUE(vPortSetTimingCriticalInterrupts(0));
+    timer_set_interrupts(FRC1, false);
+    timer_set_run(FRC1, false);
+    TEST_PASS();
+}
@@ -0,0 +1,88 @@
+#include <stdlib.h>
+#include <string.h>
+#include <xtensa_ops.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+#include "testcase.h"
+
+DEFINE_SOLO_TESTCASE(11_timers_many)
+
+/* Runs with either timer implementation, set configUSE_TIMER_WHEEL to
+   test the timing wheel */
+
+#define N_TIMERS 200
+
+static StaticTimer_t buffers[N_TIMERS];
+static TimerHandle_t timers[N_TIMERS];
+static TickType_t due[N_TIMERS];
+static volatile TickType_t fired[N_TIMERS];
+static volatile uint16_t fire_count[N_TIMERS];
+
+static void timer_cb(TimerHandle_t timer)
+{
+    int i = (int)pvTimerGetTimerID(timer);
+    fired[i] = xTaskGetTickCount();
+    fire_count[i]++;
+}
+
+static uint32_t ccount(void)
+{
+    uint32_t ccount;
+    RSR(ccount, ccount);
+    return ccount;
+}
+
+static void a_11_timers_many(void)
+{
+    uint32_t start_cycles = 0, stop_cycles = 0;
+
+    srand(11);
+    for (int i = 0; i < N_TIMERS; i++) {
+        TickType_t period = 1 + rand() % 50;
+        if (i % 10 == 0) {
+            period += 1000;     /* Stopped before they expire */
+        }
+        timers[i] = xTimerCreateStatic("t", period, pdFALSE, (void *)i, timer_cb, &buffers[i]);
+        TEST_ASSERT_NOT_NULL(timers[i]);
+    }
+
+    /* With timers.c these can block when the command queue is full */
+    for (int i = 0; i < N_TIMERS; i++) {
+        TickType_t now = xTaskGetTickCount();
+        uint32_t before = ccount();
+        TEST_ASSERT_TRUE(xTimerStart(timers[i], 100));
+        start_cycles += ccount() - before;
+        due[i] = now + xTimerGetPeriod(timers[i]);
+    }
+
+    vTaskDelay(60);
+    for (int i = 0; i < N_TIMERS; i += 10) {
+        TEST_ASSERT_TRUE(xTimerIsTimerActive(timers[i]));
+        uint32_t before = ccount();
+        TEST_ASSERT_TRUE(xTimerStop(timers[i], 100));
+        stop_cycles += ccount() - before;
+    }
+    vTaskDelay(20);
+
+    printf("%d timers: %u cycles per start, %u per stop (%s)\n", N_TIMERS,
+           start_cycles / N_TIMERS, stop_cycles / (N_TIMERS / 10),
+           configUSE_TIMER_WHEEL ? "timer wheel" : "timers.c");
+    for (int i = 0; i < N_TIMERS; i++) {
+        TEST_ASSERT_FALSE(xTimerIsTimerActive(timers[i]));
+        if (i % 10 == 0) {
+            TEST_ASSERT_EQUAL_UINT16_MESSAGE(0, fire_count[i], "Stopped timer fired");
+        } else {
+            TEST_ASSERT_EQUAL_UINT16_MESSAGE(1, fire_count[i], "Timer didn't fire once");
+            /* Callbacks can run late (but never early) if several are due
+               on the same tick */
+            TEST_ASSERT_INT_WITHIN_MESSAGE(1, due[i], fired[i], "Timer fired at the wrong time");
+            TEST_ASSERT_TRUE((int32_t)(fired[i] - due[i]) >= 0);
+        }
+    }
+    for (int i = 0; i < N_TIMERS; i++) {
+        TEST_ASSERT_TRUE(xTimerDelete(timers[i], 100));
+    }
+    TEST_PASS();
+}
@@ -0,0 +1,81 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "esp/spi.h"
+
+#include "testcase.h"
+
+DEFINE_SOLO_TESTCASE(12_spi_bus_devices)
+
+/* Nothing is sent, so nothing needs to be connected to HSPI */
+static const spi_device_t dev_a = {
+    .bus = 1,
+    .settings = { SPI_MODE0, SPI_FREQ_DIV_20M, true, SPI_LITTLE_ENDIAN, true },
+    .cs_gpio = SPI_CS_NONE
+};
+
+static const spi_device_t dev_b = {
+    .bus = 1,
+    .settings = { SPI_MODE3, SPI_FREQ_DIV_1M, false, SPI_BIG_ENDIAN, false },
+    .cs_gpio = SPI_CS_NONE
+};
+
+static void check_settings(const spi_settings_t *expect)
+{
+    spi_settings_t s;
+
+    spi_get_settings(1, &s);
+    TEST_ASSERT_EQUAL(expect->mode, s.mode);
+    TEST_ASSERT_EQUAL_HEX32(expect->freq_divider, s.freq_divider);
+    TEST_ASSERT_EQUAL(expect->msb, s.msb);
+    TEST_ASSERT_EQUAL(expect->endianness, s.endianness);
+    TEST_ASSERT_EQUAL(expect->minimal_pins, s.minimal_pins);
+}
+
+static volatile bool other_got_bus;
+
+static void other_task(void *arg)
+{
+    other_got_bus = spi_device_acquire(&dev_b, 0);
+    if (other_got_bus) {
+        spi_device_release(&dev_b);
+    }
+    vTaskDelete(NULL);
+}
+
+static void a_12_spi_bus_devices(void)
+{
+    TEST_ASSERT_TRUE(spi_set_settings(1, &dev_a.settings));
+    check_settings(&dev_a.settings);
+
+    /* Each device's settings are applied when it takes the bus */
+    TEST_ASSERT_TRUE(spi_device_acquire(&dev_b, portMAX_DELAY));
+    check_settings(&dev_b.settings);
+    spi_device_release(&dev_b);
+    TEST_ASSERT_TRUE(spi_device_acquire(&dev_a, portMAX_DELAY));
+    check_settings(&dev_a.settings);
+
+    /* Settings changed behind the device layer's back are put right */
+    spi_set_mode(1, SPI_MODE2);
+    spi_set_frequency_div(1, SPI_FREQ_DIV_4M);
+    spi_device_release(&dev_a);
+    TEST_ASSERT_TRUE(spi_device_acquire(&dev_a, portMAX_DELAY));
+    check_settings(&dev_a.settings);
+
+    /* Nobody else gets the bus while it is taken */
+    xTaskCreate(other_task, "other", 256, NULL, uxTaskPriorityGet(NULL) + 1, NULL);
+    vTaskDelay(2);
+    TEST_ASSERT_FALSE(other_got_bus);
+    spi_device_release(&dev_a);
+
+    xTaskCreate(other_task, "other", 256, NULL, uxTaskPriorityGet(NULL) + 1, NULL);
+    vTaskDelay(2);
+    TEST_ASSERT_TRUE(other_got_bus);
+    check_settings(&dev_b.settings);
+
+    /* Bus 0 is never set up here */
+    spi_device_t flash = dev_a;
+    flash.bus = 0;
+    TEST_ASSERT_FALSE(spi_device_acquire(&flash, 0));
+    TEST_PASS();
+}
@@ -0,0 +1,35 @@
+/* Checks for the host unit tests (core/tests, lwip/tests, extras/<name>/tests)
+ *
+ * CHECK() reports a failed condition and carries on, so one run shows
+ * every failure. main() ends with 'return check_done("<name>");'.
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#ifndef _HOST_CHECK_H
+#define _HOST_CHECK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: %s: CHECK(%s) failed\n", __FILE__, __LINE__, __func__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+/* Print the result, and return main()'s exit status */
+static inline int check_done(const char *name)
+{
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All %s tests passed\n", name);
+    return EXIT_SUCCESS;
+}
+
+#endif /* _HOST_CHECK_H */
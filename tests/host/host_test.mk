@@ -0,0 +1,34 @@
+# Rules shared by the host unit test Makefiles (core/tests, lwip/tests, extras/<name>/tests)
+#
+# In extras/foo/tests, set TESTS to the test programs, each built from
+# <test>.c (or .cpp), then include this file and list any other sources
+# and headers a test uses as its prerequisites:
+#
+#   TESTS = foo_test
+#   include ../../../tests/host/host_test.mk
+#   foo_test: ../foo.c ../foo.h
+#
+# 'make test' builds and runs them all, tests/host runs every directory.
+
+HOST_TEST_DIR := $(dir $(lastword $(MAKEFILE_LIST)))
+
+CC ?= gcc
+CXX ?= g++
+CFLAGS += -std=gnu99 -O2 -g -Wall -Wextra -I.. -I$(HOST_TEST_DIR)
+CXXFLAGS += -std=gnu++11 -O2 -g -Wall -Wextra -I.. -I$(HOST_TEST_DIR)
+
+all: $(TESTS)
+
+%: %.c $(HOST_TEST_DIR)check.h
+	$(CC) $(CFLAGS) -o $@ $(filter %.c,$^) $(LDLIBS)
+
+%: %.cpp $(HOST_TEST_DIR)check.h
+	$(CXX) $(CXXFLAGS) -o $@ $(filter %.cpp,$^) $(LDLIBS)
+
+test: $(TESTS)
+	@set -e; for t in $(TESTS); do echo ./$$t; ./$$t; done
+
+clean:
+	rm -f $(TESTS)
+
+.PHONY: all test clean
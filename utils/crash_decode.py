@@ -0,0 +1,192 @@
+#!/usr/bin/env python
+#
+# Decode crash records from core/crash_record.c.
+#
+# Input files (or stdin) are any mix of:
+#   - console logs containing "CR:" lines from crash_record_print()
+#   - binary records, e.g. MQTT payloads or a dump of the flash sector
+#
+# Prints each record with its registers and the code addresses found on
+# the stack, resolved with addr2line if --elf is given. Each record gets a
+# signature made from the crash reason and the functions involved, which
+# stays the same across rebuilds, and --summary counts records by
+# signature to find the most common crashes across many devices.
+#
+from __future__ import print_function
+import argparse
+import collections
+import hashlib
+import json
+import re
+import struct
+import subprocess
+import sys
+
+MAGICS = (0x31445243, 0x4e445243)       # "CRD1", "CRDN"
+STACK_WORDS = 24
+FORMAT = "<10I16I4I16s%dI" % STACK_WORDS
+SIZE = struct.calcsize(FORMAT)
+
+REASONS = {1: "exception", 2: "abort"}
+
+EXCCAUSE = {
+    0: "IllegalInstruction", 2: "InstructionFetchError", 3: "LoadStoreError",
+    4: "Level1Interrupt", 6: "IntegerDivideByZero", 9: "LoadStoreAlignment",
+    12: "InstrPIFDataError", 13: "LoadStorePIFDataError", 14: "InstrPIFAddrError",
+    15: "LoadStorePIFAddrError", 20: "InstFetchProhibited", 28: "LoadProhibited",
+    29: "StoreProhibited",
+}
+
+RE_LINE = re.compile(r"CR:([0-9a-fA-F]{%d})" % (SIZE * 2))
+
+Record = collections.namedtuple("Record", "seq reason exccause epc1 epc2 epc3 excvaddr depc "
+                                          "a sar uptime_ms free_heap heap_used task stack")
+
+
+def is_code(addr):
+    return 0x40100000 <= addr < 0x40108000 or 0x40200000 <= addr < 0x40300000
+
+
+def decode(data, off=0):
+    if len(data) - off < SIZE:
+        return None
+    v = struct.unpack_from(FORMAT, data, off)
+    words = struct.unpack_from("<%dI" % (SIZE // 4), data, off)
+    if v[0] not in MAGICS or v[1] != ~sum(words[2:]) & 0xffffffff:
+        return None
+    return Record(seq=v[2], reason=v[3], exccause=v[4], epc1=v[5], epc2=v[6], epc3=v[7],
+                  excvaddr=v[8], depc=v[9], a=list(v[10:26]), sar=v[26], uptime_ms=v[27],
+                  free_heap=v[28], heap_used=v[29],
+                  task=v[30].split(b"\0")[0].decode("ascii", "replace"), stack=list(v[31:]))
+
+
+def read_records(data):
+    text = data.decode("latin-1")
+    lines = RE_LINE.findall(text)
+    if lines:
+        for h in lines:
+            r = decode(bytearray.fromhex(h))
+            if r:
+                yield r
+        return
+    # Binary: records are word aligned, wherever they are
+    off = 0
+    while off + SIZE <= len(data):
+        r = decode(data, off)
+        if r:
+            yield r
+            off += SIZE
+        else:
+            off += 4
+
+
+class Symbols(object):
+    def __init__(self, elf, addr2line):
+        self.elf = elf
+        self.addr2line = addr2line
+        self.cache = {}
+
+    def lookup(self, addrs):
+        addrs = [a for a in set(addrs) if a not in self.cache]
+        if not self.elf or not addrs:
+            return
+        args = [self.addr2line, "-f", "-p", "-e", self.elf] + ["0x%08x" % a for a in addrs]
+        out = subprocess.check_output(args).decode().splitlines()
+        for addr, line in zip(addrs, out):
+            self.cache[addr] = line.strip()
+
+    def name(self, addr):
+        sym = self.cache.get(addr)
+        return "0x%08x %s" % (addr, sym) if sym else "0x%08x" % addr
+
+    def function(self, addr):
+        sym = self.cache.get(addr)
+        if not sym or sym.startswith("??"):
+            return "0x%08x" % addr
+        return sym.split(" at ")[0]
+
+
+def code_addrs(r):
+    """The crash address, return address and code addresses on the stack"""
+    addrs = [r.epc1] if is_code(r.epc1) else []
+    if is_code(r.a[0]) and r.a[0] not in addrs:
+        addrs.append(r.a[0])
+    addrs += [w for w in r.stack if is_code(w) and w not in addrs]
+    return addrs
+
+
+def signature(r, syms, depth):
+    funcs = [syms.function(a) for a in code_addrs(r)[:depth]]
+    what = "%s:%d" % (REASONS.get(r.reason, r.reason), r.exccause if r.reason == 1 else 0)
+    key = " ".join([what] + funcs)
+    return hashlib.sha1(key.encode()).hexdigest()[:12], key
+
+
+def print_record(r, syms, sig):
+    if r.reason == 1:
+        print("Crash %d: exception %d (%s) at %s" %
+              (r.seq, r.exccause, EXCCAUSE.get(r.exccause, "?"), syms.name(r.epc1)))
+        print("  excvaddr 0x%08x  epc2 0x%08x  epc3 0x%08x  depc 0x%08x" %
+              (r.excvaddr, r.epc2, r.epc3, r.depc))
+    else:
+        print("Crash %d: abort() at %s" % (r.seq, syms.name(r.epc1)))
+    print("  task '%s', up %.3f s, free heap %s, heap used %d" %
+          (r.task, r.uptime_ms / 1000.0,
+           "?" if r.free_heap == 0xffffffff else r.free_heap, r.heap_used))
+    print("  signature %s  (%s)" % sig)
+    for i in range(0, 16, 4):
+        print("  " + "  ".join("a%-2d %08x" % (j, r.a[j]) for j in range(i, i + 4)))
+    print("  sar %08x" % r.sar)
+    print("  a0 %s" % syms.name(r.a[0]))
+    for i, w in enumerate(r.stack):
+        if is_code(w):
+            print("  sp+%-3d %s" % (i * 4, syms.name(w)))
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode crash records from core/crash_record.c")
+    parser.add_argument("files", nargs="*", help="Console logs or binary records (default stdin)")
+    parser.add_argument("--elf", help="Program ELF file to resolve addresses")
+    parser.add_argument("--addr2line", default="xtensa-lx106-elf-addr2line")
+    parser.add_argument("--depth", type=int, default=4,
+                        help="Number of code addresses in the signature")
+    parser.add_argument("--summary", action="store_true", help="Only count records by signature")
+    parser.add_argument("--json", action="store_true", help="Print one JSON object per record")
+    args = parser.parse_args()
+
+    records = []
+    if args.files:
+        for name in args.files:
+            with open(name, "rb") as f:
+                records += list(read_records(f.read()))
+    else:
+        stdin = getattr(sys.stdin, "buffer", sys.stdin)
+        records = list(read_records(stdin.read()))
+    if not records:
+        sys.exit("No crash records found")
+
+    syms = Symbols(args.elf, args.addr2line)
+    syms.lookup([a for r in records for a in code_addrs(r)])
+
+    counts = collections.Counter()
+    keys = {}
+    for r in records:
+        sig = signature(r, syms, args.depth)
+        counts[sig[0]] += 1
+        keys[sig[0]] = sig[1]
+        if args.json:
+            d = r._asdict()
+            d["signature"], d["signature_key"] = sig
+            print(json.dumps(d))
+        elif not args.summary:
+            print_record(r, syms, sig)
+
+    if not args.json:
+        print("%6s  %-12s  %s" % ("count", "signature", "reason and functions"))
+        for sig, n in counts.most_common():
+            print("%6d  %-12s  %s" % (n, sig, keys[sig]))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,166 @@
+#!/usr/bin/env python
+#
+# Format records from extras/dlog on a host.
+#
+# Input is one of:
+#   - a console log with "DL:" lines (dlog_start() with DLOG_OUTPUT_HEX),
+#     read from a file or stdin
+#   - a binary file of dlog_read() words starting with "DLG1"
+#
+# The format strings (and any %s arguments pointing at string constants)
+# are read from the program's ELF file, which must be the one that
+# produced the records. Output matches DLOG_OUTPUT_TEXT on the device.
+# --stats counts records by format string instead.
+#
+from __future__ import print_function
+import argparse
+import collections
+import re
+import struct
+import sys
+
+ID_LOST = 0xffff
+LEVELS = "?EWID"
+
+RE_LINE = re.compile(r"DL:([0-9a-fA-F]+)")
+RE_CONV = re.compile(r"%([-+ #0]*)(\d+|\*)?(?:\.(\d+|\*))?(?:hh|h|ll|l|z|j|t)?([diouxXcsp%])")
+
+
+class Elf(object):
+    """Just enough of ELF32 to read symbols and constant data"""
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        if self.data[:4] != b"\x7fELF" or self.data[4:5] != b"\x01":
+            raise ValueError("%s is not a 32 bit ELF file" % path)
+        shoff, = struct.unpack_from("<I", self.data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", self.data, 0x2e)
+        self.sections = []
+        for i in range(shnum):
+            name, stype, flags, addr, offset, size, link = \
+                struct.unpack_from("<IIIIIII", self.data, shoff + i * shentsize)
+            self.sections.append((name, stype, flags, addr, offset, size, link))
+        self.symbols = {}
+        for name, stype, flags, addr, offset, size, link in self.sections:
+            if stype != 2:          # SHT_SYMTAB
+                continue
+            stroff = self.sections[link][4]
+            for off in range(offset, offset + size, 16):
+                st_name, st_value = struct.unpack_from("<II", self.data, off)
+                end = self.data.index(b"\0", stroff + st_name)
+                self.symbols[self.data[stroff + st_name:end].decode("ascii", "replace")] = st_value
+
+    def read(self, addr, length):
+        for name, stype, flags, saddr, offset, size, link in self.sections:
+            if stype == 1 and (flags & 2) and saddr <= addr < saddr + size:    # PROGBITS, ALLOC
+                n = min(length, saddr + size - addr)
+                return self.data[offset + addr - saddr:offset + addr - saddr + n]
+        return None
+
+    def string(self, addr, limit=256):
+        data = self.read(addr, limit)
+        if data is None:
+            return None
+        return data.split(b"\0")[0].decode("latin-1")
+
+
+def read_records(data):
+    if data[:4] == b"DLG1":
+        words = struct.unpack_from("<%dI" % ((len(data) - 4) // 4), data, 4)
+        i = 0
+        while i < len(words):
+            n = 2 + (words[i] & 0xf)
+            if i + n > len(words):
+                break
+            yield words[i:i + n]
+            i += n
+        return
+    for m in RE_LINE.finditer(data.decode("latin-1")):
+        raw = bytearray.fromhex(m.group(1))
+        words = struct.unpack("<%dI" % (len(raw) // 4), raw[:len(raw) // 4 * 4])
+        if len(words) >= 2 and len(words) == 2 + (words[0] & 0xf):
+            yield words
+
+
+def signed(w):
+    return w - (1 << 32) if w & 0x80000000 else w
+
+
+def c_format(fmt, args, elf):
+    """printf() with 32 bit arguments"""
+    args = list(args)
+
+    def arg():
+        return args.pop(0) if args else 0
+
+    def conv(m):
+        flags, width, prec, c = m.groups()
+        if c == "%":
+            return "%"
+        if width == "*":
+            width = str(signed(arg()))
+        if prec == "*":
+            prec = str(signed(arg()))
+        spec = "%" + flags + (width or "") + ("." + prec if prec else "")
+        v = arg()
+        if c in "di":
+            return (spec + "d") % signed(v)
+        if c in "ouxX":
+            return (spec + c) % v
+        if c == "c":
+            return (spec + "c") % chr(v & 0xff)
+        if c == "p":
+            return (spec + "s") % ("0x%08x" % v)
+        s = elf.string(v)
+        return (spec + "s") % (s if s is not None else "<0x%08x>" % v)
+
+    return RE_CONV.sub(conv, fmt)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Format extras/dlog records")
+    parser.add_argument("file", nargs="?", help="Console log or binary capture (default stdin)")
+    parser.add_argument("--elf", required=True, help="Program ELF file with the format strings")
+    parser.add_argument("--stats", action="store_true", help="Count records by format string")
+    args = parser.parse_args()
+
+    elf = Elf(args.elf)
+    base = elf.symbols.get("_dlog_fmt_start")
+    if base is None:
+        sys.exit("%s has no _dlog_fmt_start, is extras/dlog linked in?" % args.elf)
+
+    if args.file:
+        with open(args.file, "rb") as f:
+            data = f.read()
+    else:
+        data = getattr(sys.stdin, "buffer", sys.stdin).read()
+
+    counts = collections.Counter()
+    lost = 0
+    for rec in read_records(data):
+        fid = rec[0] >> 16
+        level = (rec[0] >> 4) & 7
+        if fid == ID_LOST:
+            lost += rec[2]
+            text = "(%u log records lost)" % rec[2]
+        else:
+            fmt = elf.string(base + fid * 4)
+            if fmt is None:
+                fmt = "<unknown format %d>" % fid
+            if args.stats:
+                counts[fmt] += 1
+                continue
+            text = c_format(fmt, rec[2:], elf)
+        if not args.stats:
+            print("%u.%06u %s %s" % (rec[1] // 1000000, rec[1] % 1000000,
+                                     LEVELS[level] if level < len(LEVELS) else "?", text))
+    if args.stats:
+        print("%8s  %s" % ("records", "format"))
+        for fmt, n in counts.most_common():
+            print("%8d  %s" % (n, fmt))
+        if lost:
+            print("%8d  (lost)" % lost)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,267 @@
+#!/usr/bin/env python
+#
+# Analyse a capture from the extras/heap_trace component.
+#
+# Input is one of:
+#   - a console log containing "HT:" lines (heap_trace_stream_uart() or
+#     the crash dump), read from a file or stdin
+#   - a binary capture starting with "HTR1" (heap_trace_stream_tcp())
+#   - a live TCP connection with --tcp host:port, until Ctrl-C
+#
+# Prints allocation counts, peak usage, the call sites and tasks holding
+# the most memory at the peak and at the end of the capture, and a map of
+# the traced blocks across the heap at the peak. With --elf, call sites are
+# resolved to functions with addr2line. --replay writes the allocation
+# sequence in the format read by utils/slab_replay.
+#
+from __future__ import print_function
+import argparse
+import collections
+import re
+import socket
+import struct
+import subprocess
+import sys
+
+OP_ALLOC, OP_FREE, OP_FAIL, OP_TASK, OP_LOST = range(5)
+
+RE_LINE = re.compile(r"HT:([0-9a-fA-F]{32})")
+
+Record = collections.namedtuple("Record", "ptr caller time size op task")
+
+
+def decode(ptr, caller, time, info):
+    return Record(ptr, caller, time, info & 0xfffff, (info >> 20) & 0x7, info >> 23)
+
+
+def read_text(f):
+    for line in f:
+        m = RE_LINE.search(line)
+        if m:
+            h = m.group(1)
+            yield decode(*[int(h[i:i + 8], 16) for i in range(0, 32, 8)])
+
+
+def read_binary(data):
+    for off in range(4, len(data) - 15, 16):
+        yield decode(*struct.unpack_from("<IIII", data, off))
+
+
+def read_tcp(target, save):
+    host, port = target.rsplit(":", 1)
+    s = socket.create_connection((host, int(port)))
+    data = b""
+    print("Capturing from %s, Ctrl-C to stop" % target, file=sys.stderr)
+    try:
+        while True:
+            chunk = s.recv(4096)
+            if not chunk:
+                break
+            data += chunk
+    except KeyboardInterrupt:
+        pass
+    s.close()
+    if save:
+        with open(save, "wb") as f:
+            f.write(data)
+    if data[:4] != b"HTR1":
+        sys.exit("Not a heap_trace stream")
+    return read_binary(data)
+
+
+def task_name(rec):
+    raw = struct.pack("<III", rec.ptr, rec.caller, rec.time)
+    return raw.split(b"\0")[0].decode("ascii", "replace")
+
+
+class Symbols(object):
+    def __init__(self, elf, addr2line):
+        self.elf = elf
+        self.addr2line = addr2line
+        self.cache = {}
+
+    def lookup(self, addrs):
+        addrs = [a for a in set(addrs) if a not in self.cache]
+        if not self.elf or not addrs:
+            return
+        args = [self.addr2line, "-f", "-p", "-e", self.elf] + ["0x%08x" % a for a in addrs]
+        out = subprocess.check_output(args).decode().splitlines()
+        for addr, line in zip(addrs, out):
+            self.cache[addr] = line.strip()
+
+    def name(self, addr):
+        sym = self.cache.get(addr)
+        return "0x%08x %s" % (addr, sym) if sym else "0x%08x" % addr
+
+
+class Analysis(object):
+    def __init__(self):
+        self.live = {}              # ptr -> (size, caller, task)
+        self.live_bytes = 0
+        self.peak_bytes = 0
+        self.peak_time = 0
+        self.peak_live = {}
+        self.tasks = {0: "(isr/startup)"}
+        self.counts = collections.Counter()
+        self.task_allocs = collections.Counter()
+        self.task_bytes = collections.Counter()
+        self.fails = []
+        self.lost = 0
+        self.unknown_frees = 0
+        self.replay = []
+        self.ids = {}
+        self.next_id = 0
+
+    def add(self, r):
+        self.counts[r.op] += 1
+        if r.op == OP_TASK:
+            self.tasks[r.task] = task_name(r)
+        elif r.op == OP_LOST:
+            self.lost += r.size
+        elif r.op == OP_FAIL:
+            self.fails.append(r)
+        elif r.op == OP_ALLOC:
+            old = self.live.pop(r.ptr, None)
+            if old:
+                # Missed the free (lost records), don't count it twice
+                self.live_bytes -= old[0]
+            self.live[r.ptr] = (r.size, r.caller, r.task)
+            self.live_bytes += r.size
+            self.task_allocs[r.task] += 1
+            self.task_bytes[r.task] += r.size
+            self.ids[r.ptr] = self.next_id
+            self.replay.append("a %d %d" % (self.next_id, r.size))
+            self.next_id += 1
+            if self.live_bytes > self.peak_bytes:
+                self.peak_bytes = self.live_bytes
+                self.peak_time = r.time
+                self.peak_live = dict(self.live)
+        elif r.op == OP_FREE:
+            old = self.live.pop(r.ptr, None)
+            if old is None:
+                self.unknown_frees += 1
+                return
+            self.live_bytes -= old[0]
+            self.replay.append("f %d" % self.ids.pop(r.ptr))
+
+    def task(self, tid):
+        return self.tasks.get(tid, "task %d" % tid)
+
+
+def by_caller(live):
+    sites = collections.defaultdict(lambda: [0, 0])
+    for size, caller, _ in live.values():
+        sites[caller][0] += size
+        sites[caller][1] += 1
+    return sorted(sites.items(), key=lambda kv: -kv[1][0])
+
+
+def print_sites(title, live, syms, top):
+    print("\n%s:" % title)
+    print("%8s %6s  %s" % ("bytes", "blocks", "caller"))
+    for caller, (size, count) in by_caller(live)[:top]:
+        print("%8d %6d  %s" % (size, count, syms.name(caller)))
+
+
+def print_map(live, start, end, width=64, rows=16):
+    """One character per (end - start) / (width * rows) bytes: '#' all
+    allocated, '+' partly allocated, '.' free as far as the trace knows."""
+    step = max(1, (end - start) // (width * rows))
+    used = collections.Counter()
+    for ptr, (size, _, _) in live.items():
+        a = max(ptr, start)
+        b = min(ptr + size, end)
+        while a < b:
+            cell = (a - start) // step
+            cell_end = start + (cell + 1) * step
+            used[cell] += min(b, cell_end) - a
+            a = cell_end
+    print("\nHeap map at peak, 0x%08x-0x%08x, %d bytes per character:" % (start, end, step))
+    ncells = (end - start + step - 1) // step
+    for row in range(0, ncells, width):
+        line = ""
+        for cell in range(row, min(row + width, ncells)):
+            u = used[cell]
+            line += "#" if u >= step else ("+" if u else ".")
+        print("0x%08x %s" % (start + row * step, line))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Analyse a heap_trace capture")
+    parser.add_argument("file", nargs="?", help="Console log or binary capture (default stdin)")
+    parser.add_argument("--tcp", metavar="HOST:PORT", help="Capture from heap_trace_stream_tcp()")
+    parser.add_argument("--save", metavar="FILE", help="With --tcp, also save the raw capture")
+    parser.add_argument("--elf", help="Program ELF file to resolve call sites")
+    parser.add_argument("--addr2line", default="xtensa-lx106-elf-addr2line")
+    parser.add_argument("--top", type=int, default=15, help="Number of call sites to list")
+    parser.add_argument("--heap", metavar="START:END",
+                        help="Heap address range for the map (default: span of traced blocks)")
+    parser.add_argument("--replay", metavar="FILE", help="Write a utils/slab_replay trace")
+    args = parser.parse_args()
+
+    if args.tcp:
+        records = read_tcp(args.tcp, args.save)
+    elif args.file:
+        with open(args.file, "rb") as f:
+            data = f.read()
+        if data[:4] == b"HTR1":
+            records = read_binary(data)
+        else:
+            records = read_text(data.decode("latin-1").splitlines())
+    else:
+        records = read_text(sys.stdin)
+
+    a = Analysis()
+    first = last = None
+    for r in records:
+        if r.op != OP_TASK:
+            first = r.time if first is None else first
+            last = r.time
+        a.add(r)
+    if first is None:
+        sys.exit("No heap_trace records found")
+
+    syms = Symbols(args.elf, args.addr2line)
+    syms.lookup([v[1] for v in a.peak_live.values()] + [v[1] for v in a.live.values()]
+                + [r.caller for r in a.fails])
+
+    print("%d allocs, %d frees, %d failures over %.3f s" %
+          (a.counts[OP_ALLOC], a.counts[OP_FREE], a.counts[OP_FAIL], ((last - first) & 0xffffffff) / 1e6))
+    if a.lost:
+        print("WARNING: %d records were lost, totals are approximate" % a.lost)
+    if a.unknown_frees:
+        print("%d frees of blocks allocated before the capture started" % a.unknown_frees)
+    print("Peak %d bytes in %d blocks at %.3f s, %d bytes in %d blocks at end" %
+          (a.peak_bytes, len(a.peak_live), ((a.peak_time - first) & 0xffffffff) / 1e6,
+           a.live_bytes, len(a.live)))
+
+    print_sites("Live at peak, by call site", a.peak_live, syms, args.top)
+    print_sites("Live at end, by call site", a.live, syms, args.top)
+
+    print("\n%-16s %8s %10s %10s" % ("task", "allocs", "bytes", "live"))
+    live_by_task = collections.Counter()
+    for size, _, task in a.live.values():
+        live_by_task[task] += size
+    for tid in sorted(a.task_allocs, key=lambda t: -a.task_bytes[t]):
+        print("%-16s %8d %10d %10d" % (a.task(tid), a.task_allocs[tid], a.task_bytes[tid], live_by_task[tid]))
+
+    if a.fails:
+        print("\nFailed allocations:")
+        for r in a.fails:
+            print("  %6d bytes  %-16s %s" % (r.size, a.task(r.task), syms.name(r.caller)))
+
+    if a.peak_live:
+        if args.heap:
+            start, end = [int(x, 0) for x in args.heap.split(":")]
+        else:
+            start = min(a.peak_live)
+            end = max(p + s for p, (s, _, _) in a.peak_live.items())
+        print_map(a.peak_live, start, end)
+
+    if args.replay:
+        with open(args.replay, "w") as f:
+            f.write("\n".join(a.replay) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+#
+# Minimal HTTP/1.1 file server for testing extras/rboot-ota/ota-http.c on a
+# Linux host.
+#
+# Unlike "python3 -m http.server" it understands "Range: bytes=N-" and
+# "If-Range", sends a strong ETag, and can deliberately drop connections
+# part way through a transfer to exercise download resume.
+#
+import argparse
+import hashlib
+import os
+import re
+import socketserver
+import http.server
+
+RE_RANGE = re.compile(r"bytes=(\d+)-(\d*)$")
+
+
+class OTAHandler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def do_GET(self):
+        path = os.path.join(self.server.root, self.path.lstrip("/"))
+        if not os.path.isfile(path):
+            self.send_error(404)
+            return
+        with open(path, "rb") as f:
+            data = f.read()
+        etag = '"%s"' % hashlib.sha1(data).hexdigest()[:16]
+
+        start = 0
+        end = len(data) - 1
+        status = 200
+        range_hdr = self.headers.get("Range")
+        if_range = self.headers.get("If-Range")
+        if range_hdr and (if_range is None or if_range == etag):
+            m = RE_RANGE.match(range_hdr.strip())
+            if not m or int(m.group(1)) >= len(data):
+                self.send_response(416)
+                self.send_header("Content-Range", "bytes */%d" % len(data))
+                self.send_header("Content-Length", "0")
+                self.end_headers()
+                return
+            start = int(m.group(1))
+            if m.group(2):
+                end = min(end, int(m.group(2)))
+            status = 206
+
+        body = data[start:end + 1]
+        self.send_response(status)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(len(body)))
+        self.send_header("ETag", etag)
+        if status == 206:
+            self.send_header("Content-Range", "bytes %d-%d/%d" % (start, end, len(data)))
+        self.send_header("Connection", "close")
+        self.end_headers()
+
+        drop = self.server.drop_every
+        if drop and len(body) > drop:
+            print("Dropping connection after %d of %d bytes" % (drop, len(body)))
+            self.wfile.write(body[:drop])
+            self.close_connection = True
+            return
+        self.wfile.write(body)
+
+
+class Server(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Range-capable HTTP server for OTA testing")
+    parser.add_argument("-d", "--directory", default=".", help="Directory to serve")
+    parser.add_argument("-p", "--port", type=int, default=8080, help="TCP port to listen on")
+    parser.add_argument("--drop-every", type=int, default=0, metavar="BYTES",
+                        help="Close each response after this many body bytes (0 = never)")
+    args = parser.parse_args()
+
+    server = Server(("", args.port), OTAHandler)
+    server.root = os.path.abspath(args.directory)
+    server.drop_every = args.drop_every
+    print("Serving %s on port %d" % (server.root, args.port))
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
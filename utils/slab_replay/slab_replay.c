@@ -0,0 +1,440 @@
+/* Replay a heap allocation trace against a model of the ESP8266 heap, with
+ * and without the core/slab.c small object allocator in front of it.
+ *
+ * The heap model is a first fit allocator like newlib's nano malloc: an
+ * address ordered free list with coalescing, a 4 byte size header per
+ * chunk, 8 byte alignment and a fixed size limit. Running the same trace
+ * both ways shows allocation failures, heap high water mark and free
+ * space fragmentation for each.
+ *
+ * Trace format, one operation per line ('#' starts a comment):
+ *
+ *   a <id> <size>            allocation of <size> bytes returned <id>
+ *   f <id>                   free of <id>
+ *   r <old id> <new id> <size>  realloc
+ *
+ * Ids are arbitrary tokens (usually the pointers from a recorded trace)
+ * and only need to be unique among live allocations.
+ *
+ * Usage: slab_replay [-h heap_bytes] [-n repeat] trace.txt
+ *        slab_replay [-h heap_bytes] -s operations   (synthetic trace)
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ---- First fit heap model ---- */
+
+/* Packed so the header is 4 bytes as on the ESP8266 */
+typedef struct __attribute__((packed)) ff_chunk {
+    uint32_t size;           /* Whole chunk including header */
+    struct ff_chunk *next;   /* Only valid while free */
+} ff_chunk_t;
+
+#define FF_HDR sizeof(uint32_t)
+#define FF_ALIGN 8
+#define FF_MIN_CHUNK 16
+
+static uint8_t *ff_base;
+static size_t ff_limit;
+static size_t ff_top;        /* Bytes taken from the "sbrk" area */
+static size_t ff_top_peak;
+static ff_chunk_t *ff_free_list;
+static unsigned ff_failures;
+
+static void ff_init(size_t limit)
+{
+    free(ff_base);
+    ff_base = aligned_alloc(FF_ALIGN, limit);
+    ff_limit = limit;
+    ff_top = ff_top_peak = 0;
+    ff_free_list = NULL;
+    ff_failures = 0;
+}
+
+static void *ff_malloc(size_t size)
+{
+    size_t need = (size + FF_HDR + FF_ALIGN - 1) & ~(size_t)(FF_ALIGN - 1);
+    if(need < FF_MIN_CHUNK) {
+        need = FF_MIN_CHUNK;
+    }
+
+    ff_chunk_t *prev = NULL;
+    for(ff_chunk_t *c = ff_free_list; c != NULL; prev = c, c = c->next) {
+        if(c->size < need) {
+            continue;
+        }
+        ff_chunk_t *next = c->next;
+        if(c->size - need >= FF_MIN_CHUNK) {
+            /* Split, keeping the tail on the free list */
+            next = (ff_chunk_t *)((uint8_t *)c + need);
+            next->size = c->size - need;
+            next->next = c->next;
+            c->size = need;
+        }
+        if(prev != NULL) {
+            prev->next = next;
+        } else {
+            ff_free_list = next;
+        }
+        return (uint8_t *)c + FF_HDR;
+    }
+
+    if(ff_top + need > ff_limit) {
+        ff_failures++;
+        return NULL;
+    }
+    ff_chunk_t *c = (ff_chunk_t *)(ff_base + ff_top);
+    c->size = need;
+    ff_top += need;
+    if(ff_top > ff_top_peak) {
+        ff_top_peak = ff_top;
+    }
+    return (uint8_t *)c + FF_HDR;
+}
+
+static void ff_free(void *ptr)
+{
+    if(ptr == NULL) {
+        return;
+    }
+    ff_chunk_t *c = (ff_chunk_t *)((uint8_t *)ptr - FF_HDR);
+
+    ff_chunk_t *prev = NULL, *next = ff_free_list;
+    while(next != NULL && next < c) {
+        prev = next;
+        next = next->next;
+    }
+    if(next != NULL && (uint8_t *)c + c->size == (uint8_t *)next) {
+        c->size += next->size;
+        next = next->next;
+    }
+    c->next = next;
+    if(prev != NULL && (uint8_t *)prev + prev->size == (uint8_t *)c) {
+        prev->size += c->size;
+        prev->next = next;
+        c = prev;
+    } else if(prev != NULL) {
+        prev->next = c;
+    } else {
+        ff_free_list = c;
+    }
+}
+
+static void *ff_realloc(void *ptr, size_t size)
+{
+    if(ptr == NULL) {
+        return ff_malloc(size);
+    }
+    ff_chunk_t *c = (ff_chunk_t *)((uint8_t *)ptr - FF_HDR);
+    size_t old = c->size - FF_HDR;
+    if(size <= old) {
+        return ptr;
+    }
+    void *n = ff_malloc(size);
+    if(n != NULL) {
+        memcpy(n, ptr, old);
+        ff_free(ptr);
+    }
+    return n;
+}
+
+/* ---- Slab allocator, built on the heap model ---- */
+
+#define SLAB_HOST
+#define SLAB_LOCK()
+#define SLAB_UNLOCK()
+#define SLAB_BACKEND_MALLOC ff_malloc
+#define SLAB_BACKEND_FREE ff_free
+#define SLAB_BACKEND_REALLOC ff_realloc
+#include "../../core/slab.c"
+
+/* ---- Trace handling ---- */
+
+typedef enum { OP_ALLOC, OP_FREE, OP_REALLOC } op_type_t;
+
+typedef struct {
+    op_type_t type;
+    uint32_t id;         /* Index into the live pointer table */
+    uint32_t new_id;
+    uint32_t size;
+} op_t;
+
+static op_t *ops;
+static size_t n_ops, ops_cap;
+static uint32_t n_ids;
+
+static void add_op(op_type_t type, uint32_t id, uint32_t new_id, uint32_t size)
+{
+    if(n_ops == ops_cap) {
+        ops_cap = ops_cap ? ops_cap * 2 : 4096;
+        ops = realloc(ops, ops_cap * sizeof(op_t));
+    }
+    ops[n_ops++] = (op_t) { type, id, new_id, size };
+}
+
+/* Map trace ids to dense indexes. Each allocation gets a new index, ids
+   are looked up in an open addressing table. Entries are never removed
+   (a freed id is just marked dead), so probe chains stay intact. */
+typedef struct {
+    char name[24];
+    uint32_t index;
+    bool used;
+    bool live;
+} id_entry_t;
+
+static id_entry_t *id_table;
+static size_t id_table_size = 1 << 18;
+
+static id_entry_t *id_lookup(const char *name)
+{
+    uint32_t h = 2166136261u;
+    for(const char *p = name; *p; p++) {
+        h = (h ^ (uint8_t)*p) * 16777619u;
+    }
+    for(size_t i = h & (id_table_size - 1);; i = (i + 1) & (id_table_size - 1)) {
+        if(!id_table[i].used || strcmp(id_table[i].name, name) == 0) {
+            return &id_table[i];
+        }
+    }
+}
+
+static uint32_t id_new(const char *name)
+{
+    id_entry_t *e = id_lookup(name);
+    e->used = true;
+    e->live = true;
+    strncpy(e->name, name, sizeof(e->name) - 1);
+    e->index = n_ids++;
+    return e->index;
+}
+
+/* Look up and kill a live id */
+static bool id_release(const char *name, uint32_t *index)
+{
+    id_entry_t *e = id_lookup(name);
+    if(!e->live) {
+        return false;
+    }
+    e->live = false;
+    *index = e->index;
+    return true;
+}
+
+static void load_trace(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if(f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    id_table = calloc(id_table_size, sizeof(id_entry_t));
+    char line[128], a[24], b[24];
+    unsigned size;
+    unsigned lineno = 0, skipped = 0;
+    while(fgets(line, sizeof(line), f)) {
+        uint32_t id;
+        lineno++;
+        if(line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if(sscanf(line, "a %23s %u", a, &size) == 2) {
+            add_op(OP_ALLOC, id_new(a), 0, size);
+        } else if(sscanf(line, "f %23s", a) == 1) {
+            if(id_release(a, &id)) {
+                add_op(OP_FREE, id, 0, 0);
+            } else {
+                skipped++; /* allocated before the trace started */
+            }
+        } else if(sscanf(line, "r %23s %23s %u", a, b, &size) == 3) {
+            if(id_release(a, &id)) {
+                add_op(OP_REALLOC, id, id_new(b), size);
+            } else {
+                add_op(OP_ALLOC, id_new(b), 0, size);
+                skipped++;
+            }
+        } else {
+            fprintf(stderr, "%s:%u: can't parse '%s'\n", path, lineno, line);
+        }
+    }
+    fclose(f);
+    free(id_table);
+    if(skipped) {
+        fprintf(stderr, "%u operations on blocks allocated before the trace started\n", skipped);
+    }
+}
+
+/* Network-stack-like workload: bursts of short lived allocations (pbuf
+   headers, netbufs, MTU sized frames) freed in roughly LIFO order, mixed
+   with a slowly churning population of long lived small objects (pcbs,
+   timers, queue items) that pin down holes in a first fit heap. */
+#define SYN_TRANSIENT 48
+#define SYN_PERSISTENT 64
+
+static uint32_t synthetic_size(bool persistent)
+{
+    int r = rand() % 100;
+    if(persistent) {
+        return (r < 60) ? 16 + rand() % 48 : 64 + rand() % 160;
+    }
+    if(r < 50) {
+        return 16 + rand() % 24;
+    } else if(r < 75) {
+        return 40 + rand() % 120;
+    } else if(r < 88) {
+        return 160 + rand() % 96;
+    }
+    return 300 + rand() % 1300;
+}
+
+static void synthetic_trace(unsigned count)
+{
+    uint32_t transient[SYN_TRANSIENT], persistent[SYN_PERSISTENT];
+    unsigned n_transient = 0, n_persistent = 0;
+    srand(1);
+    while(n_ops < count) {
+        if(n_persistent < SYN_PERSISTENT || rand() % 50 == 0) {
+            if(n_persistent == SYN_PERSISTENT) {
+                unsigned j = rand() % n_persistent;
+                add_op(OP_FREE, persistent[j], 0, 0);
+                persistent[j] = persistent[--n_persistent];
+            }
+            persistent[n_persistent++] = n_ids;
+            add_op(OP_ALLOC, n_ids++, 0, synthetic_size(true));
+        }
+        if(n_transient == SYN_TRANSIENT ||
+           (n_transient > 0 && (unsigned)rand() % SYN_TRANSIENT < n_transient)) {
+            /* Free one of the most recent few */
+            unsigned back = rand() % (n_transient < 4 ? n_transient : 4);
+            unsigned j = n_transient - 1 - back;
+            add_op(OP_FREE, transient[j], 0, 0);
+            memmove(&transient[j], &transient[j + 1], back * sizeof(uint32_t));
+            n_transient--;
+        } else {
+            transient[n_transient++] = n_ids;
+            add_op(OP_ALLOC, n_ids++, 0, synthetic_size(false));
+        }
+    }
+}
+
+typedef void *(*malloc_fn)(size_t);
+typedef void (*free_fn)(void *);
+typedef void *(*realloc_fn)(void *, size_t);
+
+static void free_chunk_stats(unsigned *chunks, size_t *total, size_t *largest)
+{
+    *chunks = 0;
+    *total = ff_limit - ff_top;
+    *largest = *total;
+    for(ff_chunk_t *c = ff_free_list; c != NULL; c = c->next) {
+        (*chunks)++;
+        *total += c->size;
+        if(c->size > *largest) {
+            *largest = c->size;
+        }
+    }
+}
+
+static void replay(const char *name, malloc_fn m, free_fn f, realloc_fn r, unsigned repeat)
+{
+    void **ptrs = calloc(n_ids, sizeof(void *));
+    double worst_frag = 0;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(unsigned rep = 0; rep < repeat; rep++) {
+        for(size_t i = 0; i < n_ops; i++) {
+            op_t *op = &ops[i];
+            switch(op->type) {
+            case OP_ALLOC:
+                ptrs[op->id] = m(op->size);
+                break;
+            case OP_FREE:
+                f(ptrs[op->id]);
+                ptrs[op->id] = NULL;
+                break;
+            case OP_REALLOC:
+                if(ptrs[op->id] == NULL) {
+                    ptrs[op->new_id] = m(op->size);
+                } else {
+                    ptrs[op->new_id] = r(ptrs[op->id], op->size);
+                    if(ptrs[op->new_id] == NULL) {
+                        f(ptrs[op->id]);
+                    }
+                }
+                if(op->new_id != op->id) {
+                    ptrs[op->id] = NULL;
+                }
+                break;
+            }
+            if(rep == 0 && (i & 63) == 0) {
+                unsigned chunks;
+                size_t total, largest;
+                free_chunk_stats(&chunks, &total, &largest);
+                double frag = total ? 1.0 - (double)largest / total : 0;
+                if(frag > worst_frag) {
+                    worst_frag = frag;
+                }
+            }
+        }
+        /* Release whatever the trace left allocated before repeating */
+        if(rep + 1 < repeat) {
+            for(uint32_t id = 0; id < n_ids; id++) {
+                f(ptrs[id]);
+                ptrs[id] = NULL;
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    unsigned chunks;
+    size_t total, largest;
+    free_chunk_stats(&chunks, &total, &largest);
+    printf("%-10s %8.1f ns/op  %6u failures  peak heap %6zu  free %6zu in %4u chunks, largest %6zu  frag end %4.1f%% worst %4.1f%%\n",
+           name, ns / (n_ops * repeat), ff_failures, ff_top_peak, total, chunks,
+           largest, total ? 100.0 * (1.0 - (double)largest / total) : 0.0, 100.0 * worst_frag);
+    free(ptrs);
+}
+
+int main(int argc, char **argv)
+{
+    size_t heap = 40 * 1024;
+    unsigned repeat = 1, synthetic = 0;
+    int opt;
+
+    while((opt = getopt(argc, argv, "h:n:s:")) != -1) {
+        switch(opt) {
+        case 'h': heap = strtoul(optarg, NULL, 0); break;
+        case 'n': repeat = strtoul(optarg, NULL, 0); break;
+        case 's': synthetic = strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "Usage: %s [-h heap_bytes] [-n repeat] (trace.txt | -s operations)\n", argv[0]);
+            return 1;
+        }
+    }
+    if(synthetic) {
+        synthetic_trace(synthetic);
+    } else if(optind < argc) {
+        load_trace(argv[optind]);
+    } else {
+        fprintf(stderr, "No trace given\n");
+        return 1;
+    }
+    printf("%zu operations, %u allocations, %zu byte heap\n", n_ops, n_ids, heap);
+
+    ff_init(heap);
+    replay("first-fit", ff_malloc, ff_free, ff_realloc, repeat);
+
+    ff_init(heap);
+    replay("slab", slab_malloc, slab_free, slab_realloc, repeat);
+    slab_print_stats();
+    return 0;
+}
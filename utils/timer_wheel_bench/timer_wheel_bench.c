@@ -0,0 +1,159 @@
+/* Benchmark for the core/timer_wheel.c timing wheel
+ *
+ * Times starting, restarting and stopping timers, and expiring them,
+ * with the wheel and with a sorted list like the one
+ * FreeRTOS/Source/timers.c uses. The model test checking the wheel's
+ * behaviour is core/tests/timer_wheel_test.c.
+ *
+ * Usage: timer_wheel_bench [-b timers] [-s seed]
+ *
+ * Part of esp-open-rtos
+ * BSD Licensed as described in the file LICENSE
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "timer_wheel.h"
+
+/* Sorted doubly linked list, inserting by walking from the head like
+   vListInsert() */
+typedef struct list_timer {
+    struct list_timer *next, *prev;
+    uint64_t expiry;
+    timer_wheel_node_t node;
+} bench_timer_t;
+
+static bench_timer_t list_head = { &list_head, &list_head, UINT64_MAX, { 0 } };
+
+static void list_insert(bench_timer_t *t, uint64_t expiry)
+{
+    bench_timer_t *pos = list_head.next;
+
+    t->expiry = expiry;
+    while (pos != &list_head && pos->expiry <= expiry) {
+        pos = pos->next;
+    }
+    t->next = pos;
+    t->prev = pos->prev;
+    pos->prev->next = t;
+    pos->prev = t;
+}
+
+static void list_remove(bench_timer_t *t)
+{
+    if (t->next) {
+        t->prev->next = t->next;
+        t->next->prev = t->prev;
+        t->next = t->prev = NULL;
+    }
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void benchmark(int n)
+{
+    bench_timer_t *timers = calloc(n, sizeof(bench_timer_t));
+    uint32_t *periods = malloc(n * sizeof(uint32_t));
+    timer_wheel_t w;
+    const int rounds = 50;
+    double t0, start_ns[2] = { 0 }, restart_ns[2] = { 0 }, stop_ns[2] = { 0 }, expire_ns[2] = { 0 };
+
+    /* Mix of short retries and animations, and longer timeouts */
+    for (int i = 0; i < n; i++) {
+        periods[i] = random() % 4 ? 1 + random() % 100 : 100 + random() % 30000;
+    }
+    for (int r = 0; r < rounds; r++) {
+        uint32_t now = random();
+
+        timer_wheel_init(&w, now);
+        t0 = now_ns();
+        for (int i = 0; i < n; i++) {
+            timer_wheel_add(&w, &timers[i].node, now, periods[i]);
+        }
+        start_ns[0] += now_ns() - t0;
+        t0 = now_ns();
+        for (int i = 0; i < n; i++) {
+            timer_wheel_add(&w, &timers[i].node, now + 1, periods[(i + 7) % n]);
+        }
+        restart_ns[0] += now_ns() - t0;
+        t0 = now_ns();
+        for (int i = 0; i < n; i++) {
+            timer_wheel_remove(&w, &timers[i].node);
+        }
+        stop_ns[0] += now_ns() - t0;
+        for (int i = 0; i < n; i++) {
+            timer_wheel_add(&w, &timers[i].node, now, periods[i]);
+        }
+        t0 = now_ns();
+        for (int i = 0; timer_wheel_expire(&w, now + 40000); i++) {
+        }
+        expire_ns[0] += now_ns() - t0;
+
+        t0 = now_ns();
+        for (int i = 0; i < n; i++) {
+            list_insert(&timers[i], (uint64_t)now + periods[i]);
+        }
+        start_ns[1] += now_ns() - t0;
+        t0 = now_ns();
+        for (int i = 0; i < n; i++) {
+            list_remove(&timers[i]);
+            list_insert(&timers[i], (uint64_t)now + 1 + periods[(i + 7) % n]);
+        }
+        restart_ns[1] += now_ns() - t0;
+        t0 = now_ns();
+        for (int i = 0; i < n; i++) {
+            list_remove(&timers[i]);
+        }
+        stop_ns[1] += now_ns() - t0;
+        for (int i = 0; i < n; i++) {
+            list_insert(&timers[i], (uint64_t)now + periods[i]);
+        }
+        t0 = now_ns();
+        while (list_head.next != &list_head && list_head.next->expiry <= (uint64_t)now + 40000) {
+            list_remove(list_head.next);
+        }
+        expire_ns[1] += now_ns() - t0;
+    }
+
+    double per = (double)rounds * n;
+    printf("%d timers, ns per timer    start  restart     stop   expire\n", n);
+    printf("timer wheel            %8.1f %8.1f %8.1f %8.1f\n",
+           start_ns[0] / per, restart_ns[0] / per, stop_ns[0] / per, expire_ns[0] / per);
+    printf("sorted list            %8.1f %8.1f %8.1f %8.1f\n",
+           start_ns[1] / per, restart_ns[1] / per, stop_ns[1] / per, expire_ns[1] / per);
+    free(timers);
+    free(periods);
+}
+
+int main(int argc, char **argv)
+{
+    int bench = 1000;
+    int opt;
+
+    srandom(1);
+    while ((opt = getopt(argc, argv, "b:s:")) != -1) {
+        switch (opt) {
+        case 'b':
+            bench = atoi(optarg);
+            break;
+        case 's':
+            srandom(strtoul(optarg, NULL, 0));
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-b timers] [-s seed]\n", argv[0]);
+            return 2;
+        }
+    }
+    benchmark(bench);
+    return 0;
+}